@@ -0,0 +1,737 @@
+/**
+ @file arc.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Sector archive: a collection of disk images sharing one pool of unique sectors
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "v80.h"
+#include "stats.h"
+#include "vdi.h"
+#include "hash.h"
+#include "arc.h"
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CARC::CARC()
+: m_pTable(NULL), m_dwSectors(0)
+{
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CARC::~CARC()
+{
+    free(m_pTable);
+}
+
+//---------------------------------------------------------------------------------
+// Find the image in the archive (m_pMember, or the first one) and load its references
+//---------------------------------------------------------------------------------
+
+DWORD CARC::Load(HANDLE hFile, DWORD dwFlags)
+{
+
+    ARC_HEADER  Header;
+    ARC_IMAGE*  pImages = NULL;
+    DWORD       x = 0;
+    DWORD       dwError;
+
+    if ((dwError = Directory(hFile, Header, pImages)) != NO_ERROR)
+        goto Done;
+
+    if (m_pMember != NULL)
+        for (x = 0; x < Header.dwImages && strncmp(pImages[x].szName, m_pMember, ARC_NAME) != 0; x++);
+
+    if (x >= Header.dwImages)
+    {
+        dwError = (m_pMember != NULL ? ERROR_NOT_FOUND : ERROR_UNRECOGNIZED_MEDIA);
+        goto Done;
+    }
+
+    // The references must cover the geometry exactly
+    if (pImages[x].dwSectors != Count(pImages[x].DG))
+    {
+        dwError = ERROR_FILE_CORRUPT;
+        goto Done;
+    }
+
+    free(m_pTable);
+
+    if ((m_pTable = (DWORD*)malloc(pImages[x].dwSectors * sizeof(DWORD))) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    STAT_COUNT(STAT_SEEK);
+    if (fseeko(hFile, pImages[x].qwTable, SEEK_SET) == -1)
+    {
+        dwError = ERROR_SEEK;
+        goto Done;
+    }
+
+    if (fread(m_pTable, sizeof(DWORD), pImages[x].dwSectors, hFile) != pImages[x].dwSectors)
+    {
+        dwError = ERROR_READ_FAULT;
+        goto Done;
+    }
+
+    // The geometry comes from the directory (a preset one is not needed)
+    m_DG = pImages[x].DG;
+    m_dwSectors = pImages[x].dwSectors;
+
+    // Copy file handle and user flags to member variables
+    m_hFile = hFile;
+    m_dwFlags = dwFlags;
+
+    Done:
+    free(pImages);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Read one sector from the pool
+//---------------------------------------------------------------------------------
+
+DWORD CARC::Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize)
+{
+
+    VDI_TRACK*  pTrack;
+    DWORD       dwIndex;
+    DWORD       dwBytes;
+    DWORD       dwError;
+
+    if ((dwError = Index(m_DG, nTrack, nSide, nSector, dwIndex)) != NO_ERROR)
+        goto Done;
+
+    // Get a pointer to the correct track descriptor
+    pTrack = (nTrack == m_DG.FT.nTrack ? &m_DG.FT : &m_DG.LT);
+
+    // Check caller's buffer size
+    if (wSize < pTrack->wSectorSize)
+    {
+        dwError = ERROR_INVALID_USER_BUFFER;
+        goto Done;
+    }
+
+    // The sector could not be read when the disk was archived
+    if (m_pTable[dwIndex] == ARC_NONE)
+    {
+        dwError = ERROR_READ_FAULT;
+        goto Done;
+    }
+
+    STAT_COUNT(STAT_SEEK);
+    if (fseeko(m_hFile, (off_t)m_pTable[dwIndex] * ARC_UNIT, SEEK_SET) == -1)
+    {
+        dwError = ERROR_SEEK;
+        goto Done;
+    }
+
+    // Read one sector directly to the caller's buffer
+    if ((dwBytes = fread(pBuffer, 1, pTrack->wSectorSize, m_hFile)) != pTrack->wSectorSize)
+    {
+        dwError = ERROR_READ_FAULT;
+        goto Done;
+    }
+
+    STAT_COUNT(STAT_VDI_READ);
+    STAT_ADD(STAT_BYTES_READ, dwBytes);
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Archived disks are read-only (a sector may be shared by many images)
+//---------------------------------------------------------------------------------
+
+DWORD CARC::Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize)
+{
+    return ERROR_NOT_SUPPORTED;
+}
+
+//---------------------------------------------------------------------------------
+// Archive file offset of a sector (the ones stored in the first 4 GB)
+//---------------------------------------------------------------------------------
+
+DWORD CARC::Offset(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset)
+{
+
+    DWORD   dwIndex;
+    DWORD   dwError;
+
+    if ((dwError = Index(m_DG, nTrack, nSide, nSector, dwIndex)) != NO_ERROR)
+        return dwError;
+
+    if (m_pTable[dwIndex] == ARC_NONE || m_pTable[dwIndex] >= 0xFFFFFFFFU / ARC_UNIT)
+        return ERROR_NOT_SUPPORTED;
+
+    dwOffset = m_pTable[dwIndex] * ARC_UNIT;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Read the header and the directory of an archive (the caller frees pImages)
+//---------------------------------------------------------------------------------
+
+DWORD CARC::Directory(FILE* hFile, ARC_HEADER& Header, ARC_IMAGE*& pImages)
+{
+
+    pImages = NULL;
+
+    STAT_COUNT(STAT_SEEK);
+    if (fseeko(hFile, 0, SEEK_SET) == -1)
+        return ERROR_SEEK;
+
+    if (fread(&Header, 1, sizeof(Header), hFile) != sizeof(Header))
+        return ERROR_UNRECOGNIZED_MEDIA;
+
+    if (memcmp(Header.cMagic, ARC_MAGIC, sizeof(Header.cMagic)) != 0 || Header.wVersion != ARC_VERSION || Header.wHeaderSize != sizeof(ARC_HEADER))
+        return ERROR_UNRECOGNIZED_MEDIA;
+
+    if ((pImages = (ARC_IMAGE*)malloc((Header.dwImages + 1) * sizeof(ARC_IMAGE))) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    STAT_COUNT(STAT_SEEK);
+    if (fseeko(hFile, Header.qwDirectory, SEEK_SET) == -1 || fread(pImages, sizeof(ARC_IMAGE), Header.dwImages, hFile) != Header.dwImages)
+    {
+        free(pImages);
+        pImages = NULL;
+        return ERROR_FILE_CORRUPT;
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Reference number of a sector: the first track, then the rest, side by side
+//---------------------------------------------------------------------------------
+
+DWORD CARC::Index(const VDI_GEOMETRY& DG, BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwIndex)
+{
+
+    const VDI_TRACK*    pTrack = (nTrack == DG.FT.nTrack ? &DG.FT : &DG.LT);
+    DWORD               dwSides;
+    DWORD               dwSectors;
+
+    if (nTrack < DG.FT.nTrack || nTrack > DG.LT.nTrack || nSide < pTrack->nFirstSide || nSide > pTrack->nLastSide || nSector < pTrack->nFirstSector || nSector > pTrack->nLastSector)
+        return ERROR_SECTOR_NOT_FOUND;
+
+    dwSides = pTrack->nLastSide - pTrack->nFirstSide + 1;
+    dwSectors = pTrack->nLastSector - pTrack->nFirstSector + 1;
+
+    if (nTrack == DG.FT.nTrack)
+        dwIndex = (nSide - pTrack->nFirstSide) * dwSectors + (nSector - pTrack->nFirstSector);
+    else
+        dwIndex = (DG.FT.nLastSide - DG.FT.nFirstSide + 1) * (DG.FT.nLastSector - DG.FT.nFirstSector + 1) +
+            ((nTrack - DG.FT.nTrack - 1) * dwSides + (nSide - pTrack->nFirstSide)) * dwSectors + (nSector - pTrack->nFirstSector);
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Number of sectors of a geometry
+//---------------------------------------------------------------------------------
+
+DWORD CARC::Count(const VDI_GEOMETRY& DG)
+{
+    return (DG.FT.nLastSide - DG.FT.nFirstSide + 1) * (DG.FT.nLastSector - DG.FT.nFirstSector + 1) +
+        (DG.LT.nTrack - DG.FT.nTrack) * (DG.LT.nLastSide - DG.LT.nFirstSide + 1) * (DG.LT.nLastSector - DG.LT.nFirstSector + 1);
+}
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CArchive::CArchive()
+: m_hFile(-1), m_pPath(NULL), m_pTemp(NULL), m_Header(), m_pImages(NULL), m_pSlots(NULL), m_dwSlots(0), m_qwEnd(0)
+{
+    pthread_mutex_init(&m_Mutex, NULL);
+}
+
+//---------------------------------------------------------------------------------
+// Discard an unfinished archive
+//---------------------------------------------------------------------------------
+
+CArchive::~CArchive()
+{
+
+    if (m_hFile != -1)
+    {
+        close(m_hFile);
+        unlink(m_pTemp);
+    }
+
+    free(m_pPath);
+    free(m_pTemp);
+    free(m_pImages);
+    free(m_pSlots);
+
+    pthread_mutex_destroy(&m_Mutex);
+
+}
+
+//---------------------------------------------------------------------------------
+// Start a new archive (written under a temporary name until End)
+//---------------------------------------------------------------------------------
+
+DWORD CArchive::Create(const char* pPath)
+{
+
+    size_t  nLength = strlen(pPath);
+
+    if ((m_pPath = strdup(pPath)) == NULL || (m_pTemp = (char*)malloc(nLength + 5)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    snprintf(m_pTemp, nLength + 5, "%s.tmp", pPath);
+
+    m_dwSlots = 4096;
+
+    if ((m_pSlots = (ARC_SLOT*)calloc(m_dwSlots, sizeof(ARC_SLOT))) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    if ((m_hFile = open(m_pTemp, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1)
+        return ERROR_WRITE_FAULT;
+
+    // The header is written last, the pool starts right after it
+    memcpy(m_Header.cMagic, ARC_MAGIC, sizeof(m_Header.cMagic));
+    m_Header.wVersion = ARC_VERSION;
+    m_Header.wHeaderSize = sizeof(ARC_HEADER);
+
+    m_qwEnd = sizeof(ARC_HEADER);
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Add an image: new sectors go to the pool, followed by the image reference table
+//---------------------------------------------------------------------------------
+
+DWORD CArchive::Add(const char* pName, const char* pVDI, ARC_DISK& Disk, DWORD& dwNew)
+{
+
+    ARC_IMAGE*  pImage;
+    BYTE*       pPending = NULL;
+    DWORD*      pTable;
+    DWORD       dwFirst;
+    DWORD       dwUsed = 0;
+    DWORD       dwData = 0;
+    DWORD       dwUnit;
+    DWORD       x;
+    WORD        wSize;
+    ssize_t     nWritten;
+    DWORD       dwError = NO_ERROR;
+
+    dwNew = 0;
+
+    if (strlen(pName) >= ARC_NAME)
+        return ERROR_INVALID_NAME;
+
+    pthread_mutex_lock(&m_Mutex);
+
+    if (m_hFile == -1)
+    {
+        dwError = ERROR_WRITE_FAULT;
+        goto Done;
+    }
+
+    // Image names must tell the images apart
+    for (x = 0; x < m_Header.dwImages; x++)
+    {
+        if (strcmp(m_pImages[x].szName, pName) == 0)
+        {
+            dwError = ERROR_FILE_EXISTS;
+            goto Done;
+        }
+    }
+
+    if (m_Header.dwImages % 64 == 0)
+    {
+        if ((pImage = (ARC_IMAGE*)realloc(m_pImages, (m_Header.dwImages + 64) * sizeof(ARC_IMAGE))) == NULL)
+        {
+            dwError = ERROR_OUTOFMEMORY;
+            goto Done;
+        }
+        m_pImages = pImage;
+    }
+
+    // Room for every sector (if none is in the pool yet) and the reference table, in ARC_UNITs
+    dwFirst = (Disk.DG.FT.nLastSide - Disk.DG.FT.nFirstSide + 1) * (Disk.DG.FT.nLastSector - Disk.DG.FT.nFirstSector + 1);
+
+    for (x = 0; x < Disk.dwSectors; x++)
+        dwData += (x < dwFirst ? Disk.DG.FT.wSectorSize : Disk.DG.LT.wSectorSize);
+
+    if ((pPending = (BYTE*)malloc(dwData + (Disk.dwSectors * sizeof(DWORD) + ARC_UNIT - 1) / ARC_UNIT * ARC_UNIT)) == NULL ||
+        (pTable = (DWORD*)malloc(Disk.dwSectors * sizeof(DWORD))) == NULL)
+    {
+        free(pPending);
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    // Reference each sector, appending the ones the pool doesn't have
+    for (x = 0, dwData = 0; x < Disk.dwSectors; dwData += wSize, x++)
+    {
+
+        wSize = (x < dwFirst ? Disk.DG.FT.wSectorSize : Disk.DG.LT.wSectorSize);
+
+        if (Disk.pHash[x] == 0)
+        {
+            pTable[x] = ARC_NONE;
+            continue;
+        }
+
+        m_Header.qwRaw += wSize;
+
+        if (Find(&Disk.pData[dwData], wSize, Disk.pHash[x], pPending, m_qwEnd, dwUnit) == NO_ERROR)
+        {
+            pTable[x] = dwUnit;
+            continue;
+        }
+
+        dwUnit = (m_qwEnd + dwUsed) / ARC_UNIT;
+
+        if ((dwError = Insert(Disk.pHash[x], wSize, dwUnit)) != NO_ERROR)
+            break;
+
+        memcpy(&pPending[dwUsed], &Disk.pData[dwData], wSize);
+        dwUsed += wSize;
+
+        pTable[x] = dwUnit;
+
+        m_Header.dwBlocks++;
+        m_Header.qwPool += wSize;
+        dwNew++;
+
+    }
+
+    // The reference table follows the new sectors (every sector size is a multiple of ARC_UNIT)
+    if (dwError == NO_ERROR)
+    {
+
+        pImage = &m_pImages[m_Header.dwImages];
+        memset(pImage, 0, sizeof(ARC_IMAGE));
+        strcpy(pImage->szName, pName);
+        strncpy(pImage->cVDI, pVDI, sizeof(pImage->cVDI));
+        pImage->DG = Disk.DG;
+        pImage->dwSectors = Disk.dwSectors;
+        pImage->dwBad = Disk.dwBad;
+        pImage->qwTable = m_qwEnd + dwUsed;
+
+        memcpy(&pPending[dwUsed], pTable, Disk.dwSectors * sizeof(DWORD));
+        memset(&pPending[dwUsed + Disk.dwSectors * sizeof(DWORD)], 0, (ARC_UNIT - Disk.dwSectors * sizeof(DWORD) % ARC_UNIT) % ARC_UNIT);
+        dwUsed += (Disk.dwSectors * sizeof(DWORD) + ARC_UNIT - 1) / ARC_UNIT * ARC_UNIT;
+
+        // One write for the whole image
+        for (x = 0; x < dwUsed; x += nWritten)
+        {
+            if ((nWritten = pwrite(m_hFile, &pPending[x], dwUsed - x, m_qwEnd + x)) <= 0)
+            {
+                dwError = ERROR_WRITE_FAULT;
+                break;
+            }
+        }
+
+    }
+
+    // The pool index already points into this image's data, so a failure ends the archive
+    if (dwError != NO_ERROR)
+    {
+        close(m_hFile);
+        unlink(m_pTemp);
+        m_hFile = -1;
+    }
+    else
+    {
+        m_qwEnd += dwUsed;
+        m_Header.qwSectors += Disk.dwSectors;
+        m_Header.dwImages++;
+    }
+
+    free(pTable);
+    free(pPending);
+
+    Done:
+    pthread_mutex_unlock(&m_Mutex);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write the directory and the header, then give the archive its final name
+//---------------------------------------------------------------------------------
+
+DWORD CArchive::End()
+{
+
+    DWORD   dwError = NO_ERROR;
+
+    pthread_mutex_lock(&m_Mutex);
+
+    if (m_hFile == -1)
+    {
+        dwError = ERROR_WRITE_FAULT;
+        goto Done;
+    }
+
+    m_Header.qwDirectory = m_qwEnd;
+
+    if (pwrite(m_hFile, m_pImages, m_Header.dwImages * sizeof(ARC_IMAGE), m_qwEnd) != (ssize_t)(m_Header.dwImages * sizeof(ARC_IMAGE)) ||
+        pwrite(m_hFile, &m_Header, sizeof(ARC_HEADER), 0) != sizeof(ARC_HEADER))
+        dwError = ERROR_WRITE_FAULT;
+
+    if (close(m_hFile) != 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    m_hFile = -1;
+
+    if (dwError == NO_ERROR && rename(m_pTemp, m_pPath) != 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    if (dwError != NO_ERROR)
+        unlink(m_pTemp);
+
+    Done:
+    pthread_mutex_unlock(&m_Mutex);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Copy the archive counters
+//---------------------------------------------------------------------------------
+
+void CArchive::GetHeader(ARC_HEADER& Header)
+{
+    pthread_mutex_lock(&m_Mutex);
+    Header = m_Header;
+    pthread_mutex_unlock(&m_Mutex);
+}
+
+//---------------------------------------------------------------------------------
+// Read and hash every sector of a disk, in reference order (outside the archive lock)
+//---------------------------------------------------------------------------------
+
+DWORD CArchive::Snap(CVDI* pVDI, ARC_DISK& Disk)
+{
+
+    VDI_TRACK*  pTrack;
+    CHash       XXH;
+    DWORD       dwData = 0;
+    DWORD       x = 0;
+    BYTE        nTrack, nSide, nSector;
+
+    memset(&Disk, 0, sizeof(Disk));
+
+    pVDI->GetDG(Disk.DG);
+
+    Disk.dwSectors = CARC::Count(Disk.DG);
+
+    if ((Disk.pData = (BYTE*)malloc(Disk.dwSectors * 1024)) == NULL || (Disk.pHash = (unsigned long long*)calloc(Disk.dwSectors, sizeof(unsigned long long))) == NULL)
+    {
+        Release(Disk);
+        return ERROR_OUTOFMEMORY;
+    }
+
+    for (nTrack = Disk.DG.FT.nTrack; nTrack <= Disk.DG.LT.nTrack; nTrack++)
+    {
+
+        pTrack = (nTrack == Disk.DG.FT.nTrack ? &Disk.DG.FT : &Disk.DG.LT);
+
+        for (nSide = pTrack->nFirstSide; nSide <= pTrack->nLastSide; nSide++)
+        {
+            for (nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++, x++)
+            {
+
+                // An unreadable sector is kept as a missing reference (hash 0)
+                if (pVDI->Read(nTrack, nSide, nSector, &Disk.pData[dwData], pTrack->wSectorSize) != NO_ERROR)
+                {
+                    memset(&Disk.pData[dwData], 0, pTrack->wSectorSize);
+                    Disk.dwBad++;
+                }
+                else
+                {
+                    XXH.Reset(pTrack->wSectorSize);
+                    XXH.Update(&Disk.pData[dwData], pTrack->wSectorSize);
+                    Disk.pHash[x] = (XXH.Digest() | 1);
+                }
+
+                dwData += pTrack->wSectorSize;
+
+                if (nSector == 0xFF)
+                    break;
+
+            }
+        }
+
+        if (nTrack == 0xFF)
+            break;
+
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Contents of a snapped sector (NULL: unreadable or off the disk)
+//---------------------------------------------------------------------------------
+
+const BYTE* CArchive::Sector(const ARC_DISK& Disk, BYTE nTrack, BYTE nSide, BYTE nSector)
+{
+
+    DWORD   dwFirst = (Disk.DG.FT.nLastSide - Disk.DG.FT.nFirstSide + 1) * (Disk.DG.FT.nLastSector - Disk.DG.FT.nFirstSector + 1);
+    DWORD   dwIndex;
+
+    if (Disk.pData == NULL || CARC::Index(Disk.DG, nTrack, nSide, nSector, dwIndex) != NO_ERROR || Disk.pHash[dwIndex] == 0)
+        return NULL;
+
+    // The first track may have a sector size of its own
+    if (dwIndex < dwFirst)
+        return &Disk.pData[dwIndex * Disk.DG.FT.wSectorSize];
+
+    return &Disk.pData[dwFirst * Disk.DG.FT.wSectorSize + (dwIndex - dwFirst) * Disk.DG.LT.wSectorSize];
+
+}
+
+//---------------------------------------------------------------------------------
+// Free the memory of a snapped disk
+//---------------------------------------------------------------------------------
+
+void CArchive::Release(ARC_DISK& Disk)
+{
+
+    free(Disk.pData);
+    free(Disk.pHash);
+
+    Disk.pData = NULL;
+    Disk.pHash = NULL;
+
+}
+
+//---------------------------------------------------------------------------------
+// Look a sector up in the pool (pPending holds the data not yet written, from qwPending)
+//---------------------------------------------------------------------------------
+
+DWORD CArchive::Find(const BYTE* pData, WORD wSize, unsigned long long qwHash, const BYTE* pPending, unsigned long long qwPending, DWORD& dwUnit)
+{
+
+    BYTE                Buffer[1024];
+    unsigned long long  qwOffset;
+    DWORD               x;
+
+    for (x = qwHash & (m_dwSlots - 1); m_pSlots[x].dwUnit != ARC_NONE; x = (x + 1) & (m_dwSlots - 1))
+    {
+
+        if (m_pSlots[x].qwHash != qwHash || m_pSlots[x].wSize != wSize)
+            continue;
+
+        // Same hash: compare the contents, so that a collision never merges two sectors
+        qwOffset = (unsigned long long)m_pSlots[x].dwUnit * ARC_UNIT;
+
+        if (qwOffset >= qwPending)
+        {
+            if (memcmp(&pPending[qwOffset - qwPending], pData, wSize) != 0)
+                continue;
+        }
+        else if (pread(m_hFile, Buffer, wSize, qwOffset) != wSize || memcmp(Buffer, pData, wSize) != 0)
+            continue;
+
+        dwUnit = m_pSlots[x].dwUnit;
+        return NO_ERROR;
+
+    }
+
+    return ERROR_NOT_FOUND;
+
+}
+
+//---------------------------------------------------------------------------------
+// Add a sector to the pool index (kept at most half full)
+//---------------------------------------------------------------------------------
+
+DWORD CArchive::Insert(unsigned long long qwHash, WORD wSize, DWORD dwUnit)
+{
+
+    ARC_SLOT*   pSlots;
+    DWORD       dwSlots;
+    DWORD       x, y;
+
+    // Double the index, rehashing the entries
+    if ((m_Header.dwBlocks + 1) * 2 > m_dwSlots)
+    {
+
+        dwSlots = m_dwSlots * 2;
+
+        if ((pSlots = (ARC_SLOT*)calloc(dwSlots, sizeof(ARC_SLOT))) == NULL)
+            return ERROR_OUTOFMEMORY;
+
+        for (x = 0; x < m_dwSlots; x++)
+        {
+            if (m_pSlots[x].dwUnit == ARC_NONE)
+                continue;
+            for (y = m_pSlots[x].qwHash & (dwSlots - 1); pSlots[y].dwUnit != ARC_NONE; y = (y + 1) & (dwSlots - 1));
+            pSlots[y] = m_pSlots[x];
+        }
+
+        free(m_pSlots);
+        m_pSlots = pSlots;
+        m_dwSlots = dwSlots;
+
+    }
+
+    for (x = qwHash & (m_dwSlots - 1); m_pSlots[x].dwUnit != ARC_NONE; x = (x + 1) & (m_dwSlots - 1));
+
+    m_pSlots[x].qwHash = qwHash;
+    m_pSlots[x].wSize = wSize;
+    m_pSlots[x].dwUnit = dwUnit;
+
+    return NO_ERROR;
+
+}
@@ -0,0 +1,143 @@
+/**
+ @file arc.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Sector archive: a collection of disk images sharing one pool of unique sectors
+//---------------------------------------------------------------------------------
+//
+// File layout (offsets in bytes, every block aligned to ARC_UNIT):
+//
+//   ARC_HEADER                     magic, counts and the directory offset
+//   sector pool                    each distinct sector content stored once
+//   reference tables               one DWORD per sector of an image, in ARC_UNITs
+//   ARC_IMAGE[dwImages]            directory: name, source format, geometry, table
+//
+// An image is its VDI geometry plus one reference per sector, in track, side and
+// sector order (the first track, then the rest). The pool and the tables of an
+// image are appended together, so an archive is written in one pass.
+//
+// CArchive builds an archive; CARC is the disk interface that reads one image
+// straight out of it ("archive:image" as the image filename). Archived disks are
+// read-only, and keep only the sectors of their geometry (DAM marks, CRC status
+// and sectors outside the geometry are not kept).
+//
+//---------------------------------------------------------------------------------
+
+#include <pthread.h>
+
+#define ARC_MAGIC           "V80A"                                                  // Archive file signature
+#define ARC_VERSION         1                                                       // Archive file format version
+#define ARC_EXT             ".v80a"                                                 // Usual archive extension
+#define ARC_UNIT            128                                                     // Pool allocation unit (smallest sector size)
+#define ARC_NONE            0                                                       // Reference of a sector that could not be read
+#define ARC_NAME            120                                                     // Room for an image name (without directory)
+
+struct  __attribute__((packed)) ARC_HEADER                                          // Archive header (one ARC_UNIT)
+{
+    char        cMagic[4];                                                          // ARC_MAGIC
+    WORD        wVersion;                                                           // ARC_VERSION
+    WORD        wHeaderSize;                                                        // sizeof(ARC_HEADER)
+    DWORD       dwImages;                                                           // Number of images in the directory
+    DWORD       dwBlocks;                                                           // Number of distinct sectors in the pool
+    unsigned long long qwDirectory;                                                 // Directory offset
+    unsigned long long qwPool;                                                      // Bytes of sector data in the pool
+    unsigned long long qwRaw;                                                       // Bytes of sector data referenced by the images
+    unsigned long long qwSectors;                                                   // Number of sector references
+    BYTE        Reserved[ARC_UNIT - 48];                                            // Zero
+};
+
+struct  __attribute__((packed)) ARC_IMAGE                                           // Directory entry
+{
+    char        szName[ARC_NAME];                                                   // Image filename
+    char        cVDI[4];                                                            // Source disk format ("DMK", "JV1", "JV3")
+    VDI_GEOMETRY DG;                                                                // Disk geometry
+    DWORD       dwSectors;                                                          // Number of references in the table
+    DWORD       dwBad;                                                              // Sectors that could not be read from the source
+    unsigned long long qwTable;                                                     // Reference table offset
+};
+
+struct  ARC_DISK                                                                    // A disk read into memory, ready to be added
+{
+    VDI_GEOMETRY DG;                                                                // Disk geometry
+    DWORD       dwSectors;                                                          // Number of sectors
+    DWORD       dwBad;                                                              // Sectors that could not be read
+    BYTE*       pData;                                                              // Sector contents, back to back in reference order
+    unsigned long long* pHash;                                                      // Content hash of each sector (0: unreadable)
+};
+
+struct  ARC_SLOT                                                                    // Pool index entry (build time only)
+{
+    unsigned long long qwHash;                                                      // Sector content hash
+    DWORD       dwUnit;                                                             // Where the sector is, in ARC_UNITs (ARC_NONE: free slot)
+    WORD        wSize;                                                              // Sector size
+};
+
+class   CARC: public CVDI
+{
+protected:
+    DWORD*      m_pTable;                                                           // Sector references of the loaded image
+    DWORD       m_dwSectors;                                                        // Number of references
+public:
+                CARC();                                                                     // Initialize member variables
+                ~CARC();                                                                    // Release allocated memory
+    DWORD       Load(HANDLE hFile, DWORD dwFlags);                                          // Find the image in the archive and load its references
+    DWORD       Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);     // Read one sector from the pool
+    DWORD       Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);    // Archived disks are read-only
+    DWORD       Offset(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset);             // Archive file offset of a sector (first 4 GB)
+    static DWORD Directory(FILE* hFile, ARC_HEADER& Header, ARC_IMAGE*& pImages);           // Read the header and the directory (free() pImages)
+    static DWORD Index(const VDI_GEOMETRY& DG, BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwIndex); // Reference number of a sector
+    static DWORD Count(const VDI_GEOMETRY& DG);                                             // Number of sectors of a geometry
+};
+
+class   CArchive
+{
+protected:
+    int         m_hFile;                                                            // Archive being written (under a temporary name)
+    char*       m_pPath;                                                            // Final archive path
+    char*       m_pTemp;                                                            // Temporary archive path
+    ARC_HEADER  m_Header;                                                           // Header, completed by End()
+    ARC_IMAGE*  m_pImages;                                                          // Directory
+    ARC_SLOT*   m_pSlots;                                                           // Pool index (open addressing)
+    DWORD       m_dwSlots;                                                          // Size of the pool index (a power of two)
+    unsigned long long m_qwEnd;                                                     // End of the archive data
+    pthread_mutex_t m_Mutex;                                                        // Serializes Add() and End()
+public:
+                CArchive();                                                                 // Initialize member variables
+                ~CArchive();                                                                // Discard an unfinished archive
+    DWORD       Create(const char* pPath);                                                  // Start a new archive
+    DWORD       Add(const char* pName, const char* pVDI, ARC_DISK& Disk, DWORD& dwNew);     // Add an image (dwNew: sectors new to the pool)
+    DWORD       End();                                                                      // Write the directory and the header, then name the archive
+    void        GetHeader(ARC_HEADER& Header);                                              // Copy the archive counters
+    static DWORD Snap(CVDI* pVDI, ARC_DISK& Disk);                                          // Read and hash every sector of a disk (free with Release)
+    static void Release(ARC_DISK& Disk);                                                    // Free the memory of a snapped disk
+    static const BYTE* Sector(const ARC_DISK& Disk, BYTE nTrack, BYTE nSide, BYTE nSector);   // Contents of a snapped sector (NULL: unreadable or off the disk)
+protected:
+    DWORD       Find(const BYTE* pData, WORD wSize, unsigned long long qwHash, const BYTE* pPending, unsigned long long qwPending, DWORD& dwUnit); // Look a sector up in the pool
+    DWORD       Insert(unsigned long long qwHash, WORD wSize, DWORD dwUnit);                // Add a sector to the pool index
+};
@@ -0,0 +1,129 @@
+#!/bin/sh
+#---------------------------------------------------------------------------------
+# VDK-80 benchmark driver
+#---------------------------------------------------------------------------------
+#
+# Generates a matrix of synthetic images (every disk format, DOS, density and side
+# count) with bench/mkimg, times each v80 operation on them and prints one JSON
+# object per measurement on stdout:
+#
+#   {"vdi":"jv1","dos":"td4","density":"dd","sides":2,"op":"get","files":60,
+#    "seconds":0.001234,"status":0}
+#
+# "seconds" is the best of REPEAT runs and "status" the v80 exit status of the
+# last one. Operations are run with the disk and DOS interfaces forced, except
+# "probe" which times the auto-detection of both on the populated image.
+#
+# Environment:
+#   V80      v80 binary (default ./v80)
+#   MKIMG    image generator (default bench/mkimg)
+#   TRACKS   tracks per side (default 40)
+#   FILES    files per populated image (default 60, capped by the disk/directory)
+#   REPEAT   runs per measurement (default 3)
+#   SEED     generator seed (default 1)
+#   VDIS     disk formats to include (default "jv1 jv3 dmk")
+#   DOSES    DOSes to include (default "td1 td3 td4 rd nd dd md cpm")
+#
+#---------------------------------------------------------------------------------
+
+V80=${V80:-./v80}
+MKIMG=${MKIMG:-bench/mkimg}
+TRACKS=${TRACKS:-40}
+FILES=${FILES:-60}
+REPEAT=${REPEAT:-3}
+SEED=${SEED:-1}
+VDIS=${VDIS:-"jv1 jv3 dmk"}
+DOSES=${DOSES:-"td1 td3 td4 rd nd dd md cpm"}
+
+TMP=$(mktemp -d "${TMPDIR:-/tmp}/v80bench.XXXXXX") || exit 1
+trap 'rm -rf "$TMP"' EXIT INT TERM
+
+#---------------------------------------------------------------------------------
+# Operations each DOS interface supports (MicroDOS is read-only, CP/M list-only)
+#---------------------------------------------------------------------------------
+
+ops()
+{
+    case $1 in
+        md)     echo "probe dir get dump" ;;
+        cpm)    echo "probe dir dump" ;;
+        *)      echo "probe dir get put ren del dump" ;;
+    esac
+}
+
+#---------------------------------------------------------------------------------
+# Prepare the inputs of an operation (not timed)
+#---------------------------------------------------------------------------------
+
+setup()
+{
+    rm -rf "$TMP/out" "$TMP/work.dsk"
+    mkdir "$TMP/out"
+    case $1 in
+        put)        cp "$TMP/blank.dsk" "$TMP/work.dsk" ;;
+        ren|del)    cp "$TMP/full.dsk" "$TMP/work.dsk" ;;
+    esac
+}
+
+#---------------------------------------------------------------------------------
+# Run an operation once
+#---------------------------------------------------------------------------------
+
+run()
+{
+    case $1 in
+        probe)  "$V80" -l "$TMP/full.dsk" ;;
+        dir)    "$V80" -l $FORCE "$TMP/full.dsk" ;;
+        get)    "$V80" -r $FORCE "$TMP/full.dsk" '*.*' "$TMP/out" ;;
+        put)    "$V80" -w $FORCE "$TMP/work.dsk" "$TMP/files" ;;
+        ren)    "$V80" -n $FORCE "$TMP/work.dsk" '*.DAT' '*.BIN' ;;
+        del)    "$V80" -k $FORCE "$TMP/work.dsk" '*.*' ;;
+        dump)   "$V80" -d $FORCE "$TMP/full.dsk" ;;
+    esac > /dev/null 2>&1
+}
+
+#---------------------------------------------------------------------------------
+# Main
+#---------------------------------------------------------------------------------
+
+for VDI in $VDIS; do
+for DOS in $DOSES; do
+for DENSITY in sd dd; do
+for SIDES in 1 2; do
+
+    # TRSDOS Model III only handles single-sided disks
+    "$MKIMG" $VDI $DOS $DENSITY $SIDES $TRACKS 0 $SEED "$TMP/blank.dsk" 2> /dev/null || continue
+    "$MKIMG" $VDI $DOS $DENSITY $SIDES $TRACKS $FILES $SEED "$TMP/full.dsk" || continue
+
+    FORCE="-$VDI -$DOS"
+
+    # Host copies of the files, used as the source of "put"
+    rm -rf "$TMP/files"
+    mkdir "$TMP/files"
+    "$V80" -r $FORCE "$TMP/full.dsk" '*.*' "$TMP/files" > /dev/null 2>&1
+    NFILES=$("$V80" -l $FORCE "$TMP/full.dsk" | sed -n 's/.* in \([0-9]*\) files.*/\1/p')
+
+    for OP in $(ops $DOS); do
+
+        BEST=
+        for N in $(seq $REPEAT); do
+            setup $OP
+            T0=$(date +%s%N)
+            run $OP
+            STATUS=$?
+            T1=$(date +%s%N)
+            T=$((T1 - T0))
+            if [ -z "$BEST" ] || [ $T -lt $BEST ]; then
+                BEST=$T
+            fi
+        done
+
+        printf '{"vdi":"%s","dos":"%s","density":"%s","sides":%d,"op":"%s","files":%d,"seconds":%d.%09d,"status":%d}\n' \
+            $VDI $DOS $DENSITY $SIDES $OP $NFILES $((BEST / 1000000000)) $((BEST % 1000000000)) $STATUS
+
+    done
+
+done
+done
+done
+done
@@ -0,0 +1,685 @@
+/**
+ @file mkimg.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Synthetic disk image generator for the benchmark suite
+//---------------------------------------------------------------------------------
+//
+// mkimg <vdi> <dos> <sd|dd> <sides> <tracks> <files> <seed> <image>
+//
+//  vdi     jv1, jv3 or dmk
+//  dos     td1, td3, td4, rd, nd, dd, md or cpm
+//  files   Number of files to populate the image with (0 for a blank image)
+//  seed    Seed for the file sizes and contents (same seed, same image)
+//
+// The DOS structures are the minimum each OSI validates when loading a disk. Files
+// are written through libv80, except for MicroDOS (its DATA/TXT area is filled) and
+// CP/M (its directory and blocks are built here, and it always gets at least one
+// file because an empty CP/M directory can't be recognized).
+//
+//---------------------------------------------------------------------------------
+
+#define DEFINE_ERRORS_MSG
+
+#include "windows.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "jv3.h"
+#include "dmk.h"
+#include "td4.h"
+#include "nd.h"
+#include "cpm.h"
+
+#define MK_SECTOR_SIZE      256                                                     // Every generated sector has 256 bytes
+#define MK_NAME             "BENCH   "                                              // Disk name
+#define MK_DATE             "06/15/85"                                              // Disk date
+
+//---------------------------------------------------------------------------------
+// Function Definitions
+//---------------------------------------------------------------------------------
+
+DWORD   FormatTD4(BYTE nDirByte, bool bRD);
+DWORD   FormatTD3();
+DWORD   FormatND(bool bDD);
+DWORD   FormatMD(DWORD dwFiles);
+DWORD   FormatCPM(DWORD dwFiles);
+DWORD   Populate(const char* pName, const char* pVDI, const char* pOSI, DWORD dwFiles);
+DWORD   SaveJV1(FILE* hFile);
+DWORD   SaveJV3(FILE* hFile);
+DWORD   SaveDMK(FILE* hFile);
+BYTE*   Sector(WORD wSector);
+BYTE*   Sector(BYTE nTrack, BYTE nSide, BYTE nSector);
+WORD    CRC(WORD wCRC, const BYTE* pData, int nLength);
+DWORD   Random();
+
+//---------------------------------------------------------------------------------
+// Data structures
+//---------------------------------------------------------------------------------
+
+BYTE*       gpDisk = NULL;                                                          // Sector contents, track by track, side by side
+BYTE        gnTracks = 40;                                                          // Disk geometry
+BYTE        gnSides = 1;
+BYTE        gnSectors = 10;
+bool        gbDouble = false;
+DWORD       gdwSeed = 1;                                                            // Pseudo-random generator state
+
+const char* gpVDIs[] = { "jv1", "jv3", "dmk" };
+const char* gpOSIs[] = { "td1", "td3", "td4", "rd", "nd", "dd", "md", "cpm" };
+
+//---------------------------------------------------------------------------------
+// Main
+//---------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+
+    FILE*   hFile = NULL;
+    int     nVDI = -1;
+    int     nOSI = -1;
+    DWORD   dwFiles;
+    DWORD   dwError = NO_ERROR;
+
+    if (argc != 9)
+    {
+        puts("Syntax: mkimg <jv1|jv3|dmk> <td1|td3|td4|rd|nd|dd|md|cpm> <sd|dd> <sides> <tracks> <files> <seed> <image>");
+        return 1;
+    }
+
+    for (int x = 0; x < 3; x++)
+        if (strcmp(argv[1], gpVDIs[x]) == 0)
+            nVDI = x;
+
+    for (int x = 0; x < 8; x++)
+        if (strcmp(argv[2], gpOSIs[x]) == 0)
+            nOSI = x;
+
+    gbDouble = (strcmp(argv[3], "dd") == 0);
+    gnSides = atoi(argv[4]);
+    gnTracks = atoi(argv[5]);
+    gnSectors = (gbDouble ? 18 : 10);
+    dwFiles = atoi(argv[6]);
+    gdwSeed = atoi(argv[7]);
+
+    // Check the parameters against what the interfaces support
+    if (nVDI == -1 || nOSI == -1 || (gnSides != 1 && gnSides != 2) || gnTracks < 35 || gnTracks > 80)
+    {
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Done;
+    }
+
+    // TRSDOS Model III only handles single-sided disks
+    if (nOSI == 1 && gnSides != 1)
+    {
+        dwError = ERROR_NOT_SUPPORTED;
+        goto Done;
+    }
+
+    // Allocate the disk contents (the unused space keeps the format filler byte)
+    if ((gpDisk = (BYTE*)malloc(gnTracks * gnSides * gnSectors * MK_SECTOR_SIZE)) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    memset(gpDisk, 0xE5, gnTracks * gnSides * gnSectors * MK_SECTOR_SIZE);
+
+    // Build the DOS structures
+    switch (nOSI)
+    {
+        case 0:
+        case 2:
+            dwError = FormatTD4(2, false);
+            break;
+        case 1:
+            dwError = FormatTD3();
+            break;
+        case 3:
+            dwError = FormatTD4(2, true);
+            break;
+        case 4:
+            dwError = FormatND(false);
+            break;
+        case 5:
+            dwError = FormatND(true);
+            break;
+        case 6:
+            dwError = FormatMD(dwFiles);
+            break;
+        case 7:
+            dwError = FormatCPM(dwFiles);
+            break;
+    }
+
+    if (dwError != NO_ERROR)
+        goto Done;
+
+    // Save the disk in the requested container
+    if ((hFile = fopen(argv[8], "w")) == NULL)
+    {
+        dwError = ERROR_FILE_NOT_FOUND;
+        goto Done;
+    }
+
+    switch (nVDI)
+    {
+        case 0:
+            dwError = SaveJV1(hFile);
+            break;
+        case 1:
+            dwError = SaveJV3(hFile);
+            break;
+        case 2:
+            dwError = SaveDMK(hFile);
+            break;
+    }
+
+    fclose(hFile);
+
+    if (dwError != NO_ERROR)
+        goto Done;
+
+    // Files of the DOS with write support go through libv80
+    if (nOSI < 6 && dwFiles > 0)
+        dwError = Populate(argv[8], gpVDIs[nVDI], gpOSIs[nOSI], dwFiles);
+
+    Done:
+    if (dwError != NO_ERROR)
+        fprintf(stderr, "mkimg: %s\n", (dwError < ERROR_LAST ? errors_msg[dwError] : "UNKNOWN"));
+    free(gpDisk);
+    return (dwError == NO_ERROR ? 0 : 1);
+
+}
+
+//---------------------------------------------------------------------------------
+// TRSDOS Model I/4, LDOS and RapiDOS: boot sector pointing to the directory track,
+// which holds the GAT, the HIT and the directory entries
+//---------------------------------------------------------------------------------
+
+DWORD FormatTD4(BYTE nDirByte, bool bRD)
+{
+
+    TD4_GAT*    pGAT;
+    BYTE        nDirTrack = gnTracks / 2;
+    BYTE        nGranules = (gbDouble ? 3 : 2);
+    BYTE        nUsed = (1 << (nGranules * gnSides)) - 1;
+
+    // Boot sector (RapiDOS looks for the directory track in the second sector)
+    memset(Sector(0, 0, 0), 0, MK_SECTOR_SIZE);
+    Sector(0, 0, 0)[nDirByte] = nDirTrack;
+
+    if (bRD)
+    {
+        memset(Sector(0, 0, 1), 0, MK_SECTOR_SIZE);
+        Sector(0, 0, 1)[nDirByte] = nDirTrack;
+    }
+
+    // Directory cylinder: empty HIT and directory entries
+    for (BYTE nSide = 0; nSide < gnSides; nSide++)
+        for (BYTE nSector = 0; nSector < gnSectors; nSector++)
+            memset(Sector(nDirTrack, nSide, nSector), 0, MK_SECTOR_SIZE);
+
+    // GAT: boot and directory cylinders in use, cylinders past the end locked out
+    pGAT = (TD4_GAT*)Sector(nDirTrack, 0, 0);
+
+    for (int x = 0; x < (int)sizeof(pGAT->nAllocTbl); x++)
+    {
+        pGAT->nAllocTbl[x] = (x == 0 || x == nDirTrack ? nUsed : (x >= gnTracks ? 0xFF : 0x00));
+        pGAT->nLockoutTbl[x] = (x >= gnTracks ? 0xFF : 0x00);
+    }
+
+    pGAT->nDosVersion = 0x51;
+    pGAT->nCylinderExcess = gnTracks - 35;
+    pGAT->nDiskConfig = (gbDouble ? TD4_GAT_DENSITY : 0) | (gnSides == 2 ? TD4_GAT_SIDES : 0) | (nGranules - 1);
+    pGAT->wPasswordHash = 0xE042;
+    memcpy(pGAT->cDiskName, MK_NAME, sizeof(pGAT->cDiskName));
+    memcpy(pGAT->cDiskDate, MK_DATE, sizeof(pGAT->cDiskDate));
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// TRSDOS Model III: directory track in the second byte of the boot sector and the
+// system file vectors at the end of the HIT
+//---------------------------------------------------------------------------------
+
+DWORD FormatTD3()
+{
+
+    BYTE    nDirTrack = gnTracks / 2;
+    BYTE    nGranules = gnSectors / (gbDouble ? 3 : 2);
+    DWORD   dwError;
+
+    if ((dwError = FormatTD4(1, false)) != NO_ERROR)
+        return dwError;
+
+    // One granule bit per sector group (the GAT layout of TD4 doesn't apply here)
+    for (BYTE nTrack = 0; nTrack < gnTracks; nTrack++)
+        Sector(nDirTrack, 0, 0)[nTrack] = (nTrack == 0 || nTrack == nDirTrack ? (1 << nGranules) - 1 : 0);
+
+    // No system file vectors
+    memset(&Sector(nDirTrack, 0, 1)[MK_SECTOR_SIZE - 32], 0xFF, 32);
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// NewDOS/80 and DoubleDOS: PDRIVE table in the third sector, directory at a lump
+//---------------------------------------------------------------------------------
+
+DWORD FormatND(bool bDD)
+{
+
+    ND_PDRIVE*  pPDRIVE;
+    ND_GAT*     pGAT;
+    BYTE        nSPG = (bDD || !gbDouble ? 5 : 6);
+    BYTE        nGPL = 2;
+    BYTE        nDDGA = 2;
+    WORD        wSectors = gnTracks * gnSides * gnSectors;
+    BYTE        nLumps = wSectors / nSPG / nGPL;
+    BYTE        nDDSL = (bDD ? 17 : nLumps / 2);
+    WORD        wDirSector = nDDSL * nGPL * nSPG;
+
+    // DoubleDOS has a fixed layout whose lumps must fit the GAT
+    if (nLumps > sizeof(pGAT->nAllocTbl) || wSectors % (nSPG * nGPL) != 0)
+        return ERROR_NOT_SUPPORTED;
+
+    // Boot track
+    for (BYTE nSector = 0; nSector < 3; nSector++)
+        memset(Sector(nSector), 0, MK_SECTOR_SIZE);
+
+    // PDRIVE entry matching the disk geometry
+    pPDRIVE = (ND_PDRIVE*)Sector(2);
+    pPDRIVE->nLumps = nLumps;
+    pPDRIVE->nFlags1 = 0;
+    pPDRIVE->nTC = gnTracks;
+    pPDRIVE->nSPC = gnSectors * gnSides;
+    pPDRIVE->nGPL = nGPL;
+    pPDRIVE->nFlags2 = (gbDouble ? ND_FLAGS2_DD : 0) | (gnSides == 2 ? ND_FLAGS2_DS : 0);
+    pPDRIVE->nDDSL = nDDSL;
+    pPDRIVE->nDDGA = nDDGA;
+    pPDRIVE->nSPG = nSPG;
+    pPDRIVE->wTI = ND_TI_A;
+    pPDRIVE->nTD = (gbDouble ? ND_TD_E : ND_TD_A) + (gnSides == 2 ? 2 : 0);
+
+    // Directory: GAT, empty HIT and directory entries
+    for (WORD x = 0; x < nDDGA * nSPG; x++)
+        memset(Sector(wDirSector + x), 0, MK_SECTOR_SIZE);
+
+    pGAT = (ND_GAT*)Sector(wDirSector);
+
+    for (int x = 0; x < (int)sizeof(pGAT->nAllocTbl); x++)
+        pGAT->nAllocTbl[x] = (x == 0 || x == nDDSL ? (1 << nGPL) - 1 : (x >= nLumps ? 0xFF : 0x00));
+
+    memcpy(pGAT->cDiskName, MK_NAME, sizeof(pGAT->cDiskName));
+    memcpy(pGAT->cDiskDate, MK_DATE, sizeof(pGAT->cDiskDate));
+    pGAT->cCommand[0] = 0x0D;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// MicroDOS: signature in the boot sector, data area filled when populated
+//---------------------------------------------------------------------------------
+
+DWORD FormatMD(DWORD dwFiles)
+{
+
+    WORD    wSectors = gnTracks * gnSides * gnSectors;
+
+    memset(Sector(0), 0, MK_SECTOR_SIZE);
+    memcpy(&Sector(0)[241], "MICRODOS", 8);
+
+    for (WORD x = 20; x < wSectors && dwFiles > 0; x++)
+        for (int y = 0; y < MK_SECTOR_SIZE; y++)
+            Sector(x)[y] = Random();
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// CP/M: two reserved tracks, one-track directory and 8-bit block numbers
+//---------------------------------------------------------------------------------
+
+DWORD FormatCPM(DWORD dwFiles)
+{
+
+    CPM_FCB*    pFCB;
+    WORD        wBLS = 1024;
+    BYTE        nOFF = 2;
+    WORD        wBlocks;
+    WORD        wBlock = 2;
+    BYTE        nCount;
+    WORD        wSector;
+    DWORD       dwSize;
+
+    // Pick the smallest block size that keeps block numbers in 8 bits
+    while ((gnTracks - nOFF) * gnSides * gnSectors * MK_SECTOR_SIZE / wBLS > 255)
+        wBLS *= 2;
+
+    // Blocks 0 and 1 hold the directory, data blocks start right after its track
+    wBlocks = 2 + ((gnTracks - nOFF) * gnSides - 1) * gnSectors * MK_SECTOR_SIZE / wBLS;
+
+    // Reserved tracks can't look like a directory
+    for (BYTE nTrack = 0; nTrack < nOFF; nTrack++)
+        for (BYTE nSide = 0; nSide < gnSides; nSide++)
+            for (BYTE nSector = 0; nSector < gnSectors; nSector++)
+                memset(Sector(nTrack, nSide, nSector), 0, MK_SECTOR_SIZE);
+
+    // An empty directory isn't recognized, and there is one track for it
+    if (dwFiles == 0)
+        dwFiles = 1;
+
+    if (dwFiles > (DWORD)gnSectors * MK_SECTOR_SIZE / sizeof(CPM_FCB))
+        dwFiles = gnSectors * MK_SECTOR_SIZE / sizeof(CPM_FCB);
+
+    for (DWORD x = 0; x < dwFiles; x++)
+    {
+
+        // Whole blocks, at least two, less than 16K (one directory entry)
+        nCount = 2 + Random() % ((16384 / wBLS) - 2);
+        dwSize = nCount * wBLS;
+
+        if (wBlock + nCount > wBlocks)
+            break;
+
+        pFCB = (CPM_FCB*)&Sector(nOFF, 0, 0)[x * sizeof(CPM_FCB)];
+        memset(pFCB, 0, sizeof(CPM_FCB));
+
+        sprintf((char*)pFCB->cFN, "FILE%04u", x + 1);
+        memcpy(pFCB->cFT, "DAT", 3);
+        pFCB->nRC = dwSize / 128;
+
+        for (BYTE y = 0; y < nCount; y++, wBlock++)
+        {
+
+            pFCB->DM.nDM[y] = wBlock;
+
+            // Block data follows the directory track
+            wSector = nOFF * gnSides * gnSectors + gnSectors + (wBlock - 2) * (wBLS / MK_SECTOR_SIZE);
+
+            for (WORD z = 0; z < wBLS; z++)
+                Sector(wSector + z / MK_SECTOR_SIZE)[z % MK_SECTOR_SIZE] = Random();
+
+        }
+
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write pseudo-random files through the library
+//---------------------------------------------------------------------------------
+
+DWORD Populate(const char* pName, const char* pVDI, const char* pOSI, DWORD dwFiles)
+{
+
+    CImage      Image;
+    OSI_FILE    File;
+    void*       pFile;
+    BYTE*       pBuffer;
+    DWORD       dwBytes;
+    DWORD       dwError;
+
+    if ((pBuffer = (BYTE*)malloc(8192)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    if ((dwError = Image.Open(pName)) != NO_ERROR)
+        goto Done;
+
+    // Force the interfaces (some layouts are acceptable to more than one DOS)
+    if ((dwError = Image.Probe(pVDI, pOSI)) != NO_ERROR)
+        goto Done;
+
+    for (DWORD x = 0; x < dwFiles; x++)
+    {
+
+        memset(&File, 0, sizeof(File));
+        sprintf(File.szName, "FILE%04u", x + 1);
+        memcpy(File.szType, "DAT", 4);
+        File.dwSize = 128 + Random() % (8192 - 128);
+        File.Date.nDay = 15;
+        File.Date.nMonth = 6;
+        File.Date.wYear = 1985;
+        File.nAccess = OSI_PROT_FULL;
+
+        for (DWORD y = 0; y < File.dwSize; y++)
+            pBuffer[y] = Random();
+
+        // A full disk ends the population
+        if ((dwError = Image.Create(&pFile, File)) != NO_ERROR)
+            break;
+
+        dwBytes = File.dwSize;
+
+        if ((dwError = Image.Write(pFile, 0, pBuffer, dwBytes)) != NO_ERROR)
+            break;
+
+    }
+
+    if (dwError == ERROR_DISK_FULL)
+        dwError = NO_ERROR;
+
+    if (dwError == NO_ERROR)
+        dwError = Image.Flush();
+
+    Done:
+    free(pBuffer);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// JV1: plain sectors, track by track
+//---------------------------------------------------------------------------------
+
+DWORD SaveJV1(FILE* hFile)
+{
+
+    DWORD dwBytes = gnTracks * gnSides * gnSectors * MK_SECTOR_SIZE;
+
+    return (fwrite(gpDisk, 1, dwBytes, hFile) == dwBytes ? NO_ERROR : ERROR_WRITE_FAULT);
+
+}
+
+//---------------------------------------------------------------------------------
+// JV3: sector headers followed by the sectors in the same order
+//---------------------------------------------------------------------------------
+
+DWORD SaveJV3(FILE* hFile)
+{
+
+    JV3_HEADER* pHeader;
+    WORD        wSector = 0;
+    DWORD       dwBytes = gnTracks * gnSides * gnSectors * MK_SECTOR_SIZE;
+    DWORD       dwError = NO_ERROR;
+
+    if ((pHeader = (JV3_HEADER*)malloc(sizeof(JV3_HEADER))) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    // Free entries are marked in every field
+    memset(pHeader, 0xFF, sizeof(JV3_HEADER));
+
+    for (BYTE nTrack = 0; nTrack < gnTracks; nTrack++)
+        for (BYTE nSide = 0; nSide < gnSides; nSide++)
+            for (BYTE nSector = 0; nSector < gnSectors; nSector++, wSector++)
+            {
+                pHeader->Sector[wSector].nTrack = nTrack;
+                pHeader->Sector[wSector].nSector = nSector;
+                pHeader->Sector[wSector].nFlags = (gbDouble ? JV3_FLAG_DENSITY : 0) | (nSide ? JV3_FLAG_SIDE : 0);
+            }
+
+    if (fwrite(pHeader, 1, sizeof(JV3_HEADER), hFile) != sizeof(JV3_HEADER) || fwrite(gpDisk, 1, dwBytes, hFile) != dwBytes)
+        dwError = ERROR_WRITE_FAULT;
+
+    free(pHeader);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// DMK: raw tracks with IDAM pointers, address marks, gaps and CRCs
+//---------------------------------------------------------------------------------
+
+DWORD SaveDMK(FILE* hFile)
+{
+
+    DMK_HEADER  Header;
+    BYTE*       pTrack;
+    BYTE*       p;
+    WORD        wCRC;
+    WORD        wLength = (gbDouble ? 0x1900 : 0x0CC0);
+    DWORD       dwError = NO_ERROR;
+
+    memset(&Header, 0, sizeof(Header));
+    Header.nWriteProtected = DMK_WP_NO;
+    Header.nTracks = gnTracks;
+    Header.wTrackLength = wLength;
+    Header.nFlags = (gnSides == 1 ? DMK_FLAG_SINGLE_SIDED : 0) | (gbDouble ? 0 : DMK_FLAG_SINGLE_DENSITY);
+    Header.dwSignature = DMK_DISK_VIRTUAL;
+
+    if (fwrite(&Header, 1, sizeof(Header), hFile) != sizeof(Header))
+        return ERROR_WRITE_FAULT;
+
+    if ((pTrack = (BYTE*)malloc(wLength)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    for (BYTE nTrack = 0; nTrack < gnTracks && dwError == NO_ERROR; nTrack++)
+        for (BYTE nSide = 0; nSide < gnSides && dwError == NO_ERROR; nSide++)
+        {
+
+            memset(pTrack, 0, sizeof(DMK_TRACK));
+            memset(pTrack + sizeof(DMK_TRACK), (gbDouble ? 0x4E : 0xFF), wLength - sizeof(DMK_TRACK));
+            p = pTrack + sizeof(DMK_TRACK) + (gbDouble ? 32 : 16);
+
+            for (BYTE nSector = 0; nSector < gnSectors; nSector++)
+            {
+
+                // Sync field and ID address mark
+                memset(p, 0x00, (gbDouble ? 12 : 6));
+                p += (gbDouble ? 12 : 6);
+
+                if (gbDouble)
+                {
+                    memset(p, 0xA1, 3);
+                    p += 3;
+                }
+
+                ((WORD*)pTrack)[nSector] = (p - pTrack) | (gbDouble ? DMK_IDAM_DENSITY : 0);
+
+                p[0] = 0xFE;
+                p[1] = nTrack;
+                p[2] = nSide;
+                p[3] = nSector;
+                p[4] = 1;
+                wCRC = CRC((gbDouble ? 0xCDB4 : 0xFFFF), p, 5);
+                p[5] = wCRC >> 8;
+                p[6] = wCRC & 0xFF;
+                p += 7 + (gbDouble ? 22 : 11);
+
+                // Sync field, data address mark, data and CRC
+                memset(p, 0x00, (gbDouble ? 12 : 6));
+                p += (gbDouble ? 12 : 6);
+
+                if (gbDouble)
+                {
+                    memset(p, 0xA1, 3);
+                    p += 3;
+                }
+
+                p[0] = 0xFB;
+                memcpy(&p[1], Sector(nTrack, nSide, nSector), MK_SECTOR_SIZE);
+                wCRC = CRC((gbDouble ? 0xCDB4 : 0xFFFF), p, MK_SECTOR_SIZE + 1);
+                p[MK_SECTOR_SIZE + 1] = wCRC >> 8;
+                p[MK_SECTOR_SIZE + 2] = wCRC & 0xFF;
+                p += MK_SECTOR_SIZE + 3 + (gbDouble ? 24 : 12);
+
+            }
+
+            if (fwrite(pTrack, 1, wLength, hFile) != wLength)
+                dwError = ERROR_WRITE_FAULT;
+
+        }
+
+    free(pTrack);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Return a sector by its relative number or by its track, side and sector numbers
+//---------------------------------------------------------------------------------
+
+BYTE* Sector(WORD wSector)
+{
+    return &gpDisk[wSector * MK_SECTOR_SIZE];
+}
+
+BYTE* Sector(BYTE nTrack, BYTE nSide, BYTE nSector)
+{
+    return Sector((nTrack * gnSides + nSide) * gnSectors + nSector);
+}
+
+//---------------------------------------------------------------------------------
+// CRC-16/CCITT as used by the floppy disk controllers
+//---------------------------------------------------------------------------------
+
+WORD CRC(WORD wCRC, const BYTE* pData, int nLength)
+{
+
+    for (int x = 0; x < nLength; x++)
+    {
+        wCRC ^= pData[x] << 8;
+        for (int y = 0; y < 8; y++)
+            wCRC = (wCRC & 0x8000 ? (wCRC << 1) ^ 0x1021 : wCRC << 1);
+    }
+
+    return wCRC;
+
+}
+
+//---------------------------------------------------------------------------------
+// Pseudo-random numbers (the same seed always produces the same image)
+//---------------------------------------------------------------------------------
+
+DWORD Random()
+{
+    gdwSeed = gdwSeed * 1103515245 + 12345;
+    return (gdwSeed >> 16) & 0x7FFF;
+}
@@ -0,0 +1,343 @@
+/**
+ @file replay.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Sector access trace replay
+//---------------------------------------------------------------------------------
+//
+// replay <trace> [image [dmk|jv1|jv3]]
+//
+// Reads a trace recorded with v80 -tr and prints, one JSON object per line:
+//
+//  - a summary of the trace (operations, errors, distinct tracks, time span)
+//  - the hits, misses (track loads) and write-backs an LRU track cache of 1, 2, 4,
+//    8, 16 and unlimited tracks would have had (1 track is what CDMK does today)
+//  - when an image is given, the time taken to replay the trace against it through
+//    the named disk interface (the traced one by default). Writes put back the data
+//    just read from the same sector, so the image contents are left unchanged.
+//
+//---------------------------------------------------------------------------------
+
+#define DEFINE_ERRORS_MSG
+
+#include "windows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "trace.h"
+
+#define RP_KEYS             512                                                     // Distinct track/side pairs (256 tracks, 2 sides)
+
+struct  RP_SLOT                                                                     // Simulated cache slot
+{
+    WORD        wKey;                                                               // Track * 2 + Side
+    bool        bDirty;                                                             // Holds writes not saved yet
+    DWORD       dwUsed;                                                             // Time of the last access (for LRU)
+};
+
+//---------------------------------------------------------------------------------
+// Function Definitions
+//---------------------------------------------------------------------------------
+
+DWORD   LoadTrace(const char* pName);
+void    Summary(const char* pName);
+void    Simulate(int nSlots);
+DWORD   Replay(const char* pName, const char* pVDI);
+
+//---------------------------------------------------------------------------------
+// Data structures
+//---------------------------------------------------------------------------------
+
+TRACE_HEADER    gHeader;                                                            // Trace header
+TRACE_RECORD*   gpRecords = NULL;                                                   // Trace records
+DWORD           gdwRecords = 0;                                                     // Number of trace records
+
+//---------------------------------------------------------------------------------
+// Main
+//---------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+
+    int     nSlots[] = { 1, 2, 4, 8, 16, RP_KEYS };
+    DWORD   dwError;
+
+    if (argc < 2 || argc > 4)
+    {
+        puts("Syntax: replay <trace> [image [dmk|jv1|jv3]]");
+        return 1;
+    }
+
+    if ((dwError = LoadTrace(argv[1])) != NO_ERROR)
+        goto Done;
+
+    Summary(argv[1]);
+
+    for (int x = 0; x < (int)(sizeof(nSlots) / sizeof(nSlots[0])); x++)
+        Simulate(nSlots[x]);
+
+    if (argc > 2)
+        dwError = Replay(argv[2], (argc > 3 ? argv[3] : gHeader.cVDI));
+
+    Done:
+    if (dwError != NO_ERROR)
+        fprintf(stderr, "replay: %s\n", (dwError < ERROR_LAST ? errors_msg[dwError] : "UNKNOWN"));
+    free(gpRecords);
+    return (dwError == NO_ERROR ? 0 : 1);
+
+}
+
+//---------------------------------------------------------------------------------
+// Load the whole trace in memory
+//---------------------------------------------------------------------------------
+
+DWORD LoadTrace(const char* pName)
+{
+
+    FILE*   hFile;
+    long    lSize;
+    DWORD   dwError = NO_ERROR;
+
+    if ((hFile = fopen(pName, "r")) == NULL)
+        return ERROR_FILE_NOT_FOUND;
+
+    // Check the header
+    if (fread(&gHeader, 1, sizeof(gHeader), hFile) != sizeof(gHeader))
+    {
+        dwError = ERROR_READ_FAULT;
+        goto Done;
+    }
+
+    if (memcmp(gHeader.cMagic, TRACE_MAGIC, sizeof(gHeader.cMagic)) != 0 || gHeader.wVersion != TRACE_VERSION || gHeader.wRecordSize != sizeof(TRACE_RECORD))
+    {
+        dwError = ERROR_FILE_CORRUPT;
+        goto Done;
+    }
+
+    gHeader.cVDI[sizeof(gHeader.cVDI) - 1] = 0;
+
+    // Read the records
+    fseek(hFile, 0, SEEK_END);
+    lSize = ftell(hFile) - sizeof(gHeader);
+    fseek(hFile, sizeof(gHeader), SEEK_SET);
+
+    gdwRecords = lSize / sizeof(TRACE_RECORD);
+
+    if ((gpRecords = (TRACE_RECORD*)malloc(gdwRecords * sizeof(TRACE_RECORD) + 1)) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    if (fread(gpRecords, sizeof(TRACE_RECORD), gdwRecords, hFile) != gdwRecords)
+        dwError = ERROR_READ_FAULT;
+
+    Done:
+    fclose(hFile);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Print the trace summary
+//---------------------------------------------------------------------------------
+
+void Summary(const char* pName)
+{
+
+    DWORD   dwOps[3] = { 0, 0, 0 };
+    DWORD   dwErrors = 0;
+    DWORD   dwTracks = 0;
+    bool    bSeen[RP_KEYS];
+
+    memset(bSeen, 0, sizeof(bSeen));
+
+    for (DWORD x = 0; x < gdwRecords; x++)
+    {
+
+        if (gpRecords[x].nOp <= TRACE_FLUSH)
+            dwOps[gpRecords[x].nOp]++;
+
+        if (gpRecords[x].wError != NO_ERROR)
+            dwErrors++;
+
+        if (gpRecords[x].nOp != TRACE_FLUSH && !bSeen[gpRecords[x].nTrack * 2 + (gpRecords[x].nSide & 1)])
+        {
+            bSeen[gpRecords[x].nTrack * 2 + (gpRecords[x].nSide & 1)] = true;
+            dwTracks++;
+        }
+
+    }
+
+    printf("{\"trace\":\"%s\",\"vdi\":\"%s\",\"records\":%u,\"reads\":%u,\"writes\":%u,\"flushes\":%u,\"errors\":%u,\"tracks\":%u,\"span\":%.6f}\n",
+        pName, gHeader.cVDI, gdwRecords, dwOps[TRACE_READ], dwOps[TRACE_WRITE], dwOps[TRACE_FLUSH], dwErrors, dwTracks,
+        (gdwRecords > 0 ? gpRecords[gdwRecords - 1].dwTime / 1e6 : 0.0));
+
+}
+
+//---------------------------------------------------------------------------------
+// Simulate a write-back LRU cache of whole tracks
+//---------------------------------------------------------------------------------
+
+void Simulate(int nSlots)
+{
+
+    RP_SLOT Slots[RP_KEYS];
+    int     nUsed = 0;
+    int     nSlot;
+    WORD    wKey;
+    DWORD   dwHits = 0;
+    DWORD   dwMisses = 0;
+    DWORD   dwSaves = 0;
+
+    for (DWORD x = 0; x < gdwRecords; x++)
+    {
+
+        // A flush saves every dirty track but keeps them cached
+        if (gpRecords[x].nOp == TRACE_FLUSH)
+        {
+            for (int y = 0; y < nUsed; y++)
+            {
+                if (Slots[y].bDirty)
+                    dwSaves++;
+                Slots[y].bDirty = false;
+            }
+            continue;
+        }
+
+        wKey = gpRecords[x].nTrack * 2 + (gpRecords[x].nSide & 1);
+
+        // Look the track up
+        for (nSlot = 0; nSlot < nUsed && Slots[nSlot].wKey != wKey; nSlot++);
+
+        if (nSlot < nUsed)
+            dwHits++;
+        else
+        {
+
+            dwMisses++;
+
+            // Take a free slot or evict the least recently used one
+            if (nUsed < nSlots)
+                nSlot = nUsed++;
+            else
+            {
+                nSlot = 0;
+                for (int y = 1; y < nUsed; y++)
+                    if (Slots[y].dwUsed < Slots[nSlot].dwUsed)
+                        nSlot = y;
+                if (Slots[nSlot].bDirty)
+                    dwSaves++;
+            }
+
+            Slots[nSlot].wKey = wKey;
+            Slots[nSlot].bDirty = false;
+
+        }
+
+        Slots[nSlot].dwUsed = x;
+
+        if (gpRecords[x].nOp == TRACE_WRITE)
+            Slots[nSlot].bDirty = true;
+
+    }
+
+    // Tracks still dirty are saved when the image is closed
+    for (int y = 0; y < nUsed; y++)
+        if (Slots[y].bDirty)
+            dwSaves++;
+
+    printf("{\"cache\":\"lru\",\"slots\":%d,\"hits\":%u,\"misses\":%u,\"writebacks\":%u,\"hit_rate\":%.4f}\n",
+        nSlots, dwHits, dwMisses, dwSaves, (dwHits + dwMisses > 0 ? (double)dwHits / (dwHits + dwMisses) : 0.0));
+
+}
+
+//---------------------------------------------------------------------------------
+// Replay the trace against an image through the named disk interface
+//---------------------------------------------------------------------------------
+
+DWORD Replay(const char* pName, const char* pVDI)
+{
+
+    CImage          Image;
+    CVDI*           pDisk;
+    BYTE            Buffer[1024];
+    DWORD           dwErrors = 0;
+    DWORD           dwError;
+    struct timespec ts[2];
+
+    if ((dwError = Image.Open(pName)) != NO_ERROR)
+        return dwError;
+
+    if ((dwError = Image.ProbeVDI(pVDI)) != NO_ERROR)
+        return dwError;
+
+    pDisk = Image.GetVDI();
+
+    clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+
+    for (DWORD x = 0; x < gdwRecords; x++)
+    {
+
+        switch (gpRecords[x].nOp)
+        {
+            case TRACE_READ:
+                dwError = pDisk->Read(gpRecords[x].nTrack, gpRecords[x].nSide, gpRecords[x].nSector, Buffer, sizeof(Buffer));
+                break;
+            case TRACE_WRITE:
+                if ((dwError = pDisk->Read(gpRecords[x].nTrack, gpRecords[x].nSide, gpRecords[x].nSector, Buffer, sizeof(Buffer))) == NO_ERROR)
+                    dwError = pDisk->Write(gpRecords[x].nTrack, gpRecords[x].nSide, gpRecords[x].nSector, Buffer, gpRecords[x].wSize);
+                break;
+            case TRACE_FLUSH:
+                dwError = pDisk->Flush();
+                break;
+        }
+
+        if (dwError != NO_ERROR)
+            dwErrors++;
+
+    }
+
+    // Include the final write-back in the timing
+    Image.Close();
+
+    clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+
+    printf("{\"replay\":\"%s\",\"image\":\"%s\",\"errors\":%u,\"seconds\":%.6f}\n",
+        pVDI, pName, dwErrors,
+        (ts[1].tv_sec - ts[0].tv_sec) + (ts[1].tv_nsec - ts[0].tv_nsec) / 1e9);
+
+    return NO_ERROR;
+
+}
@@ -0,0 +1,257 @@
+/**
+ @file cache.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Probe result cache (sidecar file or central cache directory)
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "v80.h"
+#include "vdi.h"
+#include "cache.h"
+
+//---------------------------------------------------------------------------------
+// Add a block of bytes to an FNV-1a hash
+//---------------------------------------------------------------------------------
+
+unsigned long long Hash(const BYTE* pData, size_t nBytes, unsigned long long qwHash)
+{
+
+    for (size_t x = 0; x < nBytes; x++)
+        qwHash = (qwHash ^ pData[x]) * FNV_PRIME;
+
+    return qwHash;
+
+}
+
+//---------------------------------------------------------------------------------
+// Set the cache file path
+//---------------------------------------------------------------------------------
+
+CCache::CCache(const char* pPath)
+:   m_pPath(strdup(pPath)), m_Entry(), m_bLoaded(false), m_bValid(false)
+{
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CCache::~CCache()
+{
+    free(m_pPath);
+}
+
+//---------------------------------------------------------------------------------
+// Read the entry and check it against the image (the file is read only once)
+//---------------------------------------------------------------------------------
+
+bool CCache::Load(FILE* hImage, DWORD dwFlags)
+{
+
+    CACHE_ENTRY Entry;
+    FILE*       hFile;
+
+    if (m_bLoaded)
+        return m_bValid;
+
+    m_bLoaded = true;
+
+    if (m_pPath == NULL || (hFile = fopen(m_pPath, "r")) == NULL)
+        return false;
+
+    if (fread(&m_Entry, 1, sizeof(m_Entry), hFile) == sizeof(m_Entry) && memcmp(m_Entry.cMagic, CACHE_MAGIC, sizeof(m_Entry.cMagic)) == 0 &&
+        m_Entry.wVersion == CACHE_VERSION && m_Entry.wEntrySize == sizeof(m_Entry) && Stamp(hImage, dwFlags, Entry) == NO_ERROR)
+    {
+
+        // The image must be the one the entry was taken from, probed the same way
+        m_bValid = (Entry.dwFlags == m_Entry.dwFlags && Entry.qwSize == m_Entry.qwSize && Entry.qwTime == m_Entry.qwTime && Entry.qwHash == m_Entry.qwHash);
+
+        m_Entry.cVDI[sizeof(m_Entry.cVDI) - 1] = 0;
+        m_Entry.cOSI[sizeof(m_Entry.cOSI) - 1] = 0;
+
+    }
+
+    fclose(hFile);
+
+    return m_bValid;
+
+}
+
+//---------------------------------------------------------------------------------
+// Stop using a stale entry (an interface no longer loads with it)
+//---------------------------------------------------------------------------------
+
+void CCache::Drop()
+{
+    m_bLoaded = true;
+    m_bValid = false;
+}
+
+//---------------------------------------------------------------------------------
+// Write a new entry, unless the cached one is still exact (pOSI NULL: keep the cached DOS)
+//---------------------------------------------------------------------------------
+
+DWORD CCache::Save(FILE* hImage, DWORD dwFlags, const char* pVDI, VDI_GEOMETRY& DG, const char* pOSI)
+{
+
+    CACHE_ENTRY Entry;
+    char        szTemp[MAX_PATH];
+    FILE*       hFile;
+    DWORD       dwError;
+
+    if (m_pPath == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    if ((dwError = Stamp(hImage, dwFlags, Entry)) != NO_ERROR)
+        return dwError;
+
+    memcpy(Entry.cMagic, CACHE_MAGIC, sizeof(Entry.cMagic));
+    Entry.wVersion = CACHE_VERSION;
+    Entry.wEntrySize = sizeof(Entry);
+    strncpy(Entry.cVDI, pVDI, sizeof(Entry.cVDI) - 1);
+    memcpy(&Entry.DG, &DG, sizeof(DG));
+
+    // A DOS detected on this same image before is still good when only the disk was probed now
+    if (pOSI != NULL)
+        strncpy(Entry.cOSI, pOSI, sizeof(Entry.cOSI) - 1);
+    else if (m_bValid && strcmp(m_Entry.cVDI, Entry.cVDI) == 0)
+        memcpy(Entry.cOSI, m_Entry.cOSI, sizeof(Entry.cOSI));
+
+    if (m_bValid && memcmp(&Entry, &m_Entry, sizeof(Entry)) == 0)
+        return NO_ERROR;
+
+    // Replace the cache file in one step, so a concurrent reader never sees half of it
+    snprintf(szTemp, sizeof(szTemp), "%s.%d", m_pPath, (int)getpid());
+
+    if ((hFile = fopen(szTemp, "w")) == NULL)
+        return ERROR_FILE_NOT_FOUND;
+
+    if (fwrite(&Entry, 1, sizeof(Entry), hFile) != sizeof(Entry))
+        dwError = ERROR_WRITE_FAULT;
+
+    if (fclose(hFile) != 0 && dwError == NO_ERROR)
+        dwError = ERROR_WRITE_FAULT;
+
+    if (dwError == NO_ERROR && rename(szTemp, m_pPath) != 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    if (dwError != NO_ERROR)
+        remove(szTemp);
+    else
+    {
+        memcpy(&m_Entry, &Entry, sizeof(Entry));
+        m_bValid = true;
+    }
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Cached disk interface name
+//---------------------------------------------------------------------------------
+
+const char* CCache::VDI()
+{
+    return m_Entry.cVDI;
+}
+
+//---------------------------------------------------------------------------------
+// Cached DOS interface name ("" if the DOS has not been probed)
+//---------------------------------------------------------------------------------
+
+const char* CCache::OSI()
+{
+    return m_Entry.cOSI;
+}
+
+//---------------------------------------------------------------------------------
+// Copy the cached disk geometry to the caller's struct
+//---------------------------------------------------------------------------------
+
+void CCache::GetDG(VDI_GEOMETRY& DG)
+{
+    memcpy(&DG, &m_Entry.DG, sizeof(DG));
+}
+
+//---------------------------------------------------------------------------------
+// Build the cache file path of an image: a sidecar, or a file named after the hash
+// of the image's full path inside a central cache directory
+//---------------------------------------------------------------------------------
+
+void CCache::Name(const char* pImage, const char* pDir, char* pPath, size_t nSize)
+{
+
+    char    szFull[MAX_PATH];
+
+    if (pDir == NULL || pDir[0] == 0)
+    {
+        snprintf(pPath, nSize, "%s%s", pImage, CACHE_EXT);
+        return;
+    }
+
+    if (realpath(pImage, szFull) == NULL)
+        snprintf(szFull, sizeof(szFull), "%s", pImage);
+
+    snprintf(pPath, nSize, "%s/%016llx%s", pDir, Hash((const BYTE*)szFull, strlen(szFull)), CACHE_EXT);
+
+}
+
+//---------------------------------------------------------------------------------
+// Fill the image identity fields of an entry (the rest is zeroed)
+//---------------------------------------------------------------------------------
+
+DWORD CCache::Stamp(FILE* hImage, DWORD dwFlags, CACHE_ENTRY& Entry)
+{
+
+    BYTE        Buffer[CACHE_HASH_BYTES];
+    struct stat st;
+    ssize_t     nBytes;
+
+    memset(&Entry, 0, sizeof(Entry));
+
+    if (fstat(fileno(hImage), &st) != 0)
+        return ERROR_FILE_NOT_FOUND;
+
+    // Read past the stdio buffer, which the caller has flushed
+    if ((nBytes = pread(fileno(hImage), Buffer, sizeof(Buffer), 0)) < 0)
+        return ERROR_READ_FAULT;
+
+    Entry.dwFlags = dwFlags & CACHE_FLAGS;
+    Entry.qwSize = st.st_size;
+    Entry.qwTime = (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    Entry.qwHash = Hash(Buffer, nBytes);
+
+    return NO_ERROR;
+
+}
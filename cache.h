@@ -0,0 +1,85 @@
+/**
+ @file cache.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Probe result cache (sidecar file or central cache directory)
+//---------------------------------------------------------------------------------
+//
+// A cache file holds one CACHE_ENTRY with the disk interface, disk geometry and DOS
+// detected on an image, stamped with the image size, modification time and a hash
+// of its first CACHE_HASH_BYTES. The entry is used only while the stamp and the
+// flags that influence the probing still match the image.
+//
+//---------------------------------------------------------------------------------
+
+#define CACHE_MAGIC         "V80C"                                                  // Cache file signature
+#define CACHE_VERSION       1                                                       // Cache file format version
+#define CACHE_EXT           ".v80c"                                                 // Extension appended to the image name by -ca
+#define CACHE_HASH_BYTES    16384                                                   // Image bytes covered by the content hash
+#define CACHE_FLAGS         (V80_FLAG_CHKDIR | V80_FLAG_CHKDSK | V80_FLAG_GATFIX | V80_FLAG_SS | V80_FLAG_DS)  // Flags that change the probe results
+
+#define FNV_OFFSET          0xCBF29CE484222325ULL                                   // FNV-1a 64-bit offset basis
+#define FNV_PRIME           0x00000100000001B3ULL                                   // FNV-1a 64-bit prime
+
+struct  __attribute__((packed)) CACHE_ENTRY                                         // Cache file contents
+{
+    char        cMagic[4];                                                          // CACHE_MAGIC
+    WORD        wVersion;                                                           // CACHE_VERSION
+    WORD        wEntrySize;                                                         // sizeof(CACHE_ENTRY)
+    DWORD       dwFlags;                                                            // User flags in effect (CACHE_FLAGS only)
+    unsigned long long qwSize;                                                      // Image size
+    unsigned long long qwTime;                                                      // Image modification time (nanoseconds)
+    unsigned long long qwHash;                                                      // FNV-1a hash of the first CACHE_HASH_BYTES
+    char        cVDI[4];                                                            // Detected disk interface ("DMK", "JV1", "JV3")
+    char        cOSI[4];                                                            // Detected DOS interface (empty: not probed)
+    VDI_GEOMETRY DG;                                                                // Detected disk geometry
+};
+
+class   CCache
+{
+protected:
+    char*       m_pPath;                                                            // Cache file path
+    CACHE_ENTRY m_Entry;                                                            // Entry read from the cache file
+    bool        m_bLoaded;                                                          // The cache file has been read
+    bool        m_bValid;                                                           // m_Entry matches the image
+public:
+                CCache(const char* pPath);                                                  // Set the cache file path
+                ~CCache();                                                                  // Release allocated memory
+    bool        Load(FILE* hImage, DWORD dwFlags);                                          // Read the entry and check it against the image (once)
+    void        Drop();                                                                     // Stop using a stale entry
+    DWORD       Save(FILE* hImage, DWORD dwFlags, const char* pVDI, VDI_GEOMETRY& DG, const char* pOSI); // Write a new entry (if anything changed)
+    const char* VDI();                                                                      // Cached disk interface name
+    const char* OSI();                                                                      // Cached DOS interface name ("": none)
+    void        GetDG(VDI_GEOMETRY& DG);                                                    // Copy the cached disk geometry to the caller's struct
+    static void Name(const char* pImage, const char* pDir, char* pPath, size_t nSize);      // Cache file of an image (sidecar if pDir is NULL)
+protected:
+    static DWORD Stamp(FILE* hImage, DWORD dwFlags, CACHE_ENTRY& Entry);                    // Fill the image identity fields of an entry
+};
+
+unsigned long long  Hash(const BYTE* pData, size_t nBytes, unsigned long long qwHash = FNV_OFFSET); // Add a block of bytes to an FNV-1a hash
@@ -0,0 +1,602 @@
+/**
+ @file convert.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Streaming conversion of a disk into the JV1, JV3 or DMK format
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include "v80.h"
+#include "vdi.h"
+#include "jv3.h"
+#include "dmk.h"
+#include "convert.h"
+
+//---------------------------------------------------------------------------------
+// CRC-16/CCITT as used by the floppy disk controllers
+//---------------------------------------------------------------------------------
+
+static WORD CRC(WORD wCRC, const BYTE* pData, int nLength)
+{
+
+    for (int x = 0; x < nLength; x++)
+    {
+        wCRC ^= pData[x] << 8;
+        for (int y = 0; y < 8; y++)
+            wCRC = (wCRC & 0x8000 ? (wCRC << 1) ^ 0x1021 : wCRC << 1);
+    }
+
+    return wCRC;
+
+}
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CConvert::CConvert()
+:   m_pVDI(NULL), m_DG(), m_hFile(NULL), m_nFormat(CONVERT_DMK), m_wTrackLength(0), m_bSingle(false), m_pHeader(NULL),
+    m_wSectors(0), m_wBad(0), m_nUnits(0), m_Slot(), m_bEnd(false), m_bAbort(false), m_dwError(NO_ERROR)
+{
+    pthread_mutex_init(&m_Mutex, NULL);
+    pthread_cond_init(&m_Cond, NULL);
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CConvert::~CConvert()
+{
+
+    for (int x = 0; x < CONVERT_SLOTS; x++)
+    {
+        free(m_Slot[x].pData);
+        free(m_Slot[x].pOutput);
+    }
+
+    free(m_pHeader);
+
+    pthread_cond_destroy(&m_Cond);
+    pthread_mutex_destroy(&m_Mutex);
+
+}
+
+//---------------------------------------------------------------------------------
+// Convert the whole disk into a target file ("JV1", "JV3" or "DMK")
+//---------------------------------------------------------------------------------
+
+DWORD CConvert::Run(CVDI* pVDI, const char* pFormat, FILE* hFile, DWORD dwThreads)
+{
+
+    pthread_t       hEncoders[CONVERT_MAX_THREADS];
+    pthread_t       hWriter;
+    CONVERT_SLOT*   pSlot;
+    VDI_TRACK*      pTrack;
+    int             nEncoders = 0;
+    int             nUnit = 0;
+    bool            bWriter = false;
+    bool            bAbort;
+    DWORD           dwError = NO_ERROR;
+
+    m_pVDI = pVDI;
+    m_hFile = hFile;
+    m_pVDI->GetDG(m_DG);
+
+    // Validate the geometry against the target format and write its header
+    if ((dwError = Prepare(pFormat)) != NO_ERROR)
+        goto Done;
+
+    // Start the writer and the encoders
+    if (pthread_create(&hWriter, NULL, Writer, this) != 0)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    bWriter = true;
+
+    for (; nEncoders < (int)dwThreads && nEncoders < CONVERT_MAX_THREADS; nEncoders++)
+        if (pthread_create(&hEncoders[nEncoders], NULL, Encoder, this) != 0)
+            break;
+
+    if (nEncoders == 0)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Stop;
+    }
+
+    // Decode the disk one track side at a time, in the order of the target file
+    for (int nTrack = m_DG.FT.nTrack; nTrack <= m_DG.LT.nTrack; nTrack++)
+    {
+
+        pTrack = (nTrack == m_DG.FT.nTrack ? &m_DG.FT : &m_DG.LT);
+
+        for (int nSide = pTrack->nFirstSide; nSide <= pTrack->nLastSide; nSide++, nUnit++)
+        {
+
+            pSlot = &m_Slot[nUnit % CONVERT_SLOTS];
+
+            // Wait for the writer to release the slot
+            pthread_mutex_lock(&m_Mutex);
+            while (pSlot->nState != CONVERT_FREE && !m_bAbort)
+                pthread_cond_wait(&m_Cond, &m_Mutex);
+            bAbort = m_bAbort;
+            pthread_mutex_unlock(&m_Mutex);
+
+            if (bAbort)
+                goto Stop;
+
+            pSlot->nTrack = nTrack;
+            pSlot->nSide = nSide;
+            pSlot->pTrack = pTrack;
+
+            // Unreadable sectors are zero-filled and flagged in the target
+            for (int nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++)
+            {
+                BYTE* pData = &pSlot->pData[(nSector - pTrack->nFirstSector) * CONVERT_SECTOR];
+                if ((pSlot->bBad[nSector - pTrack->nFirstSector] = (m_pVDI->Read(nTrack, nSide, nSector, pData, CONVERT_SECTOR) != NO_ERROR)))
+                    memset(pData, 0, pTrack->wSectorSize);
+            }
+
+            // Hand the slot over to the encoders
+            pthread_mutex_lock(&m_Mutex);
+            pSlot->nState = CONVERT_READ;
+            pthread_cond_broadcast(&m_Cond);
+            pthread_mutex_unlock(&m_Mutex);
+
+        }
+
+    }
+
+    // Let the threads drain the ring and quit
+    Stop:
+    pthread_mutex_lock(&m_Mutex);
+    m_bEnd = true;
+    if (dwError != NO_ERROR)
+        m_bAbort = true;
+    pthread_cond_broadcast(&m_Cond);
+    pthread_mutex_unlock(&m_Mutex);
+
+    for (int x = 0; x < nEncoders; x++)
+        pthread_join(hEncoders[x], NULL);
+
+    if (bWriter)
+        pthread_join(hWriter, NULL);
+
+    if (dwError == NO_ERROR)
+        dwError = m_dwError;
+
+    // Complete the target header
+    if (dwError == NO_ERROR)
+        dwError = Finish();
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Number of sectors converted
+//---------------------------------------------------------------------------------
+
+WORD CConvert::Sectors()
+{
+    return m_wSectors;
+}
+
+//---------------------------------------------------------------------------------
+// Number of sectors that could not be read from the source (flagged in the target)
+//---------------------------------------------------------------------------------
+
+WORD CConvert::BadSectors()
+{
+    return m_wBad;
+}
+
+//---------------------------------------------------------------------------------
+// Validate the geometry against the target format and write the target header
+//---------------------------------------------------------------------------------
+
+DWORD CConvert::Prepare(const char* pFormat)
+{
+
+    VDI_TRACK*  pTracks[2] = { &m_DG.FT, &m_DG.LT };
+    DMK_HEADER  Header;
+    DWORD       dwLength;
+    DWORD       dwSectors;
+    int         nSectors;
+    DWORD       dwError = NO_ERROR;
+
+    if (strcasecmp(pFormat, "JV1") == 0)
+        m_nFormat = CONVERT_JV1;
+    else if (strcasecmp(pFormat, "JV3") == 0)
+        m_nFormat = CONVERT_JV3;
+    else if (strcasecmp(pFormat, "DMK") == 0)
+        m_nFormat = CONVERT_DMK;
+    else
+    {
+        dwError = ERROR_INVALID_PARAMETER;
+        goto Done;
+    }
+
+    // Every format starts at track 0 and JV1/DMK need the same sides on every track
+    if (m_DG.FT.nTrack != 0 || (m_nFormat != CONVERT_JV3 && (m_DG.FT.nFirstSide != m_DG.LT.nFirstSide || m_DG.FT.nLastSide != m_DG.LT.nLastSide)))
+    {
+        dwError = ERROR_NOT_SUPPORTED;
+        goto Done;
+    }
+
+    // Count the sectors and the track sides, and size the slot buffers for the longest track
+    nSectors = 0;
+    m_nUnits = (m_DG.FT.nLastSide - m_DG.FT.nFirstSide + 1) + (m_DG.LT.nTrack - m_DG.FT.nTrack) * (m_DG.LT.nLastSide - m_DG.LT.nFirstSide + 1);
+    dwSectors = (m_DG.FT.nLastSide - m_DG.FT.nFirstSide + 1) * (m_DG.FT.nLastSector - m_DG.FT.nFirstSector + 1) +
+                (m_DG.LT.nTrack - m_DG.FT.nTrack) * (m_DG.LT.nLastSide - m_DG.LT.nFirstSide + 1) * (m_DG.LT.nLastSector - m_DG.LT.nFirstSector + 1);
+
+    for (int x = 0; x < 2; x++)
+        if (pTracks[x]->nLastSector - pTracks[x]->nFirstSector + 1 > nSectors)
+            nSectors = pTracks[x]->nLastSector - pTracks[x]->nFirstSector + 1;
+
+    switch (m_nFormat)
+    {
+
+        // JV1: 256-byte sectors numbered from 0, the same layout on every track
+        case CONVERT_JV1:
+            if (m_DG.FT.wSectorSize != 256 || m_DG.LT.wSectorSize != 256 || m_DG.FT.nFirstSector != 0 || m_DG.LT.nFirstSector != 0 || m_DG.FT.nLastSector != m_DG.LT.nLastSector)
+                dwError = ERROR_NOT_SUPPORTED;
+            dwLength = nSectors * 256;
+            break;
+
+        // JV3: one header entry per sector, filled by the writer and saved by Finish()
+        case CONVERT_JV3:
+            if (dwSectors > sizeof(m_pHeader->Sector) / sizeof(JV3_SECTOR))
+            {
+                dwError = ERROR_NOT_SUPPORTED;
+                break;
+            }
+            if ((m_pHeader = (JV3_HEADER*)malloc(sizeof(JV3_HEADER))) == NULL)
+            {
+                dwError = ERROR_OUTOFMEMORY;
+                break;
+            }
+            for (int x = 0; x < (int)(sizeof(m_pHeader->Sector) / sizeof(JV3_SECTOR)); x++)
+            {
+                m_pHeader->Sector[x].nTrack = JV3_SECTOR_FREE;
+                m_pHeader->Sector[x].nSector = JV3_SECTOR_FREE;
+                m_pHeader->Sector[x].nFlags = JV3_SECTOR_FREEF;
+            }
+            m_pHeader->nWriteProtected = JV3_WP_NO;
+            if (fwrite(m_pHeader, 1, sizeof(JV3_HEADER), m_hFile) != sizeof(JV3_HEADER))
+                dwError = ERROR_WRITE_FAULT;
+            dwLength = nSectors * CONVERT_SECTOR;
+            break;
+
+        // DMK: single density bytes are doubled unless every track is in single density
+        case CONVERT_DMK:
+            m_bSingle = (m_DG.FT.nDensity == VDI_DENSITY_SINGLE && m_DG.LT.nDensity == VDI_DENSITY_SINGLE);
+            m_wTrackLength = (m_bSingle ? 0x0CC0 : 0x1900);
+            for (int x = 0; x < 2; x++)
+            {
+                // IDAM table, gap 1, then sync, ID, gap 2, sync, data and gap 3 for every sector
+                if (pTracks[x]->nDensity != VDI_DENSITY_SINGLE)
+                    dwLength = sizeof(DMK_TRACK) + 32 + (pTracks[x]->nLastSector - pTracks[x]->nFirstSector + 1) * (12 + 3 + 7 + 22 + 12 + 3 + 1 + pTracks[x]->wSectorSize + 2 + 24);
+                else
+                    dwLength = sizeof(DMK_TRACK) + ((16 + (pTracks[x]->nLastSector - pTracks[x]->nFirstSector + 1) * (6 + 7 + 11 + 6 + 1 + pTracks[x]->wSectorSize + 2 + 12)) << (m_bSingle ? 0 : 1));
+                if (dwLength > m_wTrackLength)
+                    m_wTrackLength = dwLength;
+            }
+            if (nSectors > 64 || m_wTrackLength > DMK_IDAM_OFFSET)
+            {
+                dwError = ERROR_NOT_SUPPORTED;
+                break;
+            }
+            memset(&Header, 0, sizeof(Header));
+            Header.nWriteProtected = DMK_WP_NO;
+            Header.nTracks = m_DG.LT.nTrack + 1;
+            Header.wTrackLength = m_wTrackLength;
+            Header.nFlags = (m_DG.LT.nFirstSide == m_DG.LT.nLastSide ? DMK_FLAG_SINGLE_SIDED : 0) | (m_bSingle ? DMK_FLAG_SINGLE_DENSITY : 0);
+            Header.dwSignature = DMK_DISK_VIRTUAL;
+            if (fwrite(&Header, 1, sizeof(Header), m_hFile) != sizeof(Header))
+                dwError = ERROR_WRITE_FAULT;
+            dwLength = m_wTrackLength;
+            break;
+
+    }
+
+    if (dwError != NO_ERROR)
+        goto Done;
+
+    // Allocate the ring
+    for (int x = 0; x < CONVERT_SLOTS; x++)
+    {
+        if ((m_Slot[x].pData = (BYTE*)malloc(nSectors * CONVERT_SECTOR)) == NULL || (m_Slot[x].pOutput = (BYTE*)malloc(dwLength)) == NULL)
+        {
+            dwError = ERROR_OUTOFMEMORY;
+            goto Done;
+        }
+    }
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Complete the target header (JV3 only: its sector table precedes the data)
+//---------------------------------------------------------------------------------
+
+DWORD CConvert::Finish()
+{
+
+    if (m_nFormat != CONVERT_JV3)
+        return NO_ERROR;
+
+    if (fseek(m_hFile, 0, SEEK_SET) != 0 || fwrite(m_pHeader, 1, sizeof(JV3_HEADER), m_hFile) != sizeof(JV3_HEADER))
+        return ERROR_WRITE_FAULT;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Encode one track side in the target format
+//---------------------------------------------------------------------------------
+
+void CConvert::Encode(CONVERT_SLOT& Slot)
+{
+
+    VDI_TRACK*  pTrack = Slot.pTrack;
+
+    // JV1 and JV3 hold the bare sectors, back to back
+    if (m_nFormat != CONVERT_DMK)
+    {
+        Slot.dwOutput = 0;
+        for (int nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++, Slot.dwOutput += pTrack->wSectorSize)
+            memcpy(&Slot.pOutput[Slot.dwOutput], &Slot.pData[(nSector - pTrack->nFirstSector) * CONVERT_SECTOR], pTrack->wSectorSize);
+        return;
+    }
+
+    EncodeDMK(Slot);
+
+}
+
+//---------------------------------------------------------------------------------
+// Build one raw DMK track: IDAM pointers, address marks, gaps and CRCs
+//---------------------------------------------------------------------------------
+
+void CConvert::EncodeDMK(CONVERT_SLOT& Slot)
+{
+
+    VDI_TRACK*  pTrack = Slot.pTrack;
+    bool        bDouble = (pTrack->nDensity != VDI_DENSITY_SINGLE);
+    int         nStep = (bDouble || m_bSingle ? 1 : 2);
+    BYTE        nSize;
+    BYTE        ID[5];
+    BYTE*       pData;
+    BYTE*       p;
+    WORD        wCRC;
+
+    // Size code (0:128, 1:256, 2:512, 3:1024)
+    for (nSize = 0; (128 << nSize) < pTrack->wSectorSize && nSize < 3; nSize++);
+
+    // Empty IDAM table, then gap filler up to the end of the track
+    memset(Slot.pOutput, 0, sizeof(DMK_TRACK));
+    memset(Slot.pOutput + sizeof(DMK_TRACK), (bDouble ? 0x4E : 0xFF), m_wTrackLength - sizeof(DMK_TRACK));
+    p = Slot.pOutput + sizeof(DMK_TRACK) + (bDouble ? 32 : 16) * nStep;
+
+    for (int nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++)
+    {
+
+        pData = &Slot.pData[(nSector - pTrack->nFirstSector) * CONVERT_SECTOR];
+
+        // Sync field and ID address mark (the double density CRC preset covers the three 0xA1)
+        memset(p, 0x00, (bDouble ? 12 : 6) * nStep);
+        p += (bDouble ? 12 : 6) * nStep;
+
+        if (bDouble)
+        {
+            memset(p, 0xA1, 3);
+            p += 3;
+        }
+
+        ((WORD*)Slot.pOutput)[nSector - pTrack->nFirstSector] = (p - Slot.pOutput) | (bDouble ? DMK_IDAM_DENSITY : 0);
+
+        ID[0] = 0xFE;
+        ID[1] = Slot.nTrack;
+        ID[2] = Slot.nSide;
+        ID[3] = nSector;
+        ID[4] = nSize;
+        wCRC = CRC((bDouble ? 0xCDB4 : 0xFFFF), ID, 5);
+
+        for (int x = 0; x < 7; x++, p += nStep)
+            memset(p, (x < 5 ? ID[x] : x == 5 ? wCRC >> 8 : wCRC & 0xFF), nStep);
+
+        p += (bDouble ? 22 : 11) * nStep;
+
+        // Sync field, data address mark, data and CRC (inverted for sectors the source couldn't read)
+        memset(p, 0x00, (bDouble ? 12 : 6) * nStep);
+        p += (bDouble ? 12 : 6) * nStep;
+
+        if (bDouble)
+        {
+            memset(p, 0xA1, 3);
+            p += 3;
+        }
+
+        memset(p, 0xFB, nStep);
+        p += nStep;
+
+        wCRC = CRC(CRC((bDouble ? 0xCDB4 : 0xFFFF), (const BYTE*)"\xFB", 1), pData, pTrack->wSectorSize);
+
+        if (Slot.bBad[nSector - pTrack->nFirstSector])
+            wCRC = ~wCRC;
+
+        if (nStep == 1)
+        {
+            memcpy(p, pData, pTrack->wSectorSize);
+            p += pTrack->wSectorSize;
+        }
+        else
+        {
+            for (int x = 0; x < pTrack->wSectorSize; x++, p += 2)
+                p[0] = p[1] = pData[x];
+        }
+
+        memset(p, wCRC >> 8, nStep);
+        p += nStep;
+        memset(p, wCRC & 0xFF, nStep);
+        p += nStep;
+
+        p += (bDouble ? 24 : 12) * nStep;
+
+    }
+
+    Slot.dwOutput = m_wTrackLength;
+
+}
+
+//---------------------------------------------------------------------------------
+// Encoder thread: encode decoded slots in any order
+//---------------------------------------------------------------------------------
+
+void* CConvert::Encoder(void* pParam)
+{
+
+    CConvert*       pThis = (CConvert*)pParam;
+    CONVERT_SLOT*   pSlot;
+
+    pthread_mutex_lock(&pThis->m_Mutex);
+
+    while (!pThis->m_bAbort)
+    {
+
+        // Take any decoded slot
+        pSlot = NULL;
+        for (int x = 0; x < CONVERT_SLOTS && pSlot == NULL; x++)
+            if (pThis->m_Slot[x].nState == CONVERT_READ)
+                pSlot = &pThis->m_Slot[x];
+
+        if (pSlot == NULL)
+        {
+            if (pThis->m_bEnd)
+                break;
+            pthread_cond_wait(&pThis->m_Cond, &pThis->m_Mutex);
+            continue;
+        }
+
+        pSlot->nState = CONVERT_BUSY;
+        pthread_mutex_unlock(&pThis->m_Mutex);
+
+        pThis->Encode(*pSlot);
+
+        pthread_mutex_lock(&pThis->m_Mutex);
+        pSlot->nState = CONVERT_DONE;
+        pthread_cond_broadcast(&pThis->m_Cond);
+
+    }
+
+    pthread_mutex_unlock(&pThis->m_Mutex);
+
+    return NULL;
+
+}
+
+//---------------------------------------------------------------------------------
+// Writer thread: write encoded slots in the order they were decoded
+//---------------------------------------------------------------------------------
+
+void* CConvert::Writer(void* pParam)
+{
+
+    CConvert*       pThis = (CConvert*)pParam;
+    CONVERT_SLOT*   pSlot;
+    VDI_TRACK*      pTrack;
+    JV3_SECTOR*     pEntry;
+    BYTE            nSize;
+    bool            bAbort;
+
+    for (int nUnit = 0; nUnit < pThis->m_nUnits; nUnit++)
+    {
+
+        pSlot = &pThis->m_Slot[nUnit % CONVERT_SLOTS];
+
+        // Wait for the slot to be encoded
+        pthread_mutex_lock(&pThis->m_Mutex);
+        while (pSlot->nState != CONVERT_DONE && !pThis->m_bAbort)
+            pthread_cond_wait(&pThis->m_Cond, &pThis->m_Mutex);
+        bAbort = pThis->m_bAbort;
+        pthread_mutex_unlock(&pThis->m_Mutex);
+
+        if (bAbort)
+            break;
+
+        if (fwrite(pSlot->pOutput, 1, pSlot->dwOutput, pThis->m_hFile) != pSlot->dwOutput)
+        {
+            pthread_mutex_lock(&pThis->m_Mutex);
+            pThis->m_dwError = ERROR_WRITE_FAULT;
+            pThis->m_bAbort = true;
+            pthread_cond_broadcast(&pThis->m_Cond);
+            pthread_mutex_unlock(&pThis->m_Mutex);
+            break;
+        }
+
+        // Account for the sectors and describe them in the JV3 header
+        pTrack = pSlot->pTrack;
+
+        for (nSize = 0; (128 << nSize) < pTrack->wSectorSize && nSize < 3; nSize++);
+
+        for (int nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++, pThis->m_wSectors++)
+        {
+
+            if (pSlot->bBad[nSector - pTrack->nFirstSector])
+                pThis->m_wBad++;
+
+            if (pThis->m_nFormat != CONVERT_JV3)
+                continue;
+
+            // JV3 size codes: 00:256, 01:128, 10:1024, 11:512
+            pEntry = &pThis->m_pHeader->Sector[pThis->m_wSectors];
+            pEntry->nTrack = pSlot->nTrack;
+            pEntry->nSector = nSector;
+            pEntry->nFlags = (pTrack->nDensity != VDI_DENSITY_SINGLE ? JV3_FLAG_DENSITY : 0) | (pSlot->nSide ? JV3_FLAG_SIDE : 0) |
+                             (pSlot->bBad[nSector - pTrack->nFirstSector] ? JV3_FLAG_CRC : 0) | (nSize ^ 1);
+
+        }
+
+        // Release the slot to the reader
+        pthread_mutex_lock(&pThis->m_Mutex);
+        pSlot->nState = CONVERT_FREE;
+        pthread_cond_broadcast(&pThis->m_Cond);
+        pthread_mutex_unlock(&pThis->m_Mutex);
+
+    }
+
+    return NULL;
+
+}
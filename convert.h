@@ -0,0 +1,105 @@
+/**
+ @file convert.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Streaming conversion of a disk into the JV1, JV3 or DMK format
+//---------------------------------------------------------------------------------
+//
+// The calling thread decodes one track side at a time from the source CVDI into a
+// ring of CONVERT_SLOTS slots, encoder threads turn each one into the bytes of the
+// target format, and a writer thread appends them to the target file in order.
+//
+//---------------------------------------------------------------------------------
+
+#include <pthread.h>
+
+#define CONVERT_SLOTS       8                                                       // Track sides in flight between the reader and the writer
+#define CONVERT_MAX_THREADS 16                                                      // Upper limit for the number of encoder threads
+#define CONVERT_SECTOR      1024                                                    // Largest sector size (one slot of a track buffer)
+
+enum    CONVERT_FORMAT                                                              // Target format enumerator
+{
+    CONVERT_JV1 = 0,                                                                // Sectors only
+    CONVERT_JV3 = 1,                                                                // Sector headers followed by the sectors
+    CONVERT_DMK = 2                                                                 // Raw tracks with IDAM pointers, gaps and CRCs
+};
+
+enum    CONVERT_STATE                                                               // Slot state enumerator
+{
+    CONVERT_FREE = 0,                                                               // Waiting for the reader
+    CONVERT_READ = 1,                                                               // Decoded, waiting for an encoder
+    CONVERT_BUSY = 2,                                                               // Being encoded
+    CONVERT_DONE = 3                                                                // Encoded, waiting for the writer
+};
+
+struct  CONVERT_SLOT                                                                // One track side in flight
+{
+    CONVERT_STATE   nState;                                                         // Slot state
+    BYTE            nTrack;                                                         // Track number
+    BYTE            nSide;                                                          // Side number
+    VDI_TRACK*      pTrack;                                                         // Track descriptor
+    BYTE*           pData;                                                          // Decoded sectors, CONVERT_SECTOR bytes apart
+    bool            bBad[256];                                                      // Sector could not be read from the source
+    BYTE*           pOutput;                                                        // Encoded track side
+    DWORD           dwOutput;                                                       // Number of bytes held by pOutput
+};
+
+class   CConvert
+{
+protected:
+    CVDI*           m_pVDI;                                                         // Source disk interface
+    VDI_GEOMETRY    m_DG;                                                           // Source disk geometry
+    FILE*           m_hFile;                                                        // Target file handle
+    CONVERT_FORMAT  m_nFormat;                                                      // Target format
+    WORD            m_wTrackLength;                                                 // DMK track length
+    bool            m_bSingle;                                                      // DMK: every track is in single density (no doubled bytes)
+    JV3_HEADER*     m_pHeader;                                                      // JV3 header, filled as the sectors are written
+    WORD            m_wSectors;                                                     // Number of sectors written
+    WORD            m_wBad;                                                         // Number of sectors that could not be read
+    int             m_nUnits;                                                       // Number of track sides to convert
+    CONVERT_SLOT    m_Slot[CONVERT_SLOTS];                                          // Ring of track sides in flight
+    bool            m_bEnd;                                                         // Reader has decoded every track side
+    bool            m_bAbort;                                                       // Writer has given up
+    DWORD           m_dwError;                                                      // Error raised by the writer thread
+    pthread_mutex_t m_Mutex;                                                        // Protects the slot states
+    pthread_cond_t  m_Cond;                                                         // Signals any slot state change
+public:
+    CConvert();
+    ~CConvert();
+    DWORD   Run(CVDI* pVDI, const char* pFormat, FILE* hFile, DWORD dwThreads = 4); // Convert the whole disk into a target file
+    WORD    Sectors();                                                              // Number of sectors converted
+    WORD    BadSectors();                                                           // Number of them that could not be read (flagged in the target)
+protected:
+    DWORD   Prepare(const char* pFormat);                                           // Validate the geometry and write the target header
+    DWORD   Finish();                                                               // Complete the target header
+    void    Encode(CONVERT_SLOT& Slot);                                             // Encode one track side in the target format
+    void    EncodeDMK(CONVERT_SLOT& Slot);                                          // Build one raw DMK track
+    static void*    Encoder(void* pParam);                                          // Encoder thread: encode decoded slots in any order
+    static void*    Writer(void* pParam);                                           // Writer thread: write encoded slots in order
+};
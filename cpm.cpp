@@ -35,6 +35,7 @@
 #include <math.h>
 #include <stdio.h>
 #include "v80.h"
+#include "stats.h"
 #include "vdi.h"
 #include "osi.h"
 #include "cpm.h"
@@ -42,12 +43,14 @@
 void    Dump(unsigned char* pBuffer, int nSize);
 void    PrintError(DWORD dwError);
 
+extern __thread FILE* ghOut;
+
 //---------------------------------------------------------------------------------
 // Initialize member variables
 //---------------------------------------------------------------------------------
 
 CCPM::CCPM()
-: m_pDir(NULL), m_DPB(), m_nSectorsPerBlock(0), m_nReservedSectors(0), m_dwFilePos(0), m_wSector(0), m_Buffer()
+: m_pDir(NULL), m_DPB(), m_nSectorsPerBlock(0), m_nReservedSectors(0), m_dwFilePos(0), m_wSector(0), m_Buffer(), m_wFCB(-1)
 {
 }
 
@@ -104,8 +107,8 @@ DWORD CCPM::Load(CVDI* pVDI, DWORD dwFlags)
 
     if (m_dwFlags & V80_FLAG_INFO)
     {
-        printf("DOS:   BLS RPT BSH BLM EXM DSM DRM AL0 AL1 CKS OFF SSZ SKF OPT\r\n");
-        printf("DOS: %5d %3d %3d %3d %3d %3d %3d  %02X  %02X %3d %3d %3d %3d  %02X\r\n",
+        fprintf(ghOut, "DOS:   BLS RPT BSH BLM EXM DSM DRM AL0 AL1 CKS OFF SSZ SKF OPT\r\n");
+        fprintf(ghOut, "DOS: %5d %3d %3d %3d %3d %3d %3d  %02X  %02X %3d %3d %3d %3d  %02X\r\n",
                m_DPB.wBLS, m_DPB.nRPT, m_DPB.nBSH, m_DPB.nBLM, m_DPB.nEXM, m_DPB.wDSM, m_DPB.wDRM, m_DPB.nAL0, m_DPB.nAL1, m_DPB.nCKS, m_DPB.nOFF, m_DPB.nSSZ, m_DPB.nSKF, m_DPB.nOPT);
     }
 
@@ -121,19 +124,17 @@ DWORD CCPM::Load(CVDI* pVDI, DWORD dwFlags)
 DWORD CCPM::Dir(void** pFile, OSI_DIR nFlag)
 {
 
-    static WORD wFCB = -1;
-
     DWORD dwError = NO_ERROR;
 
     // Reset index if FindFirst has been requested
     if (nFlag == OSI_DIR_FIND_FIRST)
-        wFCB = -1;
+        m_wFCB = -1;
 
-    while (++wFCB <= m_DPB.wDRM)
+    while (++m_wFCB <= m_DPB.wDRM)
     {
 
         // Get a pointer to the next entry
-        *pFile = &((CPM_FCB*)m_pDir)[wFCB];
+        *pFile = &((CPM_FCB*)m_pDir)[m_wFCB];
 
         // Check whether entry is deleted
         if (((CPM_FCB*)(*pFile))->nET == 0xE5)
@@ -629,6 +630,7 @@ void CCPM::GetFile(void* pFile, OSI_FILE& File)
     File.bSystem    = (((CPM_FCB*)pFile)->cFT[1] & 0x80);
     File.bInvisible = (((CPM_FCB*)pFile)->cFT[1] & 0x80) || (((CPM_FCB*)pFile)->nET == 0x80);
     File.bModified  = ((CPM_FCB*)pFile)->cFT[2] & 0x80;;
+    File.nLRL       = 128;                                                      // CP/M records are always 128 bytes
 
 }
 
@@ -819,6 +821,9 @@ DWORD CCPM::DirRW(CPM_DIR nMode)
     DWORD   dwOffset = 0;
     DWORD   dwError = NO_ERROR;
 
+    STAT_COUNT(nMode == CPM_DIR_WRITE ? STAT_DIR_WRITE : STAT_DIR_READ);
+    STAT_PHASE(nMode == CPM_DIR_WRITE ? STAT_PHASE_COMMIT : STAT_PHASE_DIR);
+
     for (BYTE nExSide = m_DG.LT.nFirstSide; nExSide <= (m_DPB.nOPT & CPM_OPT_SSEL ? m_DG.LT.nLastSide : m_DG.LT.nFirstSide) && nSectors > 0; nExSide++)
     {
         for (BYTE nTrack = m_DG.FT.nTrack + m_DPB.nOFF; nTrack <= m_DG.LT.nTrack && nSectors > 0; nTrack++)
@@ -1028,7 +1033,7 @@ DWORD CCPM::CreateExtent(CPM_EXTENT& Extent, BYTE nGranules)
     {
 
         // Test the state of 'CurrentGranule' at GAT[CurrentCylinder]
-        while ((m_pDir[nCurrentCylinder] & (1 << nCurrentGranule)) != nExpectedBit)
+        while (((m_pDir[nCurrentCylinder] >> nCurrentGranule) & 1) != nExpectedBit)
         {
 
             // Check if we are in the "continue up to the first non-empty slot" phase
@@ -1147,6 +1152,8 @@ DWORD CCPM::CopyExtent(void* pFile, CPM_EXT nMode, BYTE nExtent, CPM_EXTENT& Ext
     CPM_EXTENT* pExtent;
     DWORD       dwError = NO_ERROR;
 
+    STAT_COUNT(STAT_EXTENT);
+
     // Go through the extents table
     for (int x = 1, y = 1; x < 6; x++)
     {
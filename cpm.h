@@ -93,6 +93,7 @@ protected:
     DWORD           m_dwFilePos;                                                    // Current file position - Seek()
     WORD            m_wSector;                                                      // Current relative sector - Seek()
     BYTE            m_Buffer[1024];                                                 // Generic buffer for operations on sectors
+    WORD            m_wFCB;                                                         // Last directory entry returned - Dir()
 public:
                     CCPM();                                                         // Initialize member variables
     virtual         ~CCPM();                                                        // Release allocated memory
@@ -111,8 +111,8 @@ DWORD CDD::Load(CVDI* pVDI, DWORD dwFlags)
         goto Done;
     }
 
-    // Load directory into memory
-    if ((dwError = DirRW(ND_DIR_READ)) != NO_ERROR)
+    // Load GAT and HIT into memory (the directory entries are read on first use)
+    if ((dwError = DirRW(ND_DIR_OPEN)) != NO_ERROR)
         goto Done;
 
     // Check directory structure
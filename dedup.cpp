@@ -0,0 +1,337 @@
+/**
+ @file dedup.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Duplicate files across disk images
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "hash.h"
+#include "dedup.h"
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CDedup::CDedup()
+:   m_pFiles(NULL), m_nFiles(0), m_pGroups(NULL), m_nGroups(0), m_nUnique(0), m_nCopies(0), m_qwBytes(0), m_qwSaved(0)
+{
+    pthread_mutex_init(&m_Mutex, NULL);
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CDedup::~CDedup()
+{
+    Reset();
+    pthread_mutex_destroy(&m_Mutex);
+}
+
+//---------------------------------------------------------------------------------
+// Hash the files of an image that match the mask (and the flags let through)
+//---------------------------------------------------------------------------------
+
+DWORD CDedup::Add(CImage* pImage, const char* pName, const char* pMask, DWORD dwFlags, DUP_HASHED pHashed, void* pParam, WORD& wFiles, DWORD& dwSize)
+{
+
+    OSI_FILE    File;
+    char        cMask[11];
+    void*       pFile = NULL;
+    BYTE*       pBuffer = NULL;
+    DUP_FILE*   pFiles = NULL;
+    DUP_FILE*   pMore;
+    size_t      nFiles = 0;
+    CHash       XXH;
+    DWORD       dwPos;
+    DWORD       dwBytes;
+    DWORD       dwError = NO_ERROR;
+
+    wFiles = 0;
+    dwSize = 0;
+
+    if ((pBuffer = (BYTE*)malloc(V80_CHUNK)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    // Convert Windows filespec to TRS standard
+    Win2TRS((pMask != NULL ? pMask : "*.*"), cMask);
+
+    while ((dwError = pImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == NO_ERROR)
+    {
+
+        // Compare file attributes against user options
+        if ((File.bSystem && !(dwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(dwFlags & V80_FLAG_INVISIBLE)))
+            continue;
+
+        // Compare the filename against the source filespec
+        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
+            continue;
+
+        if (nFiles % 64 == 0)
+        {
+            if ((pMore = (DUP_FILE*)realloc(pFiles, (nFiles + 64) * sizeof(DUP_FILE))) == NULL)
+            {
+                dwError = ERROR_OUTOFMEMORY;
+                goto Done;
+            }
+            pFiles = pMore;
+        }
+
+        pFiles[nFiles].dwSize = File.dwSize;
+        pFiles[nFiles].pImage = pName;
+        FmtName(File.szName, File.szType, pImage->Divider(), pFiles[nFiles].szFile);
+
+        // Stream the file through the hash, straight from the image
+        for (XXH.Reset(), dwPos = 0; dwPos < File.dwSize; dwPos += dwBytes)
+        {
+            dwBytes = (File.dwSize - dwPos < V80_CHUNK ? File.dwSize - dwPos : V80_CHUNK);
+            if ((dwError = pImage->Read(pFile, dwPos, pBuffer, dwBytes)) != NO_ERROR || dwBytes == 0)
+                break;
+            XXH.Update(pBuffer, dwBytes);
+        }
+
+        pFiles[nFiles].qwHash = XXH.Digest();
+
+        // A file that can't be read whole is left out
+        if (dwPos < File.dwSize)
+        {
+            dwError = NO_ERROR;
+            if (pHashed != NULL)
+                pHashed(pParam, pFiles[nFiles], ERROR_READ_FAULT);
+            continue;
+        }
+
+        if (pHashed != NULL)
+            pHashed(pParam, pFiles[nFiles], NO_ERROR);
+
+        nFiles++;
+        wFiles++;
+        dwSize += File.dwSize;
+
+    }
+
+    // If exited on "No More Files" then "No Error"
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = NO_ERROR;
+
+    // Add this image's files to the others
+    pthread_mutex_lock(&m_Mutex);
+
+    if ((pMore = (DUP_FILE*)realloc(m_pFiles, (m_nFiles + nFiles) * sizeof(DUP_FILE))) != NULL)
+    {
+        m_pFiles = pMore;
+        memcpy(&m_pFiles[m_nFiles], pFiles, nFiles * sizeof(DUP_FILE));
+        m_nFiles += nFiles;
+    }
+    else if (nFiles > 0)
+        dwError = ERROR_OUTOFMEMORY;
+
+    pthread_mutex_unlock(&m_Mutex);
+
+    Done:
+    free(pFiles);
+    free(pBuffer);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Sort the files by contents and find the groups of copies, largest savings first
+//---------------------------------------------------------------------------------
+
+DWORD CDedup::Group()
+{
+
+    DUP_GROUP*  pMore;
+    size_t      x, y;
+
+    free(m_pGroups);
+
+    m_pGroups = NULL;
+    m_nGroups = 0;
+    m_nUnique = 0;
+    m_nCopies = 0;
+    m_qwBytes = 0;
+    m_qwSaved = 0;
+
+    // Files with the same contents end up next to each other
+    qsort(m_pFiles, m_nFiles, sizeof(DUP_FILE), Compare);
+
+    for (x = 0; x < m_nFiles; x = y)
+    {
+
+        for (y = x + 1; y < m_nFiles && m_pFiles[y].qwHash == m_pFiles[x].qwHash && m_pFiles[y].dwSize == m_pFiles[x].dwSize; y++);
+
+        m_nUnique++;
+        m_qwBytes += (unsigned long long)m_pFiles[x].dwSize * (y - x);
+
+        if (y - x < 2)
+            continue;
+
+        if (m_nGroups % 256 == 0)
+        {
+            if ((pMore = (DUP_GROUP*)realloc(m_pGroups, (m_nGroups + 256) * sizeof(DUP_GROUP))) == NULL)
+                return ERROR_OUTOFMEMORY;
+            m_pGroups = pMore;
+        }
+
+        m_pGroups[m_nGroups].nFirst = x;
+        m_pGroups[m_nGroups].nCount = y - x;
+        m_pGroups[m_nGroups].qwSaved = (unsigned long long)m_pFiles[x].dwSize * (y - x - 1);
+
+        m_nCopies += y - x - 1;
+        m_qwSaved += m_pGroups[m_nGroups].qwSaved;
+        m_nGroups++;
+
+    }
+
+    qsort(m_pGroups, m_nGroups, sizeof(DUP_GROUP), CompareGroup);
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Forget every file
+//---------------------------------------------------------------------------------
+
+void CDedup::Reset()
+{
+
+    free(m_pGroups);
+    free(m_pFiles);
+
+    m_pFiles = NULL;
+    m_nFiles = 0;
+    m_pGroups = NULL;
+    m_nGroups = 0;
+    m_nUnique = 0;
+    m_nCopies = 0;
+    m_qwBytes = 0;
+    m_qwSaved = 0;
+
+}
+
+//---------------------------------------------------------------------------------
+// Totals (those of the groups are set by Group)
+//---------------------------------------------------------------------------------
+
+size_t CDedup::Files()
+{
+    return m_nFiles;
+}
+
+size_t CDedup::Unique()
+{
+    return m_nUnique;
+}
+
+size_t CDedup::Groups()
+{
+    return m_nGroups;
+}
+
+size_t CDedup::Copies()
+{
+    return m_nCopies;
+}
+
+unsigned long long CDedup::Bytes()
+{
+    return m_qwBytes;
+}
+
+unsigned long long CDedup::Saved()
+{
+    return m_qwSaved;
+}
+
+//---------------------------------------------------------------------------------
+// Return a group of copies, or a file
+//---------------------------------------------------------------------------------
+
+const DUP_GROUP& CDedup::GetGroup(size_t nGroup)
+{
+    return m_pGroups[nGroup];
+}
+
+const DUP_FILE& CDedup::GetFile(size_t nFile)
+{
+    return m_pFiles[nFile];
+}
+
+//---------------------------------------------------------------------------------
+// Order the hashed files by contents (hash, then size), then by image and name
+//---------------------------------------------------------------------------------
+
+int CDedup::Compare(const void* pFile1, const void* pFile2)
+{
+
+    const DUP_FILE* p1 = (const DUP_FILE*)pFile1;
+    const DUP_FILE* p2 = (const DUP_FILE*)pFile2;
+    int             nOrder;
+
+    if (p1->qwHash != p2->qwHash)
+        return (p1->qwHash < p2->qwHash ? -1 : 1);
+
+    if (p1->dwSize != p2->dwSize)
+        return (p1->dwSize < p2->dwSize ? -1 : 1);
+
+    if ((nOrder = strcmp(p1->pImage, p2->pImage)) != 0)
+        return nOrder;
+
+    return strcmp(p1->szFile, p2->szFile);
+
+}
+
+//---------------------------------------------------------------------------------
+// Order the duplicate groups by bytes saved, largest first
+//---------------------------------------------------------------------------------
+
+int CDedup::CompareGroup(const void* pGroup1, const void* pGroup2)
+{
+
+    const DUP_GROUP* p1 = (const DUP_GROUP*)pGroup1;
+    const DUP_GROUP* p2 = (const DUP_GROUP*)pGroup2;
+
+    if (p1->qwSaved != p2->qwSaved)
+        return (p1->qwSaved > p2->qwSaved ? -1 : 1);
+
+    return (p1->nFirst < p2->nFirst ? -1 : (p1->nFirst > p2->nFirst ? 1 : 0));
+
+}
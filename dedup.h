@@ -0,0 +1,92 @@
+/**
+ @file dedup.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Duplicate files across disk images
+//---------------------------------------------------------------------------------
+//
+// Add() streams the files of an image through XXH64, straight from the image, and
+// keeps one entry per file. Once every image is in, Group() sorts the entries by
+// contents and finds the groups of copies, largest savings first.
+//
+// Add() may be called from the batch workers at once, Group() only after them.
+//
+//---------------------------------------------------------------------------------
+
+#include <pthread.h>
+
+class   CImage;
+
+struct  DUP_FILE                                                                    // One file hashed
+{
+    unsigned long long qwHash;                                                      // XXH64 of the contents
+    DWORD       dwSize;                                                             // File size
+    const char* pImage;                                                             // Disk image holding the file (kept by the caller)
+    char        szFile[13];                                                         // Formatted filename
+};
+
+struct  DUP_GROUP                                                                   // Files with the same contents
+{
+    size_t      nFirst;                                                             // First file of the group (GetFile)
+    size_t      nCount;                                                             // Number of copies
+    unsigned long long qwSaved;                                                     // Bytes taken by all copies but one
+};
+
+typedef void (*DUP_HASHED)(void* pParam, const DUP_FILE& File, DWORD dwError);      // Called for each file (ERROR_READ_FAULT: left out)
+
+class   CDedup
+{
+protected:
+    DUP_FILE*   m_pFiles;                                                           // Files hashed so far (sorted by Group)
+    size_t      m_nFiles;                                                           // Number of files
+    DUP_GROUP*  m_pGroups;                                                          // Groups of copies (Group)
+    size_t      m_nGroups;                                                          // Number of groups
+    size_t      m_nUnique;                                                          // Number of different contents
+    size_t      m_nCopies;                                                          // Copies beyond the first of each group
+    unsigned long long m_qwBytes;                                                   // Bytes taken by all files
+    unsigned long long m_qwSaved;                                                   // Bytes taken by the extra copies
+    pthread_mutex_t m_Mutex;                                                        // Serializes Add() (batch workers)
+public:
+                CDedup();                                                           // Initialize member variables
+    virtual     ~CDedup();                                                          // Release allocated memory
+    DWORD       Add(CImage* pImage, const char* pName, const char* pMask, DWORD dwFlags, DUP_HASHED pHashed, void* pParam, WORD& wFiles, DWORD& dwSize); // Hash the files of an image (pMask NULL: every file)
+    DWORD       Group();                                                            // Find the groups of copies, largest savings first
+    void        Reset();                                                            // Forget every file
+    size_t      Files();                                                            // Number of files hashed
+    size_t      Unique();                                                           // Number of different contents
+    size_t      Groups();                                                           // Number of groups of copies
+    size_t      Copies();                                                           // Number of redundant copies
+    unsigned long long Bytes();                                                     // Bytes taken by all files
+    unsigned long long Saved();                                                     // Bytes taken by the redundant copies
+    const DUP_GROUP& GetGroup(size_t nGroup);                                       // Return a group of copies
+    const DUP_FILE& GetFile(size_t nFile);                                          // Return a file (the copies of a group follow its first one)
+protected:
+    static int  Compare(const void* pFile1, const void* pFile2);                    // Order the files by contents, then by image and name
+    static int  CompareGroup(const void* pGroup1, const void* pGroup2);             // Order the groups by bytes saved
+};
@@ -0,0 +1,518 @@
+/**
+ @file diff.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Structural diff of two disk images
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "hash.h"
+#include "arc.h"
+#include "diff.h"
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CDiff::CDiff()
+:   m_Disk1(), m_Disk2(), m_bSnap(false), m_pFiles1(NULL), m_pFiles2(NULL), m_nFiles1(0), m_nFiles2(0), m_dwSectors(0), m_dwDiffer(0),
+    m_dwAdded(0), m_dwRemoved(0), m_dwRenamed(0), m_dwChanged(0), m_dwSame(0), m_dwMemory(0)
+{
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CDiff::~CDiff()
+{
+
+    CArchive::Release(m_Disk1);
+    CArchive::Release(m_Disk2);
+
+    free(m_pFiles1);
+    free(m_pFiles2);
+
+}
+
+//---------------------------------------------------------------------------------
+// Compare the sector hashes, when both disks are laid out alike (the files are then compared in memory)
+//---------------------------------------------------------------------------------
+
+DWORD CDiff::CompareSectors(CImage* pImage1, CImage* pImage2, DIFF_SECTOR pSector, void* pParam)
+{
+
+    VDI_GEOMETRY    DG1;
+    VDI_GEOMETRY    DG2;
+    VDI_TRACK*      pTrack;
+    BYTE            nTrack, nSide, nSector;
+    DWORD           x;
+    DWORD           dwError;
+
+    pImage1->GetVDI()->GetDG(DG1);
+    pImage2->GetVDI()->GetDG(DG2);
+
+    if (!CVDI::SameTrack(DG1.FT, DG2.FT) || !CVDI::SameTrack(DG1.LT, DG2.LT))
+        return ERROR_NOT_SUPPORTED;
+
+    if ((dwError = CArchive::Snap(pImage1->GetVDI(), m_Disk1)) != NO_ERROR || (dwError = CArchive::Snap(pImage2->GetVDI(), m_Disk2)) != NO_ERROR)
+        return dwError;
+
+    m_bSnap = true;
+    m_dwSectors = m_Disk1.dwSectors;
+    m_dwDiffer = 0;
+
+    for (nTrack = DG1.FT.nTrack, x = 0; nTrack <= DG1.LT.nTrack; nTrack++)
+    {
+
+        pTrack = (nTrack == DG1.FT.nTrack ? &DG1.FT : &DG1.LT);
+
+        for (nSide = pTrack->nFirstSide; nSide <= pTrack->nLastSide; nSide++)
+        {
+            for (nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++, x++)
+            {
+
+                if (m_Disk1.pHash[x] != m_Disk2.pHash[x])
+                {
+                    m_dwDiffer++;
+                    if (pSector != NULL)
+                        pSector(pParam, nTrack, nSide, nSector);
+                }
+
+                if (nSector == 0xFF)
+                    break;
+
+            }
+        }
+
+        if (nTrack == 0xFF)
+            break;
+
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Compare the files: by name, then the renamed ones by contents, then the rest
+// (the images must be those given to CompareSectors, if it was called)
+//---------------------------------------------------------------------------------
+
+DWORD CDiff::CompareFiles(CImage* pImage1, CImage* pImage2, const char* pMask, DWORD dwFlags, DIFF_REPORT pReport, void* pParam)
+{
+
+    DIFF_ITEM   Item;
+    bool        bMemory;
+    size_t      x, y;
+    int         nOrder;
+    DWORD       dwError;
+
+    if ((dwError = List(pImage1, pMask, dwFlags, m_pFiles1, m_nFiles1)) != NO_ERROR || (dwError = List(pImage2, pMask, dwFlags, m_pFiles2, m_nFiles2)) != NO_ERROR)
+        return dwError;
+
+    // Files by the same name: properties and contents (in name order)
+    for (x = 0, y = 0; x < m_nFiles1 && y < m_nFiles2; )
+    {
+
+        if ((nOrder = strcmp(m_pFiles1[x].szFile, m_pFiles2[y].szFile)) != 0)
+        {
+            (nOrder < 0 ? x++ : y++);
+            continue;
+        }
+
+        m_pFiles1[x].bMatched = m_pFiles2[y].bMatched = true;
+
+        memset(&Item, 0, sizeof(Item));
+        Item.nChange = DIFF_CHANGED;
+        Item.pOld = &m_pFiles1[x];
+        Item.pNew = &m_pFiles2[y];
+
+        Attr(m_pFiles1[x].File, Item.szOld);
+        Attr(m_pFiles2[y].File, Item.szNew);
+
+        Item.bAttr = (strcmp(Item.szOld, Item.szNew) != 0);
+        Item.dwError = Data(pImage1, &m_pFiles1[x], pImage2, &m_pFiles2[y], Item.dwFirst, Item.dwBytes, bMemory);
+
+        if (Item.dwError == NO_ERROR && Item.dwBytes == 0 && !Item.bAttr)
+        {
+            m_dwSame++;
+            m_dwMemory += bMemory;
+        }
+        else
+        {
+            m_dwChanged++;
+            pReport(pParam, Item);
+        }
+
+        x++;
+        y++;
+
+    }
+
+    // A file only on each side with the same contents was renamed
+    for (x = 0; x < m_nFiles1; x++)
+    {
+
+        if (m_pFiles1[x].bMatched || Hash(pImage1, &m_pFiles1[x]) != NO_ERROR)
+            continue;
+
+        for (y = 0; y < m_nFiles2; y++)
+        {
+
+            if (m_pFiles2[y].bMatched || m_pFiles2[y].File.dwSize != m_pFiles1[x].File.dwSize || Hash(pImage2, &m_pFiles2[y]) != NO_ERROR || m_pFiles2[y].qwHash != m_pFiles1[x].qwHash)
+                continue;
+
+            m_pFiles1[x].bMatched = m_pFiles2[y].bMatched = true;
+
+            memset(&Item, 0, sizeof(Item));
+            Item.nChange = DIFF_RENAMED;
+            Item.pOld = &m_pFiles1[x];
+            Item.pNew = &m_pFiles2[y];
+
+            m_dwRenamed++;
+            pReport(pParam, Item);
+            break;
+
+        }
+
+    }
+
+    // The rest were removed or added
+    for (x = 0; x < m_nFiles1; x++)
+    {
+
+        if (m_pFiles1[x].bMatched)
+            continue;
+
+        memset(&Item, 0, sizeof(Item));
+        Item.nChange = DIFF_REMOVED;
+        Item.pOld = &m_pFiles1[x];
+
+        m_dwRemoved++;
+        pReport(pParam, Item);
+
+    }
+
+    for (y = 0; y < m_nFiles2; y++)
+    {
+
+        if (m_pFiles2[y].bMatched)
+            continue;
+
+        memset(&Item, 0, sizeof(Item));
+        Item.nChange = DIFF_ADDED;
+        Item.pNew = &m_pFiles2[y];
+
+        m_dwAdded++;
+        pReport(pParam, Item);
+
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Totals
+//---------------------------------------------------------------------------------
+
+DWORD CDiff::Sectors()
+{
+    return m_dwSectors;
+}
+
+DWORD CDiff::Differ()
+{
+    return m_dwDiffer;
+}
+
+DWORD CDiff::Added()
+{
+    return m_dwAdded;
+}
+
+DWORD CDiff::Removed()
+{
+    return m_dwRemoved;
+}
+
+DWORD CDiff::Renamed()
+{
+    return m_dwRenamed;
+}
+
+DWORD CDiff::Changed()
+{
+    return m_dwChanged;
+}
+
+DWORD CDiff::Unchanged()
+{
+    return m_dwSame;
+}
+
+DWORD CDiff::InMemory()
+{
+    return m_dwMemory;
+}
+
+//---------------------------------------------------------------------------------
+// Format the disk layout of an image (e.g. "JV3 40:1:18,DD")
+//---------------------------------------------------------------------------------
+
+void CDiff::Geometry(CImage* pImage, char szGeometry[32])
+{
+
+    VDI_GEOMETRY DG;
+
+    pImage->GetVDI()->GetDG(DG);
+
+    snprintf(szGeometry, 32, "%s %02d:%d:%02d,%s", pImage->VDIName(), (DG.LT.nTrack-DG.FT.nTrack+1), (DG.LT.nLastSide-DG.LT.nFirstSide+1), (DG.LT.nLastSector-DG.LT.nFirstSector+1),
+        (DG.FT.nDensity!=DG.LT.nDensity?"MD":(DG.LT.nDensity==VDI_DENSITY_SINGLE?"SD":"DD")));
+
+}
+
+//---------------------------------------------------------------------------------
+// Format the file properties other than the name and size (as in a store manifest)
+//---------------------------------------------------------------------------------
+
+void CDiff::Attr(const OSI_FILE& File, char szAttr[32])
+{
+    snprintf(szAttr, 32, "%04d-%02d-%02d %c%c%c %d %d", File.Date.wYear, File.Date.nMonth, File.Date.nDay,
+        (File.bSystem ? 'S' : '-'), (File.bInvisible ? 'I' : '-'), (File.bModified ? 'M' : '-'), File.nAccess, File.nLRL);
+}
+
+//---------------------------------------------------------------------------------
+// List the files of an image matching the filespec, in name order
+//---------------------------------------------------------------------------------
+
+DWORD CDiff::List(CImage* pImage, const char* pMask, DWORD dwFlags, DIFF_FILE*& pFiles, size_t& nFiles)
+{
+
+    OSI_FILE    File;
+    char        cMask[11];
+    void*       pFile = NULL;
+    DIFF_FILE*  pMore;
+    DWORD       dwError;
+
+    // Convert Windows filespec to TRS standard
+    Win2TRS((pMask != NULL ? pMask : "*.*"), cMask);
+
+    while ((dwError = pImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == NO_ERROR)
+    {
+
+        // Compare file attributes against user options
+        if ((File.bSystem && !(dwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(dwFlags & V80_FLAG_INVISIBLE)))
+            continue;
+
+        // Compare the filename against the filespec
+        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
+            continue;
+
+        if (nFiles % 64 == 0)
+        {
+            if ((pMore = (DIFF_FILE*)realloc(pFiles, (nFiles + 64) * sizeof(DIFF_FILE))) == NULL)
+                return ERROR_OUTOFMEMORY;
+            pFiles = pMore;
+        }
+
+        memset(&pFiles[nFiles], 0, sizeof(DIFF_FILE));
+        pFiles[nFiles].pFile = pFile;
+        pFiles[nFiles].File = File;
+        FmtName(File.szName, File.szType, pImage->Divider(), pFiles[nFiles].szFile);
+
+        nFiles++;
+
+    }
+
+    qsort(pFiles, nFiles, sizeof(DIFF_FILE), Compare);
+
+    // If exited on "No More Files" then "No Error"
+    return (dwError == ERROR_NO_MORE_FILES ? NO_ERROR : dwError);
+
+}
+
+//---------------------------------------------------------------------------------
+// Hash the contents of a file (once)
+//---------------------------------------------------------------------------------
+
+DWORD CDiff::Hash(CImage* pImage, DIFF_FILE* pFile)
+{
+
+    BYTE    Buffer[V80_CHUNK];
+    CHash   XXH;
+    DWORD   dwPos;
+    DWORD   dwBytes;
+    DWORD   dwError;
+
+    if (pFile->bHashed)
+        return NO_ERROR;
+
+    for (dwPos = 0; dwPos < pFile->File.dwSize; dwPos += dwBytes)
+    {
+        dwBytes = (pFile->File.dwSize - dwPos < V80_CHUNK ? pFile->File.dwSize - dwPos : V80_CHUNK);
+        if ((dwError = pImage->Read(pFile->pFile, dwPos, Buffer, dwBytes)) != NO_ERROR)
+            return dwError;
+        if (dwBytes == 0)
+            return ERROR_READ_FAULT;
+        XXH.Update(Buffer, dwBytes);
+    }
+
+    pFile->qwHash = XXH.Digest();
+    pFile->bHashed = true;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Compare the contents of two files (in the snapped sectors, when both disks are in memory)
+//---------------------------------------------------------------------------------
+
+DWORD CDiff::Data(CImage* pImage1, DIFF_FILE* pFile1, CImage* pImage2, DIFF_FILE* pFile2, DWORD& dwFirst, DWORD& dwBytes, bool& bMemory)
+{
+
+    BYTE        Buffer1[V80_CHUNK];
+    BYTE        Buffer2[V80_CHUNK];
+    const BYTE* pData1;
+    const BYTE* pData2;
+    DWORD       dwSize1 = pFile1->File.dwSize;
+    DWORD       dwSize2 = pFile2->File.dwSize;
+    DWORD       dwLength = (dwSize1 < dwSize2 ? dwSize1 : dwSize2);
+    DWORD       dwPos = 0;
+    DWORD       dwChunk;
+    DWORD       dwBytes1;
+    DWORD       dwBytes2;
+    WORD        wSize1;
+    WORD        wSize2;
+    BYTE        nTrack1, nSide1, nSector1;
+    BYTE        nTrack2, nSide2, nSector2;
+    DWORD       dwError = NO_ERROR;
+
+    dwFirst = 0;
+    dwBytes = 0;
+    bMemory = false;
+
+    // Both disks in memory: compare the sectors holding the files, one piece at a time
+    if (m_bSnap)
+    {
+
+        for (; dwPos < dwLength; dwPos += dwChunk)
+        {
+
+            if (pImage1->GetOSI()->Where(pFile1->pFile, dwPos, nTrack1, nSide1, nSector1) != NO_ERROR ||
+                pImage2->GetOSI()->Where(pFile2->pFile, dwPos, nTrack2, nSide2, nSector2) != NO_ERROR ||
+                (pData1 = CArchive::Sector(m_Disk1, nTrack1, nSide1, nSector1)) == NULL ||
+                (pData2 = CArchive::Sector(m_Disk2, nTrack2, nSide2, nSector2)) == NULL)
+                break;
+
+            wSize1 = (nTrack1 == m_Disk1.DG.FT.nTrack ? m_Disk1.DG.FT.wSectorSize : m_Disk1.DG.LT.wSectorSize);
+            wSize2 = (nTrack2 == m_Disk2.DG.FT.nTrack ? m_Disk2.DG.FT.wSectorSize : m_Disk2.DG.LT.wSectorSize);
+
+            // The piece runs up to the end of either sector (or of the shorter file)
+            dwChunk = wSize1 - dwPos % wSize1;
+
+            if (dwChunk > wSize2 - dwPos % wSize2)
+                dwChunk = wSize2 - dwPos % wSize2;
+
+            if (dwChunk > dwLength - dwPos)
+                dwChunk = dwLength - dwPos;
+
+            pData1 += dwPos % wSize1;
+            pData2 += dwPos % wSize2;
+
+            for (DWORD x = 0; x < dwChunk; x++)
+            {
+                if (pData1[x] != pData2[x] && dwBytes++ == 0)
+                    dwFirst = dwPos + x;
+            }
+
+        }
+
+        // A file on a sector the DOS can't map, or that could not be read, is read through the DOS
+        if (!(bMemory = (dwPos >= dwLength)))
+        {
+            dwPos = 0;
+            dwFirst = 0;
+            dwBytes = 0;
+        }
+
+    }
+
+    for (; !bMemory && dwPos < dwLength; dwPos += dwChunk)
+    {
+
+        dwChunk = (dwLength - dwPos < V80_CHUNK ? dwLength - dwPos : V80_CHUNK);
+        dwBytes1 = dwBytes2 = dwChunk;
+
+        if ((dwError = pImage1->Read(pFile1->pFile, dwPos, Buffer1, dwBytes1)) != NO_ERROR || (dwError = pImage2->Read(pFile2->pFile, dwPos, Buffer2, dwBytes2)) != NO_ERROR)
+            break;
+
+        if (dwBytes1 != dwChunk || dwBytes2 != dwChunk)
+        {
+            dwError = ERROR_READ_FAULT;
+            break;
+        }
+
+        for (DWORD x = 0; x < dwChunk; x++)
+        {
+            if (Buffer1[x] != Buffer2[x] && dwBytes++ == 0)
+                dwFirst = dwPos + x;
+        }
+
+    }
+
+    // The bytes past the end of the shorter file differ too
+    if (dwError == NO_ERROR && dwSize1 != dwSize2)
+    {
+        if (dwBytes == 0)
+            dwFirst = dwLength;
+        dwBytes += (dwSize1 > dwSize2 ? dwSize1 : dwSize2) - dwLength;
+    }
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Order the files of an image by name
+//---------------------------------------------------------------------------------
+
+int CDiff::Compare(const void* pFile1, const void* pFile2)
+{
+    return strcmp(((const DIFF_FILE*)pFile1)->szFile, ((const DIFF_FILE*)pFile2)->szFile);
+}
@@ -0,0 +1,116 @@
+/**
+ @file diff.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Structural diff of two disk images
+//---------------------------------------------------------------------------------
+//
+// Sectors() snaps both disks into memory when they are laid out alike and lists
+// the sectors whose hashes differ. Files() then pairs the files by name (their
+// properties and contents), finds the renamed ones by their contents and lists
+// the rest as removed or added. The contents of a file are compared in the
+// snapped sectors when the DOS maps them, and read through the DOS otherwise.
+//
+//---------------------------------------------------------------------------------
+
+class   CImage;
+
+enum    DIFF_CHANGE                                                                 // How a file differs
+{
+    DIFF_CHANGED,                                                                   // Same name, other properties or contents
+    DIFF_RENAMED,                                                                   // Other name, same contents
+    DIFF_REMOVED,                                                                   // Only on the first image
+    DIFF_ADDED                                                                      // Only on the second image
+};
+
+struct  DIFF_FILE                                                                   // One file of an image
+{
+    void*       pFile;                                                              // Directory entry
+    OSI_FILE    File;                                                               // File properties
+    char        szFile[13];                                                         // Formatted filename
+    unsigned long long qwHash;                                                      // XXH64 of the contents (to find the renamed files)
+    bool        bHashed;                                                            // qwHash is valid
+    bool        bMatched;                                                           // Paired with a file of the other image
+};
+
+struct  DIFF_ITEM                                                                   // One file that differs
+{
+    DIFF_CHANGE nChange;                                                            // How it differs
+    const DIFF_FILE* pOld;                                                          // File of the first image (NULL: added)
+    const DIFF_FILE* pNew;                                                          // File of the second image (NULL: removed)
+    char        szOld[32];                                                          // Old properties, as Attr() formats them (changed)
+    char        szNew[32];                                                          // New properties
+    bool        bAttr;                                                              // The properties differ
+    DWORD       dwFirst;                                                            // First byte that differs
+    DWORD       dwBytes;                                                            // Number of bytes that differ
+    DWORD       dwError;                                                            // The contents could not be read (changed)
+};
+
+typedef void (*DIFF_SECTOR)(void* pParam, BYTE nTrack, BYTE nSide, BYTE nSector);   // Called for each sector that differs
+typedef void (*DIFF_REPORT)(void* pParam, const DIFF_ITEM& Item);                   // Called for each file that differs
+
+class   CDiff
+{
+protected:
+    ARC_DISK    m_Disk1;                                                            // First disk in memory (Sectors)
+    ARC_DISK    m_Disk2;                                                            // Second disk in memory
+    bool        m_bSnap;                                                            // Both disks are in memory
+    DIFF_FILE*  m_pFiles1;                                                          // Files of the first image, in name order
+    DIFF_FILE*  m_pFiles2;                                                          // Files of the second image
+    size_t      m_nFiles1;                                                          // Number of files of the first image
+    size_t      m_nFiles2;                                                          // Number of files of the second image
+    DWORD       m_dwSectors;                                                        // Sectors compared
+    DWORD       m_dwDiffer;                                                         // Sectors that differ
+    DWORD       m_dwAdded;                                                          // Files added
+    DWORD       m_dwRemoved;                                                        // Files removed
+    DWORD       m_dwRenamed;                                                        // Files renamed
+    DWORD       m_dwChanged;                                                        // Files changed
+    DWORD       m_dwSame;                                                           // Files unchanged
+    DWORD       m_dwMemory;                                                         // Files unchanged, compared in the snapped sectors
+public:
+                CDiff();                                                            // Initialize member variables
+    virtual     ~CDiff();                                                           // Release allocated memory
+    DWORD       CompareSectors(CImage* pImage1, CImage* pImage2, DIFF_SECTOR pSector, void* pParam); // Compare the sectors (ERROR_NOT_SUPPORTED: different layout)
+    DWORD       CompareFiles(CImage* pImage1, CImage* pImage2, const char* pMask, DWORD dwFlags, DIFF_REPORT pReport, void* pParam); // Compare the files (pMask NULL: every file)
+    DWORD       Sectors();                                                          // Number of sectors compared
+    DWORD       Differ();                                                           // Number of sectors that differ
+    DWORD       Added();                                                            // Number of files added
+    DWORD       Removed();                                                          // Number of files removed
+    DWORD       Renamed();                                                          // Number of files renamed
+    DWORD       Changed();                                                          // Number of files changed
+    DWORD       Unchanged();                                                        // Number of files unchanged
+    DWORD       InMemory();                                                         // Number of those compared in the snapped sectors
+    static void Geometry(CImage* pImage, char szGeometry[32]);                      // Format the disk layout of an image
+    static void Attr(const OSI_FILE& File, char szAttr[32]);                        // Format the file properties other than the name and size
+protected:
+    DWORD       List(CImage* pImage, const char* pMask, DWORD dwFlags, DIFF_FILE*& pFiles, size_t& nFiles); // List the files matching the mask, in name order
+    DWORD       Hash(CImage* pImage, DIFF_FILE* pFile);                             // Hash the contents of a file (once)
+    DWORD       Data(CImage* pImage1, DIFF_FILE* pFile1, CImage* pImage2, DIFF_FILE* pFile2, DWORD& dwFirst, DWORD& dwBytes, bool& bMemory); // Compare the contents of two files
+    static int  Compare(const void* pFile1, const void* pFile2);                    // Order the files by name
+};
@@ -34,6 +34,7 @@
 #include "windows.h"
 #include <math.h>
 #include "v80.h"
+#include "stats.h"
 #include "vdi.h"
 #include "dmk.h"
 
@@ -76,6 +77,7 @@ DWORD CDMK::Load(HANDLE hFile, DWORD dwFlags)
         SaveTrack();
 
     // Position file pointer at the disk header
+    STAT_COUNT(STAT_SEEK);
     if (fseek(hFile, 0, 0) == -1)
     {
         dwError = ERROR_SEEK;
@@ -132,8 +134,10 @@ DWORD CDMK::Load(HANDLE hFile, DWORD dwFlags)
     m_nCacheTrack = 0xFF;
     m_nCacheSide = 0xFF;
 
-    // Detect disk geometry
-    if ((dwError = FindGeometry()) != NO_ERROR)
+    // Detect disk geometry (unless it was preset from the probe cache)
+    if (m_bKnownDG)
+        m_nSides = (m_Header.nFlags & DMK_FLAG_SINGLE_SIDED ? 1 : 2);
+    else if ((dwError = FindGeometry()) != NO_ERROR)
         goto Done;
 
     Done:
@@ -188,6 +192,9 @@ DWORD CDMK::Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSiz
     if ((dwError = GetSectorData(Sector, pBuffer, wSize)) != NO_ERROR)
         goto Done;
 
+    STAT_COUNT(STAT_VDI_READ);
+    STAT_ADD(STAT_BYTES_READ, Sector.wSize);
+
     Done:
     return dwError;
 
@@ -243,6 +250,9 @@ DWORD CDMK::Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSi
     // Set the write-pending flag
     m_bCacheWrite = true;
 
+    STAT_COUNT(STAT_VDI_WRITE);
+    STAT_ADD(STAT_BYTES_WRITTEN, Sector.wSize);
+
     Done:
     return dwError;
 
@@ -296,6 +306,7 @@ DWORD CDMK::FindGeometry()
             continue;
 
         // Set file pointer to the calculated track offset
+        STAT_COUNT(STAT_SEEK);
         if (fseek(m_hFile, dwTrack[t], 0) == -1)
         {
             dwError = ERROR_SEEK;
@@ -417,6 +428,7 @@ DWORD CDMK::LoadTrack(BYTE nTrack, BYTE nSide)
         dwBytes = ((nTrack - m_DG.FT.nTrack) * m_nSides + (nSide - pTrack->nFirstSide)) * m_Header.wTrackLength + sizeof(DMK_HEADER);
 
         // Set file pointer
+        STAT_COUNT(STAT_SEEK);
         if (fseek(m_hFile, dwBytes, 0) == -1)
         {
             dwError = ERROR_SEEK;
@@ -438,6 +450,8 @@ DWORD CDMK::LoadTrack(BYTE nTrack, BYTE nSide)
         m_nCacheTrack = nTrack;
         m_nCacheSide = nSide;
 
+        STAT_COUNT(STAT_TRACK_LOAD);
+
     }
 
     Done:
@@ -445,6 +459,22 @@ DWORD CDMK::LoadTrack(BYTE nTrack, BYTE nSide)
 
 }
 
+//---------------------------------------------------------------------------------
+// Save the cached track and commit it to the disk file
+//---------------------------------------------------------------------------------
+
+DWORD CDMK::Flush()
+{
+
+    DWORD   dwError;
+
+    if ((dwError = SaveTrack()) == NO_ERROR)
+        dwError = CVDI::Flush();
+
+    return dwError;
+
+}
+
 //---------------------------------------------------------------------------------
 // Write one entire track to the disk
 //---------------------------------------------------------------------------------
@@ -463,6 +493,7 @@ DWORD CDMK::SaveTrack()
         dwBytes = (m_nCacheTrack * m_nSides + m_nCacheSide) * m_Header.wTrackLength + sizeof(DMK_HEADER);
 
         // Set file pointer
+        STAT_COUNT(STAT_SEEK);
         if (fseek(m_hFile, dwBytes, 0) == -1)
         {
             dwError = ERROR_SEEK;
@@ -479,6 +510,8 @@ DWORD CDMK::SaveTrack()
         // Reset the write-pending flag
         m_bCacheWrite = false;
 
+        STAT_COUNT(STAT_TRACK_SAVE);
+
     }
 
     Done:
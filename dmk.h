@@ -95,6 +95,7 @@ public:
     DWORD       Load(HANDLE hFile, DWORD dwFlags);                                          // Validate disk format and detect disk geometry
     DWORD       Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);     // Read one sector from the disk
     DWORD       Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);    // Write one sector to the disk
+    DWORD       Flush();                                                                    // Save the cached track and commit it to the disk file
 protected:
     DWORD       FindGeometry();                                                             // Detect the disk geometry
     DWORD       LoadTrack(BYTE nTrack, BYTE nSide);                                         // Read one entire track from the disk
@@ -0,0 +1,392 @@
+/**
+ @file dump.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Table-driven formatter for the sector and file dumps
+//---------------------------------------------------------------------------------
+
+#include <stdarg.h>
+
+#include "windows.h"
+#include "v80.h"
+#include "dump.h"
+
+//---------------------------------------------------------------------------------
+// Lookup tables, filled once at startup
+//---------------------------------------------------------------------------------
+
+static struct DUMP_TABLES
+{
+    char    cUpper[256][3];                                                         // "XX " for the VDK-80 listing
+    char    cLower[256][2];                                                         // "xx" for xxd and JSON
+    char    cListing[256];                                                          // ASCII column of the VDK-80 listing (controls as '.')
+    char    cPrintable[256];                                                        // ASCII column of xxd (non-printables as '.')
+
+    DUMP_TABLES()
+    {
+        static const char cDigits[] = "0123456789ABCDEF0123456789abcdef";
+
+        for (int x = 0; x < 256; x++)
+        {
+            cUpper[x][0] = cDigits[x >> 4];
+            cUpper[x][1] = cDigits[x & 15];
+            cUpper[x][2] = ' ';
+            cLower[x][0] = cDigits[16 + (x >> 4)];
+            cLower[x][1] = cDigits[16 + (x & 15)];
+            cListing[x] = (x < ' ' ? '.' : x);
+            cPrintable[x] = (x >= ' ' && x <= '~' ? x : '.');
+        }
+    }
+} gTables;
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CDump::CDump()
+:   m_hOut(NULL), m_nFormat(DUMP_HEX), m_pBuffer(NULL), m_dwUsed(0), m_dwOffset(0), m_dwError(NO_ERROR)
+{
+}
+
+//---------------------------------------------------------------------------------
+// Release the output buffer
+//---------------------------------------------------------------------------------
+
+CDump::~CDump()
+{
+    if (m_pBuffer != NULL)
+        free(m_pBuffer);
+}
+
+//---------------------------------------------------------------------------------
+// Start rendering to a host file
+//---------------------------------------------------------------------------------
+
+DWORD CDump::Begin(FILE* hOut, DUMP_FORMAT nFormat)
+{
+
+    DWORD   dwError = NO_ERROR;
+
+    if (m_pBuffer == NULL && (m_pBuffer = (char*)malloc(DUMP_BUFFER)) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    m_hOut = hOut;
+    m_nFormat = nFormat;
+    m_dwUsed = 0;
+    m_dwOffset = 0;
+    m_dwError = NO_ERROR;
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write the remaining output and return the first error
+//---------------------------------------------------------------------------------
+
+DWORD CDump::End()
+{
+
+    if (m_hOut == NULL)
+        return m_dwError;
+
+    Flush();
+
+    if (m_dwError == NO_ERROR && fflush(m_hOut) != 0)
+        m_dwError = ERROR_WRITE_FAULT;
+
+    return m_dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Print a caption (only the VDK-80 listing carries them, the other formats are data only)
+//---------------------------------------------------------------------------------
+
+void CDump::Text(const char* pFormat, ...)
+{
+
+    va_list Args;
+    int     nLength;
+
+    if (m_nFormat != DUMP_HEX)
+        return;
+
+    va_start(Args, pFormat);
+    nLength = vsnprintf(NULL, 0, pFormat, Args);
+    va_end(Args);
+
+    va_start(Args, pFormat);
+    vsnprintf(Reserve(nLength + 1), nLength + 1, pFormat, Args);
+    va_end(Args);
+
+    m_dwUsed += nLength;
+
+}
+
+//---------------------------------------------------------------------------------
+// Render one disk sector
+//---------------------------------------------------------------------------------
+
+void CDump::Sector(BYTE nTrack, BYTE nSide, BYTE nSector, const BYTE* pData, WORD wSize)
+{
+
+    switch (m_nFormat)
+    {
+
+        case DUMP_HEX:
+            Text("\r\n[%02d:%d:%02d]\r\n", nTrack, nSide, nSector);
+            Hex(pData, wSize);
+            break;
+
+        // Sectors are laid out back to back, as in a JV1 image
+        case DUMP_XXD:
+            XXD(m_dwOffset, pData, wSize);
+            break;
+
+        case DUMP_RAW:
+            Raw(pData, wSize);
+            break;
+
+        case DUMP_JSON:
+            m_dwUsed += sprintf(Reserve(64), "{\"track\":%d,\"side\":%d,\"sector\":%d,", nTrack, nSide, nSector);
+            JSON(pData, wSize);
+            break;
+
+    }
+
+    m_dwOffset += wSize;
+
+}
+
+//---------------------------------------------------------------------------------
+// Render one chunk of a file
+//---------------------------------------------------------------------------------
+
+void CDump::Block(const char* pName, DWORD dwPos, const BYTE* pData, DWORD dwSize)
+{
+
+    char*   pTarget;
+    DWORD   dwLength;
+
+    switch (m_nFormat)
+    {
+
+        case DUMP_HEX:
+            Hex(pData, dwSize);
+            break;
+
+        case DUMP_XXD:
+            XXD(dwPos, pData, dwSize);
+            break;
+
+        case DUMP_RAW:
+            Raw(pData, dwSize);
+            break;
+
+        // One object per V80_CHUNK, TRS-80 filenames only need their quotes and backslashes escaped
+        case DUMP_JSON:
+            for (DWORD dwDone = 0; dwDone < dwSize; dwDone += dwLength)
+            {
+                dwLength = (dwSize - dwDone < V80_CHUNK ? dwSize - dwDone : V80_CHUNK);
+                pTarget = Reserve(64 + 2 * strlen(pName));
+                pTarget += sprintf(pTarget, "{\"file\":\"");
+                for (const char* pChar = pName; *pChar != 0; pChar++)
+                {
+                    if (*pChar == '"' || *pChar == '\\')
+                        *pTarget++ = '\\';
+                    *pTarget++ = (*pChar < ' ' ? '?' : *pChar);
+                }
+                pTarget += sprintf(pTarget, "\",\"offset\":%u,", dwPos + dwDone);
+                m_dwUsed = pTarget - m_pBuffer;
+                JSON(&pData[dwDone], dwLength);
+            }
+            break;
+
+    }
+
+}
+
+//---------------------------------------------------------------------------------
+// Make room for dwSize bytes of output, writing the buffer out when needed
+//---------------------------------------------------------------------------------
+
+char* CDump::Reserve(DWORD dwSize)
+{
+
+    if (m_dwUsed + dwSize > DUMP_BUFFER)
+        Flush();
+
+    return &m_pBuffer[m_dwUsed];
+
+}
+
+//---------------------------------------------------------------------------------
+// Write the buffer to the host file
+//---------------------------------------------------------------------------------
+
+void CDump::Flush()
+{
+
+    if (m_dwUsed != 0 && fwrite(m_pBuffer, 1, m_dwUsed, m_hOut) != m_dwUsed && m_dwError == NO_ERROR)
+        m_dwError = ERROR_WRITE_FAULT;
+
+    m_dwUsed = 0;
+
+}
+
+//---------------------------------------------------------------------------------
+// Render VDK-80 listing lines: 16 "XX " pairs, 16 ASCII characters and CR/LF
+//---------------------------------------------------------------------------------
+
+void CDump::Hex(const BYTE* pData, DWORD dwSize)
+{
+
+    char*   pLine;
+    DWORD   dwLeft;
+    int     nBytes;
+    int     x;
+
+    for (DWORD dwDone = 0; dwDone < dwSize; dwDone += nBytes)
+    {
+
+        dwLeft = dwSize - dwDone;
+        nBytes = (dwLeft < 16 ? dwLeft : 16);
+        pLine = Reserve(48 + 16 + 2);
+
+        for (x = 0; x < nBytes; x++)
+            memcpy(&pLine[x * 3], gTables.cUpper[pData[dwDone + x]], 3);
+
+        // A short first line carries no ASCII column, a short last line is padded with spaces
+        if (nBytes < 16 && dwDone == 0)
+            pLine += nBytes * 3;
+        else
+        {
+            memset(&pLine[nBytes * 3], ' ', (16 - nBytes) * 3);
+            for (x = 0; x < nBytes; x++)
+                pLine[48 + x] = gTables.cListing[pData[dwDone + x]];
+            memset(&pLine[48 + nBytes], ' ', 16 - nBytes);
+            pLine += 48 + 16;
+        }
+
+        *pLine++ = '\r';
+        *pLine++ = '\n';
+        m_dwUsed = pLine - m_pBuffer;
+
+    }
+
+}
+
+//---------------------------------------------------------------------------------
+// Render xxd lines: offset, 8 groups of 2 bytes, ASCII column and LF
+//---------------------------------------------------------------------------------
+
+void CDump::XXD(DWORD dwPos, const BYTE* pData, DWORD dwSize)
+{
+
+    char*   pLine;
+    DWORD   dwLeft;
+    int     nBytes;
+    int     x;
+
+    for (DWORD dwDone = 0; dwDone < dwSize; dwDone += nBytes)
+    {
+
+        dwLeft = dwSize - dwDone;
+        nBytes = (dwLeft < 16 ? dwLeft : 16);
+        pLine = Reserve(10 + 40 + 1 + 16 + 1);
+
+        pLine += sprintf(pLine, "%08x: ", dwPos + dwDone);
+
+        for (x = 0; x < 16; x++)
+        {
+            if (x < nBytes)
+                memcpy(pLine, gTables.cLower[pData[dwDone + x]], 2);
+            else
+                memset(pLine, ' ', 2);
+            pLine += 2;
+            if (x & 1)
+                *pLine++ = ' ';
+        }
+
+        *pLine++ = ' ';
+
+        for (x = 0; x < nBytes; x++)
+            *pLine++ = gTables.cPrintable[pData[dwDone + x]];
+
+        *pLine++ = '\n';
+        m_dwUsed = pLine - m_pBuffer;
+
+    }
+
+}
+
+//---------------------------------------------------------------------------------
+// Copy the bytes unchanged (large blocks bypass the buffer)
+//---------------------------------------------------------------------------------
+
+void CDump::Raw(const BYTE* pData, DWORD dwSize)
+{
+
+    if (dwSize > DUMP_BUFFER)
+    {
+        Flush();
+        if (fwrite(pData, 1, dwSize, m_hOut) != dwSize && m_dwError == NO_ERROR)
+            m_dwError = ERROR_WRITE_FAULT;
+        return;
+    }
+
+    memcpy(Reserve(dwSize), pData, dwSize);
+    m_dwUsed += dwSize;
+
+}
+
+//---------------------------------------------------------------------------------
+// Render the "size" and "data" members that close a JSON object
+//---------------------------------------------------------------------------------
+
+void CDump::JSON(const BYTE* pData, DWORD dwSize)
+{
+
+    char*   pTarget;
+
+    pTarget = Reserve(32 + dwSize * 2);
+    pTarget += sprintf(pTarget, "\"size\":%u,\"data\":\"", dwSize);
+
+    for (DWORD x = 0; x < dwSize; x++, pTarget += 2)
+        memcpy(pTarget, gTables.cLower[pData[x]], 2);
+
+    pTarget += sprintf(pTarget, "\"}\n");
+    m_dwUsed = pTarget - m_pBuffer;
+
+}
@@ -0,0 +1,69 @@
+/**
+ @file dump.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Table-driven formatter for the sector and file dumps
+//---------------------------------------------------------------------------------
+
+#define DUMP_BUFFER         (16*V80_CHUNK)                                          // Output buffer, written to the host at once
+#define DUMP_SECTOR         1024                                                    // Largest sector size (one slot of a track buffer)
+
+enum    DUMP_FORMAT                                                                 // Dump output format enumerator
+{
+    DUMP_HEX = 0,                                                                   // Hex and ASCII lines (VDK-80 listing)
+    DUMP_XXD = 1,                                                                   // xxd-compatible lines
+    DUMP_RAW = 2,                                                                   // Raw sector or file bytes
+    DUMP_JSON = 3                                                                   // One JSON object per sector or file chunk
+};
+
+class   CDump
+{
+protected:
+    FILE*           m_hOut;                                                         // Host file handle
+    DUMP_FORMAT     m_nFormat;                                                      // Output format
+    char*           m_pBuffer;                                                      // DUMP_BUFFER bytes of rendered output
+    DWORD           m_dwUsed;                                                       // Number of bytes held by the buffer
+    DWORD           m_dwOffset;                                                     // Running offset of the sector dump (xxd)
+    DWORD           m_dwError;                                                      // First error raised by the host writes
+public:
+    CDump();
+    ~CDump();
+    DWORD   Begin(FILE* hOut, DUMP_FORMAT nFormat);                                 // Start rendering to a host file
+    DWORD   End();                                                                  // Write the remaining output and return the first error
+    void    Text(const char* pFormat, ...);                                         // Print a caption (VDK-80 listing only)
+    void    Sector(BYTE nTrack, BYTE nSide, BYTE nSector, const BYTE* pData, WORD wSize); // Render one disk sector
+    void    Block(const char* pName, DWORD dwPos, const BYTE* pData, DWORD dwSize); // Render one chunk of a file
+protected:
+    char*   Reserve(DWORD dwSize);                                                  // Make room for dwSize bytes of output
+    void    Flush();                                                                // Write the buffer to the host file
+    void    Hex(const BYTE* pData, DWORD dwSize);                                   // Render VDK-80 listing lines
+    void    XXD(DWORD dwPos, const BYTE* pData, DWORD dwSize);                      // Render xxd lines
+    void    Raw(const BYTE* pData, DWORD dwSize);                                   // Copy the bytes unchanged
+    void    JSON(const BYTE* pData, DWORD dwSize);                                  // Render the "size" and "data" members of a JSON object
+};
@@ -0,0 +1,244 @@
+/**
+ @file fprint.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Boot sector fingerprint table (picks the DOS interface without probing)
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdlib.h>
+#include <strings.h>
+#include <pthread.h>
+#include "v80.h"
+#include "vdi.h"
+#include "cache.h"
+#include "fprint.h"
+
+#define FPRINT_GROW         64                                                      // Entries added to the table at a time
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CFPrint::CFPrint()
+:   m_pPath(NULL), m_pEntries(NULL), m_dwEntries(0), m_dwAlloc(0)
+{
+    pthread_mutex_init(&m_Mutex, NULL);
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CFPrint::~CFPrint()
+{
+    free(m_pPath);
+    free(m_pEntries);
+    pthread_mutex_destroy(&m_Mutex);
+}
+
+//---------------------------------------------------------------------------------
+// Read the table (a missing file is an empty table, created by the first Add)
+//---------------------------------------------------------------------------------
+
+DWORD CFPrint::Load(const char* pPath)
+{
+
+    FILE*               hFile;
+    char                szLine[256];
+    char                szOSI[8];
+    unsigned long long  qwPrint;
+    DWORD               dwError = NO_ERROR;
+
+    free(m_pPath);
+
+    if ((m_pPath = strdup(pPath)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    if ((hFile = fopen(pPath, "r")) == NULL)
+        return NO_ERROR;
+
+    while (dwError == NO_ERROR && fgets(szLine, sizeof(szLine), hFile) != NULL)
+    {
+
+        // Skip blank lines, comments and anything not naming a known DOS interface
+        if (sscanf(szLine, "%llx %7s", &qwPrint, szOSI) != 2 || strlen(szOSI) > 3)
+            continue;
+
+        dwError = Insert(qwPrint, szOSI);
+
+    }
+
+    fclose(hFile);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Look up the DOS of a fingerprint (false: unknown or ambiguous)
+//---------------------------------------------------------------------------------
+
+bool CFPrint::Find(unsigned long long qwPrint, char cOSI[4])
+{
+
+    FPRINT_ENTRY*   pEntry;
+    bool            bFound = false;
+
+    pthread_mutex_lock(&m_Mutex);
+
+    if ((pEntry = Entry(qwPrint)) != NULL && pEntry->cOSI[0] != 0)
+    {
+        memcpy(cOSI, pEntry->cOSI, sizeof(pEntry->cOSI));
+        bFound = true;
+    }
+
+    pthread_mutex_unlock(&m_Mutex);
+
+    return bFound;
+
+}
+
+//---------------------------------------------------------------------------------
+// Learn the DOS of a fingerprint and append it to the table file
+//---------------------------------------------------------------------------------
+
+DWORD CFPrint::Add(unsigned long long qwPrint, const char* pOSI)
+{
+
+    FPRINT_ENTRY*   pEntry;
+    FILE*           hFile;
+    DWORD           dwError = NO_ERROR;
+
+    pthread_mutex_lock(&m_Mutex);
+
+    // Nothing new to learn
+    if ((pEntry = Entry(qwPrint)) != NULL && (pEntry->cOSI[0] == 0 || strcasecmp(pEntry->cOSI, pOSI) == 0))
+        goto Done;
+
+    if ((dwError = Insert(qwPrint, pOSI)) != NO_ERROR)
+        goto Done;
+
+    if (m_pPath == NULL || (hFile = fopen(m_pPath, "a")) == NULL)
+    {
+        dwError = ERROR_FILE_NOT_FOUND;
+        goto Done;
+    }
+
+    fprintf(hFile, "%016llx %s\n", qwPrint, pOSI);
+
+    if (fclose(hFile) != 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    Done:
+    pthread_mutex_unlock(&m_Mutex);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Fingerprint the boot sector of a disk, along with the layout of its first track
+//---------------------------------------------------------------------------------
+
+DWORD CFPrint::Take(CVDI* pVDI, unsigned long long& qwPrint)
+{
+
+    VDI_GEOMETRY    DG;
+    BYTE            Buffer[1024];
+    BYTE            Layout[5];
+    DWORD           dwError;
+
+    pVDI->GetDG(DG);
+
+    if (DG.FT.wSectorSize > sizeof(Buffer))
+        return ERROR_NOT_SUPPORTED;
+
+    if ((dwError = pVDI->Read(DG.FT.nTrack, DG.FT.nFirstSide, DG.FT.nFirstSector, Buffer, DG.FT.wSectorSize)) != NO_ERROR)
+        return dwError;
+
+    // The same boot sector on another track layout may belong to another DOS (e.g. CP/M)
+    Layout[0] = DG.FT.nFirstSector;
+    Layout[1] = DG.FT.nLastSector;
+    Layout[2] = DG.FT.wSectorSize >> 8;
+    Layout[3] = DG.FT.wSectorSize & 0xFF;
+    Layout[4] = DG.FT.nDensity;
+
+    qwPrint = Hash(Buffer, DG.FT.wSectorSize, Hash(Layout, sizeof(Layout)));
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Find an entry (NULL: none)
+//---------------------------------------------------------------------------------
+
+FPRINT_ENTRY* CFPrint::Entry(unsigned long long qwPrint)
+{
+
+    for (DWORD x = 0; x < m_dwEntries; x++)
+        if (m_pEntries[x].qwPrint == qwPrint)
+            return &m_pEntries[x];
+
+    return NULL;
+
+}
+
+//---------------------------------------------------------------------------------
+// Insert or update an entry in memory (a second DOS makes it ambiguous)
+//---------------------------------------------------------------------------------
+
+DWORD CFPrint::Insert(unsigned long long qwPrint, const char* pOSI)
+{
+
+    FPRINT_ENTRY*   pEntry;
+
+    if ((pEntry = Entry(qwPrint)) != NULL)
+    {
+        if (strcasecmp(pEntry->cOSI, pOSI) != 0)
+            pEntry->cOSI[0] = 0;
+        return NO_ERROR;
+    }
+
+    if (m_dwEntries == m_dwAlloc)
+    {
+        if ((pEntry = (FPRINT_ENTRY*)realloc(m_pEntries, (m_dwAlloc + FPRINT_GROW) * sizeof(FPRINT_ENTRY))) == NULL)
+            return ERROR_OUTOFMEMORY;
+        m_pEntries = pEntry;
+        m_dwAlloc += FPRINT_GROW;
+    }
+
+    pEntry = &m_pEntries[m_dwEntries++];
+    pEntry->qwPrint = qwPrint;
+    memset(pEntry->cOSI, 0, sizeof(pEntry->cOSI));
+    strncpy(pEntry->cOSI, pOSI, sizeof(pEntry->cOSI) - 1);
+
+    return NO_ERROR;
+
+}
@@ -0,0 +1,68 @@
+/**
+ @file fprint.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Boot sector fingerprint table (picks the DOS interface without probing)
+//---------------------------------------------------------------------------------
+//
+// The table is a text file with one "<fingerprint> <DOS>" line per known boot
+// sector, e.g. "3f1c0a7d52e98b41 TD4". Anything after the DOS name is a comment.
+// Lines can be added by hand; v80 appends the DOS found by a full probe on every
+// fingerprint it did not know. A fingerprint seen with two different DOSes is not
+// used.
+//
+//---------------------------------------------------------------------------------
+
+#define FPRINT_FILE         ".v80fp"                                                // Default table, in the user's home directory
+
+struct  FPRINT_ENTRY                                                                // Fingerprint table entry
+{
+    unsigned long long qwPrint;                                                     // Boot sector fingerprint
+    char        cOSI[4];                                                            // DOS interface name ("": ambiguous)
+};
+
+class   CFPrint
+{
+protected:
+    char*           m_pPath;                                                        // Table file (learned entries are appended to it)
+    FPRINT_ENTRY*   m_pEntries;                                                     // Loaded entries
+    DWORD           m_dwEntries;                                                    // Number of loaded entries
+    DWORD           m_dwAlloc;                                                      // Number of allocated entries
+    pthread_mutex_t m_Mutex;                                                        // Serializes lookups and additions (batch workers)
+public:
+                    CFPrint();                                                      // Initialize member variables
+                    ~CFPrint();                                                     // Release allocated memory
+    DWORD           Load(const char* pPath);                                        // Read the table (a missing file is an empty table)
+    bool            Find(unsigned long long qwPrint, char cOSI[4]);                 // Look up the DOS of a fingerprint
+    DWORD           Add(unsigned long long qwPrint, const char* pOSI);              // Learn the DOS of a fingerprint
+    static DWORD    Take(CVDI* pVDI, unsigned long long& qwPrint);                  // Fingerprint the boot sector of a disk
+protected:
+    FPRINT_ENTRY*   Entry(unsigned long long qwPrint);                              // Find an entry (NULL: none)
+    DWORD           Insert(unsigned long long qwPrint, const char* pOSI);           // Insert or update an entry in memory
+};
@@ -0,0 +1,296 @@
+/**
+ @file hash.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Streaming 64-bit content hash (XXH64)
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <string.h>
+#include "hash.h"
+
+#define ROTL(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+//---------------------------------------------------------------------------------
+// Read a little-endian 64-bit / 32-bit word from an unaligned address
+//---------------------------------------------------------------------------------
+
+static inline unsigned long long Read64(const BYTE* pData)
+{
+    unsigned long long qwValue;
+    memcpy(&qwValue, pData, sizeof(qwValue));
+    return qwValue;
+}
+
+static inline unsigned long long Read32(const BYTE* pData)
+{
+    DWORD dwValue;
+    memcpy(&dwValue, pData, sizeof(dwValue));
+    return dwValue;
+}
+
+//---------------------------------------------------------------------------------
+// One lane step, and the merge of a lane into the final hash
+//---------------------------------------------------------------------------------
+
+static inline unsigned long long Lane(unsigned long long qwAcc, unsigned long long qwInput)
+{
+    qwAcc += qwInput * HASH_PRIME2;
+    qwAcc = ROTL(qwAcc, 31);
+    return qwAcc * HASH_PRIME1;
+}
+
+static inline unsigned long long Merge(unsigned long long qwHash, unsigned long long qwLane)
+{
+    qwHash ^= Lane(0, qwLane);
+    return qwHash * HASH_PRIME1 + HASH_PRIME4;
+}
+
+//---------------------------------------------------------------------------------
+// Final avalanche (every input bit affects every output bit)
+//---------------------------------------------------------------------------------
+
+static inline unsigned long long Avalanche(unsigned long long qwHash)
+{
+    qwHash ^= qwHash >> 33;
+    qwHash *= HASH_PRIME2;
+    qwHash ^= qwHash >> 29;
+    qwHash *= HASH_PRIME3;
+    qwHash ^= qwHash >> 32;
+    return qwHash;
+}
+
+//---------------------------------------------------------------------------------
+// Start a new hash
+//---------------------------------------------------------------------------------
+
+CHash::CHash(unsigned long long qwSeed)
+{
+    Reset(qwSeed);
+}
+
+//---------------------------------------------------------------------------------
+// Start over
+//---------------------------------------------------------------------------------
+
+void CHash::Reset(unsigned long long qwSeed)
+{
+
+    m_qwLane[0] = qwSeed + HASH_PRIME1 + HASH_PRIME2;
+    m_qwLane[1] = qwSeed + HASH_PRIME2;
+    m_qwLane[2] = qwSeed;
+    m_qwLane[3] = qwSeed - HASH_PRIME1;
+
+    m_qwTotal = 0;
+    m_qwSeed = qwSeed;
+    m_nStripe = 0;
+
+}
+
+//---------------------------------------------------------------------------------
+// Mix one stripe into the lanes
+//---------------------------------------------------------------------------------
+
+void CHash::Round(const BYTE* pStripe)
+{
+    m_qwLane[0] = Lane(m_qwLane[0], Read64(pStripe));
+    m_qwLane[1] = Lane(m_qwLane[1], Read64(pStripe + 8));
+    m_qwLane[2] = Lane(m_qwLane[2], Read64(pStripe + 16));
+    m_qwLane[3] = Lane(m_qwLane[3], Read64(pStripe + 24));
+}
+
+//---------------------------------------------------------------------------------
+// Add a block of bytes
+//---------------------------------------------------------------------------------
+
+void CHash::Update(const BYTE* pData, size_t nBytes)
+{
+
+    size_t  nCopy;
+
+    m_qwTotal += nBytes;
+
+    // Complete a stripe left over from the previous block
+    if (m_nStripe > 0)
+    {
+
+        nCopy = (nBytes < HASH_STRIPE - m_nStripe ? nBytes : HASH_STRIPE - m_nStripe);
+        memcpy(&m_Stripe[m_nStripe], pData, nCopy);
+
+        m_nStripe += nCopy;
+        pData += nCopy;
+        nBytes -= nCopy;
+
+        if (m_nStripe < HASH_STRIPE)
+            return;
+
+        Round(m_Stripe);
+        m_nStripe = 0;
+
+    }
+
+    // Whole stripes straight from the caller's buffer
+    for (; nBytes >= HASH_STRIPE; pData += HASH_STRIPE, nBytes -= HASH_STRIPE)
+        Round(pData);
+
+    // Keep the rest for the next block
+    memcpy(m_Stripe, pData, nBytes);
+    m_nStripe = nBytes;
+
+}
+
+//---------------------------------------------------------------------------------
+// Hash of the bytes added so far
+//---------------------------------------------------------------------------------
+
+unsigned long long CHash::Digest()
+{
+
+    unsigned long long  qwHash;
+    const BYTE*         pData = m_Stripe;
+    DWORD               nBytes = m_nStripe;
+
+    // Fold the lanes (short streams never used them)
+    if (m_qwTotal >= HASH_STRIPE)
+    {
+        qwHash = ROTL(m_qwLane[0], 1) + ROTL(m_qwLane[1], 7) + ROTL(m_qwLane[2], 12) + ROTL(m_qwLane[3], 18);
+        qwHash = Merge(qwHash, m_qwLane[0]);
+        qwHash = Merge(qwHash, m_qwLane[1]);
+        qwHash = Merge(qwHash, m_qwLane[2]);
+        qwHash = Merge(qwHash, m_qwLane[3]);
+    }
+    else
+        qwHash = m_qwSeed + HASH_PRIME5;
+
+    qwHash += m_qwTotal;
+
+    // Mix the bytes short of a stripe
+    for (; nBytes >= 8; pData += 8, nBytes -= 8)
+    {
+        qwHash ^= Lane(0, Read64(pData));
+        qwHash = ROTL(qwHash, 27) * HASH_PRIME1 + HASH_PRIME4;
+    }
+
+    if (nBytes >= 4)
+    {
+        qwHash ^= Read32(pData) * HASH_PRIME1;
+        qwHash = ROTL(qwHash, 23) * HASH_PRIME2 + HASH_PRIME3;
+        pData += 4;
+        nBytes -= 4;
+    }
+
+    for (; nBytes > 0; pData++, nBytes--)
+    {
+        qwHash ^= *pData * HASH_PRIME5;
+        qwHash = ROTL(qwHash, 11) * HASH_PRIME1;
+    }
+
+    return Avalanche(qwHash);
+
+}
+
+//---------------------------------------------------------------------------------
+// Start an empty signature
+//---------------------------------------------------------------------------------
+
+CMinHash::CMinHash()
+{
+    Reset();
+}
+
+//---------------------------------------------------------------------------------
+// Start over
+//---------------------------------------------------------------------------------
+
+void CMinHash::Reset()
+{
+    memset(m_qwMin, 0xFF, sizeof(m_qwMin));
+    m_dwItems = 0;
+}
+
+//---------------------------------------------------------------------------------
+// Add an item, given by its hash (adding it again changes nothing)
+//---------------------------------------------------------------------------------
+
+void CMinHash::Add(unsigned long long qwItem)
+{
+
+    unsigned long long qwValue;
+
+    // Each salt gives a different permutation of the hash values
+    for (int x = 0; x < HASH_MINHASH; x++)
+    {
+        qwValue = Avalanche(qwItem ^ ((x + 1) * HASH_PRIME3));
+        if (qwValue < m_qwMin[x])
+            m_qwMin[x] = qwValue;
+    }
+
+    m_dwItems++;
+
+}
+
+//---------------------------------------------------------------------------------
+// Number of items added
+//---------------------------------------------------------------------------------
+
+DWORD CMinHash::Items()
+{
+    return m_dwItems;
+}
+
+//---------------------------------------------------------------------------------
+// Hash of one band of the signature (signatures sharing a band are LSH candidates)
+//---------------------------------------------------------------------------------
+
+unsigned long long CMinHash::Band(int nBand)
+{
+
+    CHash   XXH(nBand);
+
+    XXH.Update((const BYTE*)&m_qwMin[nBand * HASH_ROWS], HASH_ROWS * sizeof(m_qwMin[0]));
+
+    return XXH.Digest();
+
+}
+
+//---------------------------------------------------------------------------------
+// Estimated Jaccard similarity of the two item sets, in percent
+//---------------------------------------------------------------------------------
+
+DWORD CMinHash::Similarity(const CMinHash& Other)
+{
+
+    DWORD   dwSame = 0;
+
+    for (int x = 0; x < HASH_MINHASH; x++)
+        dwSame += (m_qwMin[x] == Other.m_qwMin[x]);
+
+    return dwSame * 100 / HASH_MINHASH;
+
+}
@@ -0,0 +1,91 @@
+/**
+ @file hash.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Streaming 64-bit content hash (XXH64)
+//---------------------------------------------------------------------------------
+//
+// Computes the XXH64 hash of a byte stream fed in pieces of any size, with the
+// same result as the reference implementation. It runs at several bytes per cycle,
+// so hashing a whole image costs less than reading it.
+//
+//---------------------------------------------------------------------------------
+
+#define HASH_PRIME1         0x9E3779B185EBCA87ULL                                   // XXH64 primes
+#define HASH_PRIME2         0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME3         0x165667B19E3779F9ULL
+#define HASH_PRIME4         0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME5         0x27D4EB2F165667C5ULL
+#define HASH_STRIPE         32                                                      // Bytes consumed by one round of the four lanes
+
+class   CHash
+{
+protected:
+    unsigned long long m_qwLane[4];                                                 // Accumulators of the four lanes
+    unsigned long long m_qwTotal;                                                   // Bytes hashed so far
+    unsigned long long m_qwSeed;                                                    // Seed the hash started from
+    BYTE        m_Stripe[HASH_STRIPE];                                              // Bytes waiting for a full stripe
+    DWORD       m_nStripe;                                                          // Number of bytes in m_Stripe
+public:
+                CHash(unsigned long long qwSeed = 0);                               // Start a new hash
+    void        Reset(unsigned long long qwSeed = 0);                               // Start over
+    void        Update(const BYTE* pData, size_t nBytes);                           // Add a block of bytes
+    unsigned long long Digest();                                                    // Hash of the bytes added so far (the hash can go on)
+protected:
+    void        Round(const BYTE* pStripe);                                         // Mix one stripe into the lanes
+};
+
+//---------------------------------------------------------------------------------
+// MinHash signature of a set of items (given by their 64-bit hashes)
+//---------------------------------------------------------------------------------
+//
+// Two signatures agree on each value with a probability equal to the Jaccard
+// similarity of their sets. Split into bands, they find the near-duplicates of a
+// collection without comparing every pair: sets at least (1/HASH_BANDS)^(1/HASH_ROWS)
+// (50%) alike share a band with a high probability, unrelated sets hardly ever.
+//
+//---------------------------------------------------------------------------------
+
+#define HASH_MINHASH        64                                                      // Values in a signature
+#define HASH_BANDS          16                                                      // LSH bands
+#define HASH_ROWS           (HASH_MINHASH / HASH_BANDS)                             // Values in a band
+
+class   CMinHash
+{
+protected:
+    unsigned long long m_qwMin[HASH_MINHASH];                                       // Least value of each hash permutation
+    DWORD       m_dwItems;                                                          // Items added (duplicates included)
+public:
+                CMinHash();                                                         // Start an empty signature
+    void        Reset();                                                            // Start over
+    void        Add(unsigned long long qwItem);                                     // Add an item, given by its hash
+    DWORD       Items();                                                            // Number of items added
+    unsigned long long Band(int nBand);                                             // Hash of one band (the LSH bucket)
+    DWORD       Similarity(const CMinHash& Other);                                  // Estimated Jaccard similarity, in percent
+};
@@ -0,0 +1,1029 @@
+/**
+ @file image.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Disk image handle (libv80 public interface)
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <ctype.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include "v80.h"
+#include "stats.h"
+#include "vdi.h"
+#include "jv1.h"
+#include "jv3.h"
+#include "dmk.h"
+#include "arc.h"
+#include "osi.h"
+#include "td4.h"
+#include "td3.h"
+#include "td1.h"
+#include "rd.h"
+#include "md.h"
+#include "nd.h"
+#include "dd.h"
+#include "cpm.h"
+#include "trace.h"
+#include "cache.h"
+#include "fprint.h"
+#include "image.h"
+
+//---------------------------------------------------------------------------------
+// Interface factories, in probing order
+//---------------------------------------------------------------------------------
+
+static CVDI*    NewARC()    { return new CARC; }
+static CVDI*    NewDMK()    { return new CDMK; }
+static CVDI*    NewJV3()    { return new CJV3; }
+static CVDI*    NewJV1()    { return new CJV1; }
+
+static COSI*    NewTD4()    { return new CTD4; }
+static COSI*    NewTD3()    { return new CTD3; }
+static COSI*    NewTD1()    { return new CTD1; }
+static COSI*    NewRD()     { return new CRD; }
+static COSI*    NewMD()     { return new CMD; }
+static COSI*    NewND()     { return new CND; }
+static COSI*    NewDD()     { return new CDD; }
+static COSI*    NewCPM()    { return new CCPM; }
+
+// Container formats hold several images, picked with "file:member"
+static struct { const char* pName; CVDI* (*pNew)(); bool bContainer; } gVDIs[] =
+{
+    { "ARC", NewARC, true }, { "DMK", NewDMK, false }, { "JV3", NewJV3, false }, { "JV1", NewJV1, false }
+};
+
+static struct { const char* pName; COSI* (*pNew)(); } gOSIs[] =
+{
+    { "TD4", NewTD4 }, { "TD3", NewTD3 }, { "TD1", NewTD1 }, { "RD", NewRD },
+    { "MD", NewMD }, { "ND", NewND }, { "DD", NewDD }, { "CPM", NewCPM }
+};
+
+__thread FILE*  ghOut = NULL;
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CImage::CImage()
+:   m_hFile(NULL), m_pVDI(NULL), m_pOSI(NULL), m_pVDIName(NULL), m_pOSIName(NULL), m_dwFlags(0), m_pTrace(NULL),
+    m_pMember(NULL), m_pCache(NULL), m_bCacheVDI(false), m_bCacheOSI(false), m_pFPrint(NULL)
+{
+    // Extra information goes to the console unless the caller redirected it
+    if (ghOut == NULL)
+        ghOut = stdout;
+}
+
+//---------------------------------------------------------------------------------
+// Release the image
+//---------------------------------------------------------------------------------
+
+CImage::~CImage()
+{
+    Close();
+    free(m_pTrace);
+}
+
+//---------------------------------------------------------------------------------
+// Open a disk image file
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Open(const char* pName, DWORD dwFlags, bool bReadOnly)
+{
+
+    const char* pMember;
+    char*       pPath;
+    DWORD       dwError = NO_ERROR;
+
+    // Release any previous image
+    Close();
+
+    m_dwFlags = dwFlags;
+
+    // Open the disk image
+    if ((m_hFile = fopen(pName, (bReadOnly ? "r" : "r+"))) != NULL)
+        return dwError;
+
+    // Not a file: "container:member" names an image inside a container file
+    if ((pMember = strrchr(pName, ':')) != NULL && pMember != pName && pMember[1] != 0)
+    {
+
+        if ((pPath = strndup(pName, pMember - pName)) == NULL)
+            return ERROR_OUTOFMEMORY;
+
+        if ((m_hFile = fopen(pPath, (bReadOnly ? "r" : "r+"))) != NULL && (m_pMember = strdup(pMember + 1)) == NULL)
+            dwError = ERROR_OUTOFMEMORY;
+
+        free(pPath);
+
+        if (m_hFile != NULL)
+            return dwError;
+
+    }
+
+    return ERROR_FILE_NOT_FOUND;
+
+}
+
+//---------------------------------------------------------------------------------
+// Detect (or force) both the disk format and the DOS
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Probe(const char* pVDI, const char* pOSI)
+{
+
+    DWORD   dwError;
+
+    if ((dwError = ProbeVDI(pVDI)) == NO_ERROR)
+        dwError = ProbeOSI(pOSI);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Detect the disk format, trying only the named interface if one is given
+//---------------------------------------------------------------------------------
+
+DWORD CImage::ProbeVDI(const char* pVDI)
+{
+
+    CTrace*         pTrace;
+    VDI_GEOMETRY    DG;
+    bool            bCached = false;
+    bool            bForced = (pVDI != NULL);
+    DWORD           dwError = ERROR_UNRECOGNIZED_MEDIA;
+
+    STAT_PHASE(STAT_PHASE_PROBE);
+
+    // An image must have been opened
+    if (m_hFile == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    // Release any previously loaded interfaces
+    delete m_pOSI;
+    delete m_pVDI;
+    m_pOSI = NULL;
+    m_pVDI = NULL;
+    m_pOSIName = NULL;
+    m_pVDIName = NULL;
+    m_bCacheVDI = false;
+    m_bCacheOSI = false;
+
+    // A valid cache entry names the disk interface and its geometry, skipping the detection
+    // (the entry of a container file doesn't tell its members apart)
+    if (!bForced && m_pMember == NULL && m_pCache != NULL && m_pCache->Load(m_hFile, m_dwFlags))
+    {
+        pVDI = m_pCache->VDI();
+        m_pCache->GetDG(DG);
+        bCached = true;
+    }
+
+    // Try each disk interface in turn
+    for (int x = 0; x < (int)(sizeof(gVDIs) / sizeof(gVDIs[0])); x++)
+    {
+
+        if (pVDI != NULL && strcasecmp(pVDI, gVDIs[x].pName) != 0)
+            continue;
+
+        // A member name only means something to a container
+        if (m_pMember != NULL && !gVDIs[x].bContainer)
+            continue;
+
+        m_pVDI = gVDIs[x].pNew();
+
+        if (bCached)
+            m_pVDI->SetDG(DG);
+
+        if (m_pMember != NULL)
+            m_pVDI->SetMember(m_pMember);
+
+        if ((dwError = m_pVDI->Load(m_hFile, m_dwFlags)) == NO_ERROR)
+        {
+            m_pVDIName = gVDIs[x].pName;
+            break;
+        }
+
+        delete m_pVDI;
+        m_pVDI = NULL;
+
+    }
+
+    // A stale cache entry falls back to the full detection
+    if (dwError != NO_ERROR && bCached)
+    {
+        m_pCache->Drop();
+        return ProbeVDI(NULL);
+    }
+
+    // Only detected interfaces are cached (a forced one may be the wrong one)
+    m_bCacheVDI = (dwError == NO_ERROR && m_pCache != NULL && !bForced && m_pMember == NULL);
+
+    // Put the trace recorder between the DOS and the disk interfaces
+    if (dwError == NO_ERROR && m_pTrace != NULL)
+    {
+        m_pVDI = pTrace = new CTrace(m_pVDI);
+        dwError = pTrace->Begin(m_pTrace, m_pVDIName);
+    }
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Detect the DOS, trying only the named interface if one is given
+//---------------------------------------------------------------------------------
+
+DWORD CImage::ProbeOSI(const char* pOSI)
+{
+
+    unsigned long long  qwPrint;
+    char                cOSI[4];
+    bool                bPrint = false;
+    DWORD               dwError;
+
+    STAT_PHASE(STAT_PHASE_PROBE);
+
+    // The disk format must have been detected
+    if (m_pVDI == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    // Release any previously loaded DOS interface
+    delete m_pOSI;
+    m_pOSI = NULL;
+    m_pOSIName = NULL;
+    m_bCacheOSI = false;
+
+    // A forced DOS is the only one tried (and is never remembered)
+    if (pOSI != NULL)
+        return TryOSI(pOSI);
+
+    // A valid cache entry taken on the same disk interface names the DOS
+    if (m_pCache != NULL && m_pMember == NULL && m_pCache->Load(m_hFile, m_dwFlags) && m_pCache->OSI()[0] != 0 && strcmp(m_pCache->VDI(), m_pVDIName) == 0)
+    {
+        if ((dwError = TryOSI(m_pCache->OSI())) == NO_ERROR)
+            goto Done;
+        m_pCache->Drop();
+    }
+
+    // So does a known boot sector
+    if (m_pFPrint != NULL && (bPrint = (CFPrint::Take(m_pVDI, qwPrint) == NO_ERROR)) && m_pFPrint->Find(qwPrint, cOSI))
+    {
+        if ((dwError = TryOSI(cOSI)) == NO_ERROR)
+            goto Done;
+    }
+
+    // Otherwise try each DOS interface in turn, and teach the result to the fingerprint table
+    if ((dwError = TryOSI(NULL)) == NO_ERROR && bPrint)
+        m_pFPrint->Add(qwPrint, m_pOSIName);
+
+    Done:
+    m_bCacheOSI = (dwError == NO_ERROR && m_bCacheVDI);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Load the named DOS interface, or the first one that fits the disk (pOSI NULL)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::TryOSI(const char* pOSI)
+{
+
+    DWORD   dwError = ERROR_NOT_DOS_DISK;
+
+    for (int x = 0; x < (int)(sizeof(gOSIs) / sizeof(gOSIs[0])); x++)
+    {
+
+        if (pOSI != NULL && strcasecmp(pOSI, gOSIs[x].pName) != 0)
+            continue;
+
+        m_pOSI = gOSIs[x].pNew();
+
+        if ((dwError = m_pOSI->Load(m_pVDI, m_dwFlags)) == NO_ERROR)
+        {
+            m_pOSIName = gOSIs[x].pName;
+            break;
+        }
+
+        delete m_pOSI;
+        m_pOSI = NULL;
+
+    }
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Release the interfaces and close the file
+//---------------------------------------------------------------------------------
+
+void CImage::Close()
+{
+
+    VDI_GEOMETRY    DG;
+    const char*     pVDIName = (m_bCacheVDI ? m_pVDIName : NULL);
+    const char*     pOSIName = (m_bCacheOSI ? m_pOSIName : NULL);
+
+    // Interfaces with write caches save them when deleted
+    STAT_PHASE(STAT_PHASE_COMMIT);
+
+    if (pVDIName != NULL)
+        m_pVDI->GetDG(DG);
+
+    delete m_pOSI;
+    delete m_pVDI;
+
+    m_pOSI = NULL;
+    m_pVDI = NULL;
+    m_pOSIName = NULL;
+    m_pVDIName = NULL;
+
+    // Remember what was detected, stamped after the final writes (the cache is best-effort)
+    if (m_pCache != NULL && m_hFile != NULL && pVDIName != NULL && fflush(m_hFile) == 0)
+        m_pCache->Save(m_hFile, m_dwFlags, pVDIName, DG, pOSIName);
+
+    delete m_pCache;
+
+    m_pCache = NULL;
+    m_bCacheVDI = false;
+    m_bCacheOSI = false;
+
+    if (m_hFile != NULL)
+        fclose(m_hFile);
+
+    free(m_pMember);
+
+    m_hFile = NULL;
+    m_pMember = NULL;
+
+}
+
+//---------------------------------------------------------------------------------
+// Record the sector accesses of the next probed disk interface (NULL: stop)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Trace(const char* pPath)
+{
+
+    free(m_pTrace);
+    m_pTrace = NULL;
+
+    if (pPath != NULL && (m_pTrace = strdup(pPath)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Use a probe result cache file for the open image (released on Close)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Cache(const char* pPath)
+{
+
+    delete m_pCache;
+    m_pCache = NULL;
+
+    if (m_hFile == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    if (pPath != NULL && (m_pCache = new CCache(pPath)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Pick the DOS by boot sector fingerprint before probing them all (NULL: stop)
+//---------------------------------------------------------------------------------
+
+void CImage::FPrint(CFPrint* pFPrint)
+{
+    m_pFPrint = pFPrint;
+}
+
+//---------------------------------------------------------------------------------
+// Return the first/next file in the directory and its properties
+//---------------------------------------------------------------------------------
+
+DWORD CImage::List(void** pFile, OSI_FILE& File, OSI_DIR nFlag)
+{
+
+    DWORD   dwError;
+
+    if (m_pOSI == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    if ((dwError = m_pOSI->Dir(pFile, nFlag)) == NO_ERROR)
+        m_pOSI->GetFile(*pFile, File);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Return the file matching a host-style name (NAME/EXT or NAME.EXT)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Find(void** pFile, const char* pName)
+{
+
+    char    cName[11];
+
+    if (m_pOSI == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    Win2TRS(pName, cName);
+
+    return m_pOSI->Open(pFile, cName);
+
+}
+
+//---------------------------------------------------------------------------------
+// Read file data from a given position (dwBytes returns the number of bytes read)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Read(void* pFile, DWORD dwPos, BYTE* pBuffer, DWORD& dwBytes)
+{
+
+    OSI_FILE    File;
+    DWORD       dwError;
+
+    STAT_PHASE(STAT_PHASE_TRANSFER);
+
+    if (m_pOSI == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    // Stop at the end of file (the DOS interfaces expect the range to be inside the file)
+    m_pOSI->GetFile(pFile, File);
+
+    if (dwPos > File.dwSize)
+    {
+        dwBytes = 0;
+        return ERROR_HANDLE_EOF;
+    }
+
+    if (dwBytes > File.dwSize - dwPos)
+        dwBytes = File.dwSize - dwPos;
+
+    if (dwBytes == 0)
+        return NO_ERROR;
+
+    // The seek goes straight to the extent holding dwPos, so only the sectors in range are read
+    if ((dwError = m_pOSI->Seek(pFile, dwPos)) != NO_ERROR)
+    {
+        dwBytes = 0;
+        return dwError;
+    }
+
+    return m_pOSI->Read(pFile, pBuffer, dwBytes);
+
+}
+
+//---------------------------------------------------------------------------------
+// Read dwRecords logical records from record dwRecord on (dwBytes returns the number of bytes read)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::ReadRecords(void* pFile, DWORD dwRecord, DWORD dwRecords, BYTE* pBuffer, DWORD& dwBytes)
+{
+
+    OSI_FILE    File;
+    DWORD       dwLRL;
+
+    if (m_pOSI == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    // An LRL of 0 stands for 256-byte records
+    m_pOSI->GetFile(pFile, File);
+    dwLRL = (File.nLRL == 0 ? 256 : File.nLRL);
+
+    return Read(pFile, dwRecord * dwLRL, pBuffer, (dwBytes = dwRecords * dwLRL));
+
+}
+
+//---------------------------------------------------------------------------------
+// Copy a byte range of the image file to a host file descriptor (kernel-side when possible)
+//---------------------------------------------------------------------------------
+
+static DWORD CopyRun(int hSource, DWORD dwOffset, int hTarget, DWORD dwBytes, DWORD& dwDone)
+{
+
+    static __thread int nMode = 0;                                                  // 0: copy_file_range, 1: sendfile, 2: pread/write
+    BYTE        Buffer[4096];
+    loff_t      qwIn;
+    off_t       nIn;
+    ssize_t     nDone;
+
+    while (dwBytes > 0)
+    {
+
+        nDone = -1;
+
+        // Same file system: the data may not even leave the page cache
+        if (nMode == 0)
+        {
+            qwIn = dwOffset;
+            if ((nDone = copy_file_range(hSource, &qwIn, hTarget, NULL, dwBytes, 0)) < 0 && errno != ENOSPC && errno != EDQUOT && errno != EIO)
+                nMode = 1;
+        }
+
+        // Any file system, any target
+        if (nMode == 1)
+        {
+            nIn = dwOffset;
+            if ((nDone = sendfile(hTarget, hSource, &nIn, dwBytes)) < 0 && (errno == EINVAL || errno == ENOSYS))
+                nMode = 2;
+        }
+
+        if (nDone > 0)
+            STAT_ADD(STAT_KERNEL_COPY, nDone);
+
+        // Last resort, through a small buffer
+        if (nMode == 2)
+        {
+            if ((nDone = pread(hSource, Buffer, (dwBytes < sizeof(Buffer) ? dwBytes : sizeof(Buffer)), dwOffset)) > 0 && write(hTarget, Buffer, nDone) != nDone)
+                nDone = -1;
+        }
+
+        // A short image file ends the run early
+        if (nDone == 0)
+            return ERROR_READ_FAULT;
+
+        if (nDone < 0)
+            return ERROR_WRITE_FAULT;
+
+        dwOffset += nDone;
+        dwBytes -= nDone;
+        dwDone += nDone;
+
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Map file data to byte ranges of the image file (the caller frees pRuns)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Map(void* pFile, DWORD dwBytes, IMAGE_RUN*& pRuns, DWORD& dwRuns)
+{
+
+    OSI_FILE        File;
+    VDI_GEOMETRY    DG;
+    VDI_TRACK*      pTrack;
+    IMAGE_RUN*      pMore;
+    BYTE            nTrack;
+    BYTE            nSide;
+    BYTE            nSector;
+    DWORD           dwOffset;
+    DWORD           dwPos = 0;
+    DWORD           dwLength;
+    DWORD           dwAlloc = 0;
+    DWORD           dwError = NO_ERROR;
+
+    pRuns = NULL;
+    dwRuns = 0;
+
+    if (m_pVDI == NULL || m_pOSI == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    // Map up to the end of file
+    m_pOSI->GetFile(pFile, File);
+
+    if (dwBytes > File.dwSize)
+        dwBytes = File.dwSize;
+
+    // Pending sector writes must reach the image file before it is read behind the interfaces
+    if ((dwError = m_pVDI->Flush()) != NO_ERROR)
+        goto Done;
+
+    m_pVDI->GetDG(DG);
+
+    while (dwPos < dwBytes)
+    {
+
+        // Map the sector holding this position to a plain byte range of the image file
+        if ((dwError = m_pOSI->Where(pFile, dwPos, nTrack, nSide, nSector)) != NO_ERROR || (dwError = m_pVDI->Offset(nTrack, nSide, nSector, dwOffset)) != NO_ERROR)
+            goto Done;
+
+        pTrack = (nTrack == DG.FT.nTrack ? &DG.FT : &DG.LT);
+
+        // The piece runs from dwPos to the end of its sector (or of the file)
+        dwLength = pTrack->wSectorSize - dwPos % pTrack->wSectorSize;
+
+        if (dwLength > dwBytes - dwPos)
+            dwLength = dwBytes - dwPos;
+
+        dwOffset += dwPos % pTrack->wSectorSize;
+
+        // Extend the current run while the next piece follows it in the image file
+        if (dwRuns == 0 || dwOffset != pRuns[dwRuns - 1].dwOffset + pRuns[dwRuns - 1].dwBytes)
+        {
+
+            if (dwRuns == dwAlloc)
+            {
+                if ((pMore = (IMAGE_RUN*)realloc(pRuns, (dwAlloc + 16) * sizeof(IMAGE_RUN))) == NULL)
+                {
+                    dwError = ERROR_OUTOFMEMORY;
+                    goto Done;
+                }
+                pRuns = pMore;
+                dwAlloc += 16;
+            }
+
+            pRuns[dwRuns].dwOffset = dwOffset;
+            pRuns[dwRuns].dwBytes = 0;
+            dwRuns++;
+
+        }
+
+        pRuns[dwRuns - 1].dwBytes += dwLength;
+        dwPos += dwLength;
+
+    }
+
+    Done:
+    if (dwError != NO_ERROR)
+    {
+        free(pRuns);
+        pRuns = NULL;
+        dwRuns = 0;
+    }
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Copy mapped runs to a host file descriptor, in the kernel when possible (safe from any thread)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Copy(const IMAGE_RUN* pRuns, DWORD dwRuns, int hTarget, bool bBad, DWORD& dwBytes)
+{
+
+    static const BYTE Zero[1024] = {0};
+    DWORD       dwDone = 0;
+    DWORD       dwStart;
+    DWORD       dwLeft;
+    DWORD       dwLength;
+    DWORD       dwError = NO_ERROR;
+
+    STAT_PHASE(STAT_PHASE_TRANSFER);
+
+    if (m_hFile == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    for (DWORD x = 0; x < dwRuns; x++)
+    {
+
+        dwStart = dwDone;
+
+        if ((dwError = CopyRun(fileno(m_hFile), pRuns[x].dwOffset, hTarget, pRuns[x].dwBytes, dwDone)) == NO_ERROR)
+            continue;
+
+        // A run cut short by the image file leaves zeros when reading bad files, and the next run goes on
+        if (dwError != ERROR_READ_FAULT || !bBad)
+            break;
+
+        for (dwLeft = pRuns[x].dwBytes - (dwDone - dwStart); dwLeft > 0; dwLeft -= dwLength, dwDone += dwLength)
+        {
+            dwLength = (dwLeft < sizeof(Zero) ? dwLeft : sizeof(Zero));
+            if (write(hTarget, Zero, dwLength) != (ssize_t)dwLength)
+                break;
+        }
+
+        if ((dwError = (dwLeft > 0 ? ERROR_WRITE_FAULT : NO_ERROR)) != NO_ERROR)
+            break;
+
+    }
+
+    dwBytes = dwDone;
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write file data at a given position (dwBytes returns the number of bytes written)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Write(void* pFile, DWORD dwPos, BYTE* pBuffer, DWORD& dwBytes)
+{
+
+    DWORD   dwError;
+
+    STAT_PHASE(STAT_PHASE_TRANSFER);
+
+    if (m_pOSI == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    if ((dwError = m_pOSI->Seek(pFile, dwPos)) != NO_ERROR)
+    {
+        dwBytes = 0;
+        return dwError;
+    }
+
+    return m_pOSI->Write(pFile, pBuffer, dwBytes);
+
+}
+
+//---------------------------------------------------------------------------------
+// Create a new file with the indicated properties (space is allocated for File.dwSize)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Create(void** pFile, OSI_FILE& File)
+{
+    return (m_pOSI != NULL ? m_pOSI->Create(pFile, File) : ERROR_INVALID_PARAMETER);
+}
+
+//---------------------------------------------------------------------------------
+// Delete a file
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Delete(void* pFile)
+{
+    return (m_pOSI != NULL ? m_pOSI->Delete(pFile) : ERROR_INVALID_PARAMETER);
+}
+
+//---------------------------------------------------------------------------------
+// Get the file properties
+//---------------------------------------------------------------------------------
+
+void CImage::GetFile(void* pFile, OSI_FILE& File)
+{
+    if (m_pOSI != NULL)
+        m_pOSI->GetFile(pFile, File);
+}
+
+//---------------------------------------------------------------------------------
+// Set the file properties (name, date, attributes)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::SetFile(void* pFile, OSI_FILE& File)
+{
+    return (m_pOSI != NULL ? m_pOSI->SetFile(pFile, File) : ERROR_INVALID_PARAMETER);
+}
+
+//---------------------------------------------------------------------------------
+// Commit pending writes to the image file
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Flush()
+{
+
+    STAT_PHASE(STAT_PHASE_COMMIT);
+
+    if (m_pVDI != NULL)
+        return m_pVDI->Flush();
+
+    return (m_hFile == NULL || fflush(m_hFile) == 0 ? NO_ERROR : ERROR_WRITE_FAULT);
+
+}
+
+//---------------------------------------------------------------------------------
+// Return the granule size and the number of free granules
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Free(DWORD& dwGranule, DWORD& dwGranules)
+{
+    return (m_pOSI != NULL ? m_pOSI->Free(dwGranule, dwGranules) : ERROR_INVALID_PARAMETER);
+}
+
+//---------------------------------------------------------------------------------
+// Keep the directory writes in memory until Commit() (ERROR_NOT_SUPPORTED: every change is written at once)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Hold()
+{
+    return (m_pOSI != NULL ? m_pOSI->Hold() : ERROR_INVALID_PARAMETER);
+}
+
+//---------------------------------------------------------------------------------
+// Write the held directory once, then flush the image file
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Commit()
+{
+
+    DWORD   dwError;
+
+    if (m_pOSI == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    if ((dwError = m_pOSI->Commit()) != NO_ERROR)
+        return dwError;
+
+    return Flush();
+
+}
+
+//---------------------------------------------------------------------------------
+// Discard the directory changes held since Hold() (the data written meanwhile lies in free granules)
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Drop()
+{
+    return (m_pOSI != NULL ? m_pOSI->Drop() : ERROR_INVALID_PARAMETER);
+}
+
+//---------------------------------------------------------------------------------
+// Return the number of free directory entries
+//---------------------------------------------------------------------------------
+
+DWORD CImage::Entries(DWORD& dwEntries)
+{
+    return (m_pOSI != NULL ? m_pOSI->Entries(dwEntries) : ERROR_INVALID_PARAMETER);
+}
+
+//---------------------------------------------------------------------------------
+// Return the loaded interfaces and their names
+//---------------------------------------------------------------------------------
+
+CVDI* CImage::GetVDI()
+{
+    return m_pVDI;
+}
+
+COSI* CImage::GetOSI()
+{
+    return m_pOSI;
+}
+
+const char* CImage::VDIName()
+{
+    return m_pVDIName;
+}
+
+const char* CImage::OSIName()
+{
+    return m_pOSIName;
+}
+
+//---------------------------------------------------------------------------------
+// Return the name/extension divider used by the DOS
+//---------------------------------------------------------------------------------
+
+const char* CImage::Divider()
+{
+    return (m_pOSIName != NULL && strcmp(m_pOSIName, "CPM") == 0 ? "." : "/");
+}
+
+//---------------------------------------------------------------------------------
+// Check whether an interface name is known
+//---------------------------------------------------------------------------------
+
+bool CImage::IsVDI(const char* pName)
+{
+    for (int x = 0; x < (int)(sizeof(gVDIs) / sizeof(gVDIs[0])); x++)
+    {
+        if (strcasecmp(pName, gVDIs[x].pName) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+bool CImage::IsOSI(const char* pName)
+{
+    for (int x = 0; x < (int)(sizeof(gOSIs) / sizeof(gOSIs[0])); x++)
+    {
+        if (strcasecmp(pName, gOSIs[x].pName) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------
+// Format a new filename from separated parts
+//---------------------------------------------------------------------------------
+
+void FmtName(const char szName[9], const char szType[4], const char* szDivider, char szNewName[13])
+{
+
+    char szTmpName[9];
+    char szTmpType[4];
+
+    // Copy szName and szType to temporary variables
+    memcpy(szTmpName, szName, sizeof(szTmpName));
+    memcpy(szTmpType, szType, sizeof(szTmpType));
+
+    // Remove trailing spaces from name
+    for (int x = 8; x > 0 && szTmpName[x - 1] == ' '; x--)
+        szTmpName[x - 1] = 0;
+
+    // Remove trailing spaces from extension
+    for (int x = 3; x > 0 && szTmpType[x - 1] == ' '; x--)
+        szTmpType[x - 1] = 0;
+
+    // Assemble the new name from the two temporary variables
+    sprintf(szNewName, "%s%s%s", szTmpName, (szTmpType[0] ? szDivider : ""), szTmpType);
+
+}
+
+//---------------------------------------------------------------------------------
+// Convert Windows-based filename to TRS standard
+//---------------------------------------------------------------------------------
+
+void Win2TRS(const char* pWinName, char cTRSName[11])
+{
+
+    int x, y, z, k = strlen(pWinName);
+
+    for (x = k; x > 0 && pWinName[x - 1] != '/'; x--)
+		;
+
+    if (pWinName[x] == '/')
+        x++;
+
+    for (y = 0; y < 8 && pWinName[x] != '.' && pWinName[x] != '/' && pWinName[x] != 0; x++, y++)
+        cTRSName[y] = toupper(pWinName[x]);
+
+    for ( ; y < 8; y++)
+        cTRSName[y] = ' ';
+
+    for (z = 0; z < (k - x); z++)
+    {
+        if (pWinName[x+z] == '.' || pWinName[x+z] == '/')
+        {
+            x += z + 1;
+            break;
+        }
+    }
+
+    for (; y < 11 && pWinName[x] != 0; x++, y++)
+        cTRSName[y] = toupper(pWinName[x]);
+
+    for ( ; y < 11; y++)
+        cTRSName[y] = ' ';
+
+}
+
+//---------------------------------------------------------------------------------
+// Remove spaces from disk name/date
+//---------------------------------------------------------------------------------
+
+void Trim(char cField[8])
+{
+    for (int x = 8; x > 0; x--)
+    {
+        if (cField[x-1] != ' ')
+            break;
+        cField[x-1] = 0;
+    }
+}
+
+//---------------------------------------------------------------------------------
+// Compare a string against a wildcard-based mask (case insensitive)
+//---------------------------------------------------------------------------------
+
+bool WildComp(const char* pSource, const char* pMask, BYTE nLength)
+{
+
+    for (int x = 0; x < nLength; x++)
+    {
+        if (pMask[x] == '?')
+            continue;
+        if (pMask[x] == '*')
+            break;
+        if ((pMask[x] | ('a'-'A')) != (pSource[x] | ('a'-'A')))
+            return false;
+    }
+
+    return true;
+
+}
@@ -0,0 +1,106 @@
+/**
+ @file image.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Disk image handle (libv80 public interface)
+//---------------------------------------------------------------------------------
+
+class   CCache;
+class   CFPrint;
+
+struct  IMAGE_RUN                                                                   // Byte range of the image file holding file data
+{
+    DWORD       dwOffset;                                                           // Offset in the image file
+    DWORD       dwBytes;                                                            // Number of bytes
+};
+
+class   CImage
+{
+protected:
+    FILE*           m_hFile;                                                        // Disk image file handle
+    CVDI*           m_pVDI;                                                         // Virtual Disk Interface (owned)
+    COSI*           m_pOSI;                                                         // Operating System Interface (owned)
+    const char*     m_pVDIName;                                                     // Name of the loaded disk interface
+    const char*     m_pOSIName;                                                     // Name of the loaded DOS interface
+    DWORD           m_dwFlags;                                                      // User flags (V80_FLAG_*)
+    char*           m_pTrace;                                                       // Sector access trace file (NULL: no trace)
+    char*           m_pMember;                                                      // Image inside a container file (NULL: the file is the image)
+    CCache*         m_pCache;                                                       // Probe result cache (owned, NULL: no cache)
+    bool            m_bCacheVDI;                                                    // The disk interface was detected (worth caching)
+    bool            m_bCacheOSI;                                                    // The DOS interface was detected (worth caching)
+    CFPrint*        m_pFPrint;                                                      // Boot sector fingerprint table (shared, NULL: none)
+public:
+                    CImage();                                                       // Initialize member variables
+    virtual         ~CImage();                                                      // Release the image
+    DWORD           Open(const char* pName, DWORD dwFlags = 0, bool bReadOnly = false); // Open a disk image file (or "container:member")
+    DWORD           Probe(const char* pVDI = NULL, const char* pOSI = NULL);        // Detect (or force) both the disk format and the DOS
+    DWORD           ProbeVDI(const char* pVDI = NULL);                              // Detect (or force) the disk format
+    DWORD           ProbeOSI(const char* pOSI = NULL);                              // Detect (or force) the DOS
+    void            Close();                                                        // Release the interfaces and close the file
+    DWORD           Trace(const char* pPath);                                       // Record the sector accesses of the next probed disk interface
+    DWORD           Cache(const char* pPath);                                       // Use a probe result cache file for the open image
+    void            FPrint(CFPrint* pFPrint);                                       // Pick the DOS by boot sector fingerprint (table not owned)
+    DWORD           List(void** pFile, OSI_FILE& File, OSI_DIR nFlag = OSI_DIR_FIND_NEXT); // Return the first/next file and its properties
+    DWORD           Find(void** pFile, const char* pName);                          // Return the file matching a host-style name (NAME/EXT or NAME.EXT)
+    DWORD           Read(void* pFile, DWORD dwPos, BYTE* pBuffer, DWORD& dwBytes);  // Read file data from a given position (up to the end of file)
+    DWORD           ReadRecords(void* pFile, DWORD dwRecord, DWORD dwRecords, BYTE* pBuffer, DWORD& dwBytes); // Read logical records (of the file LRL)
+    DWORD           Map(void* pFile, DWORD dwBytes, IMAGE_RUN*& pRuns, DWORD& dwRuns);// Map file data to byte ranges of the image file (caller frees pRuns)
+    DWORD           Copy(const IMAGE_RUN* pRuns, DWORD dwRuns, int hTarget, bool bBad, DWORD& dwBytes);// Copy mapped runs to a host file descriptor, in the kernel (any thread)
+    DWORD           Write(void* pFile, DWORD dwPos, BYTE* pBuffer, DWORD& dwBytes); // Write file data at a given position
+    DWORD           Create(void** pFile, OSI_FILE& File);                           // Create a new file with the indicated properties
+    DWORD           Delete(void* pFile);                                            // Delete a file
+    void            GetFile(void* pFile, OSI_FILE& File);                           // Get the file properties
+    DWORD           SetFile(void* pFile, OSI_FILE& File);                           // Set the file properties (name, date, attributes)
+    DWORD           Flush();                                                        // Commit pending writes to the image file
+    DWORD           Free(DWORD& dwGranule, DWORD& dwGranules);                      // Granule size (bytes) and number of free granules
+    DWORD           Hold();                                                         // Keep the directory writes in memory until Commit()
+    DWORD           Commit();                                                       // Write the held directory once, then flush the image file
+    DWORD           Drop();                                                         // Discard the directory changes held since Hold()
+    DWORD           Entries(DWORD& dwEntries);                                      // Number of free directory entries
+    CVDI*           GetVDI();                                                       // Loaded disk interface (NULL if none)
+    COSI*           GetOSI();                                                       // Loaded DOS interface (NULL if none)
+    const char*     VDIName();                                                      // Name of the loaded disk interface ("DMK", "JV1", ...)
+    const char*     OSIName();                                                      // Name of the loaded DOS interface ("TD4", "CPM", ...)
+    const char*     Divider();                                                      // Name/extension divider used by the DOS ("/" or ".")
+    static bool     IsVDI(const char* pName);                                       // Check whether a disk interface name is known
+    static bool     IsOSI(const char* pName);                                       // Check whether a DOS interface name is known
+protected:
+    DWORD           TryOSI(const char* pOSI);                                       // Load the named DOS interface, or the first one that fits
+};
+
+// Filename helpers
+
+void    Win2TRS(const char* pWinName, char cTRSName[11]);                           // Convert a host filename to the TRS standard
+void    FmtName(const char szName[9], const char szType[4], const char* szDivider, char szNewName[13]);  // Format a TRS filename for printing
+void    Trim(char cField[8]);                                                       // Remove trailing spaces from disk name/date
+bool    WildComp(const char* pSource, const char* pMask, BYTE nLength);             // Compare a TRS name or type against a wildcard mask
+
+// Where the interfaces print extra information (V80_FLAG_INFO), per thread
+
+extern __thread FILE*   ghOut;
@@ -45,6 +45,7 @@
 
 
 #include "v80.h"
+#include "stats.h"
 #include "vdi.h"
 #include "jv1.h"
 
@@ -172,6 +173,9 @@ DWORD CJV1::Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSiz
         goto Done;
     }
 
+    STAT_COUNT(STAT_VDI_READ);
+    STAT_ADD(STAT_BYTES_READ, dwBytes);
+
     Done:
     return dwError;
 
@@ -202,11 +206,32 @@ DWORD CJV1::Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSi
         goto Done;
     }
 
+    STAT_COUNT(STAT_VDI_WRITE);
+    STAT_ADD(STAT_BYTES_WRITTEN, dwBytes);
+
     Done:
     return dwError;
 
 }
 
+//---------------------------------------------------------------------------------
+// Return the image file offset of a sector
+//---------------------------------------------------------------------------------
+
+DWORD CJV1::Offset(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset)
+{
+
+    // Validate Track, Side, Sector
+    if (nTrack > m_DG.LT.nTrack || nSide > m_DG.LT.nLastSide || nSector > m_DG.LT.nLastSector)
+        return ERROR_SECTOR_NOT_FOUND;
+
+    // Compute sector offset
+    dwOffset = ((nTrack * (m_DG.LT.nLastSide + 1) + nSide) * (m_DG.LT.nLastSector + 1) + nSector) * 256;
+
+    return NO_ERROR;
+
+}
+
 //---------------------------------------------------------------------------------
 // Position the file pointer
 //---------------------------------------------------------------------------------
@@ -217,17 +242,12 @@ DWORD CJV1::Seek(BYTE nTrack, BYTE nSide, BYTE nSector)
     DWORD   dwOffset;
     DWORD   dwError = NO_ERROR;
 
-    // Validate Track, Side, Sector
-    if (nTrack > m_DG.LT.nTrack || nSide > m_DG.LT.nLastSide || nSector > m_DG.LT.nLastSector)
-    {
-        dwError = ERROR_SECTOR_NOT_FOUND;
-        goto Done;
-    }
-
     // Compute sector offset
-    dwOffset = ((nTrack * (m_DG.LT.nLastSide + 1) + nSide) * (m_DG.LT.nLastSector + 1) + nSector) * 256;
+    if ((dwError = Offset(nTrack, nSide, nSector, dwOffset)) != NO_ERROR)
+        goto Done;
 
     // Set file pointer
+    STAT_COUNT(STAT_SEEK);
     if (fseek(m_hFile, dwOffset, 0) == -1)
     {
         dwError = ERROR_SEEK;
@@ -41,6 +41,7 @@ public:
     DWORD   Load(HANDLE hFile, DWORD dwFlags);                                          // Validate disk format and detect disk geometry
     DWORD   Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);     // Read one sector from the disk
     DWORD   Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);    // Write one sector to the disk
+    DWORD   Offset(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset);             // Image file offset of a sector
 protected:
     virtual DWORD   Seek(BYTE nTrack, BYTE nSide, BYTE nSector);                        // Position the file pointer
 };
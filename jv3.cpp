@@ -44,6 +44,7 @@
 #include <time.h>
 
 #include "v80.h"
+#include "stats.h"
 #include "vdi.h"
 #include "jv3.h"
 
@@ -52,7 +53,7 @@
 //---------------------------------------------------------------------------------
 
 CJV3::CJV3()
-: m_pHeader(NULL), m_bExtended(false), m_wSectors(0)
+: m_pHeader(NULL), m_bExtended(false), m_wSectors(0), m_nPlain(-1)
 {
 }
 
@@ -92,6 +93,7 @@ DWORD CJV3::Load(HANDLE hFile, DWORD dwFlags)
     m_pHeader = new JV3_HEADER[2];
 
     // Position file pointer at the first header
+    STAT_COUNT(STAT_SEEK);
     if (fseek(hFile, 0, 0) == -1)
     {
         dwError = ERROR_SEEK;
@@ -120,6 +122,7 @@ DWORD CJV3::Load(HANDLE hFile, DWORD dwFlags)
     {
 
         // Position file pointer at the second header
+        STAT_COUNT(STAT_SEEK);
         if (fseek(hFile, dwBytes, 0) == -1)
             throw ERROR_SEEK;
 
@@ -132,8 +135,9 @@ DWORD CJV3::Load(HANDLE hFile, DWORD dwFlags)
 
     }
 
-    // Detect disk geometry
-    FindGeometry();
+    // Detect disk geometry (unless it was preset from the probe cache)
+    if (!m_bKnownDG)
+        FindGeometry();
 
     // Track count must be between 35 and 96 or this is probably not a JV3 image
     if (!(dwFlags & V80_FLAG_CHKDSK) && (m_DG.LT.nTrack < 34 || m_DG.LT.nTrack > 95))
@@ -190,6 +194,9 @@ DWORD CJV3::Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSiz
         goto Done;
     }
 
+    STAT_COUNT(STAT_VDI_READ);
+    STAT_ADD(STAT_BYTES_READ, dwBytes);
+
     Done:
     return dwError;
 
@@ -224,6 +231,9 @@ DWORD CJV3::Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSi
         goto Done;
     }
 
+    STAT_COUNT(STAT_VDI_WRITE);
+    STAT_ADD(STAT_BYTES_WRITTEN, dwBytes);
+
     Done:
     return dwError;
 
@@ -298,17 +308,16 @@ void CJV3::FindGeometry()
 }
 
 //---------------------------------------------------------------------------------
-// Position the file pointer
+// Locate a sector in the disk header and return its image file offset
 //---------------------------------------------------------------------------------
 
-DWORD CJV3::Seek(BYTE nTrack, BYTE nSide, BYTE nSector)
+DWORD CJV3::Find(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset)
 {
 
     VDI_TRACK*  pTrack;
     JV3_SECTOR  Sector;
     WORD        wCurrent;
     WORD        wTotal;
-    DWORD       dwOffset = sizeof(JV3_HEADER);
     DWORD       dwError = NO_ERROR;
 
     // Get a pointer to the correct track descriptor
@@ -334,6 +343,9 @@ DWORD CJV3::Seek(BYTE nTrack, BYTE nSide, BYTE nSector)
         goto Done;
     }
 
+    // Sector data starts right after the first header
+    dwOffset = sizeof(JV3_HEADER);
+
     // Scan entire disk header for the requested sector
     for (wCurrent = 0, wTotal = 2901 * (m_bExtended ? 2 : 1); wCurrent < wTotal; wCurrent++)
     {
@@ -361,7 +373,100 @@ DWORD CJV3::Seek(BYTE nTrack, BYTE nSide, BYTE nSector)
     if (wCurrent > 2900)
         dwOffset += sizeof(JV3_HEADER);
 
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Return the image file offset of a sector (only while all sectors are plain)
+//---------------------------------------------------------------------------------
+
+DWORD CJV3::Offset(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset)
+{
+
+    // Mixed sector sizes, doubled sectors or a second header make the layout irregular
+    if (!Plain())
+        return ERROR_NOT_SUPPORTED;
+
+    return Find(nTrack, nSide, nSector, dwOffset);
+
+}
+
+//---------------------------------------------------------------------------------
+// Check once whether every sector has its track size and appears only once
+//---------------------------------------------------------------------------------
+
+bool CJV3::Plain()
+{
+
+    VDI_TRACK*  pTrack;
+    JV3_SECTOR  Sector;
+    BYTE*       pSeen;
+    int         nBit;
+    int         x;
+
+    if (m_nPlain >= 0)
+        return (m_nPlain != 0);
+
+    m_nPlain = 0;
+
+    if (m_bExtended || (pSeen = (BYTE*)calloc(256 * 2 * 256 / 8, 1)) == NULL)
+        return false;
+
+    for (x = 0; x < 2901; x++)
+    {
+
+        // Get a sector header
+        GetSectorHeader(Sector, x);
+
+        // If has reached the area of free sectors, stop
+        if (Sector.nTrack == JV3_SECTOR_FREE || Sector.nSector == JV3_SECTOR_FREE || Sector.nFlags >= JV3_SECTOR_FREEF)
+            break;
+
+        // Get a pointer to the correct track descriptor
+        pTrack = (Sector.nTrack == m_DG.FT.nTrack ? &m_DG.FT : &m_DG.LT);
+
+        // Reads transfer the track sector size, so any other size shifts the data
+        if (GetSectorSize(Sector) != pTrack->wSectorSize)
+            break;
+
+        // A doubled sector is only reachable through its first copy
+        nBit = (Sector.nTrack * 2 + ((Sector.nFlags & JV3_FLAG_SIDE) >> 4)) * 256 + Sector.nSector;
+
+        if (pSeen[nBit / 8] & (1 << (nBit % 8)))
+            break;
+
+        pSeen[nBit / 8] |= (1 << (nBit % 8));
+
+    }
+
+    // Plain only if the scan got through every used sector
+    if (x == 2901 || Sector.nTrack == JV3_SECTOR_FREE || Sector.nSector == JV3_SECTOR_FREE || Sector.nFlags >= JV3_SECTOR_FREEF)
+        m_nPlain = 1;
+
+    free(pSeen);
+
+    return (m_nPlain != 0);
+
+}
+
+//---------------------------------------------------------------------------------
+// Position the file pointer
+//---------------------------------------------------------------------------------
+
+DWORD CJV3::Seek(BYTE nTrack, BYTE nSide, BYTE nSector)
+{
+
+    DWORD   dwOffset;
+    DWORD   dwError = NO_ERROR;
+
+    // Locate the sector
+    if ((dwError = Find(nTrack, nSide, nSector, dwOffset)) != NO_ERROR)
+        goto Done;
+
     // Set file pointer to the calculated sector offset
+    STAT_COUNT(STAT_SEEK);
     if (fseek(m_hFile, dwOffset, 0) == -1)
     {
         dwError = ERROR_SEEK;
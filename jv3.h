@@ -78,14 +78,18 @@ protected:
     JV3_HEADER* m_pHeader;                                                          // Pointer to JV3 disk header
     bool        m_bExtended;                                                        // Flag indicating an extended disk (2nd header exists)
     WORD        m_wSectors;                                                         // Total count of disk sectors
+    int         m_nPlain;                                                           // Sectors laid out plainly (-1: not checked yet, 0: no, 1: yes)
 public:
                 CJV3();                                                                     // Initialize member variables
                 ~CJV3();                                                                    // Release allocated memory
     DWORD       Load(HANDLE hFile, DWORD dwFlags);                                          // Validate disk format and detect disk geometry
     DWORD       Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);     // Read one sector from the disk
     DWORD       Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);    // Write one sector to the disk
+    DWORD       Offset(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset);             // Image file offset of a sector (plain layouts only)
 protected:
     void        FindGeometry();                                                             // Detect the disk geometry
+    DWORD       Find(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset);               // Locate a sector and return its file offset
+    bool        Plain();                                                                    // Check whether every sector has its track size, once
     DWORD       Seek(BYTE nTrack, BYTE nSide, BYTE nSector);                                // Position the file pointer
     WORD        GetSectorSize(const JV3_SECTOR& Sector);                                    // Return a sector size
     void        GetSectorHeader(JV3_SECTOR& Sector, WORD wSector);                          // Copy sector data from 1st or 2nd header
@@ -295,6 +295,29 @@ DWORD CMD::Read(void* pFile, BYTE* pBuffer, DWORD& dwBytes)
 
 }
 
+//---------------------------------------------------------------------------------
+// Return the Track, Side, Sector holding a file position
+//---------------------------------------------------------------------------------
+
+DWORD CMD::Where(void* pFile, DWORD dwPos, BYTE& nTrack, BYTE& nSide, BYTE& nSector)
+{
+
+    DWORD   dwError;
+
+    // Walk the file to the requested position
+    if ((dwError = Seek(pFile, dwPos)) != NO_ERROR)
+        return dwError;
+
+    if (m_wSector == 0xFFFF)
+        return ERROR_SEEK;
+
+    // Convert relative sector into Track, Side, Sector
+    CHS(m_wSector, nTrack, nSide, nSector);
+
+    return NO_ERROR;
+
+}
+
 //---------------------------------------------------------------------------------
 // Save data to file
 //---------------------------------------------------------------------------------
@@ -58,6 +58,7 @@ public:
     virtual DWORD   Create(void** pFile, OSI_FILE& File);                           // Create a new file with the indicated properties
     virtual DWORD   Seek(void* pFile, DWORD dwPos);                                 // Move the file pointer
     virtual DWORD   Read(void* pFile, BYTE* pBuffer, DWORD& dwBytes);               // Read data from file
+    virtual DWORD   Where(void* pFile, DWORD dwPos, BYTE& nTrack, BYTE& nSide, BYTE& nSector); // Track/Side/Sector holding a file position
     virtual DWORD   Write(void* pFile, BYTE* pBuffer, DWORD& dwBytes);              // Save data to file
     virtual DWORD   Delete(void* pFile);                                            // Delete the file
     virtual void    GetDOS(OSI_DOS& DOS);                                           // Get DOS information
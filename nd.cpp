@@ -34,18 +34,22 @@
 #include "windows.h"
 #include <stdio.h>
 #include "v80.h"
+#include "stats.h"
 #include "vdi.h"
 #include "osi.h"
 #include "nd.h"
 
+extern __thread FILE* ghOut;
+
 //---------------------------------------------------------------------------------
 // Initialize member variables
 //---------------------------------------------------------------------------------
 
 CND::CND()
-:   m_pDir(NULL), m_wDirSector(0), m_nDirSectors(0), m_nSides(0), m_nDensity(VDI_DENSITY_SINGLE),
+:   m_pDir(NULL), m_wDirSector(0), m_nDirSectors(0), m_qwDirRead(0), m_bHold(false), m_bDirty(false), m_pGAT(NULL), m_pUndo(NULL), m_nSides(0), m_nDensity(VDI_DENSITY_SINGLE),
     m_dwFilePos(0), m_wSector(0), m_Buffer(), m_nLumps(0), m_nFlags1(0), m_nFlags2(0), m_nTC(0),
-    m_nSPC(0), m_nGPL(0), m_nDDSL(0), m_nDDGA(0), m_nSPG(0), m_wTI(0), m_nTD(0)
+    m_nSPC(0), m_nGPL(0), m_nDDSL(0), m_nDDGA(0), m_nSPG(0), m_wTI(0), m_nTD(0),
+    m_nLastCol(-1), m_nLastRow(0), m_szTI()
 {
 }
 
@@ -57,6 +61,8 @@ CND::~CND()
 {
     if (m_pDir != NULL)
         free(m_pDir);
+    free(m_pGAT);
+    free(m_pUndo);
 }
 
 //---------------------------------------------------------------------------------
@@ -178,8 +184,8 @@ DWORD CND::Load(CVDI* pVDI, DWORD dwFlags)
         goto Done;
     }
 
-    // Load directory into memory
-    if ((dwError = DirRW(ND_DIR_READ)) != NO_ERROR)
+    // Load GAT and HIT into memory (the directory entries are read on first use)
+    if ((dwError = DirRW(ND_DIR_OPEN)) != NO_ERROR)
         goto Done;
 
     // Check directory structure
@@ -188,7 +194,7 @@ DWORD CND::Load(CVDI* pVDI, DWORD dwFlags)
             goto Done;
 
     if (m_dwFlags & V80_FLAG_INFO)
-        printf("DOS: TI=%s TD=%c TC=%d SPT=%d TSR=%d GPL=%d DDSL=%d DDGA=%d Lumps=%d\r\n", TI(m_wTI), 'A' + m_nTD, m_nTC, m_nSPC, m_nTSR, m_nGPL, m_nDDSL, m_nDDGA, m_nLumps);
+        fprintf(ghOut, "DOS: TI=%s TD=%c TC=%d SPT=%d TSR=%d GPL=%d DDSL=%d DDGA=%d Lumps=%d\r\n", TI(m_wTI), 'A' + m_nTD, m_nTC, m_nSPC, m_nTSR, m_nGPL, m_nDDSL, m_nDDGA, m_nLumps);
 
     Done:
     return dwError;
@@ -281,6 +287,10 @@ DWORD CND::Create(void** pFile, OSI_FILE& File)
     // Invalidate any previous Seek()
     m_wSector = 0xFFFF;
 
+    // While held, a failure restores the directory as it was before this file
+    if (m_bHold)
+        memcpy(m_pUndo, m_pDir, m_nDirSectors * m_DG.LT.wSectorSize);
+
     // Get a new directory entry
     if ((dwError = GetFDE(pFile)) != NO_ERROR)
         goto Abort;
@@ -358,7 +368,10 @@ DWORD CND::Create(void** pFile, OSI_FILE& File)
 
     // Restore previous directory state
     Abort:
-    DirRW(ND_DIR_READ);
+    if (m_bHold)
+        memcpy(m_pDir, m_pUndo, m_nDirSectors * m_DG.LT.wSectorSize);
+    else
+        DirRW(ND_DIR_READ);
 
     Done:
     return dwError;
@@ -490,6 +503,29 @@ DWORD CND::Read(void* pFile, BYTE* pBuffer, DWORD& dwBytes)
 
 }
 
+//---------------------------------------------------------------------------------
+// Return the Track, Side, Sector holding a file position
+//---------------------------------------------------------------------------------
+
+DWORD CND::Where(void* pFile, DWORD dwPos, BYTE& nTrack, BYTE& nSide, BYTE& nSector)
+{
+
+    DWORD   dwError;
+
+    // Walk the file to the requested position
+    if ((dwError = Seek(pFile, dwPos)) != NO_ERROR)
+        return dwError;
+
+    if (m_wSector == 0xFFFF)
+        return ERROR_SEEK;
+
+    // Convert relative sector into Track, Side, Sector
+    CHS(m_wSector, nTrack, nSide, nSector);
+
+    return NO_ERROR;
+
+}
+
 //---------------------------------------------------------------------------------
 // Save data to file
 //---------------------------------------------------------------------------------
@@ -584,6 +620,10 @@ DWORD CND::Delete(void* pFile)
     // Invalidate any previous Seek()
     m_wSector = 0xFFFF;
 
+    // While held, a failure restores the directory as it was before the deletion
+    if (m_bHold)
+        memcpy(m_pUndo, m_pDir, m_nDirSectors * m_DG.LT.wSectorSize);
+
     // Inactivate directory entry
     ((ND_FPDE*)pFile)->wAttributes &= !ND_ATTR_ACTIVE;
 
@@ -600,6 +640,8 @@ DWORD CND::Delete(void* pFile)
     // If exited loop because reached the end of the extents table
     if (dwError == ERROR_NO_MATCH)
         dwError = DirRW(ND_DIR_WRITE); // Save the directory
+    else if (m_bHold)
+        memcpy(m_pDir, m_pUndo, m_nDirSectors * m_DG.LT.wSectorSize);
     else
         DirRW(ND_DIR_READ);            // Otherwise, restore its previous state
 
@@ -664,6 +706,7 @@ void CND::GetFile(void* pFile, OSI_FILE& File)
     File.bSystem    = ((ND_FPDE*)pFile)->wAttributes & ND_ATTR_SYSTEM;
     File.bInvisible = ((ND_FPDE*)pFile)->wAttributes & ND_ATTR_INVISIBLE;
     File.bModified  = ((ND_FPDE*)pFile)->wAttributes & ND_ATTR_MODIFIED;
+    File.nLRL       = ((ND_FPDE*)pFile)->nLRL;
 
 }
 
@@ -708,12 +751,144 @@ DWORD CND::SetFile(void* pFile, OSI_FILE& File, bool bCommit)
     ((ND_FPDE*)pFile)->wAttributes &= ~ND_ATTR_MODIFIED;
     ((ND_FPDE*)pFile)->wAttributes |= (ND_ATTR_MODIFIED * File.bModified);
 
+    // Set logical record length
+    ((ND_FPDE*)pFile)->nLRL = File.nLRL;
+
     return (bCommit ? DirRW(ND_DIR_WRITE) : NO_ERROR);
 
 }
 
 //---------------------------------------------------------------------------------
 // Get file size
+//---------------------------------------------------------------------------------
+// Return the granule size and the number of free granules
+//---------------------------------------------------------------------------------
+
+DWORD CND::Free(DWORD& dwGranule, DWORD& dwGranules)
+{
+
+    dwGranule = m_nSPG * m_DG.LT.wSectorSize;
+    dwGranules = 0;
+
+    // Count the empty slots of the GAT, as CreateExtent() scans them
+    for (int nLump = 0; nLump < m_nLumps; nLump++)
+    {
+        for (int nGranule = 0; nGranule < m_nGPL; nGranule++)
+        {
+            if (!Used(nLump, nGranule))
+                dwGranules++;
+        }
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Keep the directory writes in memory until Commit()
+//---------------------------------------------------------------------------------
+
+DWORD CND::Hold()
+{
+
+    DWORD   dwBytes = m_nDirSectors * m_DG.LT.wSectorSize;
+    DWORD   dwError = NO_ERROR;
+
+    if (m_bHold)
+        return NO_ERROR;
+
+    // Every sector must be in memory before the first change, so an undo copy is complete
+    for (BYTE nIndex = 0; nIndex < m_nDirSectors; nIndex++)
+        if ((dwError = DirSector(nIndex)) != NO_ERROR)
+            return dwError;
+
+    if ((m_pGAT = (BYTE*)malloc(m_DG.LT.wSectorSize)) == NULL || (m_pUndo = (BYTE*)malloc(dwBytes)) == NULL)
+    {
+        free(m_pGAT);
+        m_pGAT = NULL;
+        return ERROR_OUTOFMEMORY;
+    }
+
+    // The granules of the directory on disk are not reused before it is replaced
+    memcpy(m_pGAT, m_pDir, m_DG.LT.wSectorSize);
+
+    m_bHold = true;
+    m_bDirty = false;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write the directory once, if it changed while held
+//---------------------------------------------------------------------------------
+
+DWORD CND::Commit()
+{
+
+    if (!m_bHold)
+        return NO_ERROR;
+
+    m_bHold = false;
+
+    free(m_pGAT);
+    free(m_pUndo);
+    m_pGAT = m_pUndo = NULL;
+
+    return (m_bDirty ? DirRW(ND_DIR_WRITE) : NO_ERROR);
+
+}
+
+//---------------------------------------------------------------------------------
+// Discard the directory changes held since Hold()
+//---------------------------------------------------------------------------------
+
+DWORD CND::Drop()
+{
+
+    if (!m_bHold)
+        return NO_ERROR;
+
+    m_bHold = false;
+
+    free(m_pGAT);
+    free(m_pUndo);
+    m_pGAT = m_pUndo = NULL;
+
+    // The disk still holds the directory as of Hold()
+    return DirRW(ND_DIR_READ);
+
+}
+
+//---------------------------------------------------------------------------------
+// Return the number of free directory entries
+//---------------------------------------------------------------------------------
+
+DWORD CND::Entries(DWORD& dwEntries)
+{
+
+    int nCols = m_nDirSectors - 2;
+    int nRows = m_DG.LT.wSectorSize / sizeof(ND_FPDE);
+
+    dwEntries = 0;
+
+    // Count the empty slots of the HIT, as GetFDE() scans them
+    for (int nRow = 0; nRow < nRows; nRow++)
+    {
+        for (int nCol = 0; nCol < nCols; nCol++)
+        {
+            // The 32nd byte of a NewDOS/80 HIT contains the count of extra FDE sectors
+            if (nRow * sizeof(ND_FPDE) + nCol == 31)
+                continue;
+            if (m_pDir[m_DG.LT.wSectorSize + (nRow << 5) + nCol] == 0)
+                dwEntries++;
+        }
+    }
+
+    return NO_ERROR;
+
+}
+
 //---------------------------------------------------------------------------------
 
 DWORD CND::GetFileSize(void* pFile)
@@ -739,6 +914,21 @@ DWORD CND::DirRW(ND_DIR nMode)
     DWORD   dwOffset = 0;
     DWORD   dwError = NO_ERROR;
 
+    // While held, the directory is only written by Commit() (a read drops the held changes)
+    if (m_bHold && nMode == ND_DIR_WRITE)
+    {
+        m_bDirty = true;
+        return NO_ERROR;
+    }
+
+    m_bDirty = false;
+
+    STAT_COUNT(nMode == ND_DIR_WRITE ? STAT_DIR_WRITE : STAT_DIR_READ);
+    STAT_PHASE(nMode == ND_DIR_WRITE ? STAT_PHASE_COMMIT : STAT_PHASE_DIR);
+
+    if (nMode != ND_DIR_WRITE)
+        m_qwDirRead = 0;
+
     // Go through every relative sector
     for (BYTE nIndex = 0; nIndex < m_nDirSectors; nIndex++)
     {
@@ -748,14 +938,18 @@ DWORD CND::DirRW(ND_DIR nMode)
 
         // Read or write the sector according to the requested mode
         if (nMode == ND_DIR_WRITE)
-        {
+        {   // Sectors never referenced have not been read yet
+            if ((dwError = DirSector(nIndex)) != NO_ERROR)
+                break;
             if ((dwError = m_pVDI->Write(nTrack, nSide, nSector, &m_pDir[dwOffset], m_DG.LT.wSectorSize)) != NO_ERROR)
                 break;
         }
-        else
+        else if (nMode == ND_DIR_READ || nIndex < 2 || m_nDirSectors > 64)
         {
             if ((dwError = m_pVDI->Read(nTrack, nSide, nSector, &m_pDir[dwOffset], m_DG.LT.wSectorSize)) != NO_ERROR)
                 break;
+            if (nIndex < 64)
+                m_qwDirRead |= (1ULL << nIndex);
         }
 
         // Advance buffer pointer
@@ -767,6 +961,31 @@ DWORD CND::DirRW(ND_DIR nMode)
 
 }
 
+//---------------------------------------------------------------------------------
+// Read a directory sector on first use (nIndex counts from the GAT)
+//---------------------------------------------------------------------------------
+
+DWORD CND::DirSector(BYTE nIndex)
+{
+
+    BYTE    nTrack;
+    BYTE    nSide;
+    BYTE    nSector;
+    DWORD   dwError = NO_ERROR;
+
+    // Outside the directory, or already in memory
+    if (nIndex >= m_nDirSectors || nIndex >= 64 || (m_qwDirRead & (1ULL << nIndex)) != 0)
+        return NO_ERROR;
+
+    CHS(m_wDirSector + nIndex, nTrack, nSide, nSector);
+
+    if ((dwError = m_pVDI->Read(nTrack, nSide, nSector, &m_pDir[nIndex * m_DG.LT.wSectorSize], m_DG.LT.wSectorSize)) == NO_ERROR)
+        m_qwDirRead |= (1ULL << nIndex);
+
+    return dwError;
+
+}
+
 //---------------------------------------------------------------------------------
 // Check the directory structure
 //---------------------------------------------------------------------------------
@@ -845,25 +1064,24 @@ DWORD CND::CheckDir(void)
 DWORD CND::ScanHIT(void** pFile, ND_HIT nMode, BYTE nHash)
 {
 
-    static int nLastCol = -1;
-    static int nLastRow = 0;
-
     int nCols, nCol;
     int nRows, nRow;
     int nSlot;
 
+    STAT_COUNT(STAT_HIT_SCAN);
+
     DWORD dwError = NO_ERROR;
 
-    // If mode is any "Find First", reset static variables
+    // If mode is any "Find First", reset the scan position
     if (nMode != ND_HIT_FIND_NEXT_USED)
     {
-        nLastCol = -1;
-        nLastRow = 0;
+        m_nLastCol = -1;
+        m_nLastRow = 0;
     }
 
-    // Retrieve last values from static variables
-    nCol = nLastCol;
-    nRow = nLastRow;
+    // Retrieve the last scan position
+    nCol = m_nLastCol;
+    nRow = m_nLastRow;
 
     // Calculates max HIT columns and rows
     nCols = m_nDirSectors - 2;
@@ -898,8 +1116,8 @@ DWORD CND::ScanHIT(void** pFile, ND_HIT nMode, BYTE nHash)
         if (nRow * sizeof(ND_FPDE) + nCol == 31)
             continue;
 
-        // Get value in HIT[Row * Cols + Col]
-        nSlot = m_pDir[m_DG.LT.wSectorSize + (nRow * nCols) + nCol];
+        // Get value in HIT[DEC] (rows are always 32 bytes apart, whatever the count of directory sectors)
+        nSlot = m_pDir[m_DG.LT.wSectorSize + (nRow << 5) + nCol];
 
         // If this is not what we are looking for, skip to the next
         if ((nMode == ND_HIT_FIND_FIRST_FREE && nSlot != 0) || (nMode != ND_HIT_FIND_FIRST_FREE && nSlot == 0))
@@ -917,9 +1135,9 @@ DWORD CND::ScanHIT(void** pFile, ND_HIT nMode, BYTE nHash)
 
     }
 
-    // Update static variables
-    nLastCol = nCol;
-    nLastRow = nRow;
+    // Update the scan position
+    m_nLastCol = nCol;
+    m_nLastRow = nRow;
 
     return dwError;
 
@@ -951,7 +1169,7 @@ DWORD CND::CreateExtent(ND_EXTENT& Extent, BYTE nGranules)
     {
 
         // Test state of 'CurrentGranule' at GAT[CurrentCylinder]
-        while ((m_pDir[nCurrentLump] & (1 << nCurrentGranule)) != nExpectedBit)
+        while (Used(nCurrentLump, nCurrentGranule) != nExpectedBit)
         {
 
             // Check if we are in the "continue up to the first non-empty slot" phase
@@ -1012,6 +1230,20 @@ DWORD CND::CreateExtent(ND_EXTENT& Extent, BYTE nGranules)
 
 }
 
+//---------------------------------------------------------------------------------
+// Whether a granule is taken, in the directory in memory or (while held) in the one on disk
+//---------------------------------------------------------------------------------
+
+bool CND::Used(BYTE nLump, BYTE nGranule)
+{
+
+    if ((m_pDir[nLump] >> nGranule) & 1)
+        return true;
+
+    return (m_bHold && ((m_pGAT[nLump] >> nGranule) & 1));
+
+}
+
 //---------------------------------------------------------------------------------
 // Release disk space
 //---------------------------------------------------------------------------------
@@ -1067,6 +1299,8 @@ DWORD CND::CopyExtent(void* pFile, ND_EXT nMode, BYTE nExtent, ND_EXTENT& Extent
     ND_EXTENT*  pExtent;
     DWORD       dwError = NO_ERROR;
 
+    STAT_COUNT(STAT_EXTENT);
+
     // Go through the extents table
     for (int x = 1, y = 1; x < 6; x++)
     {
@@ -1157,6 +1391,10 @@ void* CND::DEC2FDE(BYTE nDEC)
     DWORD dwSectorOffset = ((nDEC & ND_DEC_SECTOR) + 2) * m_DG.LT.wSectorSize;
     DWORD dwEntryOffset = ((nDEC & ND_DEC_ENTRY) >> 5) * sizeof(ND_FPDE);
 
+    // The entries are read on first use
+    if ((nDEC & ND_DEC_SECTOR) < m_nDirSectors && DirSector((nDEC & ND_DEC_SECTOR) + 2) != NO_ERROR)
+        return NULL;
+
     return ((nDEC & ND_DEC_SECTOR) < m_nDirSectors ? &m_pDir[dwSectorOffset + dwEntryOffset] : NULL);
 
 }
@@ -1225,7 +1463,7 @@ void CND::CHS(WORD wSector, BYTE& nTrack, BYTE& nSide, BYTE& nSector)
 char* CND::TI(WORD wTI)
 {
 
-    static char szTI[23];
+    char*   szTI = m_szTI;
 
     szTI[0] = 0;
 
@@ -83,7 +83,8 @@
 enum    ND_DIR                                                                      // Directory enumerator
 {
     ND_DIR_READ,                                                                    // Read Directory
-    ND_DIR_WRITE                                                                    // Write Directory
+    ND_DIR_WRITE,                                                                   // Write Directory
+    ND_DIR_OPEN                                                                     // Read GAT and HIT only (the entries are read on first use)
 };
 
 enum    ND_HIT                                                                      // Hash Index Table enumerator
@@ -167,6 +168,11 @@ protected:
     BYTE*           m_pDir;                                                         // Pointer to buffer containing disk directory
     WORD            m_wDirSector;                                                   // Directory relative sector
     BYTE            m_nDirSectors;                                                  // Number of directory sectors
+    unsigned long long m_qwDirRead;                                                 // Directory sectors read so far (one bit each)
+    bool            m_bHold;                                                        // Directory writes wait for Commit()
+    bool            m_bDirty;                                                       // The directory changed while held
+    BYTE*           m_pGAT;                                                         // GAT as of Hold(), its granules stay taken until Commit()
+    BYTE*           m_pUndo;                                                        // Directory before the current change, while held
     BYTE            m_nSides;                                                       // Number of disk sides
     VDI_DENSITY     m_nDensity;                                                     // Disk density
     DWORD           m_dwFilePos;                                                    // Current file position - Seek()
@@ -184,6 +190,9 @@ protected:
     BYTE            m_nTSR;                                                         // Track Stepping Rate (TSR)
     WORD            m_wTI;                                                          // Type of Interface (TI)
     BYTE            m_nTD;                                                          // Type of Drive (TD)
+    int             m_nLastCol;                                                     // Last HIT column returned - ScanHIT()
+    int             m_nLastRow;                                                     // Last HIT row returned - ScanHIT()
+    char            m_szTI[23];                                                     // Printable TI string - TI()
 public:
                     CND();                                                          // Initialize member variables
     virtual         ~CND();                                                         // Release allocated memory
@@ -193,6 +202,12 @@ public:
     virtual DWORD   Create(void** pFile, OSI_FILE& File);                           // Create a new file with the indicated properties
     virtual DWORD   Seek(void* pFile, DWORD dwPos);                                 // Move the file pointer
     virtual DWORD   Read(void* pFile, BYTE* pBuffer, DWORD& dwBytes);               // Read data from file
+    virtual DWORD   Where(void* pFile, DWORD dwPos, BYTE& nTrack, BYTE& nSide, BYTE& nSector); // Track/Side/Sector holding a file position
+    virtual DWORD   Free(DWORD& dwGranule, DWORD& dwGranules);                      // Granule size (bytes) and number of free granules
+    virtual DWORD   Hold();                                                         // Keep the directory writes in memory until Commit()
+    virtual DWORD   Commit();                                                       // Write the directory once, if it changed while held
+    virtual DWORD   Drop();                                                         // Discard the directory changes held since Hold()
+    virtual DWORD   Entries(DWORD& dwEntries);                                      // Number of free directory entries
     virtual DWORD   Write(void* pFile, BYTE* pBuffer, DWORD& dwBytes);              // Save data to file
     virtual DWORD   Delete(void* pFile);                                            // Delete the file
     virtual void    GetDOS(OSI_DOS& DOS);                                           // Get DOS information
@@ -203,8 +218,10 @@ protected:
     virtual DWORD   SetFile(void* pFile, OSI_FILE& File, bool bCommit);             // Set the file properties (protected)
     virtual DWORD   GetFileSize(void* pFile);                                       // Get file size
     virtual DWORD   DirRW(ND_DIR nMode);                                            // Read or Write the entire directory
+    virtual DWORD   DirSector(BYTE nIndex);                                         // Read a directory sector on first use
     virtual DWORD   CheckDir(void);                                                 // Check the directory structure
     virtual DWORD   ScanHIT(void** pFile, ND_HIT nMode, BYTE nHash = 0);            // Scan the Hash Index Table
+    virtual bool    Used(BYTE nLump, BYTE nGranule);                                // Whether a granule is taken (now or as of Hold())
     virtual DWORD   CreateExtent(ND_EXTENT& Extent, BYTE nGranules);                // Allocate disk space
     virtual DWORD   DeleteExtent(ND_EXTENT& Extent);                                // Release disk space
     virtual DWORD   CopyExtent(void* pFile, ND_EXT nMode, BYTE nExtent, ND_EXTENT& Extent); // Get or Set extent data
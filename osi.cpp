@@ -44,3 +44,33 @@ COSI::COSI()
 COSI::~COSI()
 {
 }
+
+DWORD COSI::Where(void* pFile, DWORD dwPos, BYTE& nTrack, BYTE& nSide, BYTE& nSector)
+{
+    return ERROR_NOT_SUPPORTED;
+}
+
+DWORD COSI::Free(DWORD& dwGranule, DWORD& dwGranules)
+{
+    return ERROR_NOT_SUPPORTED;
+}
+
+DWORD COSI::Hold()
+{
+    return ERROR_NOT_SUPPORTED;
+}
+
+DWORD COSI::Commit()
+{
+    return NO_ERROR;
+}
+
+DWORD COSI::Drop()
+{
+    return NO_ERROR;
+}
+
+DWORD COSI::Entries(DWORD& dwEntries)
+{
+    return ERROR_NOT_SUPPORTED;
+}
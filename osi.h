@@ -70,6 +70,7 @@ struct  OSI_FILE
     bool        bSystem;                                                            // System attribute (true:System, false:Normal)
     bool        bInvisible;                                                         // Invisible attribute (true:Invisible, false:Visible)
     bool        bModified;                                                          // Backup Pending attribute (true:Pending, false:Not pending)
+    BYTE        nLRL;                                                               // Logical Record Length (0:256 bytes)
 };
 
 class   COSI
@@ -87,6 +88,12 @@ public:
     virtual DWORD   Create(void** pFile, OSI_FILE& File)=0;                         // Create a new file with the indicated properties
     virtual DWORD   Seek(void* pFile, DWORD dwPos)=0;                               // Move the file pointer
     virtual DWORD   Read(void* pFile, BYTE* pBuffer, DWORD& dwBytes)=0;             // Read data from file
+    virtual DWORD   Where(void* pFile, DWORD dwPos, BYTE& nTrack, BYTE& nSide, BYTE& nSector); // Track/Side/Sector holding a file position
+    virtual DWORD   Free(DWORD& dwGranule, DWORD& dwGranules);                      // Granule size (bytes) and number of free granules
+    virtual DWORD   Hold();                                                         // Keep the directory writes in memory until Commit()
+    virtual DWORD   Commit();                                                       // Write the directory once, if it changed while held
+    virtual DWORD   Drop();                                                         // Discard the directory changes held since Hold()
+    virtual DWORD   Entries(DWORD& dwEntries);                                      // Number of free directory entries
     virtual DWORD   Write(void* pFile, BYTE* pBuffer, DWORD& dwBytes)=0;            // Save data to file
     virtual DWORD   Delete(void* pFile)=0;                                          // Delete the file
     virtual void    GetDOS(OSI_DOS& DOS)=0;                                         // Get DOS information
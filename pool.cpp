@@ -0,0 +1,338 @@
+/**
+ @file pool.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Pool of writer threads that save decoded files to the host
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "stats.h"
+#include "pool.h"
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CPool::CPool()
+:   m_pHead(NULL), m_pTail(NULL), m_pNext(NULL), m_dwPending(0), m_dwBudget(0), m_bStop(false), m_nThreads(0)
+{
+    pthread_mutex_init(&m_Mutex, NULL);
+    pthread_cond_init(&m_Cond, NULL);
+}
+
+//---------------------------------------------------------------------------------
+// Stop the writer threads and release any job left behind
+//---------------------------------------------------------------------------------
+
+CPool::~CPool()
+{
+
+    POOL_JOB*   pJob;
+
+    End();
+
+    while ((pJob = Retire(false)) != NULL)
+    {
+        if (pJob->pBuffer != NULL)
+            free(pJob->pBuffer);
+        free(pJob->pRuns);
+        free(pJob);
+    }
+
+    pthread_cond_destroy(&m_Cond);
+    pthread_mutex_destroy(&m_Mutex);
+
+}
+
+//---------------------------------------------------------------------------------
+// Start the writer threads
+//---------------------------------------------------------------------------------
+
+DWORD CPool::Begin(int nThreads, DWORD dwBudget)
+{
+
+    DWORD   dwError = NO_ERROR;
+
+    m_dwBudget = dwBudget;
+    m_bStop = false;
+
+    // Keep the number of threads within limits
+    if (nThreads < 1)
+        nThreads = 1;
+    else if (nThreads > POOL_MAX_THREADS)
+        nThreads = POOL_MAX_THREADS;
+
+    // Start as many threads as possible up to the requested number
+    for (m_nThreads = 0; m_nThreads < nThreads; m_nThreads++)
+    {
+        if (pthread_create(&m_hThreads[m_nThreads], NULL, Writer, this) != 0)
+            break;
+    }
+
+    // At least one thread is needed
+    if (m_nThreads == 0)
+        dwError = ERROR_OUTOFMEMORY;
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Let the writer threads complete the pending jobs and wait for them
+//---------------------------------------------------------------------------------
+
+void CPool::End()
+{
+
+    pthread_mutex_lock(&m_Mutex);
+    m_bStop = true;
+    pthread_cond_broadcast(&m_Cond);
+    pthread_mutex_unlock(&m_Mutex);
+
+    for (int x = 0; x < m_nThreads; x++)
+        pthread_join(m_hThreads[x], NULL);
+
+    m_nThreads = 0;
+
+}
+
+//---------------------------------------------------------------------------------
+// Check whether a job of the given size fits the memory budget
+//---------------------------------------------------------------------------------
+
+bool CPool::Fits(DWORD dwSize)
+{
+
+    bool    bFits;
+
+    pthread_mutex_lock(&m_Mutex);
+    bFits = (m_dwPending + sizeof(POOL_JOB) + dwSize <= m_dwBudget);
+    pthread_mutex_unlock(&m_Mutex);
+
+    return bFits;
+
+}
+
+//---------------------------------------------------------------------------------
+// Check whether every submitted job has been retired
+//---------------------------------------------------------------------------------
+
+bool CPool::Empty()
+{
+
+    bool    bEmpty;
+
+    pthread_mutex_lock(&m_Mutex);
+    bEmpty = (m_pHead == NULL);
+    pthread_mutex_unlock(&m_Mutex);
+
+    return bEmpty;
+
+}
+
+//---------------------------------------------------------------------------------
+// Append a job to the list and wake up a writer thread
+//---------------------------------------------------------------------------------
+
+void CPool::Submit(POOL_JOB* pJob)
+{
+
+    pJob->bDone = false;
+    pJob->pNext = NULL;
+#ifdef V80_STATS
+    memset(&pJob->Stats, 0, sizeof(pJob->Stats));
+#endif
+
+    pthread_mutex_lock(&m_Mutex);
+
+    // Append the job to the list
+    if (m_pTail != NULL)
+        m_pTail->pNext = pJob;
+    else
+        m_pHead = pJob;
+
+    m_pTail = pJob;
+
+    // Make it the next one for the writers if they have caught up
+    if (m_pNext == NULL)
+        m_pNext = pJob;
+
+    m_dwPending += Held(pJob);
+
+    pthread_cond_broadcast(&m_Cond);
+    pthread_mutex_unlock(&m_Mutex);
+
+}
+
+//---------------------------------------------------------------------------------
+// Remove the oldest job from the list once completed, so results follow submission order
+//---------------------------------------------------------------------------------
+
+POOL_JOB* CPool::Retire(bool bWait)
+{
+
+    POOL_JOB*   pJob = NULL;
+
+    pthread_mutex_lock(&m_Mutex);
+
+    // Optionally wait for the oldest job to be completed
+    while (bWait && m_pHead != NULL && !m_pHead->bDone && m_nThreads > 0)
+        pthread_cond_wait(&m_Cond, &m_Mutex);
+
+    // Unlink it from the list
+    if (m_pHead != NULL && (m_pHead->bDone || m_nThreads == 0))
+    {
+
+        pJob = m_pHead;
+
+        if ((m_pHead = pJob->pNext) == NULL)
+            m_pTail = NULL;
+
+        if (m_pNext == pJob)
+            m_pNext = pJob->pNext;
+
+        m_dwPending -= Held(pJob);
+
+    }
+
+    pthread_mutex_unlock(&m_Mutex);
+
+#ifdef V80_STATS
+    // Account for the writer's work on the retiring thread, which prints the statistics
+    if (pJob != NULL)
+        StatMerge(pJob->Stats);
+#endif
+
+    return pJob;
+
+}
+
+//---------------------------------------------------------------------------------
+// Memory a job holds until retired (its contents, or the map of its data in the image file)
+//---------------------------------------------------------------------------------
+
+DWORD CPool::Held(POOL_JOB* pJob)
+{
+    return sizeof(POOL_JOB) + (pJob->pImage != NULL ? pJob->dwRuns * sizeof(IMAGE_RUN) : pJob->dwSize);
+}
+
+//---------------------------------------------------------------------------------
+// Writer thread: create and write host files until the pool is stopped
+//---------------------------------------------------------------------------------
+
+void* CPool::Writer(void* pParam)
+{
+
+    CPool*      pPool = (CPool*)pParam;
+    POOL_JOB*   pJob;
+    FILE*       hFile;
+    DWORD       dwBytes;
+
+    pthread_mutex_lock(&pPool->m_Mutex);
+
+    while (true)
+    {
+
+        // Wait for a job, exiting once stopped and nothing is left
+        if ((pJob = pPool->m_pNext) == NULL)
+        {
+            if (pPool->m_bStop)
+                break;
+            pthread_cond_wait(&pPool->m_Cond, &pPool->m_Mutex);
+            continue;
+        }
+
+        // Take the job
+        pPool->m_pNext = pJob->pNext;
+
+        pthread_mutex_unlock(&pPool->m_Mutex);
+
+#ifdef V80_STATS
+        StatReset();
+#endif
+
+        // Jobs that have already failed only need to be reported
+        if (pJob->dwError == NO_ERROR)
+        {
+
+            // Create the host file
+            if ((hFile = fopen(pJob->szFile, "w")) == NULL)
+                pJob->dwError = ERROR_FILE_NOT_FOUND;
+
+            // Copy the file data from the image file
+            else if (pJob->pImage != NULL)
+            {
+                pJob->dwError = pJob->pImage->Copy(pJob->pRuns, pJob->dwRuns, fileno(hFile), pJob->bBad, dwBytes);
+
+                if (fclose(hFile) != 0 && pJob->dwError == NO_ERROR)
+                    pJob->dwError = ERROR_WRITE_FAULT;
+
+                // Do not leave a truncated copy behind
+                if (pJob->dwError != NO_ERROR)
+                    remove(pJob->szFile);
+            }
+
+            // Write the file contents
+            else
+            {
+                if (fwrite(pJob->pBuffer, 1, pJob->dwSize, hFile) != pJob->dwSize)
+                    pJob->dwError = ERROR_WRITE_FAULT;
+
+                if (fclose(hFile) != 0 && pJob->dwError == NO_ERROR)
+                    pJob->dwError = ERROR_WRITE_FAULT;
+
+                // Do not leave a truncated copy behind
+                if (pJob->dwError != NO_ERROR)
+                    remove(pJob->szFile);
+            }
+
+        }
+
+#ifdef V80_STATS
+        // Hand the counters over with the job
+        StatTake(pJob->Stats);
+#endif
+
+        pthread_mutex_lock(&pPool->m_Mutex);
+
+        // Mark the job as completed
+        pJob->bDone = true;
+        pthread_cond_broadcast(&pPool->m_Cond);
+
+    }
+
+    pthread_mutex_unlock(&pPool->m_Mutex);
+
+    return NULL;
+
+}
@@ -0,0 +1,84 @@
+/**
+ @file pool.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Pool of writer threads that save decoded files to the host
+//---------------------------------------------------------------------------------
+
+#include <pthread.h>
+
+class   CImage;
+struct  IMAGE_RUN;
+
+#define POOL_MAX_THREADS    64                                                      // Upper limit for the number of writer threads
+
+struct  POOL_JOB                                                                    // Host file write request
+{
+    char        szTRSFile[13];                                                      // Disk filename (for the log)
+    char        szFile[MAX_PATH];                                                   // Host filename
+    BYTE*       pBuffer;                                                            // File contents
+    CImage*     pImage;                                                             // Image to copy the file data from (NULL: the data is in pBuffer)
+    IMAGE_RUN*  pRuns;                                                              // Byte ranges of the image file holding the data
+    DWORD       dwRuns;                                                             // Number of byte ranges
+    bool        bBad;                                                               // Zero-fill what the image file lacks (reading bad files)
+    DWORD       dwSize;                                                             // File size
+    DWORD       dwError;                                                            // Result (set by the producer when it couldn't read the file)
+    bool        bDone;                                                              // Job has been completed by a writer thread
+#ifdef V80_STATS
+    STAT_DATA   Stats;                                                              // Counters and phase times of the writer thread for this job
+#endif
+    POOL_JOB*   pNext;                                                              // Next job in submission order
+};
+
+class   CPool
+{
+protected:
+    POOL_JOB*       m_pHead;                                                        // Oldest job not yet retired
+    POOL_JOB*       m_pTail;                                                        // Most recently submitted job
+    POOL_JOB*       m_pNext;                                                        // Oldest job not yet taken by a writer thread
+    DWORD           m_dwPending;                                                    // Memory held by jobs not yet retired
+    DWORD           m_dwBudget;                                                     // Memory limit for jobs not yet retired
+    bool            m_bStop;                                                        // No more jobs will be submitted
+    int             m_nThreads;                                                     // Number of writer threads running
+    pthread_t       m_hThreads[POOL_MAX_THREADS];                                   // Writer thread handles
+    pthread_mutex_t m_Mutex;                                                        // Protects the job list
+    pthread_cond_t  m_Cond;                                                         // Signals new or completed jobs
+public:
+    CPool();
+    ~CPool();
+    DWORD       Begin(int nThreads, DWORD dwBudget);                                // Start the writer threads
+    void        End();                                                              // Let the writer threads finish and wait for them
+    bool        Fits(DWORD dwSize);                                                 // Check whether a new job fits the memory budget
+    bool        Empty();                                                            // Check whether every job has been retired
+    void        Submit(POOL_JOB* pJob);                                             // Queue a job for the writer threads
+    POOL_JOB*   Retire(bool bWait);                                                 // Remove the oldest job once it is completed (NULL if none)
+protected:
+    static DWORD    Held(POOL_JOB* pJob);                                           // Memory a job holds until retired
+    static void*    Writer(void* pParam);                                           // Writer thread
+};
@@ -0,0 +1,250 @@
+/**
+ @file search.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Multi-pattern byte string search (Aho-Corasick)
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdlib.h>
+#include <string.h>
+#include "search.h"
+
+//---------------------------------------------------------------------------------
+// Start with no patterns (the root state only)
+//---------------------------------------------------------------------------------
+
+CSearch::CSearch()
+: m_pNext(NULL), m_pOut(NULL), m_pMatch(NULL), m_pLength(NULL), m_dwStates(0), m_dwPatterns(0), m_nFirst(-1), m_bBuilt(false)
+{
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CSearch::~CSearch()
+{
+    free(m_pNext);
+    free(m_pOut);
+    free(m_pMatch);
+    free(m_pLength);
+}
+
+//---------------------------------------------------------------------------------
+// Add a pattern to the trie (a repeated pattern is only reported once)
+//---------------------------------------------------------------------------------
+
+DWORD CSearch::Add(const BYTE* pPattern, DWORD dwLength)
+{
+
+    DWORD*  pMore;
+    DWORD   dwState = 0;
+    DWORD   dwError;
+
+    if (m_bBuilt || dwLength == 0)
+        return ERROR_INVALID_PARAMETER;
+
+    if (m_dwStates == 0 && (dwError = Grow(1)) != NO_ERROR)
+        return dwError;
+
+    if ((pMore = (DWORD*)realloc(m_pLength, (m_dwPatterns + 1) * sizeof(DWORD))) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    m_pLength = pMore;
+
+    for (DWORD x = 0; x < dwLength; x++)
+    {
+
+        // A new state for the bytes the trie doesn't have yet (no edge leads back to the root)
+        if (m_pNext[dwState * SEARCH_BYTES + pPattern[x]] == 0)
+        {
+            if ((dwError = Grow(m_dwStates + 1)) != NO_ERROR)
+                return dwError;
+            m_pNext[dwState * SEARCH_BYTES + pPattern[x]] = m_dwStates - 1;
+        }
+
+        dwState = m_pNext[dwState * SEARCH_BYTES + pPattern[x]];
+
+    }
+
+    if (m_pMatch[dwState] == -1)
+        m_pMatch[dwState] = m_dwPatterns;
+
+    // The memchr skip works while every pattern starts with the same byte
+    m_nFirst = (m_dwPatterns == 0 || m_nFirst == pPattern[0] ? pPattern[0] : -1);
+
+    m_pLength[m_dwPatterns++] = dwLength;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Compile the trie into a complete automaton (breadth first, shallow states first)
+//---------------------------------------------------------------------------------
+
+DWORD CSearch::Build()
+{
+
+    DWORD*  pFail;
+    DWORD*  pQueue;
+    DWORD   dwHead = 0;
+    DWORD   dwTail = 0;
+    DWORD   dwState;
+    DWORD   dwChild;
+
+    if (m_dwPatterns == 0)
+        return ERROR_INVALID_PARAMETER;
+
+    if ((pFail = (DWORD*)calloc(m_dwStates, sizeof(DWORD))) == NULL || (pQueue = (DWORD*)malloc(m_dwStates * sizeof(DWORD))) == NULL)
+    {
+        free(pFail);
+        return ERROR_OUTOFMEMORY;
+    }
+
+    // The children of the root fail to the root
+    for (int c = 0; c < SEARCH_BYTES; c++)
+    {
+        if ((dwChild = m_pNext[c]) != 0)
+            pQueue[dwTail++] = dwChild;
+    }
+
+    while (dwHead < dwTail)
+    {
+
+        dwState = pQueue[dwHead++];
+
+        // Patterns ending on the failure chain end here too
+        m_pOut[dwState] = (m_pMatch[pFail[dwState]] != -1 ? pFail[dwState] : m_pOut[pFail[dwState]]);
+
+        // Missing transitions are those of the failure state (whose row is already complete)
+        for (int c = 0; c < SEARCH_BYTES; c++)
+        {
+            if ((dwChild = m_pNext[dwState * SEARCH_BYTES + c]) != 0)
+            {
+                pFail[dwChild] = m_pNext[pFail[dwState] * SEARCH_BYTES + c];
+                pQueue[dwTail++] = dwChild;
+            }
+            else
+                m_pNext[dwState * SEARCH_BYTES + c] = m_pNext[pFail[dwState] * SEARCH_BYTES + c];
+        }
+
+    }
+
+    free(pQueue);
+    free(pFail);
+
+    m_bBuilt = true;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Search the next piece of a stream, reporting the matches that end in it
+//---------------------------------------------------------------------------------
+
+void CSearch::Scan(SEARCH_STATE& State, const BYTE* pData, size_t nBytes, SEARCH_HIT pHit, void* pParam) const
+{
+
+    const BYTE* pSkip;
+    DWORD       dwState = State.dwState;
+    DWORD       dwOut;
+
+    for (size_t x = 0; x < nBytes; x++)
+    {
+
+        // At the root, the bytes that can't start a pattern keep it there
+        if (dwState == 0 && m_nFirst != -1)
+        {
+            if ((pSkip = (const BYTE*)memchr(&pData[x], m_nFirst, nBytes - x)) == NULL)
+                break;
+            x = pSkip - pData;
+        }
+
+        dwState = m_pNext[dwState * SEARCH_BYTES + pData[x]];
+
+        for (dwOut = (m_pMatch[dwState] != -1 ? dwState : m_pOut[dwState]); dwOut != 0; dwOut = m_pOut[dwOut])
+            pHit(pParam, m_pMatch[dwOut], State.qwPos + x + 1 - m_pLength[m_pMatch[dwOut]]);
+
+    }
+
+    State.dwState = dwState;
+    State.qwPos += nBytes;
+
+}
+
+//---------------------------------------------------------------------------------
+// Number of patterns
+//---------------------------------------------------------------------------------
+
+DWORD CSearch::Patterns()
+{
+    return m_dwPatterns;
+}
+
+//---------------------------------------------------------------------------------
+// Make room for more states (new ones have no transitions and end no pattern)
+//---------------------------------------------------------------------------------
+
+DWORD CSearch::Grow(DWORD dwStates)
+{
+
+    DWORD*  pNext;
+    DWORD*  pOut;
+    int*    pMatch;
+
+    if ((pNext = (DWORD*)realloc(m_pNext, dwStates * SEARCH_BYTES * sizeof(DWORD))) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    m_pNext = pNext;
+
+    if ((pOut = (DWORD*)realloc(m_pOut, dwStates * sizeof(DWORD))) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    m_pOut = pOut;
+
+    if ((pMatch = (int*)realloc(m_pMatch, dwStates * sizeof(int))) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    m_pMatch = pMatch;
+
+    for (DWORD x = m_dwStates; x < dwStates; x++)
+    {
+        memset(&m_pNext[x * SEARCH_BYTES], 0, SEARCH_BYTES * sizeof(DWORD));
+        m_pOut[x] = 0;
+        m_pMatch[x] = -1;
+    }
+
+    m_dwStates = dwStates;
+
+    return NO_ERROR;
+
+}
@@ -0,0 +1,73 @@
+/**
+ @file search.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Multi-pattern byte string search (Aho-Corasick)
+//---------------------------------------------------------------------------------
+//
+// The patterns are compiled into a complete automaton (one transition per state
+// and byte value), so a stream is searched one table lookup per byte, in pieces of
+// any size, whatever the number of patterns. While no pattern is under way, memchr
+// skips to the next byte that can start one (when the patterns share it).
+//
+// A compiled search is read-only: threads share it, each with its own SEARCH_STATE.
+//
+//---------------------------------------------------------------------------------
+
+#define SEARCH_BYTES        256                                                     // Transitions per state
+
+struct  SEARCH_STATE                                                                // Position in a stream
+{
+    DWORD       dwState;                                                            // Automaton state (0: no pattern under way)
+    unsigned long long qwPos;                                                       // Bytes scanned so far
+};
+
+typedef void (*SEARCH_HIT)(void* pParam, DWORD dwPattern, unsigned long long qwOffset);  // Called for each match (offset of its first byte)
+
+class   CSearch
+{
+protected:
+    DWORD*      m_pNext;                                                            // Transitions (SEARCH_BYTES per state)
+    DWORD*      m_pOut;                                                             // Next state down the failure chain that ends a pattern (0: none)
+    int*        m_pMatch;                                                           // Pattern ending at each state (-1: none)
+    DWORD*      m_pLength;                                                          // Length of each pattern
+    DWORD       m_dwStates;                                                         // Number of states
+    DWORD       m_dwPatterns;                                                       // Number of patterns
+    int         m_nFirst;                                                           // Byte starting every pattern (-1: not the same one)
+    bool        m_bBuilt;                                                           // The automaton is complete (no more patterns)
+public:
+                CSearch();                                                          // Start with no patterns
+    virtual     ~CSearch();                                                         // Release allocated memory
+    DWORD       Add(const BYTE* pPattern, DWORD dwLength);                          // Add a pattern (before Build)
+    DWORD       Build();                                                            // Compile the patterns
+    void        Scan(SEARCH_STATE& State, const BYTE* pData, size_t nBytes, SEARCH_HIT pHit, void* pParam) const; // Search the next piece of a stream
+    DWORD       Patterns();                                                         // Number of patterns
+protected:
+    DWORD       Grow(DWORD dwStates);                                               // Make room for more states
+};
@@ -0,0 +1,686 @@
+/**
+ @file server.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Image server: answers requests from local clients over a Unix domain socket
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "cache.h"
+#include "server.h"
+
+// Set by SIGINT/SIGTERM to stop the server loop
+
+static volatile sig_atomic_t gbStop = 0;
+
+static void StopHandler(int nSignal)
+{
+    gbStop = 1;
+}
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CServer::CServer()
+:   m_hSocket(-1), m_nClients(0), m_dwClock(0), m_dwFlags(0), m_pVDIName(NULL), m_pOSIName(NULL)
+{
+    m_szPath[0] = 0;
+    memset(m_Images, 0, sizeof(m_Images));
+}
+
+//---------------------------------------------------------------------------------
+// Close the connections and release the images
+//---------------------------------------------------------------------------------
+
+CServer::~CServer()
+{
+    End();
+}
+
+//---------------------------------------------------------------------------------
+// Create the socket and listen on it
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Begin(const char* pPath, DWORD dwFlags, const char* pVDI, const char* pOSI)
+{
+
+    sockaddr_un         Addr;
+    struct sigaction    Action;
+    struct stat         st;
+    DWORD               dwError = NO_ERROR;
+
+    m_dwFlags = dwFlags;
+    m_pVDIName = pVDI;
+    m_pOSIName = pOSI;
+
+    // Check whether the path fits the socket address
+    if (strlen(pPath) >= sizeof(Addr.sun_path))
+    {
+        dwError = ERROR_INVALID_NAME;
+        goto Done;
+    }
+
+    // Remove a socket left behind by a previous server (never a regular file)
+    if (stat(pPath, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(pPath);
+
+    if ((m_hSocket = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        perror("socket");
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sun_family = AF_UNIX;
+    strcpy(Addr.sun_path, pPath);
+
+    if (bind(m_hSocket, (sockaddr*)&Addr, sizeof(Addr)) == -1 || listen(m_hSocket, SRV_MAX_CLIENTS) == -1)
+    {
+        perror(pPath);
+        close(m_hSocket);
+        m_hSocket = -1;
+        dwError = ERROR_INVALID_NAME;
+        goto Done;
+    }
+
+    strcpy(m_szPath, pPath);
+
+    // Stop on SIGINT/SIGTERM (without restarting poll) and report closed connections as errors
+    memset(&Action, 0, sizeof(Action));
+    Action.sa_handler = StopHandler;
+    sigemptyset(&Action.sa_mask);
+    sigaction(SIGINT, &Action, NULL);
+    sigaction(SIGTERM, &Action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Serve requests until SIGINT/SIGTERM
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Run()
+{
+
+    pollfd  Fds[SRV_MAX_CLIENTS + 1];
+    int     hClient;
+    DWORD   dwError = NO_ERROR;
+
+    if (m_hSocket == -1)
+        return ERROR_INVALID_PARAMETER;
+
+    while (!gbStop)
+    {
+
+        // Wait for new connections and for requests from the connected clients
+        Fds[0].fd = m_hSocket;
+        Fds[0].events = POLLIN;
+
+        for (int x = 0; x < m_nClients; x++)
+        {
+            Fds[x + 1].fd = m_hClients[x];
+            Fds[x + 1].events = POLLIN;
+        }
+
+        if (poll(Fds, m_nClients + 1, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            dwError = ERROR_NOT_SUPPORTED;
+            break;
+        }
+
+        // Answer one request per ready client, dropping the ones that hung up or misbehaved
+        for (int x = m_nClients - 1; x >= 0; x--)
+        {
+            if (Fds[x + 1].revents == 0)
+                continue;
+
+            if (Serve(m_hClients[x]) != NO_ERROR)
+            {
+                close(m_hClients[x]);
+                m_hClients[x] = m_hClients[--m_nClients];
+            }
+        }
+
+        // Accept a new connection if there is room for it
+        if (Fds[0].revents & POLLIN)
+        {
+            if ((hClient = accept(m_hSocket, NULL, NULL)) != -1)
+            {
+                if (m_nClients < SRV_MAX_CLIENTS)
+                    m_hClients[m_nClients++] = hClient;
+                else
+                    close(hClient);
+            }
+        }
+
+    }
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Close the connections, the socket and the images
+//---------------------------------------------------------------------------------
+
+void CServer::End()
+{
+
+    while (m_nClients > 0)
+        close(m_hClients[--m_nClients]);
+
+    if (m_hSocket != -1)
+    {
+        close(m_hSocket);
+        unlink(m_szPath);
+    }
+
+    m_hSocket = -1;
+
+    for (int x = 0; x < SRV_MAX_IMAGES; x++)
+        Evict(&m_Images[x]);
+
+}
+
+//---------------------------------------------------------------------------------
+// Answer one request from a client (an error means the connection must be closed)
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Serve(int hClient)
+{
+
+    SRV_REQUEST Req;
+    SRV_REPLY   Reply;
+    char*       pImage = NULL;
+    char*       pName;
+    char*       pNewName;
+    BYTE*       pData;
+    BYTE*       pReply = NULL;
+    DWORD       dwReply = 0;
+    DWORD       dwError = NO_ERROR;
+
+    // Receive the request header (a closed connection ends here)
+    if (!Recv(hClient, &Req, sizeof(Req)))
+    {
+        dwError = ERROR_HANDLE_EOF;
+        goto Done;
+    }
+
+    // A bad header means the stream is out of sync
+    if (Req.wMagic != SRV_MAGIC || Req.wImage >= MAX_PATH || Req.wName >= MAX_PATH || Req.wNewName >= MAX_PATH || Req.dwData > SRV_MAX_DATA)
+    {
+        dwError = ERROR_INVALID_PARAMETER;
+        goto Done;
+    }
+
+    // Receive the strings (NUL-terminated here) and the data into a single buffer
+    if ((pImage = (char*)malloc(Req.wImage + Req.wName + Req.wNewName + 3 + Req.dwData)) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    pName = &pImage[Req.wImage + 1];
+    pNewName = &pName[Req.wName + 1];
+    pData = (BYTE*)&pNewName[Req.wNewName + 1];
+
+    if (!Recv(hClient, pImage, Req.wImage) || !Recv(hClient, pName, Req.wName) || !Recv(hClient, pNewName, Req.wNewName) || !Recv(hClient, pData, Req.dwData))
+    {
+        dwError = ERROR_HANDLE_EOF;
+        goto Done;
+    }
+
+    pImage[Req.wImage] = 0;
+    pName[Req.wName] = 0;
+    pNewName[Req.wNewName] = 0;
+
+    // Execute the request and send the reply
+    Reply.dwError = Dispatch(Req, pImage, pName, pNewName, pData, pReply, dwReply);
+    Reply.dwLength = (Reply.dwError == NO_ERROR ? dwReply : 0);
+
+    if (!Send(hClient, &Reply, sizeof(Reply)) || !Send(hClient, pReply, Reply.dwLength))
+        dwError = ERROR_WRITE_FAULT;
+
+    Done:
+    free(pReply);
+    free(pImage);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Execute a request against its image
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Dispatch(SRV_REQUEST& Req, char* pImage, char* pName, char* pNewName, BYTE* pData, BYTE*& pReply, DWORD& dwReply)
+{
+
+    SRV_IMAGE*  pSlot;
+    DWORD       dwError;
+
+    if ((pSlot = Load(pImage, dwError)) == NULL)
+        return dwError;
+
+    switch (Req.nOp)
+    {
+        case SRV_OP_LIST:
+            return List(pSlot, Req.nFlags, pReply, dwReply);
+        case SRV_OP_GET:
+            return Get(pSlot, pName, pReply, dwReply);
+        case SRV_OP_PUT:
+            return Put(pSlot, Req.nFlags, pName, pData, Req.dwData);
+        case SRV_OP_RENAME:
+            return Rename(pSlot, pName, pNewName);
+        case SRV_OP_DELETE:
+            return Delete(pSlot, pName);
+        default:
+            return ERROR_NOT_SUPPORTED;
+    }
+
+}
+
+//---------------------------------------------------------------------------------
+// Return a loaded image, reloading it if the file has changed since it was loaded
+//---------------------------------------------------------------------------------
+
+SRV_IMAGE* CServer::Load(const char* pPath, DWORD& dwError)
+{
+
+    char        szPath[MAX_PATH];
+    char        szCache[MAX_PATH];
+    struct stat st;
+    SRV_IMAGE*  pSlot = NULL;
+
+    dwError = NO_ERROR;
+
+    if (realpath(pPath, szPath) == NULL || stat(szPath, &st) == -1)
+    {
+        dwError = ERROR_FILE_NOT_FOUND;
+        return NULL;
+    }
+
+    // Look for the image in the cache, otherwise take a free slot or the least recently used one
+    for (int x = 0; x < SRV_MAX_IMAGES; x++)
+    {
+        if (strcmp(m_Images[x].szPath, szPath) == 0)
+        {
+            pSlot = &m_Images[x];
+            break;
+        }
+
+        if (pSlot == NULL || (pSlot->szPath[0] != 0 && (m_Images[x].szPath[0] == 0 || m_Images[x].dwUsed < pSlot->dwUsed)))
+            pSlot = &m_Images[x];
+    }
+
+    pSlot->dwUsed = ++m_dwClock;
+
+    // Keep the cached image while the file is the same one and hasn't been modified
+    if (strcmp(pSlot->szPath, szPath) == 0 && pSlot->nDev == st.st_dev && pSlot->nIno == st.st_ino && pSlot->nSize == st.st_size &&
+        pSlot->tMTime.tv_sec == st.st_mtim.tv_sec && pSlot->tMTime.tv_nsec == st.st_mtim.tv_nsec)
+        return pSlot;
+
+    Evict(pSlot);
+
+    // Open the image and load its interfaces (and with them the directory)
+    if ((pSlot->pImage = new CImage()) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        return NULL;
+    }
+
+    if ((dwError = pSlot->pImage->Open(szPath, m_dwFlags)) != NO_ERROR)
+    {
+        Evict(pSlot);
+        return NULL;
+    }
+
+    // Reuse the formats detected by a previous load (next to the image, or in $V80_CACHE)
+    if (m_dwFlags & V80_FLAG_CACHE)
+    {
+        CCache::Name(szPath, getenv("V80_CACHE"), szCache, sizeof(szCache));
+        pSlot->pImage->Cache(szCache);
+    }
+
+    if ((dwError = pSlot->pImage->Probe(m_pVDIName, m_pOSIName)) != NO_ERROR)
+    {
+        Evict(pSlot);
+        return NULL;
+    }
+
+    // Remember which file has been loaded (taken before opening it, so a concurrent change forces a reload)
+    strcpy(pSlot->szPath, szPath);
+    pSlot->nDev = st.st_dev;
+    pSlot->nIno = st.st_ino;
+    pSlot->nSize = st.st_size;
+    pSlot->tMTime = st.st_mtim;
+
+    return pSlot;
+
+}
+
+//---------------------------------------------------------------------------------
+// Flush a modified image and take its new identity, so our own writes don't force a reload
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Commit(SRV_IMAGE* pSlot)
+{
+
+    struct stat st;
+    DWORD       dwError;
+
+    if ((dwError = pSlot->pImage->Flush()) != NO_ERROR || stat(pSlot->szPath, &st) == -1)
+    {
+        Evict(pSlot);
+        return (dwError != NO_ERROR ? dwError : ERROR_FILE_NOT_FOUND);
+    }
+
+    pSlot->nSize = st.st_size;
+    pSlot->tMTime = st.st_mtim;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Release a cached image
+//---------------------------------------------------------------------------------
+
+void CServer::Evict(SRV_IMAGE* pSlot)
+{
+
+    delete pSlot->pImage;
+
+    pSlot->pImage = NULL;
+    pSlot->szPath[0] = 0;
+
+}
+
+//---------------------------------------------------------------------------------
+// SRV_OP_LIST: return the directory as an array of SRV_ENTRY
+//---------------------------------------------------------------------------------
+
+DWORD CServer::List(SRV_IMAGE* pSlot, BYTE nFlags, BYTE*& pReply, DWORD& dwReply)
+{
+
+    OSI_FILE    File;
+    SRV_ENTRY*  pEntry;
+    void*       pFile = NULL;
+    DWORD       dwMax = 0;
+    DWORD       dwError;
+
+    while ((dwError = pSlot->pImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == NO_ERROR)
+    {
+
+        // Compare file attributes against the request
+        if ((File.bSystem && !(nFlags & SRV_FLAG_SYSTEM)) || (File.bInvisible && !(nFlags & SRV_FLAG_INVISIBLE)))
+            continue;
+
+        // Grow the reply 64 entries at a time
+        if (dwReply + sizeof(SRV_ENTRY) > dwMax)
+        {
+            dwMax += 64 * sizeof(SRV_ENTRY);
+            if ((pEntry = (SRV_ENTRY*)realloc(pReply, dwMax)) == NULL)
+                return ERROR_OUTOFMEMORY;
+            pReply = (BYTE*)pEntry;
+        }
+
+        pEntry = (SRV_ENTRY*)&pReply[dwReply];
+        memcpy(pEntry->cName, File.szName, sizeof(pEntry->cName));
+        memcpy(pEntry->cType, File.szType, sizeof(pEntry->cType));
+        pEntry->nAccess = File.nAccess;
+        pEntry->dwSize = File.dwSize;
+        pEntry->wYear = File.Date.wYear;
+        pEntry->nMonth = File.Date.nMonth;
+        pEntry->nDay = File.Date.nDay;
+        pEntry->nAttr = (File.bSystem ? SRV_ATTR_SYSTEM : 0) | (File.bInvisible ? SRV_ATTR_INVISIBLE : 0) | (File.bModified ? SRV_ATTR_MODIFIED : 0);
+
+        dwReply += sizeof(SRV_ENTRY);
+
+    }
+
+    return (dwError == ERROR_NO_MORE_FILES ? NO_ERROR : dwError);
+
+}
+
+//---------------------------------------------------------------------------------
+// SRV_OP_GET: return the file contents
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Get(SRV_IMAGE* pSlot, const char* pName, BYTE*& pReply, DWORD& dwReply)
+{
+
+    OSI_FILE    File;
+    void*       pFile;
+    DWORD       dwError;
+
+    if ((dwError = pSlot->pImage->Find(&pFile, pName)) != NO_ERROR)
+        return dwError;
+
+    pSlot->pImage->GetFile(pFile, File);
+
+    if ((pReply = (BYTE*)malloc(File.dwSize + 1)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    dwReply = File.dwSize;
+
+    if (dwReply > 0)
+        dwError = pSlot->pImage->Read(pFile, 0, pReply, dwReply);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// SRV_OP_PUT: write a file with the request data
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Put(SRV_IMAGE* pSlot, BYTE nFlags, const char* pName, BYTE* pData, DWORD dwData)
+{
+
+    OSI_FILE    File;
+    char        cName[11];
+    void*       pFile;
+    time_t      tNow = time(NULL);
+    struct tm*  t = localtime(&tNow);
+    DWORD       dwBytes = dwData;
+    DWORD       dwCommit;
+    bool        bHeld;
+    DWORD       dwError;
+
+    // An existing file is only replaced when the client asks for it
+    if (pSlot->pImage->Find(&pFile, pName) == NO_ERROR)
+    {
+        if (!(nFlags & SRV_FLAG_REPLACE))
+            return ERROR_FILE_EXISTS;
+    }
+    else
+        pFile = NULL;
+
+    // Keep the directory in memory until the file is written, so that a failed replace keeps the old one (not every DOS can)
+    bHeld = (pSlot->pImage->Hold() == NO_ERROR);
+
+    if (pFile != NULL && (dwError = pSlot->pImage->Delete(pFile)) != NO_ERROR)
+        goto Done;
+
+    // Set the file properties
+    memset(&File, 0, sizeof(File));
+    Win2TRS(pName, cName);
+    memcpy(File.szName, cName, 8);
+    memcpy(File.szType, &cName[8], 3);
+    File.dwSize = dwData;
+    File.Date.nDay = t->tm_mday;
+    File.Date.nMonth = t->tm_mon + 1;
+    File.Date.wYear = t->tm_year + 1900;
+    File.bModified = true;
+    File.nAccess = OSI_PROT_FULL;
+
+    // Create the file and write its contents (a file that couldn't be written is removed, or dropped with the directory)
+    if ((dwError = pSlot->pImage->Create(&pFile, File)) != NO_ERROR)
+        goto Done;
+
+    if (dwBytes > 0 && (dwError = pSlot->pImage->Write(pFile, 0, pData, dwBytes)) != NO_ERROR && !bHeld)
+        pSlot->pImage->Delete(pFile);
+
+    Done:
+    // Write the directory only when the file made it, otherwise go back to the one on disk
+    if (bHeld)
+    {
+        if (dwError == NO_ERROR)
+            dwError = pSlot->pImage->Commit();
+        else
+            pSlot->pImage->Drop();
+    }
+
+    dwCommit = Commit(pSlot);
+    return (dwError != NO_ERROR ? dwError : dwCommit);
+
+}
+
+//---------------------------------------------------------------------------------
+// SRV_OP_RENAME: rename a file
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Rename(SRV_IMAGE* pSlot, const char* pName, const char* pNewName)
+{
+
+    OSI_FILE    File;
+    char        cName[11];
+    void*       pFile;
+    void*       pOther;
+    DWORD       dwCommit;
+    DWORD       dwError;
+
+    if ((dwError = pSlot->pImage->Find(&pFile, pName)) != NO_ERROR)
+        return dwError;
+
+    if (pSlot->pImage->Find(&pOther, pNewName) == NO_ERROR)
+        return ERROR_FILE_EXISTS;
+
+    pSlot->pImage->GetFile(pFile, File);
+
+    Win2TRS(pNewName, cName);
+    memcpy(File.szName, cName, 8);
+    memcpy(File.szType, &cName[8], 3);
+    File.szName[8] = 0;
+    File.szType[3] = 0;
+
+    dwError = pSlot->pImage->SetFile(pFile, File);
+
+    dwCommit = Commit(pSlot);
+    return (dwError != NO_ERROR ? dwError : dwCommit);
+
+}
+
+//---------------------------------------------------------------------------------
+// SRV_OP_DELETE: delete a file
+//---------------------------------------------------------------------------------
+
+DWORD CServer::Delete(SRV_IMAGE* pSlot, const char* pName)
+{
+
+    void*       pFile;
+    DWORD       dwCommit;
+    DWORD       dwError;
+
+    if ((dwError = pSlot->pImage->Find(&pFile, pName)) != NO_ERROR)
+        return dwError;
+
+    dwError = pSlot->pImage->Delete(pFile);
+
+    dwCommit = Commit(pSlot);
+    return (dwError != NO_ERROR ? dwError : dwCommit);
+
+}
+
+//---------------------------------------------------------------------------------
+// Receive/send exactly dwLength bytes
+//---------------------------------------------------------------------------------
+
+bool CServer::Recv(int hClient, void* pBuffer, DWORD dwLength)
+{
+
+    ssize_t nBytes;
+
+    while (dwLength > 0)
+    {
+        if ((nBytes = recv(hClient, pBuffer, dwLength, 0)) <= 0)
+        {
+            if (nBytes == -1 && errno == EINTR)
+                continue;
+            return false;
+        }
+        pBuffer = (BYTE*)pBuffer + nBytes;
+        dwLength -= nBytes;
+    }
+
+    return true;
+
+}
+
+bool CServer::Send(int hClient, const void* pBuffer, DWORD dwLength)
+{
+
+    ssize_t nBytes;
+
+    while (dwLength > 0)
+    {
+        if ((nBytes = send(hClient, pBuffer, dwLength, MSG_NOSIGNAL)) <= 0)
+        {
+            if (nBytes == -1 && errno == EINTR)
+                continue;
+            return false;
+        }
+        pBuffer = (const BYTE*)pBuffer + nBytes;
+        dwLength -= nBytes;
+    }
+
+    return true;
+
+}
@@ -0,0 +1,143 @@
+/**
+ @file server.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Image server: answers requests from local clients over a Unix domain socket
+//---------------------------------------------------------------------------------
+//
+// Every request is a SRV_REQUEST header followed by the image path, the file name,
+// the new file name and the data, in this order and without terminators. Every reply
+// is a SRV_REPLY header followed by dwLength bytes of data. All fields are in host
+// byte order. dwError carries one of the values of "enum errors" (windows.h).
+//
+//  SRV_OP_LIST     Reply data is an array of SRV_ENTRY
+//  SRV_OP_GET      Reply data is the file contents
+//  SRV_OP_PUT      Request data is the file contents (SRV_FLAG_REPLACE overwrites)
+//  SRV_OP_RENAME   Renames the file to the new file name
+//  SRV_OP_DELETE   Deletes the file
+//
+//---------------------------------------------------------------------------------
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define SRV_MAGIC           0x3038                                                  // Request signature ("80")
+#define SRV_MAX_CLIENTS     64                                                      // Connections served at once
+#define SRV_MAX_IMAGES      16                                                      // Images kept loaded
+#define SRV_MAX_DATA        0x01000000                                              // Largest file accepted by SRV_OP_PUT
+
+#define SRV_FLAG_SYSTEM     0b00000001                                              // 1: Include System files (SRV_OP_LIST)
+#define SRV_FLAG_INVISIBLE  0b00000010                                              // 1: Include Invisible files (SRV_OP_LIST)
+#define SRV_FLAG_REPLACE    0b00000100                                              // 1: Overwrite an existing file (SRV_OP_PUT)
+
+#define SRV_ATTR_SYSTEM     0b00000001                                              // SRV_ENTRY: System file
+#define SRV_ATTR_INVISIBLE  0b00000010                                              // SRV_ENTRY: Invisible file
+#define SRV_ATTR_MODIFIED   0b00000100                                              // SRV_ENTRY: Backup pending
+
+enum    SRV_OP                                                                      // Request codes
+{
+    SRV_OP_LIST = 1,                                                                // List the directory
+    SRV_OP_GET,                                                                     // Read a file
+    SRV_OP_PUT,                                                                     // Write a file
+    SRV_OP_RENAME,                                                                  // Rename a file
+    SRV_OP_DELETE                                                                   // Delete a file
+};
+
+struct  __attribute__((packed)) SRV_REQUEST                                         // Request header
+{
+    WORD        wMagic;                                                             // SRV_MAGIC
+    BYTE        nOp;                                                                // Request code (SRV_OP_*)
+    BYTE        nFlags;                                                             // Request flags (SRV_FLAG_*)
+    WORD        wImage;                                                             // Length of the image path
+    WORD        wName;                                                              // Length of the file name
+    WORD        wNewName;                                                           // Length of the new file name
+    DWORD       dwData;                                                             // Length of the data
+};
+
+struct  __attribute__((packed)) SRV_REPLY                                           // Reply header
+{
+    DWORD       dwError;                                                            // Result (enum errors)
+    DWORD       dwLength;                                                           // Length of the data
+};
+
+struct  __attribute__((packed)) SRV_ENTRY                                           // Directory entry (SRV_OP_LIST)
+{
+    char        cName[8];                                                           // Name padded on right with blanks
+    char        cType[3];                                                           // Extension padded on right with blanks
+    BYTE        nAccess;                                                            // User Protection Level (0:Full, 7:No Access)
+    DWORD       dwSize;                                                             // Size
+    WORD        wYear;                                                              // Date
+    BYTE        nMonth;
+    BYTE        nDay;
+    BYTE        nAttr;                                                              // Attributes (SRV_ATTR_*)
+};
+
+struct  SRV_IMAGE                                                                   // Loaded image
+{
+    char        szPath[MAX_PATH];                                                   // Canonical image path (empty if the slot is free)
+    CImage*     pImage;                                                             // Image handle with its interfaces and directory
+    dev_t       nDev;                                                               // Image file identity when it was loaded
+    ino_t       nIno;
+    off_t       nSize;
+    timespec    tMTime;
+    DWORD       dwUsed;                                                             // Last use (for the LRU replacement)
+};
+
+class   CServer
+{
+protected:
+    int             m_hSocket;                                                      // Listening socket
+    char            m_szPath[MAX_PATH];                                             // Socket path
+    int             m_hClients[SRV_MAX_CLIENTS];                                    // Connected clients
+    int             m_nClients;                                                     // Number of connected clients
+    SRV_IMAGE       m_Images[SRV_MAX_IMAGES];                                       // Image cache
+    DWORD           m_dwClock;                                                      // Use counter (for the LRU replacement)
+    DWORD           m_dwFlags;                                                      // User flags used to load the images (V80_FLAG_*)
+    const char*     m_pVDIName;                                                     // Disk interface forced by the user (NULL to detect)
+    const char*     m_pOSIName;                                                     // DOS interface forced by the user (NULL to detect)
+public:
+                    CServer();                                                      // Initialize member variables
+                    ~CServer();                                                     // Close the connections and release the images
+    DWORD           Begin(const char* pPath, DWORD dwFlags, const char* pVDI = NULL, const char* pOSI = NULL); // Create the socket and listen on it
+    DWORD           Run();                                                          // Serve requests until SIGINT/SIGTERM
+    void            End();                                                          // Close the connections, the socket and the images
+protected:
+    DWORD           Serve(int hClient);                                             // Answer one request from a client
+    DWORD           Dispatch(SRV_REQUEST& Req, char* pImage, char* pName, char* pNewName, BYTE* pData, BYTE*& pReply, DWORD& dwReply);
+    SRV_IMAGE*      Load(const char* pPath, DWORD& dwError);                        // Return a loaded image, reloading it if it has changed
+    DWORD           Commit(SRV_IMAGE* pSlot);                                       // Flush a modified image and take its new identity
+    void            Evict(SRV_IMAGE* pSlot);                                        // Release a cached image
+    DWORD           List(SRV_IMAGE* pSlot, BYTE nFlags, BYTE*& pReply, DWORD& dwReply);
+    DWORD           Get(SRV_IMAGE* pSlot, const char* pName, BYTE*& pReply, DWORD& dwReply);
+    DWORD           Put(SRV_IMAGE* pSlot, BYTE nFlags, const char* pName, BYTE* pData, DWORD dwData);
+    DWORD           Rename(SRV_IMAGE* pSlot, const char* pName, const char* pNewName);
+    DWORD           Delete(SRV_IMAGE* pSlot, const char* pName);
+    static bool     Recv(int hClient, void* pBuffer, DWORD dwLength);               // Receive exactly dwLength bytes
+    static bool     Send(int hClient, const void* pBuffer, DWORD dwLength);         // Send exactly dwLength bytes
+};
@@ -0,0 +1,361 @@
+/**
+ @file similar.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Near-duplicate disk images
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "hash.h"
+#include "similar.h"
+
+struct  SIM_BAND                                                                    // One signature band of an image
+{
+    unsigned long long qwHash;                                                      // Hash of the band (LSH bucket)
+    size_t      nImage;                                                             // Image the band belongs to
+};
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CSimilar::CSimilar()
+:   m_pImages(NULL), m_nImages(0), m_pMembers(NULL), m_nClusters(0), m_nClustered(0)
+{
+    pthread_mutex_init(&m_Mutex, NULL);
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CSimilar::~CSimilar()
+{
+    Reset();
+    pthread_mutex_destroy(&m_Mutex);
+}
+
+//---------------------------------------------------------------------------------
+// Sign the disk sectors (whatever the DOS), for the clusters made after the last image
+//---------------------------------------------------------------------------------
+
+DWORD CSimilar::Add(CImage* pImage, const char* pName, DWORD& dwSectors, DWORD& dwBad)
+{
+
+    VDI_GEOMETRY    DG;
+    VDI_TRACK*      pTrack;
+    BYTE            Buffer[1024];
+    SIM_IMAGE       Image;
+    SIM_IMAGE*      pMore;
+    CHash           XXH;
+    BYTE            nTrack, nSide, nSector;
+    DWORD           dwError = NO_ERROR;
+
+    dwBad = 0;
+
+    pImage->GetVDI()->GetDG(DG);
+
+    // The signature is that of the set of sector contents, wherever they are on the disk
+    for (nTrack = DG.FT.nTrack; nTrack <= DG.LT.nTrack; nTrack++)
+    {
+
+        pTrack = (nTrack == DG.FT.nTrack ? &DG.FT : &DG.LT);
+
+        for (nSide = pTrack->nFirstSide; nSide <= pTrack->nLastSide; nSide++)
+        {
+            for (nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++)
+            {
+
+                if (pTrack->wSectorSize > sizeof(Buffer) || pImage->GetVDI()->Read(nTrack, nSide, nSector, Buffer, sizeof(Buffer)) != NO_ERROR)
+                    dwBad++;
+                else
+                {
+                    XXH.Reset(pTrack->wSectorSize);
+                    XXH.Update(Buffer, pTrack->wSectorSize);
+                    Image.Sig.Add(XXH.Digest());
+                }
+
+                if (nSector == 0xFF)
+                    break;
+
+            }
+        }
+
+        if (nTrack == 0xFF)
+            break;
+
+    }
+
+    Image.pImage = pName;
+    Image.dwBad = dwBad;
+
+    dwSectors = Image.Sig.Items();
+
+    // A disk with no readable sector has nothing to compare
+    if (dwSectors == 0)
+        return NO_ERROR;
+
+    pthread_mutex_lock(&m_Mutex);
+
+    if (m_nImages % 64 == 0)
+    {
+        if ((pMore = (SIM_IMAGE*)realloc(m_pImages, (m_nImages + 64) * sizeof(SIM_IMAGE))) == NULL)
+            dwError = ERROR_OUTOFMEMORY;
+        else
+            m_pImages = pMore;
+    }
+
+    if (dwError == NO_ERROR)
+        m_pImages[m_nImages++] = Image;
+
+    pthread_mutex_unlock(&m_Mutex);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Cluster the near-duplicate images (LSH banding), largest clusters first
+//---------------------------------------------------------------------------------
+
+DWORD CSimilar::Cluster(DWORD dwSimilar)
+{
+
+    SIM_BAND*   pBands = NULL;
+    size_t*     pRoot = NULL;
+    size_t*     pSize = NULL;
+    size_t      nBands = m_nImages * HASH_BANDS;
+    size_t      x, y, z, w;
+    DWORD       dwError = NO_ERROR;
+
+    free(m_pMembers);
+
+    m_pMembers = NULL;
+    m_nClusters = 0;
+    m_nClustered = 0;
+
+    // Images listed in name order, so that the clusters don't depend on the batch workers
+    qsort(m_pImages, m_nImages, sizeof(SIM_IMAGE), Compare);
+
+    if ((pBands = (SIM_BAND*)malloc(nBands * sizeof(SIM_BAND))) == NULL || (pRoot = (size_t*)malloc(m_nImages * sizeof(size_t))) == NULL ||
+        (pSize = (size_t*)calloc(m_nImages, sizeof(size_t))) == NULL || (m_pMembers = (SIM_MEMBER*)malloc(m_nImages * sizeof(SIM_MEMBER))) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    // Every image starts as a cluster of its own
+    for (x = 0; x < m_nImages; x++)
+    {
+        pRoot[x] = x;
+        for (y = 0; y < HASH_BANDS; y++)
+        {
+            pBands[x * HASH_BANDS + y].qwHash = m_pImages[x].Sig.Band(y);
+            pBands[x * HASH_BANDS + y].nImage = x;
+        }
+    }
+
+    // Images sharing a band end up next to each other
+    qsort(pBands, nBands, sizeof(SIM_BAND), CompareBand);
+
+    // Join each candidate to the first image of its bucket when they are alike enough (linear, unlike every pair)
+    for (x = 0; x < nBands; x = y)
+    {
+        for (y = x + 1; y < nBands && pBands[y].qwHash == pBands[x].qwHash; y++)
+        {
+            if (m_pImages[pBands[x].nImage].Sig.Similarity(m_pImages[pBands[y].nImage].Sig) < dwSimilar)
+                continue;
+            // The root of a cluster stays its first image by name
+            z = Root(pRoot, pBands[y].nImage);
+            w = Root(pRoot, pBands[x].nImage);
+            pRoot[(z > w ? z : w)] = (z < w ? z : w);
+        }
+    }
+
+    // The members of a cluster follow each other, by name
+    for (x = 0; x < m_nImages; x++)
+        pSize[Root(pRoot, x)]++;
+
+    for (x = 0; x < m_nImages; x++)
+    {
+        m_pMembers[x].nRoot = pRoot[x];
+        m_pMembers[x].nSize = pSize[pRoot[x]];
+        m_pMembers[x].nImage = x;
+        if (pRoot[x] == x && pSize[x] > 1)
+        {
+            m_nClusters++;
+            m_nClustered += pSize[x];
+        }
+    }
+
+    qsort(m_pMembers, m_nImages, sizeof(SIM_MEMBER), CompareCluster);
+
+    Done:
+    free(pSize);
+    free(pRoot);
+    free(pBands);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Forget every image
+//---------------------------------------------------------------------------------
+
+void CSimilar::Reset()
+{
+
+    free(m_pMembers);
+    free(m_pImages);
+
+    m_pImages = NULL;
+    m_nImages = 0;
+    m_pMembers = NULL;
+    m_nClusters = 0;
+    m_nClustered = 0;
+
+}
+
+//---------------------------------------------------------------------------------
+// Totals (those of the clusters are set by Cluster)
+//---------------------------------------------------------------------------------
+
+size_t CSimilar::Images()
+{
+    return m_nImages;
+}
+
+size_t CSimilar::Clusters()
+{
+    return m_nClusters;
+}
+
+size_t CSimilar::Clustered()
+{
+    return m_nClustered;
+}
+
+//---------------------------------------------------------------------------------
+// Return an image by cluster, or a signed image
+//---------------------------------------------------------------------------------
+
+const SIM_MEMBER& CSimilar::GetMember(size_t nMember)
+{
+    return m_pMembers[nMember];
+}
+
+const SIM_IMAGE& CSimilar::GetImage(size_t nImage)
+{
+    return m_pImages[nImage];
+}
+
+//---------------------------------------------------------------------------------
+// Estimated similarity of two signed images, in percent
+//---------------------------------------------------------------------------------
+
+DWORD CSimilar::Similarity(size_t nImage1, size_t nImage2)
+{
+    return m_pImages[nImage1].Sig.Similarity(m_pImages[nImage2].Sig);
+}
+
+//---------------------------------------------------------------------------------
+// Cluster of an image (the root of its tree, the paths on the way shortened)
+//---------------------------------------------------------------------------------
+
+size_t CSimilar::Root(size_t* pRoot, size_t nImage)
+{
+
+    size_t  nRoot;
+    size_t  nNext;
+
+    for (nRoot = nImage; pRoot[nRoot] != nRoot; nRoot = pRoot[nRoot]);
+
+    for (; nImage != nRoot; nImage = nNext)
+    {
+        nNext = pRoot[nImage];
+        pRoot[nImage] = nRoot;
+    }
+
+    return nRoot;
+
+}
+
+//---------------------------------------------------------------------------------
+// Order the signed images by name
+//---------------------------------------------------------------------------------
+
+int CSimilar::Compare(const void* pImage1, const void* pImage2)
+{
+    return strcmp(((const SIM_IMAGE*)pImage1)->pImage, ((const SIM_IMAGE*)pImage2)->pImage);
+}
+
+//---------------------------------------------------------------------------------
+// Order the bands by hash, then by image (the first image of a bucket comes first)
+//---------------------------------------------------------------------------------
+
+int CSimilar::CompareBand(const void* pBand1, const void* pBand2)
+{
+
+    const SIM_BAND* p1 = (const SIM_BAND*)pBand1;
+    const SIM_BAND* p2 = (const SIM_BAND*)pBand2;
+
+    if (p1->qwHash != p2->qwHash)
+        return (p1->qwHash < p2->qwHash ? -1 : 1);
+
+    return (p1->nImage < p2->nImage ? -1 : (p1->nImage > p2->nImage ? 1 : 0));
+
+}
+
+//---------------------------------------------------------------------------------
+// Order the images by cluster (largest first, then by first image), then by name
+//---------------------------------------------------------------------------------
+
+int CSimilar::CompareCluster(const void* pMember1, const void* pMember2)
+{
+
+    const SIM_MEMBER* p1 = (const SIM_MEMBER*)pMember1;
+    const SIM_MEMBER* p2 = (const SIM_MEMBER*)pMember2;
+
+    if (p1->nSize != p2->nSize)
+        return (p1->nSize > p2->nSize ? -1 : 1);
+
+    if (p1->nRoot != p2->nRoot)
+        return (p1->nRoot < p2->nRoot ? -1 : 1);
+
+    return (p1->nImage < p2->nImage ? -1 : (p1->nImage > p2->nImage ? 1 : 0));
+
+}
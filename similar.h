@@ -0,0 +1,88 @@
+/**
+ @file similar.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Near-duplicate disk images
+//---------------------------------------------------------------------------------
+//
+// Add() signs the set of sector contents of an image (CMinHash), wherever they
+// are on the disk. Once every image is in, Cluster() joins the images sharing an
+// LSH band when they are alike enough, which is linear in the number of images
+// unlike comparing every pair. The clusters are listed largest first, each one
+// from its first image by name, so that they don't depend on the batch workers.
+//
+// Add() may be called from the batch workers at once, Cluster() only after them.
+//
+//---------------------------------------------------------------------------------
+
+#include <pthread.h>
+
+class   CImage;
+
+struct  SIM_IMAGE                                                                   // One image signed
+{
+    const char* pImage;                                                             // Disk image (kept by the caller)
+    DWORD       dwBad;                                                              // Unreadable sectors (left out of the signature)
+    CMinHash    Sig;                                                                // MinHash of the sector contents
+};
+
+struct  SIM_MEMBER                                                                  // One image of a cluster
+{
+    size_t      nRoot;                                                              // Cluster (its first image)
+    size_t      nSize;                                                              // Images in the cluster
+    size_t      nImage;                                                             // Member image (GetImage)
+};
+
+class   CSimilar
+{
+protected:
+    SIM_IMAGE*  m_pImages;                                                          // Images signed so far (sorted by Cluster)
+    size_t      m_nImages;                                                          // Number of images
+    SIM_MEMBER* m_pMembers;                                                         // Images by cluster (Cluster)
+    size_t      m_nClusters;                                                        // Clusters of two images or more
+    size_t      m_nClustered;                                                       // Images in those clusters
+    pthread_mutex_t m_Mutex;                                                        // Serializes Add() (batch workers)
+public:
+                CSimilar();                                                         // Initialize member variables
+    virtual     ~CSimilar();                                                        // Release allocated memory
+    DWORD       Add(CImage* pImage, const char* pName, DWORD& dwSectors, DWORD& dwBad); // Sign the sectors of an image
+    DWORD       Cluster(DWORD dwSimilar);                                           // Join the images at least dwSimilar percent alike
+    void        Reset();                                                            // Forget every image
+    size_t      Images();                                                           // Number of images signed
+    size_t      Clusters();                                                         // Number of clusters of near-duplicates
+    size_t      Clustered();                                                        // Number of images with a near-duplicate
+    const SIM_MEMBER& GetMember(size_t nMember);                                    // Return an image by cluster (the members of a cluster follow each other)
+    const SIM_IMAGE& GetImage(size_t nImage);                                       // Return a signed image
+    DWORD       Similarity(size_t nImage1, size_t nImage2);                         // Estimated similarity of two images, in percent
+protected:
+    static size_t Root(size_t* pRoot, size_t nImage);                               // Cluster of an image
+    static int  Compare(const void* pImage1, const void* pImage2);                  // Order the images by name
+    static int  CompareBand(const void* pBand1, const void* pBand2);                // Order the bands by hash, then by image
+    static int  CompareCluster(const void* pMember1, const void* pMember2);         // Order the images by cluster, then by name
+};
@@ -0,0 +1,190 @@
+/**
+ @file stats.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// I/O instrumentation counters and per-phase timing
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include "stats.h"
+
+#ifdef V80_STATS
+
+#include <time.h>
+
+__thread STAT_DATA gStats;
+
+static const char* gCounterNames[STAT_COUNTERS] =
+{
+    "vdi_read", "vdi_write", "bytes_read", "bytes_written", "seek", "track_load",
+    "track_save", "flush", "dir_read", "dir_write", "hit_scan", "extent",
+    "kernel_copy"
+};
+
+static const char* gPhaseNames[STAT_PHASES] =
+{
+    "other", "probe", "dir", "transfer", "commit"
+};
+
+//---------------------------------------------------------------------------------
+// Return a monotonic time in nanoseconds
+//---------------------------------------------------------------------------------
+
+static unsigned long long StatClock()
+{
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+}
+
+//---------------------------------------------------------------------------------
+// Charge the time elapsed since the last change to the current phase and switch
+//---------------------------------------------------------------------------------
+
+static STAT_PHASE StatSwitch(STAT_PHASE nPhase)
+{
+
+    unsigned long long  qwNow = StatClock();
+    STAT_PHASE          nPrevious = gStats.nPhase;
+
+    gStats.qwPhase[nPrevious] += qwNow - gStats.qwMark;
+    gStats.qwMark = qwNow;
+    gStats.nPhase = nPhase;
+
+    return nPrevious;
+
+}
+
+//---------------------------------------------------------------------------------
+// Enter a phase, returning to the enclosing one when the object goes out of scope
+//---------------------------------------------------------------------------------
+
+CStatPhase::CStatPhase(STAT_PHASE nPhase)
+{
+    m_nPrevious = StatSwitch(nPhase);
+}
+
+CStatPhase::~CStatPhase()
+{
+    StatSwitch(m_nPrevious);
+}
+
+//---------------------------------------------------------------------------------
+// Zero the counters and restart the clock
+//---------------------------------------------------------------------------------
+
+void StatReset()
+{
+
+    memset(&gStats, 0, sizeof(gStats));
+
+    gStats.qwStart = gStats.qwMark = StatClock();
+    gStats.nPhase = STAT_PHASE_OTHER;
+
+}
+
+//---------------------------------------------------------------------------------
+// Move the counters and phase times of this thread out, zeroing them for the next use
+//---------------------------------------------------------------------------------
+
+void StatTake(STAT_DATA& Data)
+{
+
+    // Bring the current phase up to date
+    StatSwitch(gStats.nPhase);
+
+    Data = gStats;
+
+    StatReset();
+
+}
+
+//---------------------------------------------------------------------------------
+// Add the counters and phase times taken on another thread to this thread's
+//---------------------------------------------------------------------------------
+
+void StatMerge(const STAT_DATA& Data)
+{
+
+    for (int x = 0; x < STAT_COUNTERS; x++)
+        gStats.qwCount[x] += Data.qwCount[x];
+
+    for (int x = 0; x < STAT_PHASES; x++)
+        gStats.qwPhase[x] += Data.qwPhase[x];
+
+}
+
+//---------------------------------------------------------------------------------
+// Print the counters and the phase times as text or as a single-line JSON object
+//---------------------------------------------------------------------------------
+
+void StatPrint(FILE* hOut, bool bJSON)
+{
+
+    // Bring the current phase up to date
+    StatSwitch(gStats.nPhase);
+
+    if (bJSON)
+    {
+
+        fprintf(hOut, "{\"wall\":%.6f", (gStats.qwMark - gStats.qwStart) / 1e9);
+
+        for (int x = 0; x < STAT_COUNTERS; x++)
+            fprintf(hOut, ",\"%s\":%llu", gCounterNames[x], gStats.qwCount[x]);
+
+        for (int x = 0; x < STAT_PHASES; x++)
+            fprintf(hOut, ",\"t_%s\":%.6f", gPhaseNames[x], gStats.qwPhase[x] / 1e9);
+
+        fprintf(hOut, "}\r\n");
+
+    }
+    else
+    {
+
+        fprintf(hOut, "\r\nI/O statistics:\r\n\r\n");
+
+        for (int x = 0; x < STAT_COUNTERS; x++)
+            fprintf(hOut, "%-16s%12llu\r\n", gCounterNames[x], gStats.qwCount[x]);
+
+        fprintf(hOut, "\r\n");
+
+        for (int x = 0; x < STAT_PHASES; x++)
+            fprintf(hOut, "%-16s%12.6f s\r\n", gPhaseNames[x], gStats.qwPhase[x] / 1e9);
+
+        fprintf(hOut, "%-16s%12.6f s\r\n", "wall", (gStats.qwMark - gStats.qwStart) / 1e9);
+
+    }
+
+}
+
+#endif
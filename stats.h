@@ -0,0 +1,109 @@
+/**
+ @file stats.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// I/O instrumentation counters and per-phase timing
+//---------------------------------------------------------------------------------
+//
+// Built only when V80_STATS is defined (make STATS=1). Otherwise every STAT_ macro
+// expands to nothing, so the instrumentation points cost nothing in regular builds.
+//
+// Counters and timers are kept per thread, like the command output, so that each
+// image of a batch is measured by the worker processing it. The writer threads of
+// a CPool hand theirs over with each job, and they are added to the thread that
+// retires it. With several writers the phase times may then exceed the wall time.
+//
+//---------------------------------------------------------------------------------
+
+#ifdef V80_STATS
+
+enum    STAT_COUNTER                                                                // Counter enumerator
+{
+    STAT_VDI_READ,                                                                  // Sectors read from the disk interface
+    STAT_VDI_WRITE,                                                                 // Sectors written to the disk interface
+    STAT_BYTES_READ,                                                                // Bytes read from the disk interface
+    STAT_BYTES_WRITTEN,                                                             // Bytes written to the disk interface
+    STAT_SEEK,                                                                      // fseek calls on the image file
+    STAT_TRACK_LOAD,                                                                // DMK tracks loaded into the track cache
+    STAT_TRACK_SAVE,                                                                // DMK tracks saved from the track cache
+    STAT_FLUSH,                                                                     // Image file flushes
+    STAT_DIR_READ,                                                                  // Whole directory reads (DirRW)
+    STAT_DIR_WRITE,                                                                 // Whole directory writes (DirRW)
+    STAT_HIT_SCAN,                                                                  // Hash Index Table scans
+    STAT_EXTENT,                                                                    // Extent walks (file extent get/set)
+    STAT_KERNEL_COPY,                                                               // File bytes copied image-to-file by the kernel
+    STAT_COUNTERS
+};
+
+enum    STAT_PHASE                                                                  // Phase enumerator
+{
+    STAT_PHASE_OTHER,                                                               // Time not spent in any of the phases below
+    STAT_PHASE_PROBE,                                                               // Disk format and DOS detection
+    STAT_PHASE_DIR,                                                                 // Directory load
+    STAT_PHASE_TRANSFER,                                                            // File data transfer
+    STAT_PHASE_COMMIT,                                                              // Directory write-back and image flush
+    STAT_PHASES
+};
+
+struct  STAT_DATA                                                                   // Per-thread statistics
+{
+    unsigned long long  qwCount[STAT_COUNTERS];                                     // Counters
+    unsigned long long  qwPhase[STAT_PHASES];                                       // Nanoseconds spent in each phase
+    unsigned long long  qwMark;                                                     // Time of the last phase change
+    unsigned long long  qwStart;                                                    // Time of the last reset
+    STAT_PHASE          nPhase;                                                     // Current phase
+};
+
+class   CStatPhase                                                                  // Enter a phase for the lifetime of the object
+{
+protected:
+    STAT_PHASE      m_nPrevious;                                                    // Phase to return to
+public:
+                    CStatPhase(STAT_PHASE nPhase);
+                    ~CStatPhase();
+};
+
+extern __thread STAT_DATA gStats;
+
+void    StatReset();                                                                // Zero the counters and restart the clock
+void    StatPrint(FILE* hOut, bool bJSON);                                          // Print the counters as text or as a JSON object
+void    StatTake(STAT_DATA& Data);                                                  // Move this thread's counters out and zero them
+void    StatMerge(const STAT_DATA& Data);                                           // Add counters taken on another thread
+
+#define STAT_COUNT(c)           (gStats.qwCount[c]++)
+#define STAT_ADD(c, n)          (gStats.qwCount[c] += (n))
+#define STAT_PHASE(p)           CStatPhase StatPhase(p)
+
+#else
+
+#define STAT_COUNT(c)           do { } while (0)
+#define STAT_ADD(c, n)          do { } while (0)
+#define STAT_PHASE(p)           do { } while (0)
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ @file store.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Content-addressed object store
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "store.h"
+#include "hash.h"
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CStore::CStore()
+{
+    m_pRoot = NULL;
+}
+
+//---------------------------------------------------------------------------------
+// Release allocated memory
+//---------------------------------------------------------------------------------
+
+CStore::~CStore()
+{
+    free(m_pRoot);
+}
+
+//---------------------------------------------------------------------------------
+// Use (and create if needed) a store directory
+//---------------------------------------------------------------------------------
+
+DWORD CStore::Open(const char* pRoot)
+{
+
+    char    szPath[MAX_PATH];
+
+    free(m_pRoot);
+
+    if ((m_pRoot = strdup(pRoot)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    snprintf(szPath, sizeof(szPath), "%s/%s", m_pRoot, STORE_OBJECTS);
+
+    if ((mkdir(m_pRoot, 0777) != 0 && errno != EEXIST) || (mkdir(szPath, 0777) != 0 && errno != EEXIST))
+        return ERROR_WRITE_FAULT;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Add a content, unless the store has it (bWritten tells whether a blob was written)
+//---------------------------------------------------------------------------------
+
+DWORD CStore::Put(const BYTE* pData, DWORD dwBytes, unsigned long long& qwHash, bool& bWritten)
+{
+
+    CHash       XXH;
+    char        szPath[MAX_PATH];
+    char        szTemp[MAX_PATH];
+    struct stat st;
+    ssize_t     nWritten;
+    DWORD       dwDone;
+    int         hFile;
+    DWORD       dwError = NO_ERROR;
+
+    bWritten = false;
+
+    XXH.Update(pData, dwBytes);
+    qwHash = XXH.Digest();
+
+    Path(qwHash, szPath, sizeof(szPath));
+
+    // Already stored: nothing to write (a different size means a hash collision)
+    if (stat(szPath, &st) == 0)
+        return (st.st_size == (off_t)dwBytes ? NO_ERROR : ERROR_FILE_EXISTS);
+
+    // Create the fan-out directory (the first two hex digits)
+    strcpy(szTemp, szPath);
+    *strrchr(szTemp, '/') = 0;
+
+    if (mkdir(szTemp, 0777) != 0 && errno != EEXIST)
+        return ERROR_WRITE_FAULT;
+
+    // Write to a name of this thread's own, then link it into place
+    snprintf(szTemp, sizeof(szTemp), "%s.%d.%lx", szPath, (int)getpid(), (unsigned long)pthread_self());
+
+    if ((hFile = open(szTemp, O_WRONLY | O_CREAT | O_TRUNC, 0444)) == -1)
+        return ERROR_WRITE_FAULT;
+
+    for (dwDone = 0; dwDone < dwBytes; dwDone += nWritten)
+    {
+        if ((nWritten = write(hFile, &pData[dwDone], dwBytes - dwDone)) <= 0)
+        {
+            dwError = ERROR_WRITE_FAULT;
+            break;
+        }
+    }
+
+    if (close(hFile) != 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    // Another writer may have stored the same content in the meantime
+    if (dwError == NO_ERROR && link(szTemp, szPath) == 0)
+        bWritten = true;
+    else if (dwError == NO_ERROR && errno != EEXIST)
+        dwError = ERROR_WRITE_FAULT;
+
+    unlink(szTemp);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Blob path of a hash
+//---------------------------------------------------------------------------------
+
+void CStore::Path(unsigned long long qwHash, char* pPath, size_t nSize)
+{
+    snprintf(pPath, nSize, "%s/%s/%02x/%014llx", m_pRoot, STORE_OBJECTS, (unsigned)(qwHash >> 56), qwHash & 0x00FFFFFFFFFFFFFFULL);
+}
+
+//---------------------------------------------------------------------------------
+// Manifest path of an image (named after the image file, without its directory)
+//---------------------------------------------------------------------------------
+
+void CStore::Manifest(const char* pImage, char* pPath, size_t nSize)
+{
+
+    const char* pBase = strrchr(pImage, '/');
+
+    snprintf(pPath, nSize, "%s/%s%s", m_pRoot, (pBase ? pBase + 1 : pImage), STORE_EXT);
+
+}
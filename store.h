@@ -0,0 +1,62 @@
+/**
+ @file store.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Content-addressed object store
+//---------------------------------------------------------------------------------
+//
+// Each distinct file content is kept once, as a read-only blob named after its
+// XXH64 hash (<root>/objects/xx/yyyyyyyyyyyyyy). A blob is written to a temporary
+// name and linked into place, so concurrent writers of the same content don't get
+// in each other's way. A blob already there is taken as the same content when its
+// size matches, otherwise the hashes have collided and Put() fails.
+//
+// Each image gets a text manifest (<root>/<image>.v80m) mapping its files, their
+// dates and attributes to the blobs:
+//
+//   # VDK-80 manifest: <image> (<disk interface> <DOS interface>)
+//   <hash> <size> <yyyy-mm-dd> <S|-><I|-><M|-> <access> <LRL> <NAME/EXT>
+//
+//---------------------------------------------------------------------------------
+
+#define STORE_OBJECTS       "objects"                                               // Blob directory under the store root
+#define STORE_EXT           ".v80m"                                                 // Manifest extension
+
+class   CStore
+{
+protected:
+    char*       m_pRoot;                                                            // Store root directory
+public:
+                CStore();                                                           // Initialize member variables
+                ~CStore();                                                          // Release allocated memory
+    DWORD       Open(const char* pRoot);                                            // Use (and create if needed) a store directory
+    DWORD       Put(const BYTE* pData, DWORD dwBytes, unsigned long long& qwHash, bool& bWritten); // Add a content, unless the store has it
+    void        Path(unsigned long long qwHash, char* pPath, size_t nSize);         // Blob path of a hash
+    void        Manifest(const char* pImage, char* pPath, size_t nSize);            // Manifest path of an image
+};
@@ -0,0 +1,388 @@
+/**
+ @file stream.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Double-buffered stream between the disk image and a host file
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "stream.h"
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CStream::CStream()
+:   m_pBuffer(NULL), m_dwLength(), m_bFull(), m_nSlot(), m_bAbort(false), m_bRunning(false), m_hFile(NULL), m_dwError(NO_ERROR)
+{
+    pthread_mutex_init(&m_Mutex, NULL);
+    pthread_cond_init(&m_Cond, NULL);
+}
+
+//---------------------------------------------------------------------------------
+// Stop the host thread and release allocated memory
+//---------------------------------------------------------------------------------
+
+CStream::~CStream()
+{
+    if (m_bRunning)
+    {
+        Abort();
+        End();
+    }
+
+    if (m_pBuffer != NULL)
+        free(m_pBuffer);
+
+    pthread_cond_destroy(&m_Cond);
+    pthread_mutex_destroy(&m_Mutex);
+}
+
+//---------------------------------------------------------------------------------
+// Allocate the chunk buffers (reused by every subsequent Begin)
+//---------------------------------------------------------------------------------
+
+DWORD CStream::Alloc()
+{
+    if (m_pBuffer == NULL && (m_pBuffer = (BYTE*)calloc(STREAM_SLOTS, V80_CHUNK)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    return NO_ERROR;
+}
+
+//---------------------------------------------------------------------------------
+// Reset the slots and start the host thread on the given file
+//---------------------------------------------------------------------------------
+
+DWORD CStream::Begin(FILE* hFile, STREAM_ROLE nHostRole)
+{
+
+    DWORD   dwError = NO_ERROR;
+
+    // Make sure the buffers are available
+    if ((dwError = Alloc()) != NO_ERROR)
+        goto Done;
+
+    // Reset the stream state
+    for (int x = 0; x < STREAM_SLOTS; x++)
+    {
+        m_dwLength[x] = 0;
+        m_bFull[x] = false;
+    }
+
+    m_nSlot[STREAM_PRODUCER] = 0;
+    m_nSlot[STREAM_CONSUMER] = 0;
+    m_bAbort = false;
+    m_hFile = hFile;
+    m_dwError = NO_ERROR;
+
+    // Start the host thread on the requested side of the stream
+    if (pthread_create(&m_hThread, NULL, (nHostRole == STREAM_CONSUMER ? Writer : Reader), this) != 0)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    m_bRunning = true;
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Wait for the host thread to finish and return its error code
+//---------------------------------------------------------------------------------
+
+DWORD CStream::End()
+{
+    if (m_bRunning)
+    {
+        pthread_join(m_hThread, NULL);
+        m_bRunning = false;
+    }
+
+    return m_dwError;
+}
+
+//---------------------------------------------------------------------------------
+// Wait until the next chunk is available to the given side
+//---------------------------------------------------------------------------------
+
+BYTE* CStream::Wait(STREAM_ROLE nRole, DWORD& dwLength)
+{
+
+    BYTE    nSlot = m_nSlot[nRole];
+    BYTE*   pChunk = NULL;
+
+    pthread_mutex_lock(&m_Mutex);
+
+    // The producer waits for an empty chunk, the consumer waits for a full one
+    while (!m_bAbort && m_bFull[nSlot] == (nRole == STREAM_PRODUCER))
+        pthread_cond_wait(&m_Cond, &m_Mutex);
+
+    if (!m_bAbort)
+    {
+        pChunk = m_pBuffer + nSlot * V80_CHUNK;
+        dwLength = (nRole == STREAM_PRODUCER ? V80_CHUNK : m_dwLength[nSlot]);
+    }
+
+    pthread_mutex_unlock(&m_Mutex);
+
+    return pChunk;
+
+}
+
+//---------------------------------------------------------------------------------
+// Hand the current chunk over to the other side and advance to the next one
+//---------------------------------------------------------------------------------
+
+void CStream::Post(STREAM_ROLE nRole, DWORD dwLength)
+{
+
+    BYTE    nSlot = m_nSlot[nRole];
+
+    pthread_mutex_lock(&m_Mutex);
+
+    // The producer marks the chunk as full, the consumer gives it back as empty
+    if (nRole == STREAM_PRODUCER)
+        m_dwLength[nSlot] = dwLength;
+
+    m_bFull[nSlot] = (nRole == STREAM_PRODUCER);
+
+    m_nSlot[nRole] = (nSlot + 1) % STREAM_SLOTS;
+
+    pthread_cond_broadcast(&m_Cond);
+    pthread_mutex_unlock(&m_Mutex);
+
+}
+
+//---------------------------------------------------------------------------------
+// Release both sides from any pending Wait
+//---------------------------------------------------------------------------------
+
+void CStream::Abort()
+{
+    pthread_mutex_lock(&m_Mutex);
+    m_bAbort = true;
+    pthread_cond_broadcast(&m_Cond);
+    pthread_mutex_unlock(&m_Mutex);
+}
+
+//---------------------------------------------------------------------------------
+// Stream the contents of a disk file to a host file, one chunk at a time (bBad: zero-fill the unreadable parts)
+//---------------------------------------------------------------------------------
+
+DWORD CStream::Get(CImage* pImage, void* pFile, DWORD dwSize, FILE* hFile, bool bBad)
+{
+
+    BYTE*   pChunk;
+    DWORD   dwLength;
+    DWORD   dwBytes;
+    DWORD   dwDone = 0;
+    DWORD   dwError;
+
+    // Start the writer thread on the host file
+    if ((dwError = Begin(hFile, STREAM_CONSUMER)) != 0)
+        goto Done;
+
+    // While the writer thread accepts chunks (it gives up on a host write error)
+    while ((pChunk = Wait(STREAM_PRODUCER, dwLength)) != NULL)
+    {
+
+        // Limit the chunk to what is left of the file
+        if (dwLength > dwSize - dwDone)
+            dwLength = dwSize - dwDone;
+
+        // An empty chunk tells the writer thread that the file is complete
+        if (dwLength == 0)
+        {
+            Post(STREAM_PRODUCER, 0);
+            break;
+        }
+
+        // Read the next chunk while the writer thread is busy with the previous one
+        if ((dwError = pImage->Read(pFile, dwDone, pChunk, (dwBytes = dwLength))) != 0)
+        {
+
+            // Give up unless the user wants as much as possible from bad files
+            if (!bBad)
+            {
+                Abort();
+                break;
+            }
+
+            // Zero-fill the unreadable part
+            memset(&pChunk[dwBytes], 0, dwLength - dwBytes);
+            dwError = 0;
+
+        }
+
+        // Hand the chunk over to the writer thread
+        dwDone += dwLength;
+        Post(STREAM_PRODUCER, dwLength);
+
+    }
+
+    // Wait for the writer thread and report its error, if any
+    if (End() != 0 && dwError == 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Stream the contents of a host file to a disk file, one chunk at a time
+//---------------------------------------------------------------------------------
+
+DWORD CStream::Put(CImage* pImage, void* pFile, DWORD dwSize, FILE* hFile)
+{
+
+    BYTE*   pChunk;
+    DWORD   dwLength;
+    DWORD   dwDone = 0;
+    DWORD   dwError;
+
+    // Start the reader thread on the host file
+    if ((dwError = Begin(hFile, STREAM_PRODUCER)) != 0)
+        goto Done;
+
+    // While the reader thread delivers chunks
+    while ((pChunk = Wait(STREAM_CONSUMER, dwLength)) != NULL)
+    {
+
+        // An empty chunk means the host file is over
+        if (dwLength == 0)
+            break;
+
+        // Never write past the size the disk file was created with
+        if (dwLength > dwSize - dwDone)
+        {
+            dwError = ERROR_WRITE_FAULT;
+            Abort();
+            break;
+        }
+
+        // Write this chunk while the reader thread fetches the next one
+        if ((dwError = pImage->Write(pFile, dwDone, pChunk, dwLength)) != 0)
+        {
+            Abort();
+            break;
+        }
+
+        // Give the chunk back to the reader thread
+        dwDone += dwLength;
+        Post(STREAM_CONSUMER, 0);
+
+    }
+
+    // Wait for the reader thread and report its error, if any
+    if (End() != 0 && dwError == 0)
+        dwError = ERROR_READ_FAULT;
+
+    // The host file must have matched the expected size
+    if (dwError == 0 && dwDone != dwSize)
+        dwError = ERROR_READ_FAULT;
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Host thread: drain chunks into the host file until an empty chunk arrives
+//---------------------------------------------------------------------------------
+
+void* CStream::Writer(void* pParam)
+{
+
+    CStream*    pStream = (CStream*)pParam;
+    BYTE*       pChunk;
+    DWORD       dwLength;
+
+    while ((pChunk = pStream->Wait(STREAM_CONSUMER, dwLength)) != NULL)
+    {
+
+        // An empty chunk marks the end of the stream
+        if (dwLength == 0)
+            break;
+
+        // Write chunk contents to the host file
+        if (fwrite(pChunk, 1, dwLength, pStream->m_hFile) != dwLength)
+        {
+            pStream->m_dwError = ERROR_WRITE_FAULT;
+            pStream->Abort();
+            break;
+        }
+
+        pStream->Post(STREAM_CONSUMER, 0);
+
+    }
+
+    return NULL;
+
+}
+
+//---------------------------------------------------------------------------------
+// Host thread: fill chunks from the host file, ending with an empty chunk
+//---------------------------------------------------------------------------------
+
+void* CStream::Reader(void* pParam)
+{
+
+    CStream*    pStream = (CStream*)pParam;
+    BYTE*       pChunk;
+    DWORD       dwLength;
+
+    while ((pChunk = pStream->Wait(STREAM_PRODUCER, dwLength)) != NULL)
+    {
+
+        // Read the next chunk from the host file
+        dwLength = fread(pChunk, 1, dwLength, pStream->m_hFile);
+
+        // A read error also ends the stream
+        if (dwLength == 0 && ferror(pStream->m_hFile))
+            pStream->m_dwError = ERROR_READ_FAULT;
+
+        pStream->Post(STREAM_PRODUCER, dwLength);
+
+        if (dwLength == 0)
+            break;
+
+    }
+
+    return NULL;
+
+}
@@ -0,0 +1,74 @@
+/**
+ @file stream.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Double-buffered stream between the disk image and a host file
+//---------------------------------------------------------------------------------
+
+#include <pthread.h>
+
+class   CImage;
+
+#define STREAM_SLOTS        2                                                       // Number of chunks in flight (double buffer)
+
+enum    STREAM_ROLE                                                                 // Stream side enumerator
+{
+    STREAM_PRODUCER = 0,                                                            // Side that fills chunks
+    STREAM_CONSUMER = 1                                                             // Side that drains chunks
+};
+
+class   CStream
+{
+protected:
+    BYTE*           m_pBuffer;                                                      // STREAM_SLOTS chunks of V80_CHUNK bytes each
+    DWORD           m_dwLength[STREAM_SLOTS];                                       // Number of bytes held by each chunk (0: end of stream)
+    bool            m_bFull[STREAM_SLOTS];                                          // Chunk is waiting for the consumer
+    BYTE            m_nSlot[2];                                                     // Next slot for the producer and for the consumer
+    bool            m_bAbort;                                                       // One of the sides has given up
+    bool            m_bRunning;                                                     // Host thread has been started
+    FILE*           m_hFile;                                                        // Host file handle
+    DWORD           m_dwError;                                                      // Error raised by the host thread
+    pthread_t       m_hThread;                                                      // Host thread handle
+    pthread_mutex_t m_Mutex;                                                        // Protects the slot state
+    pthread_cond_t  m_Cond;                                                         // Signals any slot state change
+public:
+    CStream();
+    ~CStream();
+    DWORD   Alloc();                                                                // Allocate the chunk buffers
+    DWORD   Begin(FILE* hFile, STREAM_ROLE nHostRole);                              // Start the host thread on a file
+    DWORD   End();                                                                  // Wait for the host thread and return its error
+    BYTE*   Wait(STREAM_ROLE nRole, DWORD& dwLength);                               // Get the next chunk for this side (NULL if aborted)
+    void    Post(STREAM_ROLE nRole, DWORD dwLength);                                // Hand the current chunk over to the other side
+    void    Abort();                                                                // Stop both sides
+    DWORD   Get(CImage* pImage, void* pFile, DWORD dwSize, FILE* hFile, bool bBad = false); // Stream a disk file to a host file (bBad: zero-fill unreadable parts)
+    DWORD   Put(CImage* pImage, void* pFile, DWORD dwSize, FILE* hFile);            // Stream a host file to a disk file
+protected:
+    static void*    Writer(void* pParam);                                           // Host thread: write chunks to the host file
+    static void*    Reader(void* pParam);                                           // Host thread: read chunks from the host file
+};
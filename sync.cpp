@@ -0,0 +1,706 @@
+/**
+ @file sync.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Sync of a host directory into a disk image
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "image.h"
+#include "cache.h"
+#include "stream.h"
+#include "sync.h"
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CSync::CSync()
+:   m_pImage(NULL), m_dwFlags(0), m_pDir(NULL), m_pItems(NULL), m_nItems(0), m_pBuffer(NULL), m_bHeld(false),
+    m_wFiles(0), m_wDeleted(0), m_wSame(0), m_dwSize(0)
+{
+}
+
+//---------------------------------------------------------------------------------
+// Drop a directory still held and release allocated memory
+//---------------------------------------------------------------------------------
+
+CSync::~CSync()
+{
+
+    if (m_bHeld)
+        m_pImage->Drop();
+
+    free(m_pItems);
+    free(m_pBuffer);
+
+}
+
+//---------------------------------------------------------------------------------
+// Compare the host files with the image files by the same TRS names
+// (pNames limits the plan to the named host files, NULL compares everything)
+//---------------------------------------------------------------------------------
+
+DWORD CSync::Plan(CImage* pImage, const char* pDir, char** pNames, int nNames, DWORD dwFlags)
+{
+
+    SYNC_ITEM*  pItem;
+    OSI_FILE    File;
+    void*       pFile = NULL;
+    DIR*        dir = NULL;
+    struct dirent* ent;
+    const char* pName;
+    int         x, y;
+    DWORD       dwError = NO_ERROR;
+
+    Reset();
+
+    m_pImage = pImage;
+    m_pDir = pDir;
+    m_dwFlags = dwFlags;
+
+    // The comparison buffer is kept for the next plans
+    if (m_pBuffer == NULL && (m_pBuffer = (BYTE*)malloc(2 * V80_CHUNK)) == NULL)
+        return ERROR_OUTOFMEMORY;
+
+    if (pNames == NULL && (dir = opendir(pDir)) == NULL)
+        return ERROR_NOT_FOUND;
+
+    // Compare each host file against the image file by the same TRS name
+    for (x = 0; ; x++)
+    {
+
+        if (dir != NULL)
+        {
+            if ((ent = readdir(dir)) == NULL)
+                break;
+            pName = ent->d_name;
+        }
+        else if (x < nNames)
+            pName = pNames[x];
+        else
+            break;
+
+        // Hidden host files are left out
+        if (pName[0] == '.')
+            continue;
+
+        if (m_nItems % 64 == 0)
+        {
+            if ((pItem = (SYNC_ITEM*)realloc(m_pItems, (m_nItems + 64) * sizeof(SYNC_ITEM))) == NULL)
+            {
+                dwError = ERROR_OUTOFMEMORY;
+                goto Done;
+            }
+            m_pItems = pItem;
+        }
+
+        if (Item(pName, m_pItems[m_nItems]) != NO_ERROR)
+            continue;
+
+        // Two host files can map to the same TRS name, the first one wins
+        for (y = 0; y < m_nItems && memcmp(m_pItems[y].cName, m_pItems[m_nItems].cName, 11) != 0; y++);
+
+        if (y < m_nItems)
+        {
+            m_pItems[m_nItems].nAction = SYNC_SKIP;
+            m_pItems[m_nItems].pReason = "Name clash";
+        }
+
+        m_nItems++;
+
+    }
+
+    // A full plan also deletes the image files no longer on the host (those the flags let through)
+    while (dir != NULL && (dwError = m_pImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == NO_ERROR)
+    {
+
+        if ((File.bSystem && !(m_dwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(m_dwFlags & V80_FLAG_INVISIBLE)))
+            continue;
+
+        for (y = 0; y < m_nItems && (memcmp(m_pItems[y].cName, File.szName, 8) != 0 || memcmp(&m_pItems[y].cName[8], File.szType, 3) != 0); y++);
+
+        if (y < m_nItems)
+            continue;
+
+        if (m_nItems % 64 == 0)
+        {
+            if ((pItem = (SYNC_ITEM*)realloc(m_pItems, (m_nItems + 64) * sizeof(SYNC_ITEM))) == NULL)
+            {
+                dwError = ERROR_OUTOFMEMORY;
+                goto Done;
+            }
+            m_pItems = pItem;
+        }
+
+        pItem = &m_pItems[m_nItems++];
+        memset(pItem, 0, sizeof(SYNC_ITEM));
+        memcpy(pItem->cName, File.szName, 8);
+        memcpy(&pItem->cName[8], File.szType, 3);
+        FmtName(File.szName, File.szType, m_pImage->Divider(), pItem->szFile);
+        pItem->nAction = SYNC_DELETE;
+        pItem->dwOld = File.dwSize;
+
+    }
+
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = NO_ERROR;
+
+    for (x = 0; x < m_nItems; x++)
+    {
+        if (m_pItems[x].nAction == SYNC_NONE)
+            m_wSame++;
+    }
+
+    Done:
+    if (dir != NULL)
+        closedir(dir);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Return the number of files the plan creates, replaces or deletes
+//---------------------------------------------------------------------------------
+
+int CSync::Changes()
+{
+
+    int     nChanges = 0;
+
+    for (int x = 0; x < m_nItems; x++)
+    {
+        if (m_pItems[x].nAction != SYNC_NONE && m_pItems[x].nAction != SYNC_SKIP)
+            nChanges++;
+    }
+
+    return nChanges;
+
+}
+
+//---------------------------------------------------------------------------------
+// Hold the directory and check that the changes fit (in granules, then in entries)
+//---------------------------------------------------------------------------------
+
+DWORD CSync::Begin(DWORD& dwNeeded, DWORD& dwAvailable, bool& bEntries)
+{
+
+    DWORD   dwGranule;
+    DWORD   dwGranules;
+    DWORD   dwFreed = 0;
+    DWORD   dwEntries;
+    DWORD   dwNew = 0;
+    DWORD   dwGone = 0;
+
+    dwNeeded = 0;
+    dwAvailable = 0;
+    bEntries = false;
+
+    // Keep the directory in memory until every change is in (not every DOS can)
+    m_bHeld = (m_pImage->Hold() == NO_ERROR);
+
+    // Without a granule size, the DOS finds out as it goes
+    if (m_pImage->Free(dwGranule, dwGranules) != NO_ERROR || dwGranule == 0)
+        return NO_ERROR;
+
+    // Add up the granules and directory entries the new data takes, and what the deleted files give back
+    for (int x = 0; x < m_nItems; x++)
+    {
+        if (m_pItems[x].nAction == SYNC_CREATE || m_pItems[x].nAction == SYNC_REPLACE)
+            dwNeeded += (m_pItems[x].dwSize + dwGranule - 1) / dwGranule;
+        if (m_pItems[x].nAction == SYNC_REPLACE || m_pItems[x].nAction == SYNC_DELETE)
+            dwFreed += (m_pItems[x].dwOld + dwGranule - 1) / dwGranule;
+        if (m_pItems[x].nAction == SYNC_CREATE)
+            dwNew++;
+        if (m_pItems[x].nAction == SYNC_DELETE)
+            dwGone++;
+    }
+
+    // While held, the granules of the replaced or deleted files are only free after the commit
+    if (m_bHeld)
+        dwFreed = 0;
+
+    if (dwNeeded > dwGranules + dwFreed)
+    {
+        dwAvailable = dwGranules + dwFreed;
+        return ERROR_DISK_FULL;
+    }
+
+    // A replaced file keeps its entry, a deleted one gives it back before the files are created
+    if (m_pImage->Entries(dwEntries) == NO_ERROR && dwNew > dwEntries + dwGone)
+    {
+        dwNeeded = dwNew;
+        dwAvailable = dwEntries + dwGone;
+        bEntries = true;
+        return ERROR_DISK_FULL;
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Delete, then create or replace the files of the plan, reporting each one
+//---------------------------------------------------------------------------------
+
+DWORD CSync::Apply(SYNC_REPORT pReport, void* pParam)
+{
+
+    SYNC_ITEM*  pItem;
+    OSI_FILE    File;
+    void*       pFile;
+    FILE*       hFile;
+    struct tm   tm;
+    char        szPath[PATH_MAX];
+    CStream     Stream;
+    int         nPass;
+    int         x;
+    DWORD       dwError;
+
+    if ((dwError = Stream.Alloc()) != NO_ERROR)
+        return ERROR_OUTOFMEMORY;
+
+    // Deletions go first, so that their entries (and, unless held, their space) are there for the new data
+    for (nPass = 0; nPass < 2 && dwError == NO_ERROR; nPass++)
+    {
+        for (x = 0; x < m_nItems && dwError == NO_ERROR; x++)
+        {
+
+            pItem = &m_pItems[x];
+            pItem->nResult = SYNC_DONE;
+
+            if (nPass == 0 && pItem->nAction == SYNC_DELETE)
+            {
+
+                if ((dwError = m_pImage->GetOSI()->Open(&pFile, pItem->cName)) != NO_ERROR || (dwError = m_pImage->Delete(pFile)) != NO_ERROR)
+                    pItem->nResult = SYNC_NO_DELETE;
+                else
+                    m_wDeleted++;
+
+                pReport(pParam, *pItem);
+
+            }
+            else if (nPass == 1 && pItem->nAction == SYNC_SKIP)
+                pReport(pParam, *pItem);
+            else if (nPass == 1 && (pItem->nAction == SYNC_CREATE || pItem->nAction == SYNC_REPLACE))
+            {
+
+                // Set the target file properties from the host file
+                memset(&File, 0, sizeof(File));
+                memcpy(File.szName, pItem->cName, 8);
+                memcpy(File.szType, &pItem->cName[8], 3);
+                File.dwSize = pItem->dwSize;
+                gmtime_r(&pItem->tTime, &tm);
+                File.Date.nDay = tm.tm_mday;
+                File.Date.nMonth = tm.tm_mon + 1;
+                File.Date.wYear = tm.tm_year + 1900;
+                File.bModified = true;
+                File.nAccess = OSI_PROT_FULL;
+
+                snprintf(szPath, sizeof(szPath), "%s/%s", m_pDir, pItem->szHost);
+
+                // A host file that can't be opened is only skipped
+                if ((hFile = fopen(szPath, "r")) == NULL)
+                {
+                    pItem->nResult = SYNC_NO_OPEN;
+                    pReport(pParam, *pItem);
+                    continue;
+                }
+
+                // Replace the old file (while held, its granules are not reused before the commit)
+                if (pItem->nAction == SYNC_REPLACE && ((dwError = m_pImage->GetOSI()->Open(&pFile, pItem->cName)) != NO_ERROR || (dwError = m_pImage->Delete(pFile)) != NO_ERROR))
+                    pItem->nResult = SYNC_NO_DELETE;
+                else if ((dwError = m_pImage->Create(&pFile, File)) != NO_ERROR)
+                    pItem->nResult = SYNC_NO_CREATE;
+
+                // Stream the host file contents to the new file
+                else if ((dwError = Stream.Put(m_pImage, pFile, File.dwSize, hFile)) != NO_ERROR)
+                {
+                    pItem->nResult = (dwError == ERROR_READ_FAULT ? SYNC_NO_READ : SYNC_NO_WRITE);
+                    m_pImage->Delete(pFile);
+                }
+                else
+                {
+                    m_wFiles++;
+                    m_dwSize += File.dwSize;
+                }
+
+                fclose(hFile);
+
+                pReport(pParam, *pItem);
+
+                // A host read error only skips a new file. It stops the pass after a replace, so that the held directory keeps the old file
+                if (pItem->nResult == SYNC_NO_READ && pItem->nAction == SYNC_CREATE)
+                    dwError = NO_ERROR;
+
+            }
+
+        }
+    }
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write the directory once when every change made it (dwError 0), otherwise drop it
+//---------------------------------------------------------------------------------
+
+DWORD CSync::End(DWORD dwError)
+{
+
+    bool    bHeld = m_bHeld;
+
+    m_bHeld = false;
+
+    if (dwError == NO_ERROR)
+        return m_pImage->Commit();
+
+    // Nothing written while held made it to the disk
+    if (bHeld)
+    {
+        m_pImage->Drop();
+        m_wFiles = 0;
+        m_wDeleted = 0;
+        m_dwSize = 0;
+    }
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Plan results and totals
+//---------------------------------------------------------------------------------
+
+bool CSync::Held()
+{
+    return m_bHeld;
+}
+
+WORD CSync::Files()
+{
+    return m_wFiles;
+}
+
+WORD CSync::Deleted()
+{
+    return m_wDeleted;
+}
+
+WORD CSync::Unchanged()
+{
+    return m_wSame;
+}
+
+DWORD CSync::Bytes()
+{
+    return m_dwSize;
+}
+
+//---------------------------------------------------------------------------------
+// Forget the last plan (the comparison buffer is kept)
+//---------------------------------------------------------------------------------
+
+void CSync::Reset()
+{
+
+    if (m_bHeld)
+        m_pImage->Drop();
+
+    free(m_pItems);
+
+    m_pItems = NULL;
+    m_nItems = 0;
+    m_bHeld = false;
+    m_wFiles = 0;
+    m_wDeleted = 0;
+    m_wSame = 0;
+    m_dwSize = 0;
+
+}
+
+//---------------------------------------------------------------------------------
+// Plan one host file (or a name no longer on the host)
+//---------------------------------------------------------------------------------
+
+DWORD CSync::Item(const char* pName, SYNC_ITEM& Item)
+{
+
+    char        szPath[PATH_MAX];
+    OSI_FILE    File;
+    void*       pFile;
+    struct stat st;
+    bool        bHost;
+
+    memset(&Item, 0, sizeof(SYNC_ITEM));
+
+    snprintf(szPath, sizeof(szPath), "%s/%s", m_pDir, pName);
+
+    // Subdirectories and other special files are not synced
+    if ((bHost = (stat(szPath, &st) == 0)) && !S_ISREG(st.st_mode))
+        return ERROR_NOT_SUPPORTED;
+
+    strncpy(Item.szHost, pName, sizeof(Item.szHost) - 1);
+    Win2TRS(pName, Item.cName);
+
+    if (bHost)
+    {
+        Item.dwSize = st.st_size;
+        Item.tTime = st.st_mtime;
+    }
+
+    // A file only on the host is created
+    if (m_pImage->Find(&pFile, pName) != NO_ERROR)
+    {
+
+        char    szName[9] = {}, szType[4] = {};
+
+        memcpy(szName, Item.cName, 8);
+        memcpy(szType, &Item.cName[8], 3);
+        FmtName(szName, szType, m_pImage->Divider(), Item.szFile);
+
+        Item.nAction = (bHost ? SYNC_CREATE : SYNC_NONE);
+
+    }
+    else
+    {
+
+        m_pImage->GetFile(pFile, File);
+        FmtName(File.szName, File.szType, m_pImage->Divider(), Item.szFile);
+
+        Item.dwOld = File.dwSize;
+
+        // The files the flags leave out are never touched
+        if ((File.bSystem && !(m_dwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(m_dwFlags & V80_FLAG_INVISIBLE)))
+        {
+            Item.nAction = (bHost ? SYNC_SKIP : SYNC_NONE);
+            Item.pReason = "Skipped";
+        }
+        else if (!bHost)
+            Item.nAction = SYNC_DELETE;
+        else if ((off_t)File.dwSize != st.st_size || !Same(pFile, szPath))
+            Item.nAction = SYNC_REPLACE;
+        else
+            Item.nAction = SYNC_NONE;
+
+    }
+
+    // The size must fit the directory entry
+    if (bHost && (off_t)Item.dwSize != st.st_size)
+    {
+        Item.nAction = SYNC_SKIP;
+        Item.pReason = "Invalid size!";
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Compare the contents of an image file and a host file of the same size
+//---------------------------------------------------------------------------------
+
+bool CSync::Same(void* pFile, const char* pPath)
+{
+
+    unsigned long long  qwImage = FNV_OFFSET;
+    unsigned long long  qwHost = FNV_OFFSET;
+    FILE*   hFile;
+    DWORD   dwPos = 0;
+    DWORD   dwBytes;
+    size_t  nBytes;
+    bool    bSame = true;
+
+    if ((hFile = fopen(pPath, "r")) == NULL)
+        return false;
+
+    // Hash both one chunk at a time (a file that can't be read counts as different)
+    do
+    {
+
+        if ((nBytes = fread(&m_pBuffer[V80_CHUNK], 1, V80_CHUNK, hFile)) == 0)
+            break;
+
+        qwHost = Hash(&m_pBuffer[V80_CHUNK], nBytes, qwHost);
+
+        if (m_pImage->Read(pFile, dwPos, m_pBuffer, (dwBytes = V80_CHUNK)) != NO_ERROR || dwBytes != nBytes)
+        {
+            bSame = false;
+            break;
+        }
+
+        qwImage = Hash(m_pBuffer, dwBytes, qwImage);
+        dwPos += dwBytes;
+
+    }
+    while (nBytes == V80_CHUNK);
+
+    if (ferror(hFile))
+        bSame = false;
+
+    fclose(hFile);
+
+    return (bSame && qwImage == qwHost);
+
+}
+
+//---------------------------------------------------------------------------------
+// Run a pass after each burst of host directory changes, until *pStop is set
+//---------------------------------------------------------------------------------
+
+DWORD CSync::Watch(const char* pDir, SYNC_PASS pPass, void* pParam, volatile sig_atomic_t* pStop)
+{
+
+    char        Buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event* pEvent;
+    struct pollfd   Poll;
+    char**      pNames = NULL;
+    char**      pMore;
+    int         nNames = 0;
+    int         nReady;
+    int         x, y;
+    ssize_t     nRead;
+    bool        bAll = false;
+    DWORD       dwError = NO_ERROR;
+
+    if ((Poll.fd = inotify_init1(IN_CLOEXEC)) == -1)
+        return ERROR_NOT_SUPPORTED;
+
+    // Files written, moved in or out, or deleted (not created: they are caught when closed)
+    if (inotify_add_watch(Poll.fd, pDir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF) == -1)
+    {
+        dwError = ERROR_NOT_FOUND;
+        goto Done;
+    }
+
+    Poll.events = POLLIN;
+
+    while (true)
+    {
+
+        // Wait for a change, then until the directory has been quiet for a while (once stopped, only drain the events)
+        nReady = poll(&Poll, 1, (*pStop ? 0 : (nNames > 0 || bAll ? V80_SYNC_QUIET : -1)));
+
+        if (nReady == -1 && errno == EINTR)
+            continue;
+
+        if (nReady == -1)
+        {
+            dwError = ERROR_READ_FAULT;
+            break;
+        }
+
+        if (nReady == 0)
+        {
+
+            // Stopped with nothing pending
+            if (nNames == 0 && !bAll)
+                break;
+
+            dwError = pPass(pParam, (bAll ? NULL : pNames), nNames);
+
+            for (x = 0; x < nNames; x++)
+                free(pNames[x]);
+            nNames = 0;
+            bAll = false;
+
+            // Running out of space is left for the user to sort out, anything else stops the watch
+            if (dwError != NO_ERROR && dwError != ERROR_DISK_FULL)
+                break;
+
+            dwError = NO_ERROR;
+            continue;
+
+        }
+
+        if ((nRead = read(Poll.fd, Buffer, sizeof(Buffer))) <= 0)
+            continue;
+
+        for (x = 0; x < nRead; x += sizeof(struct inotify_event) + pEvent->len)
+        {
+
+            pEvent = (const struct inotify_event*)&Buffer[x];
+
+            // The directory is gone
+            if (pEvent->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                dwError = ERROR_NOT_FOUND;
+                goto Done;
+            }
+
+            // Lost events: compare the whole directory
+            if (pEvent->mask & IN_Q_OVERFLOW)
+                bAll = true;
+
+            if (pEvent->len == 0 || pEvent->name[0] == '.' || bAll)
+                continue;
+
+            // Remember each name once
+            for (y = 0; y < nNames && strcmp(pNames[y], pEvent->name) != 0; y++);
+
+            if (y < nNames)
+                continue;
+
+            if ((pMore = (char**)realloc(pNames, (nNames + 1) * sizeof(char*))) != NULL)
+                pNames = pMore;
+
+            if (pMore == NULL || (pNames[nNames] = strdup(pEvent->name)) == NULL)
+                bAll = true;
+            else
+                nNames++;
+
+        }
+
+    }
+
+    Done:
+    for (x = 0; x < nNames; x++)
+        free(pNames[x]);
+    free(pNames);
+
+    close(Poll.fd);
+
+    return dwError;
+
+}
@@ -0,0 +1,118 @@
+/**
+ @file sync.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Sync of a host directory into a disk image
+//---------------------------------------------------------------------------------
+//
+// Plan() compares each host file with the image file by the same TRS name (size,
+// then contents) and lists what a pass creates, replaces and deletes. Begin() holds
+// the directory and checks that the changes fit, Apply() makes them (deletions
+// first) and End() writes the directory once, or drops it after a failure so that
+// the image is left as it was.
+//
+// Watch() follows the changes of the host directory and hands the names changed
+// over once it has been quiet for V80_SYNC_QUIET ms, so that a burst of writes
+// turns into a single pass.
+//
+//---------------------------------------------------------------------------------
+
+#include <limits.h>
+#include <signal.h>
+
+class   CImage;
+
+enum    SYNC_ACTION                                                                 // What a pass does with a file
+{
+    SYNC_NONE,                                                                      // Same on both sides
+    SYNC_CREATE,                                                                    // Only on the host
+    SYNC_REPLACE,                                                                   // Different on the host
+    SYNC_DELETE,                                                                    // Only on the image
+    SYNC_SKIP                                                                       // Left alone (pReason tells why)
+};
+
+enum    SYNC_RESULT                                                                 // How the change of a file went
+{
+    SYNC_DONE,                                                                      // Changed (or skipped, as planned)
+    SYNC_NO_OPEN,                                                                   // The host file can't be opened (the file is skipped)
+    SYNC_NO_DELETE,                                                                 // The image file can't be deleted or replaced
+    SYNC_NO_CREATE,                                                                 // The image file can't be created
+    SYNC_NO_READ,                                                                   // The host file can't be read
+    SYNC_NO_WRITE                                                                   // The image file can't be written
+};
+
+struct  SYNC_ITEM                                                                   // One file of a pass
+{
+    char        szHost[NAME_MAX+1];                                                 // Host filename (empty: the file is only on the image)
+    char        szFile[13];                                                         // Formatted image filename
+    char        cName[11];                                                          // TRS filename
+    SYNC_ACTION nAction;                                                            // What the pass does with the file
+    SYNC_RESULT nResult;                                                            // How it went (set by Apply)
+    const char* pReason;                                                            // Why the file is skipped
+    DWORD       dwSize;                                                             // Host file size
+    DWORD       dwOld;                                                              // Size of the image file replaced or deleted
+    time_t      tTime;                                                              // Host modification time
+};
+
+typedef void  (*SYNC_REPORT)(void* pParam, const SYNC_ITEM& Item);                  // Called for each file Apply() changes or skips
+typedef DWORD (*SYNC_PASS)(void* pParam, char** pNames, int nNames);                // Called by Watch() with the names changed (NULL: every file)
+
+class   CSync
+{
+protected:
+    CImage*     m_pImage;                                                           // Image being synced
+    DWORD       m_dwFlags;                                                          // User flags (V80_FLAG_SYSTEM and V80_FLAG_INVISIBLE)
+    const char* m_pDir;                                                             // Host directory
+    SYNC_ITEM*  m_pItems;                                                           // Plan
+    int         m_nItems;                                                           // Number of files in the plan
+    BYTE*       m_pBuffer;                                                          // Comparison buffer (two chunks)
+    bool        m_bHeld;                                                            // The directory is held since Begin()
+    WORD        m_wFiles;                                                           // Files created or replaced
+    WORD        m_wDeleted;                                                         // Files deleted
+    WORD        m_wSame;                                                            // Files left as they were
+    DWORD       m_dwSize;                                                           // Bytes written
+public:
+                CSync();                                                            // Initialize member variables
+                ~CSync();                                                           // Release allocated memory
+    DWORD       Plan(CImage* pImage, const char* pDir, char** pNames = NULL, int nNames = 0, DWORD dwFlags = 0); // Compare the host files with the image (pNames: only those)
+    int         Changes();                                                          // Number of files to create, replace or delete
+    DWORD       Begin(DWORD& dwNeeded, DWORD& dwAvailable, bool& bEntries);         // Hold the directory and check that the changes fit (ERROR_DISK_FULL: they don't)
+    DWORD       Apply(SYNC_REPORT pReport, void* pParam);                           // Delete, then create or replace the files
+    DWORD       End(DWORD dwError);                                                 // Write the directory (dwError 0) or drop it
+    bool        Held();                                                             // Check whether the directory is held (a failed pass leaves the image as it was)
+    WORD        Files();                                                            // Number of files created or replaced
+    WORD        Deleted();                                                          // Number of files deleted
+    WORD        Unchanged();                                                        // Number of files left as they were
+    DWORD       Bytes();                                                            // Number of bytes written
+    static DWORD Watch(const char* pDir, SYNC_PASS pPass, void* pParam, volatile sig_atomic_t* pStop); // Run a pass after each burst of changes, until *pStop
+protected:
+    void        Reset();                                                            // Forget the last plan
+    DWORD       Item(const char* pName, SYNC_ITEM& Item);                           // Plan one host file
+    bool        Same(void* pFile, const char* pPath);                               // Compare an image file with a host file of the same size
+};
@@ -0,0 +1,553 @@
+/**
+ @file tar.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Tar archive stream (POSIX ustar with pax extended headers)
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <stdlib.h>
+#include <time.h>
+#include "v80.h"
+#include "vdi.h"
+#include "osi.h"
+#include "tar.h"
+
+//---------------------------------------------------------------------------------
+// Host permission bits of each TRS-80 protection level (0:Full ... 7:No Access)
+//---------------------------------------------------------------------------------
+
+static const DWORD  gdwTarMode[8] = { 0644, 0644, 0644, 0644, 0644, 0444, 0111, 0000 };
+
+//---------------------------------------------------------------------------------
+// Append a "length key=value\n" pax record (the length counts its own digits)
+//---------------------------------------------------------------------------------
+
+static void PaxRecord(char* pBuffer, DWORD& dwLength, const char* pKey, const char* pValue)
+{
+
+    int nBase = strlen(pKey) + strlen(pValue) + 3;                                  // Space, equal sign and newline
+    int nLength;
+
+    // Find the total length that holds its own digits
+    for (nLength = nBase + 1; nBase + snprintf(NULL, 0, "%d", nLength) != nLength; nLength++);
+
+    dwLength += snprintf(&pBuffer[dwLength], TAR_PAX_MAX - dwLength, "%d %s=%s\n", nLength, pKey, pValue);
+
+}
+
+//---------------------------------------------------------------------------------
+// Parse an octal header field (false: not a number)
+//---------------------------------------------------------------------------------
+
+static bool Octal(const char* pField, int nLength, unsigned long long& qwValue)
+{
+
+    int x = 0;
+
+    qwValue = 0;
+
+    // Leading spaces are allowed, the GNU base-256 encoding is not (no TRS-80 file needs it)
+    while (x < nLength && pField[x] == ' ')
+        x++;
+
+    if (x == nLength || pField[x] < '0' || pField[x] > '7')
+        return false;
+
+    for (; x < nLength && pField[x] >= '0' && pField[x] <= '7'; x++)
+        qwValue = (qwValue << 3) + (pField[x] - '0');
+
+    return true;
+
+}
+
+//---------------------------------------------------------------------------------
+// Initialize member variables
+//---------------------------------------------------------------------------------
+
+CTar::CTar()
+:   m_hFile(NULL), m_dwLeft(0), m_dwPad(0), m_qwBytes(0)
+{
+}
+
+//---------------------------------------------------------------------------------
+// Start writing an archive to an open file
+//---------------------------------------------------------------------------------
+
+void CTar::Create(FILE* hFile)
+{
+    m_hFile = hFile;
+    m_dwLeft = 0;
+    m_dwPad = 0;
+    m_qwBytes = 0;
+}
+
+//---------------------------------------------------------------------------------
+// Start a member: its pax extended header, then its ustar header
+//---------------------------------------------------------------------------------
+
+DWORD CTar::Header(const char* pName, const OSI_FILE& File)
+{
+
+    TAR_HEADER  Header;
+    char        cPax[TAR_PAX_MAX];
+    char        szValue[16];
+    char        szPaxName[100];
+    DWORD       dwPax = 0;
+    long long   qwTime = 0;
+    struct tm   tm = {};
+    DWORD       dwError;
+
+    // The file date becomes the modification time, at midnight UTC (TRSDOS 1.3 dates have no day)
+    if (File.Date.wYear != 0 && File.Date.nMonth != 0)
+    {
+        tm.tm_year = File.Date.wYear - 1900;
+        tm.tm_mon = File.Date.nMonth - 1;
+        tm.tm_mday = (File.Date.nDay != 0 ? File.Date.nDay : 1);
+        qwTime = timegm(&tm);
+
+        snprintf(szValue, sizeof(szValue), "%04d-%02d-%02d", File.Date.wYear, File.Date.nMonth, File.Date.nDay);
+        PaxRecord(cPax, dwPax, "SCHILY.xattr.user.vdk80.date", szValue);
+    }
+
+    // The attributes with no ustar field of their own
+    snprintf(szValue, sizeof(szValue), "%d", File.nAccess & 7);
+    PaxRecord(cPax, dwPax, "SCHILY.xattr.user.vdk80.access", szValue);
+    PaxRecord(cPax, dwPax, "SCHILY.xattr.user.vdk80.system", (File.bSystem ? "1" : "0"));
+    PaxRecord(cPax, dwPax, "SCHILY.xattr.user.vdk80.invisible", (File.bInvisible ? "1" : "0"));
+    PaxRecord(cPax, dwPax, "SCHILY.xattr.user.vdk80.modified", (File.bModified ? "1" : "0"));
+    snprintf(szValue, sizeof(szValue), "%d", File.nLRL);
+    PaxRecord(cPax, dwPax, "SCHILY.xattr.user.vdk80.lrl", szValue);
+
+    // Extended header, then the records in a block of their own
+    snprintf(szPaxName, sizeof(szPaxName), "PaxHeaders/%s", pName);
+
+    if ((dwError = Block(Header, 'x', szPaxName, dwPax, 0644, qwTime)) != NO_ERROR)
+        return dwError;
+
+    m_dwLeft = dwPax;
+    m_dwPad = TAR_BLOCK - dwPax;
+
+    if ((dwError = Write((BYTE*)cPax, dwPax)) != NO_ERROR || (dwError = Pad()) != NO_ERROR)
+        return dwError;
+
+    // The file itself
+    if ((dwError = Block(Header, '0', pName, File.dwSize, gdwTarMode[File.nAccess & 7], qwTime)) != NO_ERROR)
+        return dwError;
+
+    m_dwLeft = File.dwSize;
+    m_dwPad = (TAR_BLOCK - File.dwSize % TAR_BLOCK) % TAR_BLOCK;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Append member data
+//---------------------------------------------------------------------------------
+
+DWORD CTar::Write(const BYTE* pBuffer, DWORD dwBytes)
+{
+
+    if (dwBytes > m_dwLeft)
+        return ERROR_INVALID_PARAMETER;
+
+    if (fwrite(pBuffer, 1, dwBytes, m_hFile) != dwBytes)
+        return ERROR_WRITE_FAULT;
+
+    m_dwLeft -= dwBytes;
+    m_qwBytes += dwBytes;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Account for member data written straight to the file descriptor
+//---------------------------------------------------------------------------------
+
+void CTar::Advance(DWORD dwBytes)
+{
+    m_dwLeft -= dwBytes;
+    m_qwBytes += dwBytes;
+}
+
+//---------------------------------------------------------------------------------
+// Zero-fill the rest of the member (after a read error) and its last block
+//---------------------------------------------------------------------------------
+
+DWORD CTar::Pad()
+{
+
+    DWORD dwError = Zero(m_dwLeft + m_dwPad);
+
+    m_dwLeft = 0;
+    m_dwPad = 0;
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write the two end-of-archive blocks and fill the last record
+//---------------------------------------------------------------------------------
+
+DWORD CTar::End()
+{
+
+    DWORD dwError;
+
+    if ((dwError = Zero(2 * TAR_BLOCK)) != NO_ERROR)
+        return dwError;
+
+    if ((dwError = Zero((TAR_RECORD - m_qwBytes % TAR_RECORD) % TAR_RECORD)) != NO_ERROR)
+        return dwError;
+
+    return (fflush(m_hFile) == 0 ? NO_ERROR : ERROR_WRITE_FAULT);
+
+}
+
+//---------------------------------------------------------------------------------
+// Fill in a header block and write it
+//---------------------------------------------------------------------------------
+
+DWORD CTar::Block(TAR_HEADER& Header, char cType, const char* pName, DWORD dwSize, DWORD dwMode, long long qwTime)
+{
+
+    DWORD   dwSum = 0;
+
+    memset(&Header, 0, sizeof(Header));
+
+    strncpy(Header.cName, pName, sizeof(Header.cName));
+    snprintf(Header.cMode, sizeof(Header.cMode), "%07o", dwMode);
+    snprintf(Header.cUid, sizeof(Header.cUid), "%07o", 0);
+    snprintf(Header.cGid, sizeof(Header.cGid), "%07o", 0);
+    snprintf(Header.cSize, sizeof(Header.cSize), "%011o", dwSize);
+    snprintf(Header.cMtime, sizeof(Header.cMtime), "%011llo", qwTime);
+    Header.cTypeflag = cType;
+    memcpy(Header.cMagic, "ustar", 6);
+    memcpy(Header.cVersion, "00", 2);
+
+    // The checksum is computed with its own field filled with spaces
+    memset(Header.cChksum, ' ', sizeof(Header.cChksum));
+
+    for (int x = 0; x < TAR_BLOCK; x++)
+        dwSum += ((BYTE*)&Header)[x];
+
+    snprintf(Header.cChksum, sizeof(Header.cChksum) - 1, "%06o", dwSum);
+
+    if (fwrite(&Header, 1, sizeof(Header), m_hFile) != sizeof(Header))
+        return ERROR_WRITE_FAULT;
+
+    m_qwBytes += sizeof(Header);
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write zero bytes
+//---------------------------------------------------------------------------------
+
+DWORD CTar::Zero(DWORD dwBytes)
+{
+
+    static const BYTE   Zeros[TAR_BLOCK] = {};
+    DWORD               dwLength;
+
+    for (; dwBytes > 0; dwBytes -= dwLength)
+    {
+
+        dwLength = (dwBytes < sizeof(Zeros) ? dwBytes : sizeof(Zeros));
+
+        if (fwrite(Zeros, 1, dwLength, m_hFile) != dwLength)
+            return ERROR_WRITE_FAULT;
+
+        m_qwBytes += dwLength;
+
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Start reading an archive from an open file
+//---------------------------------------------------------------------------------
+
+void CTar::Open(FILE* hFile)
+{
+    m_hFile = hFile;
+    m_dwLeft = 0;
+    m_dwPad = 0;
+    m_qwBytes = 0;
+}
+
+//---------------------------------------------------------------------------------
+// Move to the next file member and return its host name and attributes
+//---------------------------------------------------------------------------------
+
+DWORD CTar::Next(char* pName, size_t nSize, OSI_FILE& File)
+{
+
+    TAR_HEADER          Header;
+    char                cPax[TAR_PAX_READ + 1];
+    char                szPath[256] = "";
+    char*               pRecord;
+    char*               pKey;
+    char*               pValue;
+    char*               pEnd;
+    unsigned long long  qwSize;
+    unsigned long long  qwMode = 0644;
+    unsigned long long  qwTime = 0;
+    DWORD               dwSum;
+    DWORD               dwLength;
+    int                 nAccess = -1;
+    int                 nSystem = -1;
+    int                 nInvisible = -1;
+    int                 nModified = -1;
+    int                 nLRL = -1;
+    int                 nYear = 0;
+    int                 nMonth = 0;
+    int                 nDay = 0;
+    bool                bTime = false;
+    time_t              nTime;
+    struct tm           tm;
+    DWORD               dwError;
+
+    while (true)
+    {
+
+        // Skip whatever is left of the previous member
+        if ((dwError = Skip(m_dwLeft + m_dwPad)) != NO_ERROR)
+            return dwError;
+
+        m_dwLeft = 0;
+        m_dwPad = 0;
+
+        // An archive may end without its zero blocks
+        if (fread(&Header, 1, sizeof(Header), m_hFile) != sizeof(Header))
+            return ERROR_NO_MORE_FILES;
+
+        m_qwBytes += sizeof(Header);
+
+        if (Header.cName[0] == 0)
+            return ERROR_NO_MORE_FILES;
+
+        // The checksum is computed with its own field filled with spaces
+        if (!Octal(Header.cChksum, sizeof(Header.cChksum), qwSize))
+            return ERROR_FILE_CORRUPT;
+
+        dwSum = qwSize;
+        memset(Header.cChksum, ' ', sizeof(Header.cChksum));
+
+        for (int x = 0; x < TAR_BLOCK; x++)
+            dwSum -= ((BYTE*)&Header)[x];
+
+        if (dwSum != 0 || !Octal(Header.cSize, sizeof(Header.cSize), qwSize) || qwSize > 0xFFFFFFFF)
+            return ERROR_FILE_CORRUPT;
+
+        m_dwLeft = qwSize;
+        m_dwPad = (TAR_BLOCK - m_dwLeft % TAR_BLOCK) % TAR_BLOCK;
+
+        // pax extended header: the records apply to the next member
+        if (Header.cTypeflag == 'x')
+        {
+
+            if (m_dwLeft > TAR_PAX_READ)
+                continue;
+
+            if ((dwError = Read((BYTE*)cPax, (dwLength = m_dwLeft))) != NO_ERROR)
+                return dwError;
+
+            // Each record is "length key=value\n"
+            for (pRecord = cPax; pRecord < cPax + dwLength; pRecord = pEnd)
+            {
+
+                unsigned long nRecord = strtoul(pRecord, &pKey, 10);
+
+                if (nRecord == 0 || *pKey != ' ' || pRecord + nRecord > cPax + dwLength)
+                    break;
+
+                pEnd = pRecord + nRecord;
+                pEnd[-1] = 0;
+                pKey++;
+
+                if ((pValue = strchr(pKey, '=')) == NULL)
+                    continue;
+
+                *pValue++ = 0;
+
+                if (strcmp(pKey, "path") == 0)
+                    snprintf(szPath, sizeof(szPath), "%s", pValue);
+                else if (strcmp(pKey, "mtime") == 0)
+                {
+                    qwTime = strtoull(pValue, NULL, 10);
+                    bTime = true;
+                }
+                else if (strcmp(pKey, "SCHILY.xattr.user.vdk80.date") == 0)
+                    sscanf(pValue, "%d-%d-%d", &nYear, &nMonth, &nDay);
+                else if (strcmp(pKey, "SCHILY.xattr.user.vdk80.access") == 0)
+                    nAccess = atoi(pValue) & 7;
+                else if (strcmp(pKey, "SCHILY.xattr.user.vdk80.system") == 0)
+                    nSystem = atoi(pValue);
+                else if (strcmp(pKey, "SCHILY.xattr.user.vdk80.invisible") == 0)
+                    nInvisible = atoi(pValue);
+                else if (strcmp(pKey, "SCHILY.xattr.user.vdk80.modified") == 0)
+                    nModified = atoi(pValue);
+                else if (strcmp(pKey, "SCHILY.xattr.user.vdk80.lrl") == 0)
+                    nLRL = atoi(pValue) & 0xFF;
+
+            }
+
+            continue;
+
+        }
+
+        // GNU long name: the name of the next member
+        if (Header.cTypeflag == 'L')
+        {
+
+            dwLength = (m_dwLeft < sizeof(szPath) - 1 ? m_dwLeft : sizeof(szPath) - 1);
+
+            if ((dwError = Read((BYTE*)szPath, dwLength)) != NO_ERROR)
+                return dwError;
+
+            szPath[dwLength] = 0;
+            continue;
+
+        }
+
+        // Regular files only (the records of a skipped member go with it)
+        if (Header.cTypeflag != '0' && Header.cTypeflag != 0 && Header.cTypeflag != '7')
+        {
+            if (Header.cTypeflag != 'g')
+            {
+                szPath[0] = 0;
+                nAccess = nSystem = nInvisible = nModified = nLRL = -1;
+                nYear = nMonth = nDay = 0;
+                bTime = false;
+            }
+            continue;
+        }
+
+        break;
+
+    }
+
+    // Host name: pax path, GNU long name, or ustar prefix/name
+    if (szPath[0] != 0)
+        snprintf(pName, nSize, "%s", szPath);
+    else if (Header.cPrefix[0] != 0)
+        snprintf(pName, nSize, "%.*s/%.*s", (int)strnlen(Header.cPrefix, sizeof(Header.cPrefix)), Header.cPrefix, (int)strnlen(Header.cName, sizeof(Header.cName)), Header.cName);
+    else
+        snprintf(pName, nSize, "%.*s", (int)strnlen(Header.cName, sizeof(Header.cName)), Header.cName);
+
+    Octal(Header.cMode, sizeof(Header.cMode), qwMode);
+
+    if (!bTime)
+        Octal(Header.cMtime, sizeof(Header.cMtime), qwTime);
+
+    memset(&File, 0, sizeof(File));
+    File.dwSize = m_dwLeft;
+
+    // The exact TRS-80 date, otherwise the modification time (a zero time means no date)
+    nTime = qwTime;
+
+    if (nYear == 0 && qwTime != 0 && gmtime_r(&nTime, &tm) != NULL)
+    {
+        nYear = tm.tm_year + 1900;
+        nMonth = tm.tm_mon + 1;
+        nDay = tm.tm_mday;
+    }
+
+    File.Date.wYear = nYear;
+    File.Date.nMonth = nMonth;
+    File.Date.nDay = nDay;
+
+    // The protection level, otherwise the nearest one to the permission bits
+    if (nAccess < 0)
+        nAccess = ((qwMode & 0222) ? OSI_PROT_FULL : (qwMode & 0444) ? OSI_PROT_READ : (qwMode & 0111) ? OSI_PROT_EXECUTE : OSI_PROT_NOACCESS);
+
+    File.nAccess = nAccess;
+    File.bSystem = (nSystem > 0);
+    File.bInvisible = (nInvisible > 0);
+    File.bModified = (nModified != 0);
+    File.nLRL = (nLRL < 0 ? 0 : nLRL);
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Read member data
+//---------------------------------------------------------------------------------
+
+DWORD CTar::Read(BYTE* pBuffer, DWORD dwBytes)
+{
+
+    if (dwBytes > m_dwLeft)
+        return ERROR_INVALID_PARAMETER;
+
+    // A short read means a truncated archive
+    if (fread(pBuffer, 1, dwBytes, m_hFile) != dwBytes)
+        return ERROR_READ_FAULT;
+
+    m_dwLeft -= dwBytes;
+    m_qwBytes += dwBytes;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Read and discard bytes (works on pipes as well)
+//---------------------------------------------------------------------------------
+
+DWORD CTar::Skip(DWORD dwBytes)
+{
+
+    BYTE    Buffer[TAR_BLOCK];
+    DWORD   dwLength;
+
+    for (; dwBytes > 0; dwBytes -= dwLength)
+    {
+
+        dwLength = (dwBytes < sizeof(Buffer) ? dwBytes : sizeof(Buffer));
+
+        if (fread(Buffer, 1, dwLength, m_hFile) != dwLength)
+            return ERROR_READ_FAULT;
+
+        m_qwBytes += dwLength;
+
+    }
+
+    return NO_ERROR;
+
+}
@@ -0,0 +1,95 @@
+/**
+ @file tar.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Tar archive stream (POSIX ustar with pax extended headers)
+//---------------------------------------------------------------------------------
+//
+// Every member is a plain file named NAME.EXT and is preceded by a pax extended
+// header carrying its TRS-80 attributes as user.vdk80.* extended attributes
+// (SCHILY.xattr records, restored by tar --xattrs). The ustar fields hold the
+// nearest host equivalents: the file date as mtime (midnight UTC, 0 when the file
+// has no date) and the protection level as the permission bits.
+//
+// Reading takes any ustar, pax or GNU archive: directories, links and other special
+// members are skipped, and files without the VDK80 records get their attributes
+// from the ustar fields.
+//
+//---------------------------------------------------------------------------------
+
+#define TAR_EXT         ".tar"                                                      // Extension of the archives written in batch mode
+#define TAR_BLOCK       512                                                         // Header and data block size
+#define TAR_RECORD      10240                                                       // The archive ends on a record boundary (20 blocks)
+#define TAR_PAX_MAX     TAR_BLOCK                                                   // Room for the pax records of one member
+#define TAR_PAX_READ    8192                                                        // Largest pax header read back (larger ones are skipped)
+
+struct  TAR_HEADER                                                                  // ustar Header Block
+{
+    char        cName[100];                                                         // File name
+    char        cMode[8];                                                           // Permission bits (octal)
+    char        cUid[8];                                                            // Owner user ID (octal)
+    char        cGid[8];                                                            // Owner group ID (octal)
+    char        cSize[12];                                                          // File size (octal)
+    char        cMtime[12];                                                         // Modification time (octal)
+    char        cChksum[8];                                                         // Header checksum (octal, computed with spaces here)
+    char        cTypeflag;                                                          // Member type ('0': file, 'x': pax extended header)
+    char        cLinkname[100];                                                     // Link target (unused)
+    char        cMagic[6];                                                          // "ustar"
+    char        cVersion[2];                                                        // "00"
+    char        cUname[32];                                                         // Owner user name
+    char        cGname[32];                                                         // Owner group name
+    char        cDevmajor[8];                                                       // Device major number (unused)
+    char        cDevminor[8];                                                       // Device minor number (unused)
+    char        cPrefix[155];                                                       // Name prefix (unused)
+    char        cPad[12];                                                           // Up to the block size
+};
+
+class   CTar
+{
+protected:
+    FILE*               m_hFile;                                                    // Archive file handle
+    DWORD               m_dwLeft;                                                   // Data bytes of the current member still to come
+    DWORD               m_dwPad;                                                    // Zero bytes that complete its last block
+    unsigned long long  m_qwBytes;                                                  // Archive bytes so far
+public:
+                        CTar();                                                     // Initialize member variables
+    void                Create(FILE* hFile);                                        // Start writing an archive to an open file
+    DWORD               Header(const char* pName, const OSI_FILE& File);            // Start a member (pax header and ustar header)
+    DWORD               Write(const BYTE* pBuffer, DWORD dwBytes);                  // Append member data
+    void                Advance(DWORD dwBytes);                                     // Account for member data written straight to the descriptor
+    DWORD               Pad();                                                      // Zero-fill the rest of the member and its last block
+    DWORD               End();                                                      // Write the end-of-archive blocks and fill the last record
+    void                Open(FILE* hFile);                                          // Start reading an archive from an open file
+    DWORD               Next(char* pName, size_t nSize, OSI_FILE& File);            // Move to the next file member (host name and attributes)
+    DWORD               Read(BYTE* pBuffer, DWORD dwBytes);                         // Read member data
+protected:
+    DWORD               Block(TAR_HEADER& Header, char cType, const char* pName, DWORD dwSize, DWORD dwMode, long long qwTime); // Fill in and write a header block
+    DWORD               Zero(DWORD dwBytes);                                        // Write zero bytes
+    DWORD               Skip(DWORD dwBytes);                                        // Read and discard bytes
+};
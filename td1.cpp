@@ -104,8 +104,8 @@ DWORD CTD1::Load(CVDI* pVDI, DWORD dwFlags)
         goto Done;
     }
 
-    // Load directory into memory
-    if ((dwError = DirRW(TD4_DIR_READ)) != NO_ERROR)
+    // Load GAT and HIT into memory (the directory entries are read on first use)
+    if ((dwError = DirRW(TD4_DIR_OPEN)) != NO_ERROR)
         goto Done;
 
     // Calculate disk parameters
@@ -34,6 +34,7 @@
 #include "windows.h"
 #include <stdio.h>
 #include "v80.h"
+#include "stats.h"
 #include "vdi.h"
 #include "osi.h"
 #include "td4.h"
@@ -105,8 +106,8 @@ DWORD CTD3::Load(CVDI* pVDI, DWORD dwFlags)
         goto Done;
     }
 
-    // Load directory into memory
-    if ((dwError = DirRW(TD4_DIR_READ)) != NO_ERROR)
+    // Load GAT and HIT into memory (the directory entries are read on first use)
+    if ((dwError = DirRW(TD4_DIR_OPEN)) != NO_ERROR)
         goto Done;
 
     // Calculate the disk parameters
@@ -295,6 +296,7 @@ void CTD3::GetFile(void* pFile, OSI_FILE& File)
     File.bSystem    = ((TD3_FPDE*)pFile)->nAttributes & TD4_ATTR0_SYSTEM;       // [PATCH]
     File.bInvisible = ((TD3_FPDE*)pFile)->nAttributes & TD4_ATTR0_INVISIBLE;    // [PATCH]
     File.bModified  = false;                                                    // [PATCH]
+    File.nLRL       = ((TD3_FPDE*)pFile)->nLRL;
 
 }
 
@@ -331,6 +333,9 @@ DWORD CTD3::SetFile(void* pFile, OSI_FILE& File, bool bCommit)
     ((TD3_FPDE*)pFile)->nAttributes &= ~TD4_ATTR0_INVISIBLE;                    // [PATCH]
     ((TD3_FPDE*)pFile)->nAttributes |= (TD4_ATTR0_INVISIBLE * File.bInvisible); // [PATCH]
 
+    // Set logical record length
+    ((TD3_FPDE*)pFile)->nLRL = File.nLRL;
+
     return (bCommit ? DirRW(TD4_DIR_WRITE) : NO_ERROR);
 
 }
@@ -413,27 +418,26 @@ DWORD CTD3::FixGAT()
 DWORD CTD3::ScanHIT(void** pFile, TD4_HIT nMode, BYTE nHash)
 {
 
-    static int nLastCol = -1;
-    static int nLastRow = 0;
-
     int nCols, nCol;
     int nRows, nRow;
     int nSlot;
 
+    STAT_COUNT(STAT_HIT_SCAN);
+
     BYTE nEntriesPerSector = m_DG.LT.wSectorSize / sizeof(TD3_FPDE);
 
     DWORD dwError = NO_ERROR;
 
-    // If mode is any "Find First", reset static variables
+    // If mode is any "Find First", reset the scan position
     if (nMode != TD4_HIT_FIND_NEXT_USED)
     {
-        nLastCol = -1;
-        nLastRow = 0;
+        m_nLastCol = -1;
+        m_nLastRow = 0;
     }
 
-    // Retrieve last values from static variables
-    nCol = nLastCol;
-    nRow = nLastRow;
+    // Retrieve the last scan position
+    nCol = m_nLastCol;
+    nRow = m_nLastRow;
 
     // Calculates max HIT columns and rows
     nCols = m_nDirSectors - 2;
@@ -484,9 +488,9 @@ DWORD CTD3::ScanHIT(void** pFile, TD4_HIT nMode, BYTE nHash)
 
     }
 
-    // Update static variables
-    nLastCol = nCol;
-    nLastRow = nRow;
+    // Update the scan position
+    m_nLastCol = nCol;
+    m_nLastRow = nRow;
 
     return dwError;
 
@@ -522,7 +526,7 @@ DWORD CTD3::CreateExtent(TD4_EXTENT& Extent, BYTE nGranules)
     {
 
         // Test state of 'CurrentGranule' at GAT[CurrentCylinder]
-        while ((m_pDir[nCurrentCylinder] & (1 << nCurrentGranule)) != nExpectedBit)
+        while (((m_pDir[nCurrentCylinder] >> nCurrentGranule) & 1) != nExpectedBit)
         {
 
             // Check if we are in the "continue up to the first non-empty slot" phase
@@ -641,6 +645,8 @@ DWORD CTD3::CopyExtent(void* pFile, TD4_EXT nMode, BYTE nExtent, TD4_EXTENT& Ext
     TD4_EXTENT* pExtent;
     DWORD       dwError = NO_ERROR;
 
+    STAT_COUNT(STAT_EXTENT);
+
     // Go through the extents table
     for (int x = 1, y = 1; x < 14; x++)  // [PATCH]
     {
@@ -715,6 +721,10 @@ void* CTD3::DEC2FDE(BYTE nDEC)
     DWORD dwSectorOffset = ((nDEC & TD4_DEC_SECTOR) + 2) * m_DG.LT.wSectorSize;
     DWORD dwEntryOffset = ((nDEC & TD4_DEC_ENTRY) >> 5) * sizeof(TD3_FPDE); // [PATCH]
 
+    // The entries are read on first use
+    if ((nDEC & TD4_DEC_SECTOR) < m_nDirSectors && DirSector((nDEC & TD4_DEC_SECTOR) + 2) != NO_ERROR)
+        return NULL;
+
     return ((nDEC & TD4_DEC_SECTOR) < m_nDirSectors ? &m_pDir[dwSectorOffset + dwEntryOffset] : NULL);
 
 }
@@ -33,6 +33,7 @@
 
 #include "windows.h"
 #include "v80.h"
+#include "stats.h"
 #include "vdi.h"
 #include "osi.h"
 #include "td4.h"
@@ -42,8 +43,9 @@
 //---------------------------------------------------------------------------------
 
 CTD4::CTD4()
-:   m_pDir(NULL), m_nDirTrack(0), m_nDirSectors(0), m_nMaxDirSectors(0), m_nSides(0), m_nSectorsPerTrack(0),
-    m_nGranulesPerTrack(0), m_nGranulesPerCylinder(0), m_nSectorsPerGranule(0), m_dwFilePos(0), m_wSector(0), m_Buffer()
+:   m_pDir(NULL), m_nDirTrack(0), m_nDirSectors(0), m_nMaxDirSectors(0), m_nDirRead(0), m_qwDirRead(0), m_bHold(false), m_bDirty(false), m_pGAT(NULL), m_pUndo(NULL), m_nSides(0), m_nSectorsPerTrack(0),
+    m_nGranulesPerTrack(0), m_nGranulesPerCylinder(0), m_nSectorsPerGranule(0), m_dwFilePos(0), m_wSector(0), m_Buffer(),
+    m_nLastRow(-1), m_nLastCol(0)
 {
 }
 
@@ -55,6 +57,8 @@ CTD4::~CTD4()
 {
     if (m_pDir != NULL)
         free(m_pDir);
+    free(m_pGAT);
+    free(m_pUndo);
 }
 
 //---------------------------------------------------------------------------------
@@ -124,8 +128,8 @@ DWORD CTD4::Load(CVDI* pVDI, DWORD dwFlags)
         goto Done;
     }
 
-    // Load directory into memory
-    if ((dwError = DirRW(TD4_DIR_READ)) != NO_ERROR)
+    // Load GAT and HIT into memory (the directory entries are read on first use)
+    if ((dwError = DirRW(TD4_DIR_OPEN)) != NO_ERROR)
         goto Done;
 
     // Calculate DOS disk parameters
@@ -271,6 +275,10 @@ DWORD CTD4::Create(void** pFile, OSI_FILE& File)
     // Invalidate any previous Seek()
     m_wSector = 0xFFFF;
 
+    // While held, a failure restores the directory as it was before this file
+    if (m_bHold)
+        memcpy(m_pUndo, m_pDir, m_nDirSectors * m_DG.LT.wSectorSize);
+
     // Get a new directory entry
     if ((dwError = GetFDE(pFile)) != NO_ERROR)
         goto Abort;
@@ -348,7 +356,10 @@ DWORD CTD4::Create(void** pFile, OSI_FILE& File)
 
     // Restore previous directory state
     Abort:
-    DirRW(TD4_DIR_READ);
+    if (m_bHold)
+        memcpy(m_pDir, m_pUndo, m_nDirSectors * m_DG.LT.wSectorSize);
+    else
+        DirRW(TD4_DIR_READ);
 
     Done:
     return dwError;
@@ -480,6 +491,29 @@ DWORD CTD4::Read(void* pFile, BYTE* pBuffer, DWORD& dwBytes)
 
 }
 
+//---------------------------------------------------------------------------------
+// Return the Track, Side, Sector holding a file position
+//---------------------------------------------------------------------------------
+
+DWORD CTD4::Where(void* pFile, DWORD dwPos, BYTE& nTrack, BYTE& nSide, BYTE& nSector)
+{
+
+    DWORD   dwError;
+
+    // Walk the file to the requested position
+    if ((dwError = Seek(pFile, dwPos)) != NO_ERROR)
+        return dwError;
+
+    if (m_wSector == 0xFFFF)
+        return ERROR_SEEK;
+
+    // Convert relative sector into Track, Side, Sector
+    CHS(m_wSector, nTrack, nSide, nSector);
+
+    return NO_ERROR;
+
+}
+
 //---------------------------------------------------------------------------------
 // Save data to file
 //---------------------------------------------------------------------------------
@@ -574,6 +608,10 @@ DWORD CTD4::Delete(void* pFile)
     // Invalidate any previous Seek()
     m_wSector = 0xFFFF;
 
+    // While held, a failure restores the directory as it was before the deletion
+    if (m_bHold)
+        memcpy(m_pUndo, m_pDir, m_nDirSectors * m_DG.LT.wSectorSize);
+
     // Inactivate directory entry
     ((TD4_FPDE*)pFile)->nAttributes[0] &= !TD4_ATTR0_ACTIVE;
 
@@ -590,6 +628,8 @@ DWORD CTD4::Delete(void* pFile)
     // If exited the loop because reached the end of the extents table
     if (dwError == ERROR_NO_MATCH)
         dwError = DirRW(TD4_DIR_WRITE); // Save the directory
+    else if (m_bHold)
+        memcpy(m_pDir, m_pUndo, m_nDirSectors * m_DG.LT.wSectorSize);
     else
         DirRW(TD4_DIR_READ);            // Otherwise, restore its previous state
 
@@ -669,6 +709,7 @@ void CTD4::GetFile(void* pFile, OSI_FILE& File)
     File.bSystem    = ((TD4_FPDE*)pFile)->nAttributes[0] & TD4_ATTR0_SYSTEM;
     File.bInvisible = ((TD4_FPDE*)pFile)->nAttributes[0] & TD4_ATTR0_INVISIBLE;
     File.bModified  = ((TD4_FPDE*)pFile)->nAttributes[1] & TD4_ATTR1_MODIFIED;
+    File.nLRL       = ((TD4_FPDE*)pFile)->nLRL;
 
 }
 
@@ -724,12 +765,144 @@ DWORD CTD4::SetFile(void* pFile, OSI_FILE& File, bool bCommit)
     ((TD4_FPDE*)pFile)->nAttributes[1] &= ~TD4_ATTR1_MODIFIED;
     ((TD4_FPDE*)pFile)->nAttributes[1] |= (TD4_ATTR1_MODIFIED * File.bModified);
 
+    // Set logical record length
+    ((TD4_FPDE*)pFile)->nLRL = File.nLRL;
+
     return (bCommit ? DirRW(TD4_DIR_WRITE) : NO_ERROR);
 
 }
 
 //---------------------------------------------------------------------------------
 // Get file size
+//---------------------------------------------------------------------------------
+// Return the granule size and the number of free granules
+//---------------------------------------------------------------------------------
+
+DWORD CTD4::Free(DWORD& dwGranule, DWORD& dwGranules)
+{
+
+    // Calculate the number of valid cylinders
+    int nCylinders = m_DG.LT.nTrack - m_DG.FT.nTrack + 1;
+
+    dwGranule = m_nSectorsPerGranule * m_DG.LT.wSectorSize;
+    dwGranules = 0;
+
+    // Count the empty slots of the GAT, as CreateExtent() scans them
+    for (int nCylinder = 0; nCylinder < nCylinders; nCylinder++)
+    {
+        for (int nGranule = 0; nGranule < m_nGranulesPerCylinder; nGranule++)
+        {
+            if (!Used(nCylinder, nGranule))
+                dwGranules++;
+        }
+    }
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Keep the directory writes in memory until Commit()
+//---------------------------------------------------------------------------------
+
+DWORD CTD4::Hold()
+{
+
+    DWORD   dwBytes = m_nDirSectors * m_DG.LT.wSectorSize;
+    DWORD   dwError = NO_ERROR;
+
+    if (m_bHold)
+        return NO_ERROR;
+
+    // Every sector must be in memory before the first change, so an undo copy is complete
+    for (BYTE nIndex = 0; nIndex < m_nDirSectors; nIndex++)
+        if ((dwError = DirSector(nIndex)) != NO_ERROR)
+            return dwError;
+
+    if ((m_pGAT = (BYTE*)malloc(m_DG.LT.wSectorSize)) == NULL || (m_pUndo = (BYTE*)malloc(dwBytes)) == NULL)
+    {
+        free(m_pGAT);
+        m_pGAT = NULL;
+        return ERROR_OUTOFMEMORY;
+    }
+
+    // The granules of the directory on disk are not reused before it is replaced
+    memcpy(m_pGAT, m_pDir, m_DG.LT.wSectorSize);
+
+    m_bHold = true;
+    m_bDirty = false;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write the directory once, if it changed while held
+//---------------------------------------------------------------------------------
+
+DWORD CTD4::Commit()
+{
+
+    if (!m_bHold)
+        return NO_ERROR;
+
+    m_bHold = false;
+
+    free(m_pGAT);
+    free(m_pUndo);
+    m_pGAT = m_pUndo = NULL;
+
+    return (m_bDirty ? DirRW(TD4_DIR_WRITE) : NO_ERROR);
+
+}
+
+//---------------------------------------------------------------------------------
+// Discard the directory changes held since Hold()
+//---------------------------------------------------------------------------------
+
+DWORD CTD4::Drop()
+{
+
+    if (!m_bHold)
+        return NO_ERROR;
+
+    m_bHold = false;
+
+    free(m_pGAT);
+    free(m_pUndo);
+    m_pGAT = m_pUndo = NULL;
+
+    // The disk still holds the directory as of Hold()
+    return DirRW(TD4_DIR_READ);
+
+}
+
+//---------------------------------------------------------------------------------
+// Return the number of free directory entries
+//---------------------------------------------------------------------------------
+
+DWORD CTD4::Entries(DWORD& dwEntries)
+{
+
+    int nRows = m_DG.LT.wSectorSize / sizeof(TD4_FPDE);
+    int nCols = m_nDirSectors - 2;
+
+    dwEntries = 0;
+
+    // Count the empty slots of the HIT, as GetFDE() scans them
+    for (int nRow = 0; nRow < nRows; nRow++)
+    {
+        for (int nCol = 0; nCol < nCols; nCol++)
+        {
+            if (m_pDir[m_DG.LT.wSectorSize + (nRow * m_nMaxDirSectors) + nCol] == 0)
+                dwEntries++;
+        }
+    }
+
+    return NO_ERROR;
+
+}
+
 //---------------------------------------------------------------------------------
 
 DWORD CTD4::GetFileSize(void* pFile)
@@ -749,23 +922,47 @@ DWORD CTD4::GetFileSize(void* pFile)
 DWORD CTD4::DirRW(TD4_DIR nMode)
 {
 
+    BYTE    nIndex = 0;
     DWORD   dwOffset = 0;
     DWORD   dwError = NO_ERROR;
 
+    // While held, the directory is only written by Commit() (a read drops the held changes)
+    if (m_bHold && nMode == TD4_DIR_WRITE)
+    {
+        m_bDirty = true;
+        return NO_ERROR;
+    }
+
+    m_bDirty = false;
+
+    STAT_COUNT(nMode == TD4_DIR_WRITE ? STAT_DIR_WRITE : STAT_DIR_READ);
+    STAT_PHASE(nMode == TD4_DIR_WRITE ? STAT_PHASE_COMMIT : STAT_PHASE_DIR);
+
+    // A new read defines which sectors belong to the directory (the sides may be reduced afterwards)
+    if (nMode != TD4_DIR_WRITE)
+    {
+        m_nDirRead = m_nSides * (m_DG.LT.nLastSector - m_DG.LT.nFirstSector + 1);
+        m_qwDirRead = 0;
+    }
+
     // Go through every side
     for (BYTE nSide = 0; nSide < m_nSides; nSide++)
     {   // Go through every sector
-        for (BYTE nSector = m_DG.LT.nFirstSector; nSector <= m_DG.LT.nLastSector; nSector++, dwOffset += m_DG.LT.wSectorSize)
+        for (BYTE nSector = m_DG.LT.nFirstSector; nSector <= m_DG.LT.nLastSector; nSector++, nIndex++, dwOffset += m_DG.LT.wSectorSize)
         {   // Read or write the sector according to the requested mode
             if (nMode == TD4_DIR_WRITE)
-            {
+            {   // Sectors never referenced have not been read yet
+                if ((dwError = DirSector(nIndex)) != NO_ERROR)
+                    goto Done;
                 if ((dwError = m_pVDI->Write(m_nDirTrack, m_DG.LT.nFirstSide + nSide, nSector, &m_pDir[dwOffset], m_DG.LT.wSectorSize)) != NO_ERROR)
                     goto Done;
             }
-            else
+            else if (nMode == TD4_DIR_READ || nIndex < 2 || m_nDirRead > 64)
             {
                 if ((dwError = m_pVDI->Read(m_nDirTrack, m_DG.LT.nFirstSide + nSide, nSector, &m_pDir[dwOffset], m_DG.LT.wSectorSize)) != NO_ERROR)
                     goto Done;
+                if (nIndex < 64)
+                    m_qwDirRead |= (1ULL << nIndex);
             }
         }
     }
@@ -775,6 +972,27 @@ DWORD CTD4::DirRW(TD4_DIR nMode)
 
 }
 
+//---------------------------------------------------------------------------------
+// Read a directory sector on first use (nIndex counts from the GAT)
+//---------------------------------------------------------------------------------
+
+DWORD CTD4::DirSector(BYTE nIndex)
+{
+
+    BYTE    nSectors = m_DG.LT.nLastSector - m_DG.LT.nFirstSector + 1;
+    DWORD   dwError = NO_ERROR;
+
+    // Outside the directory, or already in memory
+    if (nIndex >= m_nDirRead || nIndex >= 64 || (m_qwDirRead & (1ULL << nIndex)) != 0)
+        return NO_ERROR;
+
+    if ((dwError = m_pVDI->Read(m_nDirTrack, m_DG.LT.nFirstSide + nIndex / nSectors, m_DG.LT.nFirstSector + nIndex % nSectors, &m_pDir[nIndex * m_DG.LT.wSectorSize], m_DG.LT.wSectorSize)) == NO_ERROR)
+        m_qwDirRead |= (1ULL << nIndex);
+
+    return dwError;
+
+}
+
 //---------------------------------------------------------------------------------
 // Check the directory structure
 //---------------------------------------------------------------------------------
@@ -854,25 +1072,24 @@ DWORD CTD4::CheckDir(void)
 DWORD CTD4::ScanHIT(void** pFile, TD4_HIT nMode, BYTE nHash)
 {
 
-    static int nLastRow = -1;
-    static int nLastCol = 0;
-
     int nRows, nRow;
     int nCols, nCol;
     int nSlot;
 
+    STAT_COUNT(STAT_HIT_SCAN);
+
     DWORD dwError = NO_ERROR;
 
-    // If mode is any "Find First", reset static variables
+    // If mode is any "Find First", reset the scan position
     if (nMode != TD4_HIT_FIND_NEXT_USED)
     {
-        nLastRow = -1;
-        nLastCol = 0;
+        m_nLastRow = -1;
+        m_nLastCol = 0;
     }
 
-    // Retrieve last values from static variables
-    nRow = nLastRow;
-    nCol = nLastCol;
+    // Retrieve the last scan position
+    nRow = m_nLastRow;
+    nCol = m_nLastCol;
 
     // Calculate max HIT rows and columns
     nRows = m_DG.LT.wSectorSize / sizeof(TD4_FPDE);
@@ -927,9 +1144,9 @@ DWORD CTD4::ScanHIT(void** pFile, TD4_HIT nMode, BYTE nHash)
 
     }
 
-    // Update static variables
-    nLastRow = nRow;
-    nLastCol = nCol;
+    // Update the scan position
+    m_nLastRow = nRow;
+    m_nLastCol = nCol;
 
     return dwError;
 
@@ -965,7 +1182,7 @@ DWORD CTD4::CreateExtent(TD4_EXTENT& Extent, BYTE nGranules)
     {
 
         // Test state of 'CurrentGranule' at GAT[CurrentCylinder]
-        while ((m_pDir[nCurrentCylinder] & (1 << nCurrentGranule)) != nExpectedBit)
+        while (Used(nCurrentCylinder, nCurrentGranule) != nExpectedBit)
         {
 
             // Check if we are in the "continue up to the first non-empty slot" phase
@@ -1026,6 +1243,20 @@ DWORD CTD4::CreateExtent(TD4_EXTENT& Extent, BYTE nGranules)
 
 }
 
+//---------------------------------------------------------------------------------
+// Whether a granule is taken, in the directory in memory or (while held) in the one on disk
+//---------------------------------------------------------------------------------
+
+bool CTD4::Used(BYTE nCylinder, BYTE nGranule)
+{
+
+    if ((m_pDir[nCylinder] >> nGranule) & 1)
+        return true;
+
+    return (m_bHold && ((m_pGAT[nCylinder] >> nGranule) & 1));
+
+}
+
 //---------------------------------------------------------------------------------
 // Release disk space
 //---------------------------------------------------------------------------------
@@ -1084,6 +1315,8 @@ DWORD CTD4::CopyExtent(void* pFile, TD4_EXT nMode, BYTE nExtent, TD4_EXTENT& Ext
     TD4_EXTENT* pExtent;
     DWORD       dwError = NO_ERROR;
 
+    STAT_COUNT(STAT_EXTENT);
+
     // Go through the extents table
     for (int x = 1, y = 1; x < 6; x++)
     {
@@ -1174,6 +1407,10 @@ void* CTD4::DEC2FDE(BYTE nDEC)
     DWORD dwSectorOffset = ((nDEC & TD4_DEC_SECTOR) + 2) * m_DG.LT.wSectorSize;
     DWORD dwEntryOffset = ((nDEC & TD4_DEC_ENTRY) >> 5) * sizeof(TD4_FPDE);
 
+    // The entries are read on first use
+    if ((nDEC & TD4_DEC_SECTOR) < m_nDirSectors && DirSector((nDEC & TD4_DEC_SECTOR) + 2) != NO_ERROR)
+        return NULL;
+
     return ((nDEC & TD4_DEC_SECTOR) < m_nDirSectors ? &m_pDir[dwSectorOffset + dwEntryOffset] : NULL);
 
 }
@@ -61,7 +61,8 @@
 enum    TD4_DIR                                                                     // Directory enumerator
 {
     TD4_DIR_READ,                                                                   // Read Directory
-    TD4_DIR_WRITE                                                                   // Write Directory
+    TD4_DIR_WRITE,                                                                  // Write Directory
+    TD4_DIR_OPEN                                                                    // Read GAT and HIT only (the entries are read on first use)
 };
 
 enum    TD4_HIT                                                                     // Hash Index Table enumerator
@@ -120,6 +121,12 @@ protected:
     BYTE            m_nDirTrack;                                                    // Directory track
     BYTE            m_nDirSectors;                                                  // Number of directory sectors
     BYTE            m_nMaxDirSectors;                                               // Number maximum of directory sectors
+    BYTE            m_nDirRead;                                                     // Directory sectors covered by the last read
+    unsigned long long m_qwDirRead;                                                 // Directory sectors read so far (one bit each)
+    bool            m_bHold;                                                        // Directory writes wait for Commit()
+    bool            m_bDirty;                                                       // The directory changed while held
+    BYTE*           m_pGAT;                                                         // GAT as of Hold(), its granules stay taken until Commit()
+    BYTE*           m_pUndo;                                                        // Directory before the current change, while held
     BYTE            m_nSides;                                                       // Number of disk sides
     BYTE            m_nSectorsPerTrack;                                             // Sectors per track
     BYTE            m_nGranulesPerTrack;                                            // Granules per track
@@ -128,6 +135,8 @@ protected:
     DWORD           m_dwFilePos;                                                    // Current file position - Seek()
     WORD            m_wSector;                                                      // Current relative sector - Seek()
     BYTE            m_Buffer[1024];                                                 // Generic buffer for operations on sectors
+    int             m_nLastRow;                                                     // Last HIT row returned - ScanHIT()
+    int             m_nLastCol;                                                     // Last HIT column returned - ScanHIT()
 public:
                     CTD4();                                                         // Initialize member variables
     virtual         ~CTD4();                                                        // Release allocated memory
@@ -137,6 +146,12 @@ public:
     virtual DWORD   Create(void** pFile, OSI_FILE& File);                           // Create a new file with the indicated properties
     virtual DWORD   Seek(void* pFile, DWORD dwPos);                                 // Move the file pointer
     virtual DWORD   Read(void* pFile, BYTE* pBuffer, DWORD& dwBytes);               // Read data from file
+    virtual DWORD   Where(void* pFile, DWORD dwPos, BYTE& nTrack, BYTE& nSide, BYTE& nSector); // Track/Side/Sector holding a file position
+    virtual DWORD   Free(DWORD& dwGranule, DWORD& dwGranules);                      // Granule size (bytes) and number of free granules
+    virtual DWORD   Hold();                                                         // Keep the directory writes in memory until Commit()
+    virtual DWORD   Commit();                                                       // Write the directory once, if it changed while held
+    virtual DWORD   Drop();                                                         // Discard the directory changes held since Hold()
+    virtual DWORD   Entries(DWORD& dwEntries);                                      // Number of free directory entries
     virtual DWORD   Write(void* pFile, BYTE* pBuffer, DWORD& dwBytes);              // Save data to file
     virtual DWORD   Delete(void* pFile);                                            // Delete the file
     virtual void    GetDOS(OSI_DOS& DOS);                                           // Get DOS information
@@ -147,8 +162,10 @@ protected:
     virtual DWORD   SetFile(void* pFile, OSI_FILE& File, bool bCommit);             // Set the file properties (protected)
     virtual DWORD   GetFileSize(void* pFile);                                       // Get file size
     virtual DWORD   DirRW(TD4_DIR nMode);                                           // Read or Write the entire directory
+    virtual DWORD   DirSector(BYTE nIndex);                                         // Read a directory sector on first use
     virtual DWORD   CheckDir(void);                                                 // Check the directory structure
     virtual DWORD   ScanHIT(void** pFile, TD4_HIT nMode, BYTE nHash = 0);           // Scan the Hash Index Table
+    virtual bool    Used(BYTE nCylinder, BYTE nGranule);                            // Whether a granule is taken (now or as of Hold())
     virtual DWORD   CreateExtent(TD4_EXTENT& Extent, BYTE nGranules);               // Allocate disk space
     virtual DWORD   DeleteExtent(TD4_EXTENT& Extent);                               // Release disk space
     virtual DWORD   CopyExtent(void* pFile, TD4_EXT nMode, BYTE nExtent, TD4_EXTENT& Extent);   // Get or Set extent data
@@ -0,0 +1,132 @@
+#!/bin/sh
+#---------------------------------------------------------------------------------
+# VDK-80 held directory test
+#---------------------------------------------------------------------------------
+#
+# -untar and -sync keep the directory in memory until every file is in. When a
+# file fails after another one was replaced, the directory on disk must still
+# point at the old data of the replaced file.
+#
+# For each DOS that can hold its directory, the test fragments the free space
+# (so that a large file needs more than one directory entry), then writes a
+# replacement of AAA.BIN, enough empty files to use up every free entry and a
+# large file that can no longer get its extra entries. The command must fail,
+# leave the listing as it was and AAA.BIN must still read back as the original.
+#
+# Prints one line per case and exits non-zero if any fails.
+#
+# Environment:
+#   V80      v80 binary (default ./v80)
+#   MKIMG    image generator (default bench/mkimg)
+#
+#---------------------------------------------------------------------------------
+
+V80=${V80:-./v80}
+MKIMG=${MKIMG:-bench/mkimg}
+
+TMP=$(mktemp -d "${TMPDIR:-/tmp}/v80hold.XXXXXX") || exit 1
+trap 'rm -rf "$TMP"' EXIT INT TERM
+
+FAILED=0
+
+#---------------------------------------------------------------------------------
+# Populate an image with AAA.BIN and fragmented free space
+#---------------------------------------------------------------------------------
+
+prepare()
+{
+    rm -rf "$TMP/img" "$TMP/new" "$TMP/out"
+    mkdir -p "$TMP/img/aaa" "$TMP/img/fill" "$TMP/new" "$TMP/out"
+
+    "$MKIMG" $1 $2 $3 1 40 0 1 "$TMP/test.dsk" || return 1
+
+    head -c 3000 /dev/urandom > "$TMP/img/aaa/AAA.BIN"
+    "$V80" -w "$TMP/test.dsk" "$TMP/img/aaa" > /dev/null || return 1
+
+    # One granule files, every other one deleted afterwards
+    for N in $(seq 10 69); do
+        head -c 1000 /dev/urandom > "$TMP/img/fill/F$N.BIN"
+    done
+    "$V80" -w "$TMP/test.dsk" "$TMP/img/fill" > /dev/null || return 1
+    for N in $(seq 10 2 69); do
+        "$V80" -k "$TMP/test.dsk" F$N.BIN > /dev/null || return 1
+    done
+
+    # The free directory entries, as reported when asking for too many
+    for N in $(seq 1 200); do
+        : > "$TMP/new/E$N.BIN"
+    done
+    tar cf "$TMP/many.tar" -C "$TMP/new" $(cd "$TMP/new" && ls E*)
+    ENTRIES=$("$V80" -untar "$TMP/test.dsk" - < "$TMP/many.tar" | sed -n 's/.*needed, \([0-9]*\) available.*/\1/p')
+    [ -n "$ENTRIES" ] || return 1
+
+    # The replacement, the empty files taking every other free entry, then the large file
+    rm -f "$TMP"/new/E*
+    for N in $(seq 2 $ENTRIES); do
+        : > "$TMP/new/E$N.BIN"
+    done
+    head -c 3000 /dev/urandom > "$TMP/new/AAA.BIN"
+    head -c 30000 /dev/urandom > "$TMP/new/ZZZ.BIN"
+
+    "$V80" -l "$TMP/test.dsk" > "$TMP/before.txt"
+}
+
+#---------------------------------------------------------------------------------
+# Check the image after the failed command
+#---------------------------------------------------------------------------------
+
+check()
+{
+    if [ $2 -eq 0 ]; then
+        echo "FAIL $1: the command succeeded"
+        FAILED=1
+        return
+    fi
+    "$V80" -l "$TMP/test.dsk" > "$TMP/after.txt"
+    if ! cmp -s "$TMP/before.txt" "$TMP/after.txt"; then
+        echo "FAIL $1: the directory changed"
+        FAILED=1
+        return
+    fi
+    "$V80" -r "$TMP/test.dsk" AAA.BIN "$TMP/out" > /dev/null
+    if ! cmp -s "$TMP/img/aaa/AAA.BIN" "$TMP/out/AAA.BIN"; then
+        echo "FAIL $1: AAA.BIN no longer holds its old data"
+        FAILED=1
+        return
+    fi
+    echo "ok   $1"
+}
+
+#---------------------------------------------------------------------------------
+# Main
+#---------------------------------------------------------------------------------
+
+for CASE in "jv1 td4 sd" "jv3 td4 dd" "jv1 nd sd" "jv3 nd dd"; do
+
+    set -- $CASE
+
+    # -untar: the members are written in the archive order (read from stdin, as '-')
+    if ! prepare $1 $2 $3; then
+        echo "FAIL $CASE: can't prepare the image"
+        FAILED=1
+        continue
+    fi
+    tar cf "$TMP/test.tar" -C "$TMP/new" AAA.BIN $(cd "$TMP/new" && ls E*) ZZZ.BIN
+    "$V80" -untar "$TMP/test.dsk" - < "$TMP/test.tar" > /dev/null
+    check "$CASE untar" $?
+
+    # -sync: the host directory holds the image files, changed the same way (its
+    # order decides whether AAA.BIN is replaced before the large file fails)
+    if ! prepare $1 $2 $3; then
+        echo "FAIL $CASE: can't prepare the image"
+        FAILED=1
+        continue
+    fi
+    "$V80" -r "$TMP/test.dsk" '*.*' "$TMP/new" > /dev/null
+    head -c 3000 /dev/urandom > "$TMP/new/AAA.BIN"
+    "$V80" -sync "$TMP/test.dsk" "$TMP/new" > /dev/null
+    check "$CASE sync" $?
+
+done
+
+exit $FAILED
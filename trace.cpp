@@ -0,0 +1,187 @@
+/**
+ @file trace.cpp
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Sector access trace (CVDI decorator)
+//---------------------------------------------------------------------------------
+
+#include "windows.h"
+#include <time.h>
+#include "v80.h"
+#include "vdi.h"
+#include "trace.h"
+
+//---------------------------------------------------------------------------------
+// Take ownership of the disk interface to trace
+//---------------------------------------------------------------------------------
+
+CTrace::CTrace(CVDI* pVDI)
+:   m_pVDI(pVDI), m_hTrace(NULL), m_qwStart(0)
+{
+}
+
+//---------------------------------------------------------------------------------
+// Close the trace and release the disk interface
+//---------------------------------------------------------------------------------
+
+CTrace::~CTrace()
+{
+
+    // The decorated interface may still save cached data when deleted
+    delete m_pVDI;
+
+    if (m_hTrace != NULL)
+        fclose(m_hTrace);
+
+}
+
+//---------------------------------------------------------------------------------
+// Create the trace file and write its header
+//---------------------------------------------------------------------------------
+
+DWORD CTrace::Begin(const char* pPath, const char* pVDIName)
+{
+
+    TRACE_HEADER    Header;
+    VDI_GEOMETRY    DG;
+    struct timespec ts;
+
+    if ((m_hTrace = fopen(pPath, "w")) == NULL)
+        return ERROR_FILE_NOT_FOUND;
+
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.cMagic, TRACE_MAGIC, sizeof(Header.cMagic));
+    Header.wVersion = TRACE_VERSION;
+    Header.wRecordSize = sizeof(TRACE_RECORD);
+    strncpy(Header.cVDI, pVDIName, sizeof(Header.cVDI));
+    m_pVDI->GetDG(DG);
+    memcpy(&Header.DG, &DG, sizeof(DG));
+
+    if (fwrite(&Header, 1, sizeof(Header), m_hTrace) != sizeof(Header))
+        return ERROR_WRITE_FAULT;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    m_qwStart = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    return NO_ERROR;
+
+}
+
+//---------------------------------------------------------------------------------
+// The decorated interface is loaded before it is handed over
+//---------------------------------------------------------------------------------
+
+DWORD CTrace::Load(HANDLE hFile, DWORD dwFlags)
+{
+    return m_pVDI->Load(hFile, dwFlags);
+}
+
+//---------------------------------------------------------------------------------
+// Read one sector from the disk
+//---------------------------------------------------------------------------------
+
+DWORD CTrace::Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize)
+{
+
+    DWORD dwError = m_pVDI->Read(nTrack, nSide, nSector, pBuffer, wSize);
+
+    Log(TRACE_READ, nTrack, nSide, nSector, wSize, dwError);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write one sector to the disk
+//---------------------------------------------------------------------------------
+
+DWORD CTrace::Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize)
+{
+
+    DWORD dwError = m_pVDI->Write(nTrack, nSide, nSector, pBuffer, wSize);
+
+    Log(TRACE_WRITE, nTrack, nSide, nSector, wSize, dwError);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Copy the disk geometry to the caller's struct
+//---------------------------------------------------------------------------------
+
+void CTrace::GetDG(VDI_GEOMETRY& DG)
+{
+    m_pVDI->GetDG(DG);
+}
+
+//---------------------------------------------------------------------------------
+// Commit pending writes to the disk file (and the records logged so far)
+//---------------------------------------------------------------------------------
+
+DWORD CTrace::Flush()
+{
+
+    DWORD dwError = m_pVDI->Flush();
+
+    Log(TRACE_FLUSH, 0, 0, 0, 0, dwError);
+
+    if (m_hTrace != NULL)
+        fflush(m_hTrace);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Append a record to the trace
+//---------------------------------------------------------------------------------
+
+void CTrace::Log(TRACE_OP nOp, BYTE nTrack, BYTE nSide, BYTE nSector, WORD wSize, DWORD dwError)
+{
+
+    TRACE_RECORD    Record;
+    struct timespec ts;
+
+    if (m_hTrace == NULL)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    Record.nOp = nOp;
+    Record.nTrack = nTrack;
+    Record.nSide = nSide;
+    Record.nSector = nSector;
+    Record.wSize = wSize;
+    Record.wError = dwError;
+    Record.dwTime = ((unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec - m_qwStart) / 1000;
+
+    fwrite(&Record, 1, sizeof(Record), m_hTrace);
+
+}
@@ -0,0 +1,87 @@
+/**
+ @file trace.h
+
+ @brief based on TRS-80 Virtual Disk Kit v1.7 for Windows by Miguel Dutra
+ Linux port VDK-80-Linux done by Mike Gore, 2016
+
+ @par Tools to Read and Write files inside common TRS-80 emulator images
+
+ @par Copyright &copy; 2016 Miguel Dutra, GPL License
+ @par You are free to use this code under the terms of GPL
+   please retain a copy of this notice in any code you use it in.
+
+ This is free software: you can redistribute it and/or modify it under the 
+ terms of the GNU General Public License as published by the Free Software 
+ Foundation, either version 3 of the License, or (at your option) any later version.
+
+ The software is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ @par Original Windows Code
+  @see http://www.trs-80.com/wordpress/category/contributors/miguel-dutra/
+  @see http://www.trs-80.com/wordpress/dsk-and-dmk-image-utilities/
+  @see Miguel Dutra www.mdutra.com
+*/
+//---------------------------------------------------------------------------------
+// Sector access trace (CVDI decorator)
+//---------------------------------------------------------------------------------
+//
+// A trace file holds a TRACE_HEADER followed by one TRACE_RECORD per call the DOS
+// interface made to the disk interface, in call order.
+//
+//---------------------------------------------------------------------------------
+
+#define TRACE_MAGIC         "V80T"                                                  // Trace file signature
+#define TRACE_VERSION       1                                                       // Trace file format version
+#define TRACE_EXT           ".v80t"                                                 // Extension appended to the image name by -tr
+
+enum    TRACE_OP                                                                    // Traced operation enumerator
+{
+    TRACE_READ = 0,                                                                 // Sector read
+    TRACE_WRITE = 1,                                                                // Sector write
+    TRACE_FLUSH = 2                                                                 // Commit of pending writes
+};
+
+struct  __attribute__((packed)) TRACE_HEADER                                        // Trace file header
+{
+    char        cMagic[4];                                                          // TRACE_MAGIC
+    WORD        wVersion;                                                           // TRACE_VERSION
+    WORD        wRecordSize;                                                        // sizeof(TRACE_RECORD)
+    char        cVDI[4];                                                            // Traced disk interface ("DMK", "JV1", "JV3")
+    VDI_GEOMETRY DG;                                                                // Traced disk geometry
+};
+
+struct  __attribute__((packed)) TRACE_RECORD                                        // Trace file record
+{
+    BYTE        nOp;                                                                // TRACE_OP
+    BYTE        nTrack;                                                             // Track number
+    BYTE        nSide;                                                              // Side number
+    BYTE        nSector;                                                            // Sector number
+    WORD        wSize;                                                              // Caller's buffer size
+    WORD        wError;                                                             // Result of the call
+    DWORD       dwTime;                                                             // Microseconds since the trace began
+};
+
+class   CTrace: public CVDI
+{
+protected:
+    CVDI*       m_pVDI;                                                             // Decorated disk interface (owned)
+    FILE*       m_hTrace;                                                           // Trace file handle
+    unsigned long long m_qwStart;                                                   // Time the trace began (nanoseconds)
+public:
+                CTrace(CVDI* pVDI);                                                         // Take ownership of the disk interface to trace
+                ~CTrace();                                                                  // Close the trace and release the disk interface
+    DWORD       Begin(const char* pPath, const char* pVDIName);                             // Create the trace file
+    DWORD       Load(HANDLE hFile, DWORD dwFlags);                                          // Validate disk format and detect disk geometry
+    DWORD       Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);     // Read one sector from the disk
+    DWORD       Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize);    // Write one sector to the disk
+    void        GetDG(VDI_GEOMETRY& DG);                                                    // Copy the disk geometry to the caller's struct
+    DWORD       Flush();                                                                    // Commit pending writes to the disk file
+protected:
+    void        Log(TRACE_OP nOp, BYTE nTrack, BYTE nSide, BYTE nSector, WORD wSize, DWORD dwError);  // Append a record to the trace
+};
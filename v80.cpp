@@ -43,24 +43,35 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <time.h>
+#include <glob.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 
 
 #include "v80.h"
 #include "vdi.h"
-#include "jv1.h"
-#include "jv3.h"
-#include "dmk.h"
 #include "osi.h"
-#include "td4.h"
-#include "td3.h"
-#include "td1.h"
-#include "rd.h"
-#include "md.h"
-#include "nd.h"
-#include "dd.h"
-#include "cpm.h"
-
-#define MAX_FILE_SIZE (40L*2L*18L*256L)
+#include "image.h"
+#include "stream.h"
+#include "server.h"
+#include "stats.h"
+#include "pool.h"
+#include "trace.h"
+#include "cache.h"
+#include "fprint.h"
+#include "dump.h"
+#include "jv3.h"
+#include "convert.h"
+#include "tar.h"
+#include "hash.h"
+#include "store.h"
+#include "arc.h"
+#include "search.h"
+#include "sync.h"
+#include "dedup.h"
+#include "similar.h"
+#include "diff.h"
 
 //---------------------------------------------------------------------------------
 // Function Definitions
@@ -70,22 +81,53 @@
 
 DWORD   Dir();
 DWORD   Get();
+DWORD   TarGet();
+DWORD   StoreGet();
 DWORD   Put();
+DWORD   TarPut();
+DWORD   Sync();
 DWORD   Ren();
 DWORD   Del();
 DWORD   DumpDisk();
+DWORD   Extract();
+DWORD   Copy();
+DWORD   Convert();
 DWORD   DumpFile();
+DWORD   Serve();
+DWORD   Dedup();
+DWORD   Similar();
+DWORD   Diff();
+DWORD   Search();
+DWORD   Pack();
 
 // Auxiliary functions
 
 DWORD   LoadVDI();
 DWORD   LoadOSI();
-void    Dump(unsigned char* pBuffer, int nSize);
-bool    WildComp(const char* pSource, const char* pMask, BYTE nLength);
+DWORD   LoadFPrint();
+DWORD   RunImage();
+DWORD   Batch();
+void*   BatchWorker(void* pParam);
+DWORD   BatchList(const char* pSpec);
+void    GetReport(POOL_JOB* pJob, WORD& wFiles, DWORD& dwSize);
+DWORD   DumpBegin(CDump& Dump, const char* pTarget, FILE*& hFile);
+DWORD   DumpEnd(CDump& Dump, FILE* hFile);
+DWORD   SyncPass(const char* pDir, char** pNames, int nNames);
+void    SyncReport(void* pParam, const SYNC_ITEM& Item);
+DWORD   SyncWatch(const char* pDir);
+DWORD   SyncChanged(void* pParam, char** pNames, int nNames);
+void    SyncStop(int nSignal);
+void    DedupHashed(void* pParam, const DUP_FILE& File, DWORD dwError);
+void    DedupReport();
+void    SimilarReport();
+void    DiffSector(void* pParam, BYTE nTrack, BYTE nSide, BYTE nSector);
+void    DiffReport(void* pParam, const DIFF_ITEM& Item);
+void    DiffQuote(const char* pName, char szQuoted[32]);
+DWORD   SearchBegin();
+void    SearchHit(void* pParam, DWORD dwPattern, unsigned long long qwOffset);
+DWORD   PackList();
+DWORD   PackEnd();
 void    WildCopy(const char* pSource, char* pTarget, const char* pMask, BYTE nLength);
-void    FmtName(const char szName[9], const char szType[4], const char* szDivider, char szNewName[13]);
-void    Win2TRS(const char* pWinName, char cTRSName[11]);
-void    Trim(char cField[8]);
 
 // Command-line related
 
@@ -94,6 +136,8 @@ DWORD   SetCmd(void* pParam);
 DWORD   SetOpt(void* pParam);
 DWORD   SetVDI(void* pParam);
 DWORD   SetOSI(void* pParam);
+DWORD   SetNum(void* pParam);
+DWORD   SetTo(void* pParam);
 
 void    PrintHelp();
 void    PrintError(DWORD dwError);
@@ -102,12 +146,76 @@ void    PrintError(DWORD dwError);
 // Data structures
 //---------------------------------------------------------------------------------
 
-char*   gpFileSpec[4] = {};
+// Process-wide settings
+
 DWORD   (*gpCommand)() = NULL;
-FILE    *ghFile = NULL;
-CVDI*   gpVDI = NULL;
-COSI*   gpOSI = NULL;
+const char* gpVDIName = NULL;
+const char* gpOSIName = NULL;
+const char* gpTargetVDI = NULL;
+CFPrint     gFPrint;
 DWORD   gdwFlags = 0;
+DWORD   gdwThreads = 4;
+DWORD   gdwWorkers = 4;
+DWORD   gdwRangeAt = 0;
+DWORD   gdwRangeLen = 0;
+DWORD   gdwSimilar = 50;
+
+// Per-image state (each batch worker has its own)
+
+__thread char*  gpFileSpec[4] = {};
+__thread CImage* gpImage = NULL;
+__thread DWORD  gdwFiles = 0;
+__thread DWORD  gdwBytes = 0;
+
+// Batch mode
+
+struct BATCH_IMAGE
+{
+    char*       pName;                                                              // Disk image filename
+    char*       pOutput;                                                            // Command output captured by the worker
+    size_t      nOutput;                                                            // Size of the captured output
+    DWORD       dwError;                                                            // Command result
+    DWORD       dwFiles;                                                            // Number of files processed
+    DWORD       dwBytes;                                                            // Number of bytes processed
+    bool        bDone;                                                              // Image has been processed
+};
+
+BATCH_IMAGE*    gpImages = NULL;
+int             gnImages = 0;
+int             gnNextImage = 0;
+char*           gpBatchSpec[4] = {};
+pthread_mutex_t gBatchMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  gBatchCond = PTHREAD_COND_INITIALIZER;
+
+// Watch mode
+
+volatile sig_atomic_t gbSyncStop = 0;
+
+// Dedup report (the files hashed on every image)
+
+CDedup          gDedup;
+
+// Near-duplicates report (the sector set signature of every image)
+
+CSimilar        gSimilar;
+
+// Content search (the patterns, compiled once for every image)
+
+struct SEARCH_FOUND
+{
+    const char* pImage;                                                             // Disk image
+    const char* pFile;                                                              // File searched (files mode)
+    VDI_GEOMETRY* pDG;                                                              // Geometry of the sectors searched (NULL: files mode)
+    DWORD       dwMatches;                                                          // Matches so far
+};
+
+CSearch         gSearch;
+char**          gpPatterns = NULL;
+
+// Sector archive (shared by the images of a batch)
+
+CArchive*       gpArchive = NULL;
+pthread_mutex_t gPackMutex = PTHREAD_MUTEX_INITIALIZER;
 
 struct SWITCH
 {
@@ -121,11 +229,24 @@ SWITCH  gSwitches[] =
 {
     { "-l",     SetCmd, (void*)Dir,                 "List directory (default)"                          },
     { "-r",     SetCmd, (void*)Get,                 "Read files"                                        },
+    { "-tar",   SetCmd, (void*)TarGet,              "Read files into a tar stream (to target, or stdout)"},
+    { "-cas",   SetCmd, (void*)StoreGet,            "Read files into a content store (target: store dir)"},
     { "-w",     SetCmd, (void*)Put,                 "Write files"                                       },
+    { "-untar", SetCmd, (void*)TarPut,              "Write files from a tar stream (source, or stdin)"  },
+    { "-sync",  SetCmd, (void*)Sync,                "Sync the image with a host directory (see -watch)" },
     { "-n",     SetCmd, (void*)Ren,                 "Rename files"                                      },
     { "-k",     SetCmd, (void*)Del,                 "Delete files"                                      },
-    { "-f",     SetCmd, (void*)DumpFile,            "Dump file contents"                                },
-    { "-d",     SetCmd, (void*)DumpDisk,            "Dump disk contents"                                },
+    { "-f",     SetCmd, (void*)DumpFile,            "Dump file contents (to target_filespec, if given)" },
+    { "-d",     SetCmd, (void*)DumpDisk,            "Dump disk contents (to the file after the image)"  },
+    { "-e",     SetCmd, (void*)Extract,             "Extract a range of files (see -at, -len and -lrl)" },
+    { "-y",     SetCmd, (void*)Copy,                "Copy files into another image (given as target)"   },
+    { "-v",     SetCmd, (void*)Convert,             "Convert the disk image (to the target, see -o...)" },
+    { "-dup",   SetCmd, (void*)Dedup,               "Hash the files and report duplicates (across images)"},
+    { "-diff",  SetCmd, (void*)Diff,                "Compare with another image (given as target)"      },
+    { "-find",  SetCmd, (void*)Search,              "Search the files for patterns (a|b, \\xHH escapes)"},
+    { "-sim",   SetCmd, (void*)Similar,             "Cluster near-duplicate images (see -pct)"          },
+    { "-pack",  SetCmd, (void*)Pack,                "Pack the sectors into an archive (target), or list one"},
+    { "-u",     SetCmd, (void*)Serve,               "Serve requests on a socket (path given as image)"  },
     { "-s",     SetOpt, (void*)V80_FLAG_SYSTEM,     "Include system files"                              },
     { "-i",     SetOpt, (void*)V80_FLAG_INVISIBLE,  "Include invisible files"                           },
     { "-x",     SetOpt, (void*)V80_FLAG_INFO,       "Show extra information"                            },
@@ -135,20 +256,41 @@ SWITCH  gSwitches[] =
     { "-b",     SetOpt, (void*)V80_FLAG_READBAD,    "Read as much as possible from bad files"           },
     { "-ss",    SetOpt, (void*)V80_FLAG_SS,         "Force the disk as single-sided"                    },
     { "-ds",    SetOpt, (void*)V80_FLAG_DS,         "Force the disk as double-sided"                    },
-    { "-dmk",   SetVDI, (void*)new CDMK,            "Force the DMK disk interface"                      },
-    { "-jv1",   SetVDI, (void*)new CJV1,            "Force the JV1 disk interface"                      },
-    { "-jv3",   SetVDI, (void*)new CJV3,            "Force the JV3 disk interface"                      },
-    { "-cpm",   SetOSI, (void*)new CCPM,            "Force the CP/M system interface (INCOMPLETE)"      },
-    { "-dd",    SetOSI, (void*)new CDD,             "Force the DoubleDOS system interface"              },
-    { "-md",    SetOSI, (void*)new CMD,             "Force the MicroDOS/OS-80 III system interface"     },
-    { "-nd",    SetOSI, (void*)new CND,             "Force the NewDOS/80 system interface"              },
-    { "-rd",    SetOSI, (void*)new CRD,             "Force the RapiDOS system interface"                },
-    { "-td1",   SetOSI, (void*)new CTD1,            "Force the TRSDOS Model I system interface"         },
-    { "-td3",   SetOSI, (void*)new CTD3,            "Force the TRSDOS Model III system interface"       },
-    { "-td4",   SetOSI, (void*)new CTD4,            "Force the TRSDOS Model 4 system interface"         }
+    { "-tr",    SetOpt, (void*)V80_FLAG_TRACE,      "Record the sector accesses to <image>.v80t"        },
+    { "-xxd",   SetOpt, (void*)V80_FLAG_XXD,        "Dump in xxd format"                                },
+    { "-raw",   SetOpt, (void*)V80_FLAG_RAW,        "Dump the raw sector or file bytes (-find: sectors)"},
+    { "-json",  SetOpt, (void*)V80_FLAG_JSONL,      "Dump (or diff) as JSON lines"                     },
+    { "-lrl",   SetOpt, (void*)V80_FLAG_RECORDS,    "Count -at and -len in logical records"             },
+    { "-ca",    SetOpt, (void*)V80_FLAG_CACHE,      "Cache the probe results in <image>.v80c"           },
+    { "-fp",    SetOpt, (void*)V80_FLAG_FPRINT,     "Pick the DOS by boot sector fingerprint (~/.v80fp)"},
+    { "-watch", SetOpt, (void*)V80_FLAG_WATCH,      "Keep syncing as the directory changes (with -sync)"},
+#ifdef V80_STATS
+    { "-st",    SetOpt, (void*)V80_FLAG_STATS,      "Print I/O statistics"                              },
+    { "-sj",    SetOpt, (void*)V80_FLAG_JSON,       "Print I/O statistics as JSON"                      },
+#endif
+    { "-j",     SetNum, (void*)&gdwThreads,         "Host writer threads, e.g. -j8 (default 4)"         },
+    { "-t",     SetNum, (void*)&gdwWorkers,         "Images processed at once in batch mode, e.g. -t8"  },
+    { "-at",    SetNum, (void*)&gdwRangeAt,         "Start of the range to extract, e.g. -at256"        },
+    { "-len",   SetNum, (void*)&gdwRangeLen,        "Length of the range to extract (default: to EOF)"  },
+    { "-pct",   SetNum, (void*)&gdwSimilar,         "Least similarity of near-duplicates, e.g. -pct90 (default 50)"},
+    { "-arc",   SetVDI, (void*)"ARC",               "Force the sector archive interface (file:image)"   },
+    { "-dmk",   SetVDI, (void*)"DMK",               "Force the DMK disk interface"                      },
+    { "-jv1",   SetVDI, (void*)"JV1",               "Force the JV1 disk interface"                      },
+    { "-jv3",   SetVDI, (void*)"JV3",               "Force the JV3 disk interface"                      },
+    { "-cpm",   SetOSI, (void*)"CPM",               "Force the CP/M system interface (INCOMPLETE)"      },
+    { "-dd",    SetOSI, (void*)"DD",                "Force the DoubleDOS system interface"              },
+    { "-md",    SetOSI, (void*)"MD",                "Force the MicroDOS/OS-80 III system interface"     },
+    { "-nd",    SetOSI, (void*)"ND",                "Force the NewDOS/80 system interface"              },
+    { "-rd",    SetOSI, (void*)"RD",                "Force the RapiDOS system interface"                },
+    { "-td1",   SetOSI, (void*)"TD1",               "Force the TRSDOS Model I system interface"         },
+    { "-td3",   SetOSI, (void*)"TD3",               "Force the TRSDOS Model III system interface"       },
+    { "-td4",   SetOSI, (void*)"TD4",               "Force the TRSDOS Model 4 system interface"         },
+    { "-odmk",  SetTo,  (void*)"DMK",               "Convert to the DMK disk format"                    },
+    { "-ojv1",  SetTo,  (void*)"JV1",               "Convert to the JV1 disk format"                    },
+    { "-ojv3",  SetTo,  (void*)"JV3",               "Convert to the JV3 disk format"                    }
 };
 
-const char* gCategories[4] = { "Commands", "Options", "Disk Interfaces", "DOS Interfaces" };
+const char* gCategories[6] = { "Commands", "Options", "Tuning", "Disk Interfaces", "DOS Interfaces", "Conversion Targets" };
 
 //---------------------------------------------------------------------------------
 // Main
@@ -157,12 +299,26 @@ const char* gCategories[4] = { "Commands", "Options", "Disk Interfaces", "DOS In
 int main(int argc, char* argv[])
 {
 
-    DWORD   dwError;
+    DWORD   dwError = 0;
+
+    // Command output goes to the console unless captured by a batch worker
+    ghOut = stdout;
+
+    // Process command line parameters
+    dwError = ParseCmdLine(argc, argv);
+
+    // A tar stream written to stdout leaves the console messages to stderr (batch mode writes files)
+    if (gpCommand == TarGet && gpFileSpec[1] != NULL && gpFileSpec[1][0] != '@' && strpbrk(gpFileSpec[1], "*?[") == NULL && (gpFileSpec[3] == NULL || strcmp(gpFileSpec[3], "-") == 0))
+        ghOut = stderr;
+
+    // So does a JSON diff
+    if (gpCommand == Diff && (gdwFlags & V80_FLAG_JSONL))
+        ghOut = stderr;
 
     // Print authoring information
-    puts("VDK-80, The TRS-80 Virtual Disk Kit v1.7");
-    puts("Written by Miguel Dutra (www.mdutra.com)");
-    puts("Updated for Linux by Mike Gore github.com/magore");
+    fputs("VDK-80, The TRS-80 Virtual Disk Kit v1.7\n", ghOut);
+    fputs("Written by Miguel Dutra (www.mdutra.com)\n", ghOut);
+    fputs("Updated for Linux by Mike Gore github.com/magore\n", ghOut);
 
     // Print usage instructions when no parameters are provided
     if (argc == 1)
@@ -171,8 +327,7 @@ int main(int argc, char* argv[])
         goto Exit_1;
     }
 
-    // Process command line parameters
-    if ((dwError = ParseCmdLine(argc, argv)) != 0)
+    if (dwError != 0)
 	{
 		printf("ParseCmdLine: error\n");
         goto Exit_1;
@@ -182,34 +337,410 @@ int main(int argc, char* argv[])
     if (gpFileSpec[1] == NULL)
     {
         puts("Missing the disk image filename.");
+        dwError = ERROR_BAD_ARGUMENTS;
         goto Exit_1;
     }
 
-    // Open disk image
-    if ( (ghFile = fopen(gpFileSpec[1], "r+")) == NULL )
-    {
-		printf("Can not open: %s\n", gpFileSpec[1]);
-        goto Exit_2;
-    }
-
     // Set a command to execute if the user hasn`t indicated one (first one in the array)
     if (gpCommand == NULL)
         gpCommand = (DWORD (*)())gSwitches[0].pParam;
 
+    // Load the boot sector fingerprints shared by every image
+    if ((gdwFlags & V80_FLAG_FPRINT) && (dwError = LoadFPrint()) != 0)
+        goto Exit_1;
+
+    // The patterns are compiled once, for every image
+    if (gpCommand == Search && (dwError = SearchBegin()) != 0)
+    {
+        PrintError(dwError);
+        goto Exit_1;
+    }
+
+    // The server opens images on request, a manifest (@file) or a wildcard in the image filename selects the batch mode
+    if (gpCommand == Serve)
+        dwError = Serve();
+    else if (gpFileSpec[1][0] == '@' || strpbrk(gpFileSpec[1], "*?[") != NULL)
+        dwError = Batch();
+    else
+        dwError = RunImage();
+
+    // The duplicates are reported once every image has been hashed
+    if (gpCommand == Dedup && gDedup.Files() > 0)
+        DedupReport();
+
+    // The near-duplicates are clustered once every image has been signed
+    if (gpCommand == Similar && gSimilar.Images() > 0)
+        SimilarReport();
+
+    // The archive is written out once every image has been packed
+    if (gpCommand == Pack && gpArchive != NULL && (dwError = PackEnd()) != 0)
+        PrintError(dwError);
+
+    // Exit (a nonzero status lets scripts tell a failed command apart)
+    Exit_1:
+    return (dwError == 0 ? 0 : 1);
+
+}
+
+//---------------------------------------------------------------------------------
+// Open the disk image, execute the command and close the image
+//---------------------------------------------------------------------------------
+
+DWORD RunImage()
+{
+
+    CImage  Image;
+    char    szTrace[MAX_PATH];
+    char    szCache[MAX_PATH];
+    DWORD   dwError;
+
+    // Reset the per-image state
+    gpImage = &Image;
+    gdwFiles = 0;
+    gdwBytes = 0;
+
+#ifdef V80_STATS
+    StatReset();
+#endif
+
+    // Open disk image (closed along with its interfaces when Image goes out of scope)
+    if ((dwError = Image.Open(gpFileSpec[1], gdwFlags)) != 0)
+    {
+		fprintf(ghOut, "Can not open: %s\n", gpFileSpec[1]);
+        goto Done;
+    }
+
+    // Record the sector accesses next to the image
+    if (gdwFlags & V80_FLAG_TRACE)
+    {
+        snprintf(szTrace, sizeof(szTrace), "%s%s", gpFileSpec[1], TRACE_EXT);
+        Image.Trace(szTrace);
+    }
+
+    // Reuse the formats detected on a previous run (next to the image, or in $V80_CACHE)
+    if (gdwFlags & V80_FLAG_CACHE)
+    {
+        CCache::Name(gpFileSpec[1], getenv("V80_CACHE"), szCache, sizeof(szCache));
+        Image.Cache(szCache);
+    }
+
+    if (gdwFlags & V80_FLAG_FPRINT)
+        Image.FPrint(&gFPrint);
+
     // Execute the command with parameters previously parsed from the command-line
     dwError = gpCommand();
 
-    // Close the file
-    Exit_3:
-    if (ghFile != NULL)
-        fclose(ghFile);
+    Done:
+#ifdef V80_STATS
+    // Close the image first, so that the final writes are accounted for
+    if (gdwFlags & (V80_FLAG_STATS | V80_FLAG_JSON))
+    {
+        Image.Close();
+        StatPrint(ghOut, gdwFlags & V80_FLAG_JSON);
+    }
+#endif
+    gpImage = NULL;
+    return dwError;
+
+}
 
-    // Print error message, if any
-    Exit_2:
+//---------------------------------------------------------------------------------
+// Keep images loaded and answer requests from local clients until interrupted
+//---------------------------------------------------------------------------------
 
-    // Exit
-    Exit_1:
-    return 0;
+DWORD Serve()
+{
+
+    CServer Server;
+    DWORD   dwError;
+
+    // Listen on the socket path given in place of the disk image
+    if ((dwError = Server.Begin(gpFileSpec[1], gdwFlags, gpVDIName, gpOSIName)) != 0)
+        goto Done;
+
+    printf("\r\nServing requests on %s\r\n", gpFileSpec[1]);
+
+#ifdef V80_STATS
+    StatReset();
+#endif
+
+    dwError = Server.Run();
+
+#ifdef V80_STATS
+    // Release the cached images first, so that their final writes are accounted for
+    if (gdwFlags & (V80_FLAG_STATS | V80_FLAG_JSON))
+    {
+        Server.End();
+        StatPrint(stdout, gdwFlags & V80_FLAG_JSON);
+    }
+#endif
+
+    Done:
+    if (dwError != 0)
+        PrintError(dwError);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Execute the command on every disk image of a manifest or wildcard filespec
+//---------------------------------------------------------------------------------
+
+DWORD Batch()
+{
+
+    pthread_t   hThreads[POOL_MAX_THREADS];
+    int         nThreads;
+    int         nFailed = 0;
+    DWORD       dwFiles = 0;
+    DWORD       dwBytes = 0;
+    time_t      tStart = time(NULL);
+    DWORD       dwError;
+
+    // Build the list of disk images
+    if ((dwError = BatchList(gpFileSpec[1])) != 0)
+        goto Done;
+
+    if (gnImages == 0)
+    {
+        puts("No disk images to process.");
+        goto Done;
+    }
+
+    // Workers start from the same filespecs as the main thread
+    memcpy(gpBatchSpec, gpFileSpec, sizeof(gpBatchSpec));
+
+    // Images copied into the same target image take turns
+    if (gpCommand == Copy)
+        gdwWorkers = 1;
+
+    // Start the workers (no more than there are images)
+    for (nThreads = 0; nThreads < (int)gdwWorkers && nThreads < gnImages && nThreads < POOL_MAX_THREADS; nThreads++)
+    {
+        if (pthread_create(&hThreads[nThreads], NULL, BatchWorker, NULL) != 0)
+            break;
+    }
+
+    // At least one worker is needed
+    if (nThreads == 0)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Done;
+    }
+
+    // Print each image result in list order as soon as it is available
+    for (int x = 0; x < gnImages; x++)
+    {
+
+        pthread_mutex_lock(&gBatchMutex);
+        while (!gpImages[x].bDone)
+            pthread_cond_wait(&gBatchCond, &gBatchMutex);
+        pthread_mutex_unlock(&gBatchMutex);
+
+        // Print the captured output
+        printf("\r\n[%d/%d] %s\r\n", x + 1, gnImages, gpImages[x].pName);
+        fwrite(gpImages[x].pOutput, 1, gpImages[x].nOutput, stdout);
+        free(gpImages[x].pOutput);
+
+        // Print the image status
+        if (gpImages[x].dwError == 0)
+            printf("Status: OK (%u files, %u bytes)\r\n", gpImages[x].dwFiles, gpImages[x].dwBytes);
+        else
+            printf("Status: FAILED (%s)\r\n", (gpImages[x].dwError < ERROR_LAST ? errors_msg[gpImages[x].dwError] : "UNKNOWN"));
+
+        // Update operation status variables
+        if (gpImages[x].dwError != 0)
+            nFailed++;
+        dwFiles += gpImages[x].dwFiles;
+        dwBytes += gpImages[x].dwBytes;
+
+    }
+
+    // Wait for the workers
+    for (int x = 0; x < nThreads; x++)
+        pthread_join(hThreads[x], NULL);
+
+    // Print the aggregated summary
+    printf("\r\nBatch summary:\r\n\r\n");
+
+    for (int x = 0; x < gnImages; x++)
+    {
+        if (gpImages[x].dwError != 0)
+            printf("FAILED\t%s\r\n", gpImages[x].pName);
+    }
+
+    printf("\r\nTotal of %d images processed (%d OK, %d failed), %u files, %u bytes in %ld seconds.\r\n\r\n",
+        gnImages, gnImages - nFailed, nFailed, dwFiles, dwBytes, (long)(time(NULL) - tStart));
+
+    // Report a failure if any image has failed
+    if (nFailed > 0)
+        dwError = ERROR_NO_MATCH;
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Batch worker: process images from the shared list until none is left
+//---------------------------------------------------------------------------------
+
+void* BatchWorker(void* pParam)
+{
+
+    char            szTarget[MAX_PATH];
+    BATCH_IMAGE*    pImage;
+    const char*     pBase;
+    int             nSpec;
+    int             x;
+
+    while (true)
+    {
+
+        // Take the next image from the list
+        pthread_mutex_lock(&gBatchMutex);
+        x = gnNextImage++;
+        pthread_mutex_unlock(&gBatchMutex);
+
+        if (x >= gnImages)
+            break;
+
+        pImage = &gpImages[x];
+
+        // Set up this worker's filespecs
+        memcpy(gpFileSpec, gpBatchSpec, sizeof(gpFileSpec));
+        gpFileSpec[1] = pImage->pName;
+
+        // Extracted files go to a subdirectory named after the image
+        if (gpCommand == Get || gpCommand == Extract)
+        {
+            pBase = strrchr(pImage->pName, '/');
+            snprintf(szTarget, sizeof(szTarget), "%s/%s", (gpBatchSpec[3] ? gpBatchSpec[3] : "."), (pBase ? pBase + 1 : pImage->pName));
+            mkdir(szTarget, 0777);
+            gpFileSpec[3] = szTarget;
+        }
+
+        // Tar streams go to one archive per image, in the target directory (default: current)
+        else if (gpCommand == TarGet)
+        {
+            pBase = strrchr(pImage->pName, '/');
+            if (gpBatchSpec[3] != NULL)
+                mkdir(gpBatchSpec[3], 0777);
+            snprintf(szTarget, sizeof(szTarget), "%s/%s%s", (gpBatchSpec[3] ? gpBatchSpec[3] : "."), (pBase ? pBase + 1 : pImage->pName), TAR_EXT);
+            gpFileSpec[3] = szTarget;
+        }
+
+        // Dumps to a file and converted images go to one file per image in a directory by that name
+        else if ((gpCommand == DumpDisk || gpCommand == DumpFile || gpCommand == Convert) && gpBatchSpec[nSpec = (gpCommand == DumpFile ? 3 : 2)] != NULL)
+        {
+            pBase = strrchr(pImage->pName, '/');
+            mkdir(gpBatchSpec[nSpec], 0777);
+            snprintf(szTarget, sizeof(szTarget), "%s/%s%s", gpBatchSpec[nSpec], (pBase ? pBase + 1 : pImage->pName), (gpCommand == Convert ? "" : ".dump"));
+            gpFileSpec[nSpec] = szTarget;
+        }
+
+        // Capture the command output
+        if ((ghOut = open_memstream(&pImage->pOutput, &pImage->nOutput)) == NULL)
+            pImage->dwError = ERROR_OUTOFMEMORY;
+        else
+        {
+            pImage->dwError = RunImage();
+            fclose(ghOut);
+        }
+
+        pImage->dwFiles = gdwFiles;
+        pImage->dwBytes = gdwBytes;
+
+        // Let the main thread print it
+        pthread_mutex_lock(&gBatchMutex);
+        pImage->bDone = true;
+        pthread_cond_broadcast(&gBatchCond);
+        pthread_mutex_unlock(&gBatchMutex);
+
+    }
+
+    return NULL;
+
+}
+
+//---------------------------------------------------------------------------------
+// Build the list of disk images from a manifest (@file) or a wildcard filespec
+//---------------------------------------------------------------------------------
+
+DWORD BatchList(const char* pSpec)
+{
+
+    FILE*   hList;
+    char    szLine[MAX_PATH];
+    char*   pLine;
+    char*   pEnd;
+    glob_t  Glob;
+    int     nMax = 0;
+    DWORD   dwError = 0;
+
+    // Wildcard filespec: let glob() expand it
+    if (pSpec[0] != '@')
+    {
+
+        if (glob(pSpec, 0, NULL, &Glob) != 0)
+        {
+            globfree(&Glob);
+            goto Done;
+        }
+
+        if ((gpImages = (BATCH_IMAGE*)calloc(Glob.gl_pathc, sizeof(BATCH_IMAGE))) == NULL)
+        {
+            dwError = ERROR_OUTOFMEMORY;
+            globfree(&Glob);
+            goto Done;
+        }
+
+        for (gnImages = 0; gnImages < (int)Glob.gl_pathc; gnImages++)
+            gpImages[gnImages].pName = strdup(Glob.gl_pathv[gnImages]);
+
+        globfree(&Glob);
+        goto Done;
+
+    }
+
+    // Manifest: one disk image per line, blank lines and #comments are skipped
+    if ((hList = fopen(&pSpec[1], "r")) == NULL)
+    {
+        printf("Can not open: %s\n", &pSpec[1]);
+        dwError = ERROR_FILE_NOT_FOUND;
+        goto Done;
+    }
+
+    while (fgets(szLine, sizeof(szLine), hList) != NULL)
+    {
+
+        // Trim leading and trailing blanks
+        for (pLine = szLine; isspace(*pLine); pLine++);
+        for (pEnd = pLine + strlen(pLine); pEnd > pLine && isspace(pEnd[-1]); *--pEnd = 0);
+
+        if (*pLine == 0 || *pLine == '#')
+            continue;
+
+        // Grow the list as needed
+        if (gnImages == nMax)
+        {
+            nMax = (nMax ? nMax * 2 : 256);
+            if ((gpImages = (BATCH_IMAGE*)realloc(gpImages, nMax * sizeof(BATCH_IMAGE))) == NULL)
+            {
+                dwError = ERROR_OUTOFMEMORY;
+                break;
+            }
+        }
+
+        memset(&gpImages[gnImages], 0, sizeof(BATCH_IMAGE));
+        gpImages[gnImages++].pName = strdup(pLine);
+
+    }
+
+    fclose(hList);
+
+    Done:
+    return dwError;
 
 }
 
@@ -237,25 +768,22 @@ DWORD Dir()
 
     // Initialize the DOS interface
     if ((dwError = LoadOSI()) != 0)
-        goto Exit_1;
+        goto Exit_0;
 
     // Print operation objective
-    printf("\r\nListing directory contents:\r\n\r\n");
+    fprintf(ghOut, "\r\nListing directory contents:\r\n\r\n");
 
     // Print header
-    printf("Filename\t    Size\tDate\t\tAttr\r\n");
-    printf("----------------------------------------------------\r\n");
+    fprintf(ghOut, "Filename\t    Size\tDate\t\tAttr\r\n");
+    fprintf(ghOut, "----------------------------------------------------\r\n");
 
     // Convert Windows filespec to TRS standard
     Win2TRS((gpFileSpec[2] != NULL ? gpFileSpec[2] : "*.*"), cMask);
 
     // While OSI::Dir() returns a valid file pointer
-    while ((dwError = gpOSI->Dir(&pFile, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
     {
 
-        // Get file properties
-        gpOSI->GetFile(pFile, File);
-
         // Compare file attributes against user requests
         if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
             continue;
@@ -265,10 +793,10 @@ DWORD Dir()
             continue;
 
         // Format the filename
-        FmtName(File.szName, File.szType, (strcmp(typeid(*gpOSI).name()+2, "CPM") ? "/" : "."), szFile);
+        FmtName(File.szName, File.szType, gpImage->Divider(), szFile);
 
         // Print file information
-        printf("%-12s\t%8u\t%04d/%02d/%02d\t%c%c%c%d\r\n", szFile, File.dwSize, File.Date.wYear, File.Date.nMonth, File.Date.nDay, (File.bSystem?'S':'-'), (File.bInvisible?'I':'-'), (File.bModified?'M':'-'), File.nAccess);
+        fprintf(ghOut, "%-12s\t%8u\t%04d/%02d/%02d\t%c%c%c%d\r\n", szFile, File.dwSize, File.Date.wYear, File.Date.nMonth, File.Date.nDay, (File.bSystem?'S':'-'), (File.bInvisible?'I':'-'), (File.bModified?'M':'-'), File.nAccess);
 
         // Update operation status variables
         wFiles++;
@@ -277,21 +805,16 @@ DWORD Dir()
     }
 
     // Print operation summary
-    printf("\r\nTotal of %d bytes in %d files listed.\r\n\r\n", dwSize, wFiles);
+    fprintf(ghOut, "\r\nTotal of %d bytes in %d files listed.\r\n\r\n", dwSize, wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
 
     // If exited on "No More Files" then "No Error"
     if (dwError == ERROR_NO_MORE_FILES)
         dwError = 0;
 
-    // Release the OSI object
-    if (gpOSI != NULL)
-        delete gpOSI;
-
-    // Release the VDI object
-    Exit_1:
-    if (gpVDI != NULL)
-        delete gpVDI;
-
     Exit_0:
     return dwError;
 
@@ -313,8 +836,14 @@ DWORD Get()
     void*       pFile = NULL;
     WORD        wFiles = 0;
     DWORD       dwSize = 0;
-    BYTE*       pBuffer = NULL;
     DWORD       dwBytes;
+    CStream     Stream;
+    CPool       Pool;
+    POOL_JOB*   pJob;
+    IMAGE_RUN*  pRuns;
+    DWORD       dwRuns;
+    bool        bDirect;
+    bool        bKernel = true;
     DWORD       dwError = 0;
 
     // Initialize the disk interface
@@ -327,30 +856,30 @@ DWORD Get()
     if (dwError)
         goto Exit_1;
 
-    // 360KB should be more than enough for any TRS-80 file
-    dwBytes = (MAX_FILE_SIZE) + (V80_MEM - (MAX_FILE_SIZE) % V80_MEM);
-
-    // Allocate memory
-    if ((pBuffer = (BYTE*)calloc(dwBytes,1)) == NULL)
+    // Allocate the transfer chunks, reused for every file
+    if ((dwError = Stream.Alloc()) != 0)
     {
         perror("Get Memory");
-		dwError = ERROR_OUTOFMEMORY;
-        goto Exit_2;
+        goto Exit_1;
+    }
+
+    // Start the writer threads
+    if ((dwError = Pool.Begin(gdwThreads, V80_POOL_MEM)) != 0)
+    {
+        perror("Get Threads");
+        goto Exit_1;
     }
 
     // Print operation objective
-    printf("\r\nReading files from disk:\r\n\r\n");
+    fprintf(ghOut, "\r\nReading files from disk:\r\n\r\n");
 
     // Convert Windows filespec to TRS standard
     Win2TRS((gpFileSpec[2] != NULL ? gpFileSpec[2] : "*.*"), cMask);
 
     // While OSI::Dir() returns a valid file pointer
-    while ((dwError = gpOSI->Dir(&pFile, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
     {
 
-        // Get file properties
-        gpOSI->GetFile(pFile, File);
-
         // Compare file attributes against user requests
         if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
             continue;
@@ -360,65 +889,121 @@ DWORD Get()
             continue;
 
         // Format the filenames
-        FmtName(File.szName, File.szType, (strcmp(typeid(*gpOSI).name()+2, "CPM") ? "/" : "."), szTRSFile);
+        FmtName(File.szName, File.szType, gpImage->Divider(), szTRSFile);
         FmtName(File.szName, File.szType, ".", szWinFile);
 
         // Add the user specified path (if any) to the Windows-based filename
         sprintf(szFile, "%s/%s", (gpFileSpec[3] ? gpFileSpec[3] : "."), szWinFile);
 
-        // Print filenames
-        printf("%-12s -> %-12s\t", szTRSFile, szFile);
-
-        // Check if the file is not empty
-        if (File.dwSize == 0)
-        {
-            printf("%8d bytes\tSkipped\r\n", File.dwSize);
-            continue;
-        }
-
-        // Check whether the file size is valid (<360KB)
-        if (File.dwSize > MAX_FILE_SIZE)
+        // While the disk layout allows it, a writer thread copies the file data from the image file inside the kernel
+        if (bKernel && File.dwSize != 0)
         {
-            printf("%8d bytes\tInvalid Size!\r\n", File.dwSize);
-            continue;
-        }
 
-        // Set file pointer
-        if ((dwError = gpOSI->Seek(pFile, 0)) != 0)
-        {
-            printf("Get seek error\n");
-            continue;
-        }
+            // Map the file data to the image file (on this thread, as it goes through the directory)
+            dwError = gpImage->Map(pFile, File.dwSize, pRuns, dwRuns);
 
-        // Read file contents
-        if ((dwError = gpOSI->Read(pFile, pBuffer, File.dwSize)) != 0 && !(gdwFlags & V80_FLAG_READBAD))
-        {
-            printf("Get read error\n");
-            continue;
-        }
+            // DMK images (and irregular JV3 ones) go through the buffered path from now on
+            if (dwError == ERROR_NOT_SUPPORTED)
+                bKernel = false;
 
-        // Create Windows file
-        if ((hFile = fopen(szFile, "w")) == NULL)
-        {
-			printf("Can't open: %s\n", szFile);
-            continue;
-        }
+            else if (dwError == ERROR_OUTOFMEMORY)
+                break;
 
-		dwBytes = fwrite(pBuffer, 1, File.dwSize, hFile);
+            else if (dwError == 0)
+            {
 
-        // Write buffer contents to Windows file
-        if (dwBytes != File.dwSize)
-        {
-			printf("Write error: %s\n", szFile);
-            fclose(hFile);
-            continue;
-        }
+                // Report completed jobs in order, waiting for the oldest ones until the map fits
+                while ((pJob = Pool.Retire(!Pool.Fits(dwRuns * sizeof(IMAGE_RUN)))) != NULL)
+                    GetReport(pJob, wFiles, dwSize);
+
+                if ((pJob = (POOL_JOB*)calloc(1, sizeof(POOL_JOB))) == NULL)
+                {
+                    free(pRuns);
+                    dwError = ERROR_OUTOFMEMORY;
+                    break;
+                }
+
+                strcpy(pJob->szTRSFile, szTRSFile);
+                strcpy(pJob->szFile, szFile);
+                pJob->dwSize = File.dwSize;
+                pJob->pImage = gpImage;
+                pJob->pRuns = pRuns;
+                pJob->dwRuns = dwRuns;
+                pJob->bBad = ((gdwFlags & V80_FLAG_READBAD) != 0);
+
+                // Hand the job over to the writer threads
+                Pool.Submit(pJob);
+                continue;
+
+            }
+
+            // A file with sectors the image file doesn't map goes through the buffered path
+            dwError = 0;
+
+        }
+
+        // Files larger than the pool budget are streamed directly, after every pending job
+        bDirect = (File.dwSize + sizeof(POOL_JOB) > V80_POOL_MEM);
+
+        // Report completed jobs in order, waiting for the oldest ones until the new file fits
+        while ((pJob = Pool.Retire(bDirect || !Pool.Fits(File.dwSize))) != NULL)
+            GetReport(pJob, wFiles, dwSize);
+
+        if (!bDirect)
+        {
+
+            // Allocate a job to carry the file contents to the writer threads
+            if ((pJob = (POOL_JOB*)calloc(1, sizeof(POOL_JOB))) == NULL || (pJob->pBuffer = (BYTE*)calloc(File.dwSize + 1, 1)) == NULL)
+            {
+                free(pJob);
+                dwError = ERROR_OUTOFMEMORY;
+                break;
+            }
+
+            strcpy(pJob->szTRSFile, szTRSFile);
+            strcpy(pJob->szFile, szFile);
+            pJob->dwSize = File.dwSize;
+
+            // Empty files are only reported
+            if (File.dwSize == 0)
+                pJob->dwError = ERROR_EMPTY;
+
+            // Read file contents (unreadable parts stay zeroed when reading bad files)
+            else if ((pJob->dwError = gpImage->Read(pFile, 0, pJob->pBuffer, (dwBytes = File.dwSize))) != 0 && (gdwFlags & V80_FLAG_READBAD))
+                pJob->dwError = 0;
+
+            // Hand the job over to the writer threads
+            Pool.Submit(pJob);
+            continue;
+
+        }
+
+        // Print filenames
+        fprintf(ghOut, "%-12s -> %-12s\t", szTRSFile, szFile);
+
+        // Create Windows file
+        if ((hFile = fopen(szFile, "w")) == NULL)
+        {
+			fprintf(ghOut, "Can't open: %s\n", szFile);
+            continue;
+        }
+
+        // Stream file contents while the writer thread drains them to the Windows file
+        dwError = Stream.Get(gpImage, pFile, File.dwSize, hFile, (gdwFlags & V80_FLAG_READBAD));
 
         // Close file handle
         fclose(hFile);
 
+        // Do not leave a truncated copy behind
+        if (dwError != 0)
+        {
+            fprintf(ghOut, (dwError == ERROR_WRITE_FAULT ? "Write error: %s\n" : "Get read error\n"), szFile);
+            remove(szFile);
+            continue;
+        }
+
         // Print total number of bytes extracted
-        printf("%8d bytes\tOK\r\n", File.dwSize);
+        fprintf(ghOut, "%8d bytes\tOK\r\n", File.dwSize);
 
         // Update operation status variables
         wFiles++;
@@ -426,29 +1011,26 @@ DWORD Get()
 
     }
 
+    // Let the writer threads finish and report the remaining jobs
+    Pool.End();
+
+    while ((pJob = Pool.Retire(true)) != NULL)
+        GetReport(pJob, wFiles, dwSize);
+
     // Print operation summary
-    printf("\r\nTotal of %d bytes read from %d files.\r\n\r\n", dwSize, wFiles);
+    fprintf(ghOut, "\r\nTotal of %d bytes read from %d files.\r\n\r\n", dwSize, wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
 
     // If exited on "No More Files" then "No Error"
     if (dwError == ERROR_NO_MORE_FILES)
         dwError = 0;
 
-    // Release allocated memory
-    if (pBuffer != NULL)
-        free(pBuffer);
-
-    // Release the OSI object
-    Exit_2:
-    if (gpOSI != NULL)
-        delete gpOSI;
-
-    // Release the VDI object
     Exit_1:
-    if (gpVDI != NULL)
-        delete gpVDI;
-
 	if(dwError)
-		printf("Get dwError:%d\n", dwError);
+		fprintf(ghOut, "Get dwError:%d\n", dwError);
 
     // Return
     Exit_0:
@@ -457,214 +1039,199 @@ DWORD Get()
 }
 
 //---------------------------------------------------------------------------------
-// Write files to the disk
+// Extract files from the disk into a tar stream
 //---------------------------------------------------------------------------------
 
-DWORD Put()
+DWORD TarGet()
 {
-    char            szFileSpec[MAX_PATH];
-    char            cFile[11];
-    char            szFile[13];
-    OSI_FILE        File;
-    void*           pFile;
-    FILE 	       *hFile;
-    WORD            wFiles = 0;
-    DWORD           dwSize = 0;
-    BYTE*           pBuffer = NULL;
-    DWORD           dwBytes;
-    DWORD           dwError = 0;
-    DIR            *dir = NULL;
-    class dirent *ent;
-    class stat st;
 
-    // Check whether the user informed a FROM filespec
-    if (gpFileSpec[2] == NULL)
-    {
-        dwError = ERROR_BAD_ARGUMENTS;
-        goto Exit_0;
-    }
+    OSI_FILE    File;
+    FILE*       hFile = NULL;
+    char        cMask[11];
+    char        szTRSFile[13];
+    char        szWinFile[13];
+    void*       pFile = NULL;
+    BYTE*       pBuffer = NULL;
+    WORD        wFiles = 0;
+    DWORD       dwSize = 0;
+    DWORD       dwBytes;
+    DWORD       dwPos;
+    DWORD       dwLength;
+    IMAGE_RUN*  pRuns;
+    DWORD       dwRuns;
+    CTar        Tar;
+    bool        bStdout;
+    bool        bKernel = true;
+    DWORD       dwError = 0;
 
     // Initialize the disk interface
-    if ((dwError = LoadVDI()) != 0)
+    dwError = LoadVDI();
+    if (dwError)
         goto Exit_0;
 
     // Initialize the DOS interface
-    if ((dwError = LoadOSI()) != 0)
+    dwError = LoadOSI();
+    if (dwError)
         goto Exit_1;
 
-    // 360KB should be more than enough for any TRS-80 file
-    dwBytes = (MAX_FILE_SIZE) + (V80_MEM - (MAX_FILE_SIZE) % V80_MEM);
-
-    // Allocate memory
-    if ((pBuffer = (BYTE*)calloc(1,dwBytes)) == NULL)
+    // Allocate the buffer of the disk formats the kernel can't copy
+    if ((pBuffer = (BYTE*)malloc(V80_CHUNK)) == NULL)
     {
-
-		perror("Put");
         dwError = ERROR_OUTOFMEMORY;
-        goto Exit_2;
+        goto Exit_1;
     }
 
-    // Print operation objective
-    printf("\r\nWriting files to disk:\r\n\r\n");
+    // The archive goes to stdout unless a target is given
+    bStdout = (gpFileSpec[3] == NULL || strcmp(gpFileSpec[3], "-") == 0);
 
-    // Get the target file path
-	if( realpath(gpFileSpec[2], szFileSpec) == NULL )
+    if ((hFile = (bStdout ? stdout : fopen(gpFileSpec[3], "w"))) == NULL)
     {
-		perror("Put");
-        dwError = ERROR_NOT_FOUND;
-        goto Exit_3;
+        fprintf(ghOut, "Can't open: %s\n", gpFileSpec[3]);
+        dwError = ERROR_FILE_NOT_FOUND;
+        goto Exit_1;
     }
 
-    if (stat(szFileSpec, &st) == -1)
-    {
-        printf("stat(%s) failed.\n", szFileSpec);
-        dwError = ERROR_NOT_FOUND;
-        goto Exit_3;
-    }
+    Tar.Create(hFile);
 
-    if(st.st_mode & S_IFDIR)
+    // Print operation objective
+    fprintf(ghOut, "\r\nReading files into %s:\r\n\r\n", (bStdout ? "stdout" : gpFileSpec[3]));
+
+    // Convert Windows filespec to TRS standard
+    Win2TRS((gpFileSpec[2] != NULL ? gpFileSpec[2] : "*.*"), cMask);
+
+    // While OSI::Dir() returns a valid file pointer
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
     {
-        dir = opendir(szFileSpec);
-        if (!dir)
-        {
-		    perror("opendir failed");
-            dwError = ERROR_NOT_FOUND;
-            goto Exit_3;
-        }
-    }
 
-    // While there are files pending for writing
-    while (dir == NULL || (ent = readdir(dir)) != NULL) {
-        char file_path[PATH_MAX];
-		struct tm *t;
-        const char *file_name = (dir == NULL) ? basename(szFileSpec) : ent->d_name;
+        // Compare file attributes against user requests
+        if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
+            continue;
 
-        if (file_name[0] == '.')
-            goto Loop_End;
-        
-        if (dir == NULL)
-            strcpy(file_path, szFileSpec);
-        else
-            snprintf(file_path, sizeof(file_path), "%s/%s", szFileSpec, file_name);
+        // Compare the filename against the source filespec
+        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
+            continue;
 
-        if (stat(file_path, &st) == -1)
+        // Format the filenames
+        FmtName(File.szName, File.szType, gpImage->Divider(), szTRSFile);
+        FmtName(File.szName, File.szType, ".", szWinFile);
+
+        // Print filenames
+        fprintf(ghOut, "%-12s -> %-12s\t", szTRSFile, szWinFile);
+
+        // Member headers, with the TRS-80 attributes
+        if ((dwError = Tar.Header(szWinFile, File)) != 0)
+            break;
+
+        dwPos = 0;
+
+        // While the disk layout allows it, the file data goes from the image file to the archive inside the kernel
+        if (bKernel && File.dwSize != 0)
         {
-            printf("stat(%s) failed.\n", file_path);
-            goto Loop_End;
-        }
 
-        if(st.st_mode & S_IFDIR) 
-            goto Loop_End;
+            dwError = gpImage->Map(pFile, File.dwSize, pRuns, dwRuns);
 
-		t = gmtime((const time_t *)&st.st_mtime);
+            // DMK images (and irregular JV3 ones) go through the buffer from now on
+            if (dwError == ERROR_NOT_SUPPORTED)
+                bKernel = false;
 
-        // Convert Windows filename to the TRS standard
-        Win2TRS(file_name, cFile);
+            // Otherwise a file with sectors the image file doesn't map goes through the buffer
+            else if (dwError == 0)
+            {
 
-        // Set target filename
-        memcpy(File.szName, cFile, 8);
-        memcpy(File.szType, &cFile[8], 3);
+                if (fflush(hFile) != 0)
+                {
+                    free(pRuns);
+                    dwError = ERROR_WRITE_FAULT;
+                    break;
+                }
 
-        // Set target file size
-        File.dwSize = st.st_size;
+                dwError = gpImage->Copy(pRuns, dwRuns, fileno(hFile), ((gdwFlags & V80_FLAG_READBAD) != 0), dwBytes);
 
-        // Set target file date
-        File.Date.nDay = t->tm_wday;
-        File.Date.nMonth = t->tm_mon + 1;
-        File.Date.wYear = t->tm_year + 1900;
+                free(pRuns);
 
-        // Set target file attributes
-        File.bSystem = false;
-        File.bInvisible = false;
-        File.bModified = true;
-        File.nAccess = OSI_PROT_FULL;
+                Tar.Advance(dwBytes);
+                dwPos = dwBytes;
 
-        // Format the filename for printing purposes
-        FmtName(File.szName, File.szType, (strcmp(typeid(*gpOSI).name()+2, "CPM") ? "/" : "."), szFile);
+                if (dwError == ERROR_WRITE_FAULT)
+                    break;
 
-        // Print the filenames
-        printf("%-12s -> %-12s\t", file_path, szFile);
+            }
 
-        // Check whether the file size is valid
-        if (File.dwSize > MAX_FILE_SIZE )
-        {
-            puts("Invalid size!");
-            goto Loop_End;
         }
 
-        // Open the Windows file
-        if ( (hFile = fopen(file_path, "r")) == NULL)
+        // Copy the rest through the buffer (a read error leaves the kernel copy at the bad sector)
+        for (dwError = 0; dwPos < File.dwSize; dwPos += dwLength)
         {
-            printf("Can't open: %s\n", file_path);
-            goto Loop_End;
-        }
 
-		dwBytes = fread(pBuffer, 1, File.dwSize, hFile);
-        // Read file contents to the buffer
-        if (dwBytes != File.dwSize)
-        {
-			fprintf(stderr,"Read error: %s - bytes read %d, expected %d \n", szFile, dwBytes,File.dwSize);
-                        perror("Returned error ");
-            fclose(hFile);
-            goto Loop_End;
-        }
+            dwLength = (File.dwSize - dwPos < V80_CHUNK ? File.dwSize - dwPos : V80_CHUNK);
 
-        // Close file handle
-		fclose(hFile);
+            if ((dwError = gpImage->Read(pFile, dwPos, pBuffer, (dwBytes = dwLength))) != 0)
+            {
 
-        // Create a TRS file with the properties defined above
-        if ((dwError = gpOSI->Create(&pFile, File)) != 0)
-            goto Exit_4;
+                // Give up unless the user wants as much as possible from bad files
+                if (!(gdwFlags & V80_FLAG_READBAD))
+                    break;
+
+                // Zero-fill the unreadable part
+                memset(&pBuffer[dwBytes], 0, dwLength - dwBytes);
+
+            }
+
+            if ((dwError = Tar.Write(pBuffer, dwLength)) != 0)
+                break;
 
-        // Move the file pointer to the beginning
-        if ((dwError = gpOSI->Seek(pFile, 0)) != 0)
+        }
+
+        if (dwError == ERROR_WRITE_FAULT)
+            break;
+
+        // Complete the member (zero-filled after a read error, so the archive stays readable)
+        if (Tar.Pad() != 0)
         {
-            gpOSI->Delete(pFile);
-            goto Exit_4;
+            dwError = ERROR_WRITE_FAULT;
+            break;
         }
 
-        // Write the buffer contents to the new file
-        if ((dwError = gpOSI->Write(pFile, pBuffer, File.dwSize)) != 0)
+        if (dwError != 0)
         {
-            gpOSI->Delete(pFile);
-            goto Exit_4;
+            fprintf(ghOut, "Get read error\n");
+            continue;
         }
 
-        // Print the total number of bytes written
-        printf("%8d bytes OK\r\n", File.dwSize);
+        // Print total number of bytes archived
+        fprintf(ghOut, "%8d bytes\tOK\r\n", File.dwSize);
 
         // Update operation status variables
         wFiles++;
         dwSize += File.dwSize;
 
-Loop_End:
-        // if we are only adding a single file then stop
-        if (dir == NULL)
-            break;
     }
 
-    // Print operation summary
-    printf("\r\nTotal of %d bytes written in %d files.\r\n\r\n", dwSize, wFiles);
+    // If exited on "No More Files" then "No Error", once the archive is complete
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = Tar.End();
 
-    // Close find file handle
-    Exit_4:
-    if (dir != NULL)
-        closedir(dir);
+    if (!bStdout && fclose(hFile) != 0 && dwError == 0)
+        dwError = ERROR_WRITE_FAULT;
 
-    // Release the allocated memory
-    Exit_3:
-    if (pBuffer != NULL)
-        free(pBuffer);
+    if (dwError == ERROR_WRITE_FAULT)
+    {
+        fprintf(ghOut, "Write error: %s\n", (bStdout ? "stdout" : gpFileSpec[3]));
+        goto Exit_1;
+    }
 
-    // Release the OSI object
-    Exit_2:
-    if (gpOSI != NULL)
-        delete gpOSI;
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d bytes read from %d files.\r\n\r\n", dwSize, wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
 
-    // Release the VDI object
     Exit_1:
-    if (gpVDI != NULL)
-        delete gpVDI;
+    free(pBuffer);
+
+	if(dwError)
+		fprintf(ghOut, "TarGet dwError:%d\n", dwError);
 
     // Return
     Exit_0:
@@ -673,29 +1240,36 @@ Loop_End:
 }
 
 //---------------------------------------------------------------------------------
-// Rename files
+// Read files into a content-addressed store, with a manifest per image
 //---------------------------------------------------------------------------------
 
-DWORD Ren()
+DWORD StoreGet()
 {
 
     OSI_FILE    File;
-    char        cName[9];
-    char        cType[4];
-    char        cSource[11];
-    char        cTarget[11];
-    char        szFromFile[13];
-    char        szToFile[13];
+    char        cMask[11];
+    char        szTRSFile[13];
+    char        szManifest[MAX_PATH];
+    char        szTemp[MAX_PATH];
     void*       pFile = NULL;
+    BYTE*       pData = NULL;
+    BYTE*       pMore;
+    DWORD       dwAlloc = 0;
+    DWORD       dwPos;
+    DWORD       dwBytes;
+    DWORD       dwLength;
+    unsigned long long qwHash;
+    bool        bWritten;
+    FILE*       hManifest = NULL;
+    CStore      Store;
     WORD        wFiles = 0;
+    WORD        wStored = 0;
+    DWORD       dwSize = 0;
+    DWORD       dwStored = 0;
     DWORD       dwError = 0;
 
-    // Clear variables cName and cType
-    memset(cName, 0, sizeof(cName));
-    memset(cType, 0, sizeof(cType));
-
-    // Check whether the user informed both the FROM and TO filespecs
-    if (gpFileSpec[2] == NULL || gpFileSpec[3] == NULL)
+    // Check whether the user informed the store directory
+    if (gpFileSpec[3] == NULL)
     {
         dwError = ERROR_BAD_ARGUMENTS;
         goto Exit_0;
@@ -707,75 +1281,139 @@ DWORD Ren()
 
     // Initialize the DOS interface
     if ((dwError = LoadOSI()) != 0)
-        goto Exit_1;
+        goto Exit_0;
+
+    if ((dwError = Store.Open(gpFileSpec[3])) != 0)
+    {
+        fprintf(ghOut, "Can't create the store: %s\n", gpFileSpec[3]);
+        goto Exit_0;
+    }
+
+    // The manifest replaces the previous one only when complete
+    Store.Manifest(gpFileSpec[1], szManifest, sizeof(szManifest));
+    snprintf(szTemp, sizeof(szTemp), "%s.tmp", szManifest);
+
+    if ((hManifest = fopen(szTemp, "w")) == NULL)
+    {
+        fprintf(ghOut, "Can't create: %s\n", szTemp);
+        dwError = ERROR_WRITE_FAULT;
+        goto Exit_0;
+    }
+
+    fprintf(hManifest, "# VDK-80 manifest: %s (%s %s)\n", gpFileSpec[1], gpImage->VDIName(), gpImage->OSIName());
 
     // Print operation objective
-    printf("\r\nRenaming files:\r\n\r\n");
+    fprintf(ghOut, "\r\nReading files into the store:\r\n\r\n");
 
-    // Convert Windows filespecs to TRS standards
-    Win2TRS(gpFileSpec[2], cSource);
-    Win2TRS(gpFileSpec[3], cTarget);
+    // Convert Windows filespec to TRS standard
+    Win2TRS((gpFileSpec[2] != NULL ? gpFileSpec[2] : "*.*"), cMask);
 
     // While OSI::Dir() returns a valid file pointer
-    while ((dwError = gpOSI->Dir(&pFile, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
     {
 
-        // Get file properties
-        gpOSI->GetFile(pFile, File);
-
-        // Compare file attributes against user options
+        // Compare file attributes against user requests
         if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
             continue;
 
         // Compare the filename against the source filespec
-        if (!WildComp(File.szName, cSource, 8) || !WildComp(File.szType, &cSource[8], 3))
+        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
             continue;
 
-        // Copy the filename to the internal variable checking it against the target filespec
-        WildCopy(File.szName, cName, cTarget, 8);
-        WildCopy(File.szType, cType, &cTarget[8], 3);
+        FmtName(File.szName, File.szType, gpImage->Divider(), szTRSFile);
 
-        // Format "FROM" filename
-        FmtName(File.szName, File.szType, (strcmp(typeid(*gpOSI).name()+2, "CPM") ? "/" : "."), szFromFile);
+        fprintf(ghOut, "%-12s\t", szTRSFile);
 
-        // Replace current filename with the new one
-        memcpy(File.szName, cName, sizeof(cName));
-        memcpy(File.szType, cType, sizeof(cType));
+        // The contents are hashed before they can be named, so the file is read into memory (a disk is small)
+        if (File.dwSize > dwAlloc)
+        {
+            if ((pMore = (BYTE*)realloc(pData, File.dwSize)) == NULL)
+            {
+                dwError = ERROR_OUTOFMEMORY;
+                break;
+            }
+            pData = pMore;
+            dwAlloc = File.dwSize;
+        }
 
-        // Format "TO" filename
-        FmtName(cName, cType, (strcmp(typeid(*gpOSI).name()+2, "CPM") ? "/" : "."), szToFile);
+        for (dwPos = 0; dwPos < File.dwSize; dwPos += dwLength)
+        {
 
-        // Print filenames
-        printf("%-12s -> %-12s\t", szFromFile, szToFile);
+            dwLength = (File.dwSize - dwPos < V80_CHUNK ? File.dwSize - dwPos : V80_CHUNK);
 
-        // Update file properties
-        if ((dwError = gpOSI->SetFile(pFile, File)) != 0)
-            goto Exit_2;
+            if ((dwError = gpImage->Read(pFile, dwPos, &pData[dwPos], (dwBytes = dwLength))) != 0)
+            {
 
-        // Print OK if the file has been successfully renamed
-        printf("OK\r\n");
+                // Give up unless the user wants as much as possible from bad files
+                if (!(gdwFlags & V80_FLAG_READBAD))
+                    break;
 
-        // Update operation status variable
+                // Zero-fill the unreadable part
+                memset(&pData[dwPos + dwBytes], 0, dwLength - dwBytes);
+                dwError = 0;
+
+            }
+
+        }
+
+        if (dwError != 0)
+        {
+            fprintf(ghOut, "Get read error\n");
+            dwError = 0;
+            continue;
+        }
+
+        // Write the blob only if the store doesn't have it yet
+        if ((dwError = Store.Put(pData, File.dwSize, qwHash, bWritten)) != 0)
+        {
+            fprintf(ghOut, (dwError == ERROR_FILE_EXISTS ? "Hash collision: %016llx\n" : "Write error: %016llx\n"), qwHash);
+            break;
+        }
+
+        fprintf(hManifest, "%016llx %8d %04d-%02d-%02d %c%c%c %d %3d %s\n", qwHash, File.dwSize,
+            File.Date.wYear, File.Date.nMonth, File.Date.nDay, (File.bSystem ? 'S' : '-'), (File.bInvisible ? 'I' : '-'), (File.bModified ? 'M' : '-'),
+            File.nAccess, File.nLRL, szTRSFile);
+
+        // Print the hash and whether the contents were new to the store
+        fprintf(ghOut, "%8d bytes\t%016llx %s\r\n", File.dwSize, qwHash, (bWritten ? "Stored" : "Present"));
+
+        // Update operation status variables
         wFiles++;
+        dwSize += File.dwSize;
 
-    }
+        if (bWritten)
+        {
+            wStored++;
+            dwStored += File.dwSize;
+        }
 
-    // Print operation summary
-    printf("\r\nTotal of %d files renamed.\r\n\r\n", wFiles);
+    }
 
     // If exited on "No More Files" then "No Error"
     if (dwError == ERROR_NO_MORE_FILES)
         dwError = 0;
 
-    // Release the OSI object
-    Exit_2:
-    if (gpOSI != NULL)
-        delete gpOSI;
+    if (fclose(hManifest) != 0 && dwError == 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    if (dwError == 0 && rename(szTemp, szManifest) != 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    if (dwError != 0)
+    {
+        unlink(szTemp);
+        goto Exit_1;
+    }
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d bytes read from %d files, %d bytes stored in %d new objects.\r\n\r\n", dwSize, wFiles, dwStored, wStored);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
 
-    // Release the VDI object
     Exit_1:
-    if (gpVDI != NULL)
-        delete gpVDI;
+    free(pData);
 
     // Return
     Exit_0:
@@ -784,20 +1422,26 @@ DWORD Ren()
 }
 
 //---------------------------------------------------------------------------------
-// Delete files
+// Write files to the disk
 //---------------------------------------------------------------------------------
 
-DWORD Del()
+DWORD Put()
 {
+    char            szFileSpec[MAX_PATH];
+    char            cFile[11];
+    char            szFile[13];
+    OSI_FILE        File;
+    void*           pFile;
+    FILE 	       *hFile;
+    WORD            wFiles = 0;
+    DWORD           dwSize = 0;
+    CStream         Stream;
+    DWORD           dwError = 0;
+    DIR            *dir = NULL;
+    class dirent *ent;
+    class stat st;
 
-    OSI_FILE    File;
-    char        cMask[11];
-    char        szFile[13];
-    void*       pFile = NULL;
-    WORD        wFiles = 0;
-    DWORD       dwError = 0;
-
-    // Check whether the user informed a filespec
+    // Check whether the user informed a FROM filespec
     if (gpFileSpec[2] == NULL)
     {
         dwError = ERROR_BAD_ARGUMENTS;
@@ -810,162 +1454,2125 @@ DWORD Del()
 
     // Initialize the DOS interface
     if ((dwError = LoadOSI()) != 0)
-        goto Exit_1;
+        goto Exit_0;
+
+    // Allocate the transfer chunks, reused for every file
+    if ((dwError = Stream.Alloc()) != 0)
+    {
+		perror("Put");
+        goto Exit_0;
+    }
 
     // Print operation objective
-    printf("\r\nDeleting files:\r\n\r\n");
+    fprintf(ghOut, "\r\nWriting files to disk:\r\n\r\n");
 
-    // Convert Windows filespec to TRS standard
-    Win2TRS(gpFileSpec[2], cMask);
+    // Get the target file path
+	if( realpath(gpFileSpec[2], szFileSpec) == NULL )
+    {
+		perror("Put");
+        dwError = ERROR_NOT_FOUND;
+        goto Exit_0;
+    }
 
-    // While OSI::Dir() returns a valid file pointer
-    while ((dwError = gpOSI->Dir(&pFile, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    if (stat(szFileSpec, &st) == -1)
     {
+        fprintf(ghOut, "stat(%s) failed.\n", szFileSpec);
+        dwError = ERROR_NOT_FOUND;
+        goto Exit_0;
+    }
 
-        // Get file properties
-        gpOSI->GetFile(pFile, File);
+    if(st.st_mode & S_IFDIR)
+    {
+        dir = opendir(szFileSpec);
+        if (!dir)
+        {
+		    perror("opendir failed");
+            dwError = ERROR_NOT_FOUND;
+            goto Exit_0;
+        }
+    }
 
-        // Compare file attributes against user options
-        if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
-            continue;
+    // While there are files pending for writing
+    while (dir == NULL || (ent = readdir(dir)) != NULL) {
+        char file_path[PATH_MAX];
+		struct tm *t;
+        const char *file_name = (dir == NULL) ? basename(szFileSpec) : ent->d_name;
 
-        // Compare the filename against the source filespec
-        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
-            continue;
+        if (file_name[0] == '.')
+            goto Loop_End;
+        
+        if (dir == NULL)
+            strcpy(file_path, szFileSpec);
+        else
+            snprintf(file_path, sizeof(file_path), "%s/%s", szFileSpec, file_name);
 
-        // Format filename
-        FmtName(File.szName, File.szType, (strcmp(typeid(*gpOSI).name()+2, "CPM") ? "/" : "."), szFile);
+        if (stat(file_path, &st) == -1)
+        {
+            fprintf(ghOut, "stat(%s) failed.\n", file_path);
+            goto Loop_End;
+        }
 
-        // Print filename
-        printf("%-12s\t", szFile);
+        if(st.st_mode & S_IFDIR) 
+            goto Loop_End;
 
-        // Delete the file
-        dwError = gpOSI->Delete(pFile);
+		t = gmtime((const time_t *)&st.st_mtime);
 
-        // Print error message
-        if (dwError != 0)
+        // Convert Windows filename to the TRS standard
+        Win2TRS(file_name, cFile);
+
+        // Set target filename
+        memcpy(File.szName, cFile, 8);
+        memcpy(File.szType, &cFile[8], 3);
+
+        // Set target file size
+        File.dwSize = st.st_size;
+
+        // Set target file date
+        File.Date.nDay = t->tm_wday;
+        File.Date.nMonth = t->tm_mon + 1;
+        File.Date.wYear = t->tm_year + 1900;
+
+        // Set target file attributes
+        File.bSystem = false;
+        File.bInvisible = false;
+        File.bModified = true;
+        File.nAccess = OSI_PROT_FULL;
+        File.nLRL = 0;
+
+        // Format the filename for printing purposes
+        FmtName(File.szName, File.szType, gpImage->Divider(), szFile);
+
+        // Print the filenames
+        fprintf(ghOut, "%-12s -> %-12s\t", file_path, szFile);
+
+        // Check whether the file size fits the directory entry
+        if ((off_t)File.dwSize != st.st_size)
         {
-			printf("Delete dwError:%d\n", dwError);
-            continue;
+            fprintf(ghOut, "Invalid size!\n");
+            goto Loop_End;
         }
 
-        // Print OK if the file has been successfully deleted
-        printf("OK\r\n");
+        // Open the Windows file
+        if ( (hFile = fopen(file_path, "r")) == NULL)
+        {
+            fprintf(ghOut, "Can't open: %s\n", file_path);
+            goto Loop_End;
+        }
 
-        // Update operation status variable
+        // Create a TRS file with the properties defined above
+        if ((dwError = gpImage->Create(&pFile, File)) != 0)
+        {
+            fclose(hFile);
+            goto Exit_4;
+        }
+
+        // Stream the Windows file contents to the new file
+        dwError = Stream.Put(gpImage, pFile, File.dwSize, hFile);
+
+        // Close file handle
+		fclose(hFile);
+
+        // A host read error only skips this file, a disk write error stops the command
+        if (dwError == ERROR_READ_FAULT)
+        {
+			fprintf(stderr,"Read error: %s\n", file_path);
+            gpImage->Delete(pFile);
+            dwError = 0;
+            goto Loop_End;
+        }
+        else if (dwError != 0)
+        {
+            gpImage->Delete(pFile);
+            goto Exit_4;
+        }
+
+        // Print the total number of bytes written
+        fprintf(ghOut, "%8d bytes OK\r\n", File.dwSize);
+
+        // Update operation status variables
         wFiles++;
+        dwSize += File.dwSize;
 
+Loop_End:
+        // if we are only adding a single file then stop
+        if (dir == NULL)
+            break;
     }
 
     // Print operation summary
-    printf("\r\nTotal of %d files deleted.\r\n\r\n", wFiles);
+    fprintf(ghOut, "\r\nTotal of %d bytes written in %d files.\r\n\r\n", dwSize, wFiles);
 
-    // If exited on "No More Files" then "No Error"
-    if (dwError == ERROR_NO_MORE_FILES)
-        dwError = 0;
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
 
-    // Release the OSI object
-    if (gpOSI != NULL)
-        delete gpOSI;
+    // Close find file handle
+    Exit_4:
+    if (dir != NULL)
+        closedir(dir);
 
-    // Release the VDI object
-    Exit_1:
-    if (gpVDI != NULL)
-        delete gpVDI;
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Write files to the disk from a tar stream, with one directory commit
+//---------------------------------------------------------------------------------
+
+DWORD TarPut()
+{
+
+    OSI_FILE    File;
+    OSI_FILE    Existing;
+    FILE*       hFile = NULL;
+    char        szName[256];
+    char        cFile[11];
+    char        szFile[13];
+    const char* pBase;
+    void*       pFile;
+    BYTE*       pBuffer = NULL;
+    BYTE*       pData = NULL;
+    size_t      nData = 0;
+    size_t      nRead;
+    WORD        wFiles = 0;
+    DWORD       dwSize = 0;
+    DWORD       dwDone;
+    DWORD       dwLength;
+    DWORD       dwBytes;
+    DWORD       dwGranule;
+    DWORD       dwGranules;
+    DWORD       dwNeeded = 0;
+    DWORD       dwFreed = 0;
+    DWORD       dwEntries;
+    DWORD       dwNew = 0;
+    CTar        Tar;
+    bool        bStdin;
+    bool        bHeld;
+    bool        bWriteError;
+    DWORD       dwError = 0;
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Initialize the DOS interface
+    if ((dwError = LoadOSI()) != 0)
+        goto Exit_0;
+
+    if ((pBuffer = (BYTE*)malloc(V80_CHUNK)) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Exit_0;
+    }
+
+    // The archive comes from stdin unless a source is given
+    bStdin = (gpFileSpec[2] == NULL || strcmp(gpFileSpec[2], "-") == 0);
+
+    if (bStdin && gnImages > 0)
+    {
+        fprintf(ghOut, "The archive must be a file in batch mode.\n");
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_1;
+    }
+
+    // The archive is read twice, so stdin is kept in memory (a disk worth of files)
+    if (bStdin)
+    {
+
+        do
+        {
+            if ((pData = (BYTE*)realloc(pData, nData + V80_CHUNK)) == NULL)
+            {
+                dwError = ERROR_OUTOFMEMORY;
+                goto Exit_1;
+            }
+            nData += (nRead = fread(&pData[nData], 1, V80_CHUNK, stdin));
+        }
+        while (nRead == V80_CHUNK);
+
+        // A zero byte after the data lets an empty stream open as well (it reads as the end of the archive)
+        pData[nData] = 0;
+        hFile = fmemopen(pData, nData + 1, "r");
+
+    }
+    else
+        hFile = fopen(gpFileSpec[2], "r");
+
+    if (hFile == NULL)
+    {
+        fprintf(ghOut, "Can't open: %s\n", (bStdin ? "stdin" : gpFileSpec[2]));
+        dwError = ERROR_FILE_NOT_FOUND;
+        goto Exit_1;
+    }
+
+    // Keep the directory in memory until every file is in (not every DOS can)
+    bHeld = (gpImage->Hold() == 0);
+
+    // First pass: add up the granules and directory entries the files need
+    if (gpImage->Free(dwGranule, dwGranules) == 0 && dwGranule != 0)
+    {
+
+        Tar.Open(hFile);
+
+        while ((dwError = Tar.Next(szName, sizeof(szName), File)) == 0)
+        {
+
+            pBase = strrchr(szName, '/');
+            pBase = (pBase ? pBase + 1 : szName);
+
+            if (pBase[0] == '.' || pBase[0] == 0)
+                continue;
+
+            if (gpImage->Find(&pFile, pBase) == 0)
+            {
+                gpImage->GetFile(pFile, Existing);
+                if (Existing.bSystem)
+                    continue;
+                dwFreed += (Existing.dwSize + dwGranule - 1) / dwGranule;
+            }
+            else
+                dwNew++;
+
+            dwNeeded += (File.dwSize + dwGranule - 1) / dwGranule;
+
+        }
+
+        if (dwError != ERROR_NO_MORE_FILES)
+        {
+            fprintf(ghOut, "Bad tar archive: %s\n", (bStdin ? "stdin" : gpFileSpec[2]));
+            goto Exit_2;
+        }
+
+        // While held, the granules of the replaced files are only free after the commit
+        if (bHeld)
+            dwFreed = 0;
+
+        // Leave the disk untouched when the files can't fit (a replaced file's entry is reused)
+        if (dwNeeded > dwGranules + dwFreed)
+        {
+            fprintf(ghOut, "Not enough space: %d granules needed, %d available.\n", dwNeeded, dwGranules + dwFreed);
+            dwError = ERROR_DISK_FULL;
+            goto Exit_2;
+        }
+
+        if (gpImage->Entries(dwEntries) == 0 && dwNew > dwEntries)
+        {
+            fprintf(ghOut, "Not enough directory entries: %d needed, %d available.\n", dwNew, dwEntries);
+            dwError = ERROR_DISK_FULL;
+            goto Exit_2;
+        }
+
+        rewind(hFile);
+
+    }
+
+    // Print operation objective
+    fprintf(ghOut, "\r\nWriting files to disk:\r\n\r\n");
+
+    // Second pass: write the files
+    Tar.Open(hFile);
+
+    while ((dwError = Tar.Next(szName, sizeof(szName), File)) == 0)
+    {
+
+        // Directories in the member names are dropped, hidden host files skipped
+        pBase = strrchr(szName, '/');
+        pBase = (pBase ? pBase + 1 : szName);
+
+        if (pBase[0] == '.' || pBase[0] == 0)
+            continue;
+
+        // Convert the host filename to the TRS standard
+        Win2TRS(pBase, cFile);
+        memcpy(File.szName, cFile, 8);
+        memcpy(File.szType, &cFile[8], 3);
+
+        // Format the filename for printing purposes
+        FmtName(File.szName, File.szType, gpImage->Divider(), szFile);
+
+        // Print the filenames
+        fprintf(ghOut, "%-12s -> %-12s\t", pBase, szFile);
+
+        // Replace a file by the same name, unless it is a system file
+        if (gpImage->Find(&pFile, pBase) == 0)
+        {
+
+            gpImage->GetFile(pFile, Existing);
+
+            if (Existing.bSystem)
+            {
+                fprintf(ghOut, "%8d bytes Skipped\r\n", File.dwSize);
+                continue;
+            }
+
+            if ((dwError = gpImage->Delete(pFile)) != 0)
+            {
+                fprintf(ghOut, "Can't replace: %s\n", szFile);
+                break;
+            }
+
+        }
+
+        // Create a TRS file with the archived properties (size, date, attributes and LRL)
+        if ((dwError = gpImage->Create(&pFile, File)) != 0)
+        {
+            fprintf(ghOut, "Can't create: %s\n", szFile);
+            break;
+        }
+
+        // Copy the member data one chunk at a time
+        for (dwDone = 0, bWriteError = false; dwDone < File.dwSize; dwDone += dwLength)
+        {
+
+            dwLength = (File.dwSize - dwDone < V80_CHUNK ? File.dwSize - dwDone : V80_CHUNK);
+
+            if ((dwError = Tar.Read(pBuffer, dwLength)) != 0)
+                break;
+
+            if ((dwError = gpImage->Write(pFile, dwDone, pBuffer, (dwBytes = dwLength))) != 0)
+            {
+                bWriteError = true;
+                break;
+            }
+
+        }
+
+        // A truncated archive or a disk write error stops the command
+        if (dwError != 0)
+        {
+            gpImage->Delete(pFile);
+            fprintf(ghOut, (bWriteError ? "Write error: %s\n" : "Tar read error\n"), szFile);
+            break;
+        }
+
+        // Print the total number of bytes written
+        fprintf(ghOut, "%8d bytes OK\r\n", File.dwSize);
+
+        // Update operation status variables
+        wFiles++;
+        dwSize += File.dwSize;
+
+    }
+
+    // If exited on "No More Files" then "No Error"
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = 0;
+    else if (dwError == ERROR_FILE_CORRUPT)
+        fprintf(ghOut, "Bad tar archive: %s\n", (bStdin ? "stdin" : gpFileSpec[2]));
+
+    // Write the directory once, only when every file made it
+    if (dwError == 0)
+        dwError = gpImage->Commit();
+    else if (bHeld)
+    {
+        fprintf(ghOut, "\r\nThe directory was left unchanged.\r\n");
+        wFiles = 0;
+        dwSize = 0;
+    }
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d bytes written in %d files.\r\n\r\n", dwSize, wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
+
+    // Discard whatever is still held (nothing after a commit)
+    Exit_2:
+    if (bHeld)
+        gpImage->Drop();
+
+    fclose(hFile);
+
+    Exit_1:
+    free(pBuffer);
+    free(pData);
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Bring the image in line with a host directory, in one directory commit
+//---------------------------------------------------------------------------------
+
+DWORD Sync()
+{
+
+    char        szDir[MAX_PATH];
+    struct stat st;
+    DWORD       dwError = 0;
+
+    // Check whether the user informed a FROM directory
+    if (gpFileSpec[2] == NULL)
+    {
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    if (realpath(gpFileSpec[2], szDir) == NULL || stat(szDir, &st) == -1 || !S_ISDIR(st.st_mode))
+    {
+        fprintf(ghOut, "Not a directory: %s\n", gpFileSpec[2]);
+        dwError = ERROR_NOT_FOUND;
+        goto Exit_0;
+    }
+
+    // The watch mode keeps running, so it takes a single image
+    if ((gdwFlags & V80_FLAG_WATCH) && gnImages > 0)
+    {
+        fprintf(ghOut, "The watch mode takes a single image.\n");
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Initialize the DOS interface
+    if ((dwError = LoadOSI()) != 0)
+        goto Exit_0;
+
+    // Compare the whole directory
+    dwError = SyncPass(szDir, NULL, 0);
+
+    // Then follow the changes, if requested
+    if (dwError == 0 && (gdwFlags & V80_FLAG_WATCH))
+        dwError = SyncWatch(szDir);
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Create, replace or delete the image files that differ from the host directory
+// (pNames limits the pass to the named host files, NULL compares everything)
+//---------------------------------------------------------------------------------
+
+DWORD SyncPass(const char* pDir, char** pNames, int nNames)
+{
+
+    CSync       Sync;
+    DWORD       dwNeeded;
+    DWORD       dwAvailable;
+    bool        bEntries;
+    DWORD       dwError = 0;
+
+    if ((dwError = Sync.Plan(gpImage, pDir, pNames, nNames, gdwFlags)) != 0)
+    {
+        if (dwError == ERROR_NOT_FOUND)
+            fprintf(ghOut, "Can't open: %s\n", pDir);
+        goto Exit_0;
+    }
+
+    // Nothing to do unless a file is created, replaced or deleted
+    if (Sync.Changes() == 0)
+    {
+        if (pNames == NULL)
+            fprintf(ghOut, "\r\nThe image is up to date (%d files).\r\n\r\n", Sync.Unchanged());
+        goto Exit_0;
+    }
+
+    // Leave the disk untouched when the files can't fit
+    if ((dwError = Sync.Begin(dwNeeded, dwAvailable, bEntries)) != 0)
+    {
+        if (bEntries)
+            fprintf(ghOut, "Not enough directory entries: %d needed, %d available.\n", dwNeeded, dwAvailable);
+        else
+            fprintf(ghOut, "Not enough space: %d granules needed, %d available.\n", dwNeeded, dwAvailable);
+        Sync.End(dwError);
+        goto Exit_0;
+    }
+
+    // Print operation objective
+    fprintf(ghOut, "\r\nSyncing files to disk:\r\n\r\n");
+
+    dwError = Sync.Apply(SyncReport, NULL);
+
+    if (dwError != 0 && Sync.Held())
+        fprintf(ghOut, "\r\nThe directory was left unchanged.\r\n");
+
+    // Write the directory once, only when every change made it
+    dwError = Sync.End(dwError);
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d bytes written in %d files, %d deleted, %d unchanged.\r\n\r\n", Sync.Bytes(), Sync.Files(), Sync.Deleted(), Sync.Unchanged());
+
+    // Report the totals to the batch mode
+    gdwFiles = Sync.Files() + Sync.Deleted();
+    gdwBytes = Sync.Bytes();
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Print the outcome of a file changed or skipped by a sync pass
+//---------------------------------------------------------------------------------
+
+void SyncReport(void* pParam, const SYNC_ITEM& Item)
+{
+
+    if (Item.nAction == SYNC_DELETE)
+    {
+        if (Item.nResult == SYNC_NO_DELETE)
+            fprintf(ghOut, "%-12s\tCan't delete: %s\n", Item.szFile, Item.szFile);
+        else
+            fprintf(ghOut, "%-12s\tDeleted\r\n", Item.szFile);
+        return;
+    }
+
+    fprintf(ghOut, "%-12s -> %-12s\t", Item.szHost, Item.szFile);
+
+    if (Item.nAction == SYNC_SKIP)
+    {
+        fprintf(ghOut, "%s\r\n", Item.pReason);
+        return;
+    }
+
+    switch (Item.nResult)
+    {
+        case SYNC_NO_OPEN:
+            fprintf(ghOut, "Can't open: %s\n", Item.szHost);
+            break;
+        case SYNC_NO_DELETE:
+            fprintf(ghOut, "Can't replace: %s\n", Item.szFile);
+            break;
+        case SYNC_NO_CREATE:
+            fprintf(ghOut, "Can't create: %s\n", Item.szFile);
+            break;
+        case SYNC_NO_READ:
+            fprintf(ghOut, "Read error: %s\n", Item.szHost);
+            break;
+        case SYNC_NO_WRITE:
+            fprintf(ghOut, "Write error: %s\n", Item.szFile);
+            break;
+        default:
+            fprintf(ghOut, "%8d bytes %s\r\n", Item.dwSize, (Item.nAction == SYNC_CREATE ? "Created" : "Replaced"));
+    }
+
+}
+
+//---------------------------------------------------------------------------------
+// Apply the host directory changes as they happen, until interrupted
+//---------------------------------------------------------------------------------
+
+DWORD SyncWatch(const char* pDir)
+{
+
+    struct sigaction Action, OldInt, OldTerm;
+    DWORD       dwError = 0;
+
+    // Ctrl-C stops the watch after applying the pending changes (no SA_RESTART, so that poll() returns)
+    memset(&Action, 0, sizeof(Action));
+    Action.sa_handler = SyncStop;
+    sigemptyset(&Action.sa_mask);
+    sigaction(SIGINT, &Action, &OldInt);
+    sigaction(SIGTERM, &Action, &OldTerm);
+
+    fprintf(ghOut, "Watching %s (Ctrl-C to stop)\r\n", pDir);
+    fflush(ghOut);
+
+    dwError = CSync::Watch(pDir, SyncChanged, (void*)pDir, &gbSyncStop);
+
+    if (dwError == ERROR_NOT_SUPPORTED)
+        fprintf(ghOut, "Can't watch: %s\n", pDir);
+    else if (dwError == ERROR_NOT_FOUND)
+        fprintf(ghOut, "The directory is gone: %s\n", pDir);
+    else
+        fprintf(ghOut, "\r\nStopped watching %s\r\n", pDir);
+
+    sigaction(SIGINT, &OldInt, NULL);
+    sigaction(SIGTERM, &OldTerm, NULL);
+
+    // Return
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Sync the host files changed since the last pass (pNames NULL: every file)
+//---------------------------------------------------------------------------------
+
+DWORD SyncChanged(void* pParam, char** pNames, int nNames)
+{
+
+    const char* pVDI = gpImage->VDIName();
+    const char* pOSI = gpImage->OSIName();
+    DWORD       dwError = 0;
+
+    // Reload the image, in case something else wrote to it since the last pass
+    if ((dwError = gpImage->Open(gpFileSpec[1], gdwFlags)) != 0 || (dwError = gpImage->Probe(pVDI, pOSI)) != 0)
+    {
+        fprintf(ghOut, "Can not open: %s\n", gpFileSpec[1]);
+        return dwError;
+    }
+
+    dwError = SyncPass((const char*)pParam, pNames, nNames);
+
+    gpImage->Flush();
+    fflush(ghOut);
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Signal handler of the watch mode
+//---------------------------------------------------------------------------------
+
+void SyncStop(int nSignal)
+{
+    gbSyncStop = 1;
+}
+
+//---------------------------------------------------------------------------------
+// Rename files
+//---------------------------------------------------------------------------------
+
+DWORD Ren()
+{
+
+    OSI_FILE    File;
+    char        cName[9];
+    char        cType[4];
+    char        cSource[11];
+    char        cTarget[11];
+    char        szFromFile[13];
+    char        szToFile[13];
+    void*       pFile = NULL;
+    WORD        wFiles = 0;
+    DWORD       dwError = 0;
+
+    // Clear variables cName and cType
+    memset(cName, 0, sizeof(cName));
+    memset(cType, 0, sizeof(cType));
+
+    // Check whether the user informed both the FROM and TO filespecs
+    if (gpFileSpec[2] == NULL || gpFileSpec[3] == NULL)
+    {
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Initialize the DOS interface
+    if ((dwError = LoadOSI()) != 0)
+        goto Exit_0;
+
+    // Print operation objective
+    fprintf(ghOut, "\r\nRenaming files:\r\n\r\n");
+
+    // Convert Windows filespecs to TRS standards
+    Win2TRS(gpFileSpec[2], cSource);
+    Win2TRS(gpFileSpec[3], cTarget);
+
+    // While OSI::Dir() returns a valid file pointer
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    {
+
+        // Compare file attributes against user options
+        if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
+            continue;
+
+        // Compare the filename against the source filespec
+        if (!WildComp(File.szName, cSource, 8) || !WildComp(File.szType, &cSource[8], 3))
+            continue;
+
+        // Copy the filename to the internal variable checking it against the target filespec
+        WildCopy(File.szName, cName, cTarget, 8);
+        WildCopy(File.szType, cType, &cTarget[8], 3);
+
+        // Format "FROM" filename
+        FmtName(File.szName, File.szType, gpImage->Divider(), szFromFile);
+
+        // Replace current filename with the new one
+        memcpy(File.szName, cName, sizeof(cName));
+        memcpy(File.szType, cType, sizeof(cType));
+
+        // Format "TO" filename
+        FmtName(cName, cType, gpImage->Divider(), szToFile);
+
+        // Print filenames
+        fprintf(ghOut, "%-12s -> %-12s\t", szFromFile, szToFile);
+
+        // Update file properties
+        if ((dwError = gpImage->SetFile(pFile, File)) != 0)
+            goto Exit_0;
+
+        // Print OK if the file has been successfully renamed
+        fprintf(ghOut, "OK\r\n");
+
+        // Update operation status variable
+        wFiles++;
+
+    }
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d files renamed.\r\n\r\n", wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+
+    // If exited on "No More Files" then "No Error"
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = 0;
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Delete files
+//---------------------------------------------------------------------------------
+
+DWORD Del()
+{
+
+    OSI_FILE    File;
+    char        cMask[11];
+    char        szFile[13];
+    void*       pFile = NULL;
+    WORD        wFiles = 0;
+    DWORD       dwError = 0;
+
+    // Check whether the user informed a filespec
+    if (gpFileSpec[2] == NULL)
+    {
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Initialize the DOS interface
+    if ((dwError = LoadOSI()) != 0)
+        goto Exit_1;
+
+    // Print operation objective
+    fprintf(ghOut, "\r\nDeleting files:\r\n\r\n");
+
+    // Convert Windows filespec to TRS standard
+    Win2TRS(gpFileSpec[2], cMask);
+
+    // While OSI::Dir() returns a valid file pointer
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    {
+
+        // Compare file attributes against user options
+        if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
+            continue;
+
+        // Compare the filename against the source filespec
+        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
+            continue;
+
+        // Format filename
+        FmtName(File.szName, File.szType, gpImage->Divider(), szFile);
+
+        // Print filename
+        fprintf(ghOut, "%-12s\t", szFile);
+
+        // Delete the file
+        dwError = gpImage->Delete(pFile);
+
+        // Print error message
+        if (dwError != 0)
+        {
+			fprintf(ghOut, "Delete dwError:%d\n", dwError);
+            continue;
+        }
+
+        // Print OK if the file has been successfully deleted
+        fprintf(ghOut, "OK\r\n");
+
+        // Update operation status variable
+        wFiles++;
+
+    }
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d files deleted.\r\n\r\n", wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+
+    // If exited on "No More Files" then "No Error"
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = 0;
+
+    Exit_1:
+	if (dwError)
+		fprintf(ghOut, "Delete dwError:%d\n", dwError);
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Extract a byte range (or a logical record range) of files
+//---------------------------------------------------------------------------------
+
+DWORD Extract()
+{
+
+    OSI_FILE    File;
+    FILE*       hFile;
+    char        cMask[11];
+    char        szTRSFile[13];
+    char        szWinFile[13];
+    char        szFile[MAX_PATH];
+    void*       pFile = NULL;
+    BYTE*       pBuffer = NULL;
+    WORD        wFiles = 0;
+    DWORD       dwSize = 0;
+    DWORD       dwUnit;
+    DWORD       dwPos;
+    DWORD       dwEnd;
+    DWORD       dwDone;
+    DWORD       dwLength;
+    DWORD       dwBytes;
+    DWORD       dwError = 0;
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Initialize the DOS interface
+    if ((dwError = LoadOSI()) != 0)
+        goto Exit_0;
+
+    // Allocate one transfer chunk, reused for every file
+    if ((pBuffer = (BYTE*)calloc(V80_CHUNK,1)) == NULL)
+    {
+        perror("Extract");
+        dwError = ERROR_OUTOFMEMORY;
+        goto Exit_0;
+    }
+
+    // Print operation objective
+    fprintf(ghOut, "\r\nExtracting files from disk:\r\n\r\n");
+
+    // Convert Windows filespec to TRS standard
+    Win2TRS((gpFileSpec[2] != NULL ? gpFileSpec[2] : "*.*"), cMask);
+
+    // While OSI::Dir() returns a valid file pointer
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    {
+
+        // Compare file attributes against user requests
+        if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
+            continue;
+
+        // Compare the filename against the source filespec
+        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
+            continue;
+
+        // Format the filenames
+        FmtName(File.szName, File.szType, gpImage->Divider(), szTRSFile);
+        FmtName(File.szName, File.szType, ".", szWinFile);
+
+        // Add the user specified path (if any) to the Windows-based filename
+        sprintf(szFile, "%s/%s", (gpFileSpec[3] ? gpFileSpec[3] : "."), szWinFile);
+
+        // Print filenames
+        fprintf(ghOut, "%-12s -> %-12s\t", szTRSFile, szFile);
+
+        // Convert the requested range to bytes (an LRL of 0 stands for 256-byte records) and clip it to the file
+        dwUnit = ((gdwFlags & V80_FLAG_RECORDS) ? (File.nLRL == 0 ? 256 : File.nLRL) : 1);
+        dwPos = gdwRangeAt * dwUnit;
+        dwEnd = (gdwRangeLen == 0 || gdwRangeLen * dwUnit > File.dwSize - dwPos ? File.dwSize : dwPos + gdwRangeLen * dwUnit);
+
+        if (dwPos >= File.dwSize)
+        {
+            fprintf(ghOut, "%8d bytes\tSkipped\r\n", 0);
+            continue;
+        }
+
+        // Create Windows file
+        if ((hFile = fopen(szFile, "w")) == NULL)
+        {
+            fprintf(ghOut, "Can't open: %s\n", szFile);
+            continue;
+        }
+
+        // Copy the range one chunk at a time, reading only the sectors it covers
+        for (dwDone = dwPos; dwDone < dwEnd; dwDone += dwLength)
+        {
+
+            dwLength = (dwEnd - dwDone < V80_CHUNK ? dwEnd - dwDone : V80_CHUNK);
+
+            if ((dwError = gpImage->Read(pFile, dwDone, pBuffer, (dwBytes = dwLength))) != 0)
+            {
+
+                if (!(gdwFlags & V80_FLAG_READBAD))
+                    break;
+
+                // Zero-fill the unreadable part
+                memset(&pBuffer[dwBytes], 0, dwLength - dwBytes);
+                dwError = 0;
+
+            }
+
+            if (fwrite(pBuffer, 1, dwLength, hFile) != dwLength)
+            {
+                dwError = ERROR_WRITE_FAULT;
+                break;
+            }
+
+        }
+
+        // Close file handle
+        fclose(hFile);
+
+        // Do not leave a truncated copy behind
+        if (dwError != 0)
+        {
+            fprintf(ghOut, (dwError == ERROR_WRITE_FAULT ? "Write error: %s\n" : "Extract read error\n"), szFile);
+            remove(szFile);
+            continue;
+        }
+
+        // Print total number of bytes extracted
+        fprintf(ghOut, "%8d bytes\tOK\r\n", dwEnd - dwPos);
+
+        // Update operation status variables
+        wFiles++;
+        dwSize += dwEnd - dwPos;
+
+    }
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d bytes read from %d files.\r\n\r\n", dwSize, wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
+
+    // If exited on "No More Files" then "No Error"
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = 0;
+
+    // Release the allocated memory
+    free(pBuffer);
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Copy files straight into another disk image
+//---------------------------------------------------------------------------------
+
+DWORD Copy()
+{
+
+    CImage      Target;
+    OSI_FILE    File;
+    OSI_FILE    Existing;
+    char        szSource[MAX_PATH];
+    char        szImage[MAX_PATH];
+    char        cMask[11];
+    char        szFile[13];
+    char        szWinFile[13];
+    char        szTarget[13];
+    void*       pFile = NULL;
+    void*       pTarget;
+    BYTE*       pBuffer = NULL;
+    WORD        wFiles = 0;
+    DWORD       dwSize = 0;
+    DWORD       dwDone;
+    DWORD       dwLength;
+    DWORD       dwBytes;
+    bool        bWriteError;
+    bool        bHeld;
+    DWORD       dwError = 0;
+
+    // Check whether the user informed both the source filespec and the target image
+    if (gpFileSpec[2] == NULL || gpFileSpec[3] == NULL)
+    {
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // The target must be another image
+    if (realpath(gpFileSpec[1], szSource) != NULL && realpath(gpFileSpec[3], szImage) != NULL && strcmp(szSource, szImage) == 0)
+    {
+        fprintf(ghOut, "Source and target are the same image.\n");
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Initialize the DOS interface
+    if ((dwError = LoadOSI()) != 0)
+        goto Exit_0;
+
+    // Open the target image with its own disk and DOS interfaces (the forced ones apply to the source only)
+    if ((dwError = Target.Open(gpFileSpec[3], gdwFlags)) != 0)
+    {
+        fprintf(ghOut, "Can not open: %s\n", gpFileSpec[3]);
+        goto Exit_0;
+    }
+
+    if ((dwError = Target.Probe()) != 0)
+    {
+        fprintf(ghOut, "Unrecognized target image: %s\n", gpFileSpec[3]);
+        goto Exit_0;
+    }
+
+    // Allocate one transfer chunk, reused for every file
+    if ((pBuffer = (BYTE*)calloc(V80_CHUNK,1)) == NULL)
+    {
+        perror("Copy");
+        dwError = ERROR_OUTOFMEMORY;
+        goto Exit_0;
+    }
+
+    // Print operation objective
+    fprintf(ghOut, "\r\nCopying files to %s:\r\n\r\n", gpFileSpec[3]);
+
+    // Convert Windows filespec to TRS standard
+    Win2TRS(gpFileSpec[2], cMask);
+
+    // While OSI::Dir() returns a valid file pointer
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    {
+
+        // Compare file attributes against user requests
+        if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
+            continue;
+
+        // Compare the filename against the source filespec
+        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
+            continue;
+
+        // Format the filenames
+        FmtName(File.szName, File.szType, gpImage->Divider(), szFile);
+        FmtName(File.szName, File.szType, ".", szWinFile);
+        FmtName(File.szName, File.szType, Target.Divider(), szTarget);
+
+        // Print filenames
+        fprintf(ghOut, "%-12s -> %-12s\t", szFile, szTarget);
+
+        // A system file by the same name in the target image is left alone
+        if (Target.Find(&pTarget, szWinFile) == 0)
+        {
+
+            Target.GetFile(pTarget, Existing);
+
+            if (Existing.bSystem)
+            {
+                fprintf(ghOut, "%8d bytes\tSkipped\r\n", File.dwSize);
+                continue;
+            }
+
+        }
+        else
+            pTarget = NULL;
+
+        // Keep the target directory in memory until the file is in, so that a failed replace keeps the old one (not every DOS can)
+        bHeld = (Target.Hold() == 0);
+
+        // Replace a file by the same name
+        if (pTarget != NULL && (dwError = Target.Delete(pTarget)) != 0)
+        {
+            fprintf(ghOut, "Can't replace: %s\n", szTarget);
+            if (bHeld)
+                Target.Drop();
+            break;
+        }
+
+        // Create the target file with the source properties (size, date, attributes and LRL)
+        if ((dwError = Target.Create(&pTarget, File)) != 0)
+        {
+            fprintf(ghOut, "Can't create: %s\n", szTarget);
+            if (bHeld)
+                Target.Drop();
+            break;
+        }
+
+        // Copy the file contents one chunk at a time, straight from one image to the other
+        for (dwDone = 0, bWriteError = false; dwDone < File.dwSize; dwDone += dwLength)
+        {
+
+            dwLength = (File.dwSize - dwDone < V80_CHUNK ? File.dwSize - dwDone : V80_CHUNK);
+
+            if ((dwError = gpImage->Read(pFile, dwDone, pBuffer, (dwBytes = dwLength))) != 0)
+            {
+
+                if (!(gdwFlags & V80_FLAG_READBAD))
+                    break;
+
+                // Zero-fill the unreadable part
+                memset(&pBuffer[dwBytes], 0, dwLength - dwBytes);
+                dwError = 0;
+
+            }
+
+            if ((dwError = Target.Write(pTarget, dwDone, pBuffer, (dwBytes = dwLength))) != 0)
+            {
+                bWriteError = true;
+                break;
+            }
+
+        }
+
+        // A source read error only skips this file, a target write error stops the command
+        if (dwError != 0)
+        {
+            if (bHeld)
+                Target.Drop();
+            else
+                Target.Delete(pTarget);
+            fprintf(ghOut, (bWriteError ? "Write error: %s\n" : "Copy read error\n"), szTarget);
+            if (bWriteError)
+                break;
+            continue;
+        }
+
+        // Write the target directory with the new file in place of the old one
+        if (bHeld && (dwError = Target.Commit()) != 0)
+        {
+            fprintf(ghOut, "Write error: %s\n", szTarget);
+            break;
+        }
+
+        // Print the total number of bytes copied
+        fprintf(ghOut, "%8d bytes\tOK\r\n", File.dwSize);
+
+        // Update operation status variables
+        wFiles++;
+        dwSize += File.dwSize;
+
+    }
+
+    // If exited on "No More Files" then "No Error"
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = 0;
+
+    // Commit the target image
+    if (dwError == 0)
+        dwError = Target.Flush();
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d bytes copied in %d files.\r\n\r\n", dwSize, wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
+
+    // Return
+    Exit_0:
+    free(pBuffer);
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Convert the disk image into another disk format
+//---------------------------------------------------------------------------------
+
+DWORD Convert()
+{
+
+    CConvert        Convert;
+    CImage          Target;
+    VDI_GEOMETRY    DG;
+    VDI_GEOMETRY    TargetDG;
+    char            szSource[MAX_PATH];
+    char            szImage[MAX_PATH];
+    FILE*           hFile;
+    long            nSize;
+    DWORD           dwError = 0;
+
+    // Check whether the user informed the target image and its format
+    if (gpFileSpec[2] == NULL || gpTargetVDI == NULL)
+    {
+        fprintf(ghOut, "Missing the target image or its format (-odmk, -ojv1 or -ojv3).\n");
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // The target must be another image
+    if (realpath(gpFileSpec[1], szSource) != NULL && realpath(gpFileSpec[2], szImage) != NULL && strcmp(szSource, szImage) == 0)
+    {
+        fprintf(ghOut, "Source and target are the same image.\n");
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Create the target image
+    if ((hFile = fopen(gpFileSpec[2], "wb")) == NULL)
+    {
+        fprintf(ghOut, "Can't open: %s\n", gpFileSpec[2]);
+        dwError = ERROR_WRITE_FAULT;
+        goto Exit_0;
+    }
+
+    // Print operation objective
+    fprintf(ghOut, "\r\nConverting %s disk to %s:\r\n\r\n", gpImage->VDIName(), gpTargetVDI);
+
+    // Stream the tracks through the encoder threads
+    dwError = Convert.Run(gpImage->GetVDI(), gpTargetVDI, hFile, gdwThreads);
+
+    fseek(hFile, 0, SEEK_END);
+    nSize = ftell(hFile);
+
+    if (fclose(hFile) != 0 && dwError == 0)
+        dwError = ERROR_WRITE_FAULT;
+
+    if (dwError != 0)
+        goto Remove;
+
+    // Check that the new image loads with the same geometry (e.g. JV1 infers it from the file size)
+    gpImage->GetVDI()->GetDG(DG);
+
+    if ((dwError = Target.Open(gpFileSpec[2], gdwFlags, true)) != 0 || (dwError = Target.ProbeVDI(gpTargetVDI)) != 0)
+        goto Remove;
+
+    Target.GetVDI()->GetDG(TargetDG);
+
+    if (!CVDI::SameTrack(DG.FT, TargetDG.FT) || !CVDI::SameTrack(DG.LT, TargetDG.LT))
+    {
+        dwError = ERROR_NOT_SUPPORTED;
+        goto Remove;
+    }
+
+    // Print operation summary
+    fprintf(ghOut, "%-12s -> %-12s\t%8d sectors\tOK\r\n", gpImage->VDIName(), gpTargetVDI, Convert.Sectors());
+    fprintf(ghOut, "\r\nTotal of %d sectors converted (%d unreadable).\r\n\r\n", Convert.Sectors(), Convert.BadSectors());
+
+    // Report the totals to the batch mode
+    gdwFiles = 1;
+    gdwBytes = nSize;
+
+    goto Exit_0;
+
+    // Do not leave a partial image behind
+    Remove:
+    if (dwError == ERROR_NOT_SUPPORTED)
+        fprintf(ghOut, "The %s format can't hold this disk geometry.\n", gpTargetVDI);
+    Target.Close();
+    remove(gpFileSpec[2]);
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Dump file contents
+//---------------------------------------------------------------------------------
+
+DWORD DumpFile()
+{
+
+    OSI_FILE    File;
+    CDump       Dump;
+    FILE*       hFile = NULL;
+    char        cMask[11];
+    char        szFile[13];
+    void*       pFile = NULL;
+    BYTE*       pBuffer = NULL;
+    DWORD       dwBytes;
+    DWORD       dwLength;
+    DWORD       dwDone;
+    DWORD       dwEnd;
+    DWORD       dwError = 0;
+
+    // Check whether the user informed a filespec
+    if (gpFileSpec[2] == NULL)
+    {
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Initialize the DOS interface
+    if ((dwError = LoadOSI()) != 0)
+        goto Exit_0;
+
+    // Allocate one transfer chunk, reused for every file
+    if ((pBuffer = (BYTE*)calloc(V80_CHUNK,1)) == NULL)
+    {
+        perror("Dump File");
+        dwError = ERROR_OUTOFMEMORY;
+        goto Exit_0;
+    }
+
+    // Render to the target file, if any, otherwise to the command output
+    if ((dwError = DumpBegin(Dump, gpFileSpec[3], hFile)) != 0)
+        goto Done;
+
+    // Convert Windows filespec to TRS standard
+    Win2TRS(gpFileSpec[2], cMask);
+
+    // While OSI::Dir() returns a valid file pointer
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    {
+
+        // Compare file attributes against user options
+        if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
+            continue;
+
+        // Compare the filename against the source filespec
+        if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
+            continue;
+
+        // Format filename
+        FmtName(File.szName, File.szType, gpImage->Divider(), szFile);
+
+        // Print operation objective
+        Dump.Text("\r\nDumping contents of %s:\r\n\r\n", szFile);
+
+        // Dump the file contents one chunk at a time (a multiple of the 16-byte line)
+        for (dwDone = 0; dwDone < File.dwSize; dwDone += dwLength)
+        {
+
+            dwLength = (File.dwSize - dwDone < V80_CHUNK ? File.dwSize - dwDone : V80_CHUNK);
+
+            // Read the next chunk
+            if ((dwError = gpImage->Read(pFile, dwDone, pBuffer, (dwBytes = dwLength))) != 0)
+            {
+
+                if (!(gdwFlags & V80_FLAG_READBAD))
+                    break;
+
+                // Zero-fill the unreadable part
+                memset(&pBuffer[dwBytes], 0, dwLength - dwBytes);
+                dwError = 0;
+
+            }
+
+            Dump.Block(szFile, dwDone, pBuffer, dwLength);
+
+        }
+
+        if (dwError != 0)
+        {
+            Dump.Text("Dump File Read: dwError:%d\n", dwError);
+            continue;
+        }
+
+        // Print operation summary
+        Dump.Text("\r\nTotal of %d bytes dumped.\r\n\r\n", File.dwSize);
+
+    }
+
+    // If exited on "No More Files" then "No Error"
+    if (dwError == ERROR_NO_MORE_FILES)
+        dwError = 0;
+
+    // Write out the rendered output and close the target file
+    Done:
+    if ((dwEnd = DumpEnd(Dump, hFile)) != 0 && dwError == 0)
+        dwError = dwEnd;
+
+    // Release the allocated memory
+    free(pBuffer);
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Dump disk sectors
+//---------------------------------------------------------------------------------
+
+DWORD DumpDisk()
+{
+
+    VDI_GEOMETRY    DG;
+    VDI_TRACK*      pTrack;
+    CDump           Dump;
+    FILE*           hFile = NULL;
+    BYTE*           pTrackBuffer = NULL;
+    bool            bRead[256];
+    int             nSlots;
+    WORD            wSectors = 0;
+    DWORD           dwEnd;
+    DWORD           dwError;
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Get the disk geometry
+    gpImage->GetVDI()->GetDG(DG);
+
+    // Allocate one slot per sector of the longest track
+    nSlots = DG.FT.nLastSector - DG.FT.nFirstSector + 1;
+    if (DG.LT.nLastSector - DG.LT.nFirstSector + 1 > nSlots)
+        nSlots = DG.LT.nLastSector - DG.LT.nFirstSector + 1;
+
+    if ((pTrackBuffer = (BYTE*)malloc(nSlots * DUMP_SECTOR)) == NULL)
+    {
+        dwError = ERROR_OUTOFMEMORY;
+        goto Exit_0;
+    }
+
+    // Render to the target file, if any, otherwise to the command output
+    if ((dwError = DumpBegin(Dump, gpFileSpec[2], hFile)) != 0)
+        goto Done;
+
+    // Print operation objective
+    Dump.Text("\r\nDumping disk contents:\r\n\r\n");
+
+    // For each track in the disk
+    for (int nTrack = DG.FT.nTrack; nTrack <= DG.LT.nTrack; nTrack++)
+    {
+        // Makes pTrack point to FirstTrack or LastTrack accordingly
+        pTrack = (nTrack == DG.FT.nTrack ? &DG.FT : &DG.LT);
+
+        // For each side in the disk
+        for (int nSide = pTrack->nFirstSide; nSide <= pTrack->nLastSide; nSide++)
+        {   // Read the whole track before rendering it
+            for (int nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++)
+                bRead[nSector - pTrack->nFirstSector] = (gpImage->GetVDI()->Read(nTrack, nSide, nSector, &pTrackBuffer[(nSector - pTrack->nFirstSector) * DUMP_SECTOR], DUMP_SECTOR) == 0);
+
+            // Dump the sectors that could be read
+            for (int nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++)
+            {
+                if (bRead[nSector - pTrack->nFirstSector])
+                {
+                    Dump.Sector(nTrack, nSide, nSector, &pTrackBuffer[(nSector - pTrack->nFirstSector) * DUMP_SECTOR], pTrack->wSectorSize);
+                    wSectors++;
+                }
+            }
+        }
+
+    }
+
+    // Print operation summary
+    Dump.Text("\r\nTotal of %d sectors dumped.\r\n\r\n", wSectors);
+
+    // Write out the rendered output and close the target file
+    Done:
+    if ((dwEnd = DumpEnd(Dump, hFile)) != 0 && dwError == 0)
+        dwError = dwEnd;
+
+    free(pTrackBuffer);
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Hash the file contents, for the duplicates report printed after the last image
+//---------------------------------------------------------------------------------
+
+DWORD Dedup()
+{
+
+    WORD        wFiles = 0;
+    DWORD       dwSize = 0;
+    DWORD       dwError = 0;
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Initialize the DOS interface
+    if ((dwError = LoadOSI()) != 0)
+        goto Exit_0;
+
+    // Print operation objective (the hashes only with -x)
+    fprintf(ghOut, "\r\nHashing files:\r\n\r\n");
+
+    // Add this image's files to the report
+    dwError = gDedup.Add(gpImage, gpFileSpec[1], gpFileSpec[2], gdwFlags, DedupHashed, NULL, wFiles, dwSize);
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %d bytes hashed in %d files.\r\n\r\n", dwSize, wFiles);
+
+    // Report the totals to the batch mode
+    gdwFiles = wFiles;
+    gdwBytes = dwSize;
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Print a file hashed (-x) or left out of the report
+//---------------------------------------------------------------------------------
+
+void DedupHashed(void* pParam, const DUP_FILE& File, DWORD dwError)
+{
+
+    if (dwError != 0)
+        fprintf(ghOut, "%-12s\tRead error\r\n", File.szFile);
+    else if (gdwFlags & V80_FLAG_INFO)
+        fprintf(ghOut, "%016llx %8d  %s\r\n", File.qwHash, File.dwSize, File.szFile);
+
+}
+
+//---------------------------------------------------------------------------------
+// Print the duplicate groups, largest savings first
+//---------------------------------------------------------------------------------
+
+void DedupReport()
+{
+
+    DWORD       dwError;
+    size_t      x, y;
+
+    if ((dwError = gDedup.Group()) != 0)
+    {
+        PrintError(dwError);
+        goto Done;
+    }
+
+    fprintf(ghOut, "\r\nDuplicate files (hash, size, copies, bytes saved, first copy):\r\n\r\n");
+
+    for (x = 0; x < gDedup.Groups(); x++)
+    {
+
+        const DUP_GROUP& Group = gDedup.GetGroup(x);
+        const DUP_FILE& File = gDedup.GetFile(Group.nFirst);
+
+        fprintf(ghOut, "%016llx %8d %6zu %10llu  %s:%s\r\n", File.qwHash, File.dwSize, Group.nCount, Group.qwSaved, File.pImage, File.szFile);
+
+        // Every copy with -x
+        for (y = 1; (gdwFlags & V80_FLAG_INFO) && y < Group.nCount; y++)
+            fprintf(ghOut, "%*s%s:%s\r\n", 46, "", gDedup.GetFile(Group.nFirst + y).pImage, gDedup.GetFile(Group.nFirst + y).szFile);
+
+    }
+
+    fprintf(ghOut, "\r\nTotal of %zu files (%llu bytes): %zu unique, %zu duplicate groups, %zu redundant copies, %llu bytes saved.\r\n\r\n",
+        gDedup.Files(), gDedup.Bytes(), gDedup.Unique(), gDedup.Groups(), gDedup.Copies(), gDedup.Saved());
+
+    Done:
+    gDedup.Reset();
+
+}
+
+//---------------------------------------------------------------------------------
+// Sign the disk sectors, for the near-duplicates report printed after the last image
+//---------------------------------------------------------------------------------
+
+DWORD Similar()
+{
+
+    DWORD       dwSectors = 0;
+    DWORD       dwBad = 0;
+    DWORD       dwError = 0;
+
+    // Initialize the disk interface (the sectors are signed whatever the DOS)
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // Add this image to the report
+    dwError = gSimilar.Add(gpImage, gpFileSpec[1], dwSectors, dwBad);
+
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %u sectors signed (%u unreadable).\r\n\r\n", dwSectors, dwBad);
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Print the clusters of near-duplicate images, largest first
+//---------------------------------------------------------------------------------
+
+void SimilarReport()
+{
+
+    size_t      nImages = gSimilar.Images();
+    size_t      x, y, z;
+    DWORD       dwError;
+
+    if ((dwError = gSimilar.Cluster(gdwSimilar)) != 0)
+    {
+        PrintError(dwError);
+        goto Done;
+    }
+
+    fprintf(ghOut, "\r\nNear-duplicate images (similarity to the first one, at least %u%%):\r\n", gdwSimilar);
+
+    for (x = 0; x < nImages; x = y)
+    {
+
+        for (y = x + 1; y < nImages && gSimilar.GetMember(y).nRoot == gSimilar.GetMember(x).nRoot; y++);
+
+        // With -x, the images with no near-duplicate too
+        if (y - x < 2 && !(gdwFlags & V80_FLAG_INFO))
+            continue;
+
+        fprintf(ghOut, "\r\n");
+
+        for (z = x; z < y; z++)
+        {
+            const SIM_IMAGE& Image = gSimilar.GetImage(gSimilar.GetMember(z).nImage);
+            fprintf(ghOut, "%3u%%  %s%s\r\n", gSimilar.Similarity(gSimilar.GetMember(z).nImage, gSimilar.GetMember(x).nImage), Image.pImage, (Image.dwBad > 0 ? " (unreadable sectors)" : ""));
+        }
+
+    }
+
+    fprintf(ghOut, "\r\nTotal of %zu images: %zu clusters of near-duplicates holding %zu images, %zu images with none.\r\n\r\n",
+        nImages, gSimilar.Clusters(), gSimilar.Clustered(), nImages - gSimilar.Clustered());
+
+    Done:
+    gSimilar.Reset();
+
+}
+
+//---------------------------------------------------------------------------------
+// Compare the disk with another image: geometry, sectors, directory and file contents
+//---------------------------------------------------------------------------------
+
+DWORD Diff()
+{
+
+    CImage          Image;
+    CDiff           Changes;
+    char            szOld[32];
+    char            szNew[32];
+    FILE*           hJSON = (gnImages > 0 ? ghOut : stdout);
+    bool            bJSON = (gdwFlags & V80_FLAG_JSONL);
+    bool            bFiles;
+    DWORD           dwError = 0;
+
+    // Check whether the user informed the other image
+    if (gpFileSpec[2] == NULL)
+    {
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Exit_0;
+    }
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    // The other image is only read, with the same interfaces forced (if any)
+    if ((dwError = Image.Open(gpFileSpec[2], gdwFlags, true)) != 0)
+    {
+        fprintf(ghOut, "Can not open: %s\n", gpFileSpec[2]);
+        goto Exit_0;
+    }
+
+    if ((dwError = Image.ProbeVDI(gpVDIName)) != 0)
+    {
+        fprintf(ghOut, "Unknown disk format: %s\n", gpFileSpec[2]);
+        goto Exit_0;
+    }
+
+    // Without a DOS on both sides, only the geometry and the sectors are compared
+    bFiles = (LoadOSI() == 0 && Image.ProbeOSI(gpOSIName) == 0);
+
+    CDiff::Geometry(gpImage, szOld);
+    CDiff::Geometry(&Image, szNew);
+
+    if (bJSON)
+        fprintf(hJSON, "{\"type\":\"geometry\",\"old\":\"%s\",\"new\":\"%s\",\"same\":%s}\n", szOld, szNew, (strcmp(szOld, szNew) == 0 ? "true" : "false"));
+    else if (strcmp(szOld, szNew) == 0)
+        fprintf(ghOut, "\r\nGeometry: %s\r\n", szOld);
+    else
+        fprintf(ghOut, "\r\nGeometry: %s -> %s\r\n", szOld, szNew);
+
+    // The differing sectors are listed with -x
+    if ((dwError = Changes.CompareSectors(gpImage, &Image, ((gdwFlags & V80_FLAG_INFO) ? DiffSector : NULL), hJSON)) == 0)
+    {
+        if (bJSON)
+            fprintf(hJSON, "{\"type\":\"sectors\",\"total\":%u,\"differ\":%u}\n", Changes.Sectors(), Changes.Differ());
+        else
+            fprintf(ghOut, "Sectors: %u of %u differ\r\n", Changes.Differ(), Changes.Sectors());
+    }
+    else if (dwError == ERROR_NOT_SUPPORTED)
+    {
+        if (!bJSON)
+            fprintf(ghOut, "Sectors: not compared (different layout)\r\n");
+        dwError = 0;
+    }
+    else
+        goto Exit_0;
+
+    if (!bFiles)
+    {
+        if (!bJSON)
+            fprintf(ghOut, "Files: not compared (unknown DOS)\r\n\r\n");
+        goto Exit_0;
+    }
+
+    if (!bJSON)
+        fprintf(ghOut, "\r\n");
+
+    if ((dwError = Changes.CompareFiles(gpImage, &Image, gpFileSpec[3], gdwFlags, DiffReport, hJSON)) != 0)
+        goto Exit_0;
+
+    // Print operation summary
+    if (bJSON)
+        fprintf(hJSON, "{\"type\":\"summary\",\"added\":%u,\"removed\":%u,\"renamed\":%u,\"changed\":%u,\"unchanged\":%u,\"in_memory\":%u}\n",
+            Changes.Added(), Changes.Removed(), Changes.Renamed(), Changes.Changed(), Changes.Unchanged(), Changes.InMemory());
+    else
+        fprintf(ghOut, "\r\nTotal of %u files added, %u removed, %u renamed, %u changed, %u unchanged (%u compared in the sectors already read).\r\n\r\n",
+            Changes.Added(), Changes.Removed(), Changes.Renamed(), Changes.Changed(), Changes.Unchanged(), Changes.InMemory());
+
+    // Report the totals to the batch mode
+    gdwFiles = Changes.Added() + Changes.Removed() + Changes.Renamed() + Changes.Changed();
+
+    // Return
+    Exit_0:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Print a sector that differs (pParam: the JSON Lines output)
+//---------------------------------------------------------------------------------
+
+void DiffSector(void* pParam, BYTE nTrack, BYTE nSide, BYTE nSector)
+{
+
+    if (gdwFlags & V80_FLAG_JSONL)
+        fprintf((FILE*)pParam, "{\"type\":\"sector\",\"track\":%d,\"side\":%d,\"sector\":%d}\n", nTrack, nSide, nSector);
+    else
+        fprintf(ghOut, "Sector %02d:%d:%02d differs\r\n", nTrack, nSide, nSector);
+
+}
+
+//---------------------------------------------------------------------------------
+// Print a file that differs (pParam: the JSON Lines output)
+//---------------------------------------------------------------------------------
+
+void DiffReport(void* pParam, const DIFF_ITEM& Item)
+{
+
+    FILE*       hJSON = (FILE*)pParam;
+    bool        bJSON = (gdwFlags & V80_FLAG_JSONL);
+    char        szName1[32];
+    char        szName2[32];
+
+    if (Item.pOld != NULL)
+        DiffQuote(Item.pOld->szFile, szName1);
+
+    if (Item.pNew != NULL)
+        DiffQuote(Item.pNew->szFile, szName2);
+
+    switch (Item.nChange)
+    {
+
+        case DIFF_CHANGED:
+
+            if (Item.dwError != 0)
+                fprintf(ghOut, "%-9s %-12s  Read error\r\n", "Changed", Item.pOld->szFile);
+            else if (bJSON)
+                fprintf(hJSON, "{\"type\":\"changed\",\"file\":\"%s\",\"old_size\":%u,\"new_size\":%u,\"first_diff\":%d,\"bytes_differ\":%u,\"old_attr\":\"%s\",\"new_attr\":\"%s\"}\n",
+                    szName1, Item.pOld->File.dwSize, Item.pNew->File.dwSize, (Item.dwBytes > 0 ? (int)Item.dwFirst : -1), Item.dwBytes, Item.szOld, Item.szNew);
+            else
+            {
+                fprintf(ghOut, "%-9s %-12s ", "Changed", Item.pOld->szFile);
+                if (Item.pOld->File.dwSize != Item.pNew->File.dwSize)
+                    fprintf(ghOut, " size %u -> %u,", Item.pOld->File.dwSize, Item.pNew->File.dwSize);
+                if (Item.dwBytes > 0)
+                    fprintf(ghOut, " %u bytes differ from %u%s", Item.dwBytes, Item.dwFirst, (Item.bAttr ? "," : ""));
+                if (Item.bAttr)
+                    fprintf(ghOut, " attributes %s -> %s", Item.szOld, Item.szNew);
+                fprintf(ghOut, "\r\n");
+            }
+            break;
+
+        case DIFF_RENAMED:
+
+            if (bJSON)
+                fprintf(hJSON, "{\"type\":\"renamed\",\"file\":\"%s\",\"to\":\"%s\",\"size\":%u}\n", szName1, szName2, Item.pOld->File.dwSize);
+            else
+                fprintf(ghOut, "%-9s %-12s  -> %s\r\n", "Renamed", Item.pOld->szFile, Item.pNew->szFile);
+            break;
+
+        case DIFF_REMOVED:
+
+            if (bJSON)
+                fprintf(hJSON, "{\"type\":\"removed\",\"file\":\"%s\",\"size\":%u}\n", szName1, Item.pOld->File.dwSize);
+            else
+                fprintf(ghOut, "%-9s %-12s %8u bytes\r\n", "Removed", Item.pOld->szFile, Item.pOld->File.dwSize);
+            break;
+
+        case DIFF_ADDED:
+
+            if (bJSON)
+                fprintf(hJSON, "{\"type\":\"added\",\"file\":\"%s\",\"size\":%u}\n", szName2, Item.pNew->File.dwSize);
+            else
+                fprintf(ghOut, "%-9s %-12s %8u bytes\r\n", "Added", Item.pNew->szFile, Item.pNew->File.dwSize);
+            break;
+
+    }
+
+}
+
+//---------------------------------------------------------------------------------
+// Escape a TRS-80 filename for a JSON string (quotes and backslashes)
+//---------------------------------------------------------------------------------
+
+void DiffQuote(const char* pName, char szQuoted[32])
+{
+
+    for (; *pName != 0; pName++)
+    {
+        if (*pName == '"' || *pName == '\\')
+            *szQuoted++ = '\\';
+        *szQuoted++ = (*pName < ' ' ? '?' : *pName);
+    }
+
+    *szQuoted = 0;
+
+}
+
+//---------------------------------------------------------------------------------
+// Compile the search patterns ("|" between them, "\xHH", "\|" and "\\" escapes)
+//---------------------------------------------------------------------------------
+
+DWORD SearchBegin()
+{
+
+    const char* pSpec = gpFileSpec[2];
+    const char* pStart;
+    BYTE*       pPattern;
+    char**      pMore;
+    DWORD       dwLength;
+    unsigned    nByte;
+    DWORD       dwError = 0;
+
+    // Check whether the user informed the patterns
+    if (pSpec == NULL || (pPattern = (BYTE*)malloc(strlen(pSpec) + 1)) == NULL)
+        return ERROR_BAD_ARGUMENTS;
+
+    while (dwError == 0)
+    {
+
+        // Decode the escapes of one pattern
+        for (pStart = pSpec, dwLength = 0; *pSpec != 0 && *pSpec != '|'; pSpec++)
+        {
+            if (*pSpec == '\\' && (pSpec[1] == 'x' || pSpec[1] == 'X') && isxdigit(pSpec[2]) && isxdigit(pSpec[3]))
+            {
+                sscanf(&pSpec[2], "%2x", &nByte);
+                pPattern[dwLength++] = nByte;
+                pSpec += 3;
+            }
+            else if (*pSpec == '\\' && (pSpec[1] == '\\' || pSpec[1] == '|'))
+                pPattern[dwLength++] = *++pSpec;
+            else
+                pPattern[dwLength++] = *pSpec;
+        }
+
+        // The pattern is reported as typed
+        if ((pMore = (char**)realloc(gpPatterns, (gSearch.Patterns() + 1) * sizeof(char*))) == NULL)
+        {
+            dwError = ERROR_OUTOFMEMORY;
+            break;
+        }
+
+        gpPatterns = pMore;
+
+        if ((gpPatterns[gSearch.Patterns()] = strndup(pStart, pSpec - pStart)) == NULL)
+            dwError = ERROR_OUTOFMEMORY;
+        else if ((dwError = gSearch.Add(pPattern, dwLength)) != 0)
+            printf("Empty search pattern.\n");
+
+        if (*pSpec++ == 0)
+            break;
+
+    }
+
+    free(pPattern);
+
+    if (dwError == 0)
+        dwError = gSearch.Build();
+
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Search the file contents (or with -raw, the disk sectors) for the patterns
+//---------------------------------------------------------------------------------
+
+DWORD Search()
+{
+
+    OSI_FILE        File;
+    SEARCH_STATE    State;
+    SEARCH_FOUND    Found = {};
+    VDI_GEOMETRY    DG;
+    VDI_TRACK*      pTrack;
+    char            cMask[11];
+    char            szFile[13];
+    void*           pFile = NULL;
+    BYTE*           pBuffer = NULL;
+    DWORD           dwPos;
+    DWORD           dwBytes;
+    DWORD           dwMatches;
+    DWORD           dwSectors = 0;
+    DWORD           dwBad = 0;
+    BYTE            nTrack, nSide, nSector;
+    WORD            wFiles = 0;
+    WORD            wFound = 0;
+    DWORD           dwSize = 0;
+    DWORD           dwError = 0;
+
+    // Initialize the disk interface
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
+
+    Found.pImage = gpFileSpec[1];
+
+    // The sectors are searched as one stream, in track order (deleted files included)
+    if (gdwFlags & V80_FLAG_RAW)
+    {
+
+        gpImage->GetVDI()->GetDG(DG);
+
+        Found.pDG = &DG;
+
+        // One side of a track at a time (the matcher state carries the patterns across)
+        dwBytes = (DG.FT.nLastSector - DG.FT.nFirstSector + 1) * DG.FT.wSectorSize;
+
+        if (dwBytes < (DWORD)(DG.LT.nLastSector - DG.LT.nFirstSector + 1) * DG.LT.wSectorSize)
+            dwBytes = (DG.LT.nLastSector - DG.LT.nFirstSector + 1) * DG.LT.wSectorSize;
+
+        if ((pBuffer = (BYTE*)malloc(dwBytes)) == NULL)
+        {
+            dwError = ERROR_OUTOFMEMORY;
+            goto Exit_0;
+        }
+
+        memset(&State, 0, sizeof(State));
+
+        // In the order of CARC::Index(), which SearchHit() follows back from the offset
+        for (nTrack = DG.FT.nTrack; nTrack <= DG.LT.nTrack; nTrack++)
+        {
+
+            pTrack = (nTrack == DG.FT.nTrack ? &DG.FT : &DG.LT);
+
+            for (nSide = pTrack->nFirstSide; nSide <= pTrack->nLastSide; nSide++)
+            {
+
+                for (nSector = pTrack->nFirstSector, dwPos = 0; nSector <= pTrack->nLastSector; nSector++)
+                {
+
+                    // An unreadable sector is searched as zeros
+                    if (gpImage->GetVDI()->Read(nTrack, nSide, nSector, &pBuffer[dwPos], pTrack->wSectorSize) != NO_ERROR)
+                    {
+                        memset(&pBuffer[dwPos], 0, pTrack->wSectorSize);
+                        dwBad++;
+                    }
+
+                    dwPos += pTrack->wSectorSize;
+                    dwSectors++;
+
+                    if (nSector == 0xFF)
+                        break;
+
+                }
+
+                gSearch.Scan(State, pBuffer, dwPos, SearchHit, &Found);
+                dwSize += dwPos;
 
-	if (dwError)
-		printf("Delete dwError:%d\n", dwError);
+            }
 
-    // Return
-    Exit_0:
-    return dwError;
+            if (nTrack == 0xFF)
+                break;
 
-}
+        }
 
-//---------------------------------------------------------------------------------
-// Dump file contents
-//---------------------------------------------------------------------------------
+        fprintf(ghOut, "\r\nTotal of %u matches in %u sectors (%u bytes searched, %u sectors unreadable).\r\n\r\n", Found.dwMatches, dwSectors, dwSize, dwBad);
 
-DWORD DumpFile()
-{
+        gdwBytes = dwSize;
 
-    OSI_FILE    File;
-    char        cMask[11];
-    char        szFile[13];
-    void*       pFile = NULL;
-    BYTE*       pBuffer = NULL;
-    DWORD       dwBytes;
-    DWORD       dwError = 0;
+        goto Exit_1;
 
-    // Check whether the user informed a filespec
-    if (gpFileSpec[2] == NULL)
-    {
-        dwError = ERROR_BAD_ARGUMENTS;
-        goto Exit_0;
     }
 
-    // Initialize the disk interface
-    if ((dwError = LoadVDI()) != 0)
-        goto Exit_0;
-
     // Initialize the DOS interface
     if ((dwError = LoadOSI()) != 0)
-        goto Exit_1;
-
-    // 360KB should be more than enough for any TRS-80 file
-    dwBytes = (MAX_FILE_SIZE) + (V80_MEM - (MAX_FILE_SIZE) % V80_MEM);
+        goto Exit_0;
 
-    // Allocate memory
-    if ((pBuffer = (BYTE*)calloc(dwBytes,1)) == NULL)
+    if ((pBuffer = (BYTE*)malloc(V80_CHUNK)) == NULL)
     {
-        perror("Dump File");
         dwError = ERROR_OUTOFMEMORY;
-        goto Exit_2;
+        goto Exit_0;
     }
 
     // Convert Windows filespec to TRS standard
-    Win2TRS(gpFileSpec[2], cMask);
+    Win2TRS((gpFileSpec[3] != NULL ? gpFileSpec[3] : "*.*"), cMask);
 
     // While OSI::Dir() returns a valid file pointer
-    while ((dwError = gpOSI->Dir(&pFile, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
+    while ((dwError = gpImage->List(&pFile, File, (pFile == NULL ? OSI_DIR_FIND_FIRST : OSI_DIR_FIND_NEXT))) == 0)
     {
 
-        // Get file properties
-        gpOSI->GetFile(pFile, File);
-
         // Compare file attributes against user options
         if ((File.bSystem && !(gdwFlags & V80_FLAG_SYSTEM)) || (File.bInvisible && !(gdwFlags & V80_FLAG_INVISIBLE)))
             continue;
 
-        // Compare the filename against the source filespec
+        // Compare the filename against the filespec
         if (!WildComp(File.szName, cMask, 8) || !WildComp(File.szType, &cMask[8], 3))
             continue;
 
-        // Format filename
-        FmtName(File.szName, File.szType, (strcmp(typeid(*gpOSI).name()+2, "CPM") ? "/" : "."), szFile);
+        FmtName(File.szName, File.szType, gpImage->Divider(), szFile);
 
-        // Print operation objective
-        printf("\r\nDumping contents of %s:\r\n\r\n", szFile);
+        Found.pFile = szFile;
+        dwMatches = Found.dwMatches;
 
-        // Set the file pointer
-        if ((dwError = gpOSI->Seek(pFile, 0)) != 0)
+        // Stream the file through the matcher, straight from the image
+        for (memset(&State, 0, sizeof(State)), dwPos = 0; dwPos < File.dwSize; dwPos += dwBytes)
         {
-            printf("Dump File Seek: dwError:%d\n", dwError);
-            continue;
+            dwBytes = (File.dwSize - dwPos < V80_CHUNK ? File.dwSize - dwPos : V80_CHUNK);
+            if ((dwError = gpImage->Read(pFile, dwPos, pBuffer, dwBytes)) != 0 || dwBytes == 0)
+                break;
+            gSearch.Scan(State, pBuffer, dwBytes, SearchHit, &Found);
         }
 
-        // Read the file contents
-        if ((dwError = gpOSI->Read(pFile, pBuffer, File.dwSize)) != 0 && !(gdwFlags & V80_FLAG_READBAD))
+        // What could be read has been searched
+        if (dwPos < File.dwSize)
         {
-            printf("Dump File Read: dwError:%d\n", dwError);
-            continue;
+            fprintf(ghOut, "%s:%s: Read error at %u\r\n", gpFileSpec[1], szFile, dwPos);
+            dwError = 0;
         }
 
-        // Dump the file contents
-        Dump(pBuffer, File.dwSize);
-
-        // Print operation summary
-        printf("\r\nTotal of %d bytes dumped.\r\n\r\n", File.dwSize);
+        // Update operation status variables
+        wFiles++;
+        wFound += (Found.dwMatches > dwMatches);
+        dwSize += dwPos;
 
     }
 
@@ -973,19 +3580,15 @@ DWORD DumpFile()
     if (dwError == ERROR_NO_MORE_FILES)
         dwError = 0;
 
-    // Release the allocated memory
-    if (pBuffer != NULL)
-        free(pBuffer);
+    // Print operation summary
+    fprintf(ghOut, "\r\nTotal of %u matches in %d of %d files (%u bytes searched).\r\n\r\n", Found.dwMatches, wFound, wFiles, dwSize);
 
-    // Release the OSI object
-    Exit_2:
-    if (gpOSI != NULL)
-        delete gpOSI;
+    // Report the totals to the batch mode
+    gdwFiles = wFound;
+    gdwBytes = dwSize;
 
-    // Release the VDI object
     Exit_1:
-    if (gpVDI != NULL)
-        delete gpVDI;
+    free(pBuffer);
 
     // Return
     Exit_0:
@@ -994,227 +3597,230 @@ DWORD DumpFile()
 }
 
 //---------------------------------------------------------------------------------
-// Dump disk sectors
+// Print a match: image, file and offset (or track, side, sector and offset)
 //---------------------------------------------------------------------------------
 
-DWORD DumpDisk()
+void SearchHit(void* pParam, DWORD dwPattern, unsigned long long qwOffset)
 {
 
+    SEARCH_FOUND*   pFound = (SEARCH_FOUND*)pParam;
     VDI_GEOMETRY    DG;
-    VDI_TRACK*      pTrack;
-    BYTE            Buffer[1024];
-    WORD            wSectors = 0;
-    DWORD           dwError;
-
-    // Initialize the disk interface
-    if ((dwError = LoadVDI()) != 0)
-        goto Done;
-
-    // Print operation objective
-    printf("\r\nDumping disk contents:\r\n\r\n");
+    DWORD           dwFirst;
+    DWORD           dwSides;
+    DWORD           dwSectors;
+    DWORD           dwIndex;
 
-    // Get the disk geometry
-    gpVDI->GetDG(DG);
+    pFound->dwMatches++;
 
-    // For each track in the disk
-    for (int nTrack = DG.FT.nTrack; nTrack <= DG.LT.nTrack; nTrack++)
+    if (pFound->pDG == NULL)
     {
-        // Makes pTrack point to FirstTrack or LastTrack accordingly
-        pTrack = (nTrack == 0 ? &DG.FT : &DG.LT);
+        fprintf(ghOut, "%s:%s:%llu: %s\r\n", pFound->pImage, pFound->pFile, qwOffset, gpPatterns[dwPattern]);
+        return;
+    }
 
-        // For each side in the disk
-        for (int nSide = pTrack->nFirstSide; nSide <= pTrack->nLastSide; nSide++)
-        {   // For each sector in the track
-            for (int nSector = pTrack->nFirstSector; nSector <= pTrack->nLastSector; nSector++)
-            {   // Read sector
-                if (gpVDI->Read(nTrack, nSide, nSector, Buffer, sizeof(Buffer)) == 0)
-                {   // Dump sector data
-                    printf("\r\n[%02d:%d:%02d]\r\n", nTrack, nSide, nSector);
-                    Dump(Buffer, pTrack->wSectorSize);
-                    wSectors++;
-                }
-            }
-        }
+    DG = *pFound->pDG;
+
+    // The first track comes first, then the rest, side by side (as in CARC::Index)
+    dwSides = DG.FT.nLastSide - DG.FT.nFirstSide + 1;
+    dwSectors = DG.FT.nLastSector - DG.FT.nFirstSector + 1;
+    dwFirst = dwSides * dwSectors * DG.FT.wSectorSize;
 
+    if (qwOffset < dwFirst)
+    {
+        dwIndex = qwOffset / DG.FT.wSectorSize;
+        fprintf(ghOut, "%s:%02d:%d:%02d+%llu: %s\r\n", pFound->pImage, DG.FT.nTrack, DG.FT.nFirstSide + dwIndex / dwSectors, DG.FT.nFirstSector + dwIndex % dwSectors,
+            qwOffset % DG.FT.wSectorSize, gpPatterns[dwPattern]);
+        return;
     }
 
-    // Print operation summary
-    printf("\r\nTotal of %d sectors dumped.\r\n\r\n", wSectors);
+    qwOffset -= dwFirst;
 
-    // Release the VDI object
-    delete gpVDI;
+    dwSides = DG.LT.nLastSide - DG.LT.nFirstSide + 1;
+    dwSectors = DG.LT.nLastSector - DG.LT.nFirstSector + 1;
+    dwIndex = qwOffset / DG.LT.wSectorSize;
 
-    // Return
-    Done:
-    return dwError;
+    fprintf(ghOut, "%s:%02d:%d:%02d+%llu: %s\r\n", pFound->pImage, DG.FT.nTrack + 1 + dwIndex / (dwSides * dwSectors), DG.LT.nFirstSide + dwIndex / dwSectors % dwSides,
+        DG.LT.nFirstSector + dwIndex % dwSectors, qwOffset % DG.LT.wSectorSize, gpPatterns[dwPattern]);
 
 }
 
 //---------------------------------------------------------------------------------
-// Initialize the Virtual Disk Interface
+// Pack the disk sectors into a deduplicated archive (target), or list an archive
 //---------------------------------------------------------------------------------
 
-DWORD LoadVDI()
+DWORD Pack()
 {
 
-	int dwError = 0;
-    // Check whether the user indicated a disk interface
-    if (gpVDI != NULL)
-    {
-        dwError = gpVDI->Load(ghFile, gdwFlags);
-        if (!dwError)
-            goto Done;
-        else
-            goto Error;
-    }
-
-    // Try the DMK format
-    gpVDI = new CDMK;
+    ARC_DISK    Disk;
+    const char* pBase;
+    DWORD       dwNew;
+    DWORD       dwError = 0;
 
-    dwError = gpVDI->Load(ghFile, gdwFlags);
-    if (!dwError)
-        goto Done;
+    // Without a target, the image is an archive to list
+    if (gpFileSpec[2] == NULL)
+        return PackList();
 
-    delete gpVDI;
+    // Initialize the disk interface (the sectors are packed whatever the DOS)
+    if ((dwError = LoadVDI()) != 0)
+        goto Exit_0;
 
-    // Try the JV3 format
+    // The first image creates the archive, which every image of a batch shares
+    pthread_mutex_lock(&gPackMutex);
 
-    gpVDI = new CJV3;
+    if (gpArchive == NULL)
+    {
+        gpArchive = new CArchive;
+        if ((dwError = gpArchive->Create(gpFileSpec[2])) != 0)
+            fprintf(ghOut, "Can't create the archive: %s\n", gpFileSpec[2]);
+    }
 
-    dwError = gpVDI->Load(ghFile, gdwFlags);
-    if (!dwError)
-        goto Done;
+    pthread_mutex_unlock(&gPackMutex);
 
-    delete gpVDI;
+    if (dwError != 0)
+        goto Exit_0;
 
-    // Try the JV1 format
+    // Read the sectors outside the archive lock
+    if ((dwError = CArchive::Snap(gpImage->GetVDI(), Disk)) != 0)
+        goto Exit_0;
 
-    gpVDI = new CJV1;
+    pBase = strrchr(gpFileSpec[1], '/');
 
-    dwError = gpVDI->Load(ghFile, gdwFlags);
-    if (!dwError)
-        goto Done;
+    if ((dwError = gpArchive->Add((pBase ? pBase + 1 : gpFileSpec[1]), gpImage->VDIName(), Disk, dwNew)) != 0)
+    {
+        fprintf(ghOut, (dwError == ERROR_FILE_EXISTS ? "Already in the archive: %s\n" : "Can't add to the archive: %s\n"), (pBase ? pBase + 1 : gpFileSpec[1]));
+        goto Exit_1;
+    }
 
-    delete gpVDI;
+    // Print how much of the image was new to the archive
+    fprintf(ghOut, "\r\nPacked %u sectors (%u unreadable), %u new to the archive.\r\n\r\n", Disk.dwSectors, Disk.dwBad, dwNew);
 
-    Error:
-    gpVDI = NULL;
+    // Report the totals to the batch mode
+    gdwBytes = Disk.dwSectors * Disk.DG.LT.wSectorSize;
 
-    Done:
-    // If requested by the user, print disk data
-    if ((gdwFlags & V80_FLAG_INFO) && gpVDI != NULL)
-    {
-        VDI_GEOMETRY DG;
-        gpVDI->GetDG(DG);
-        printf("\r\nVDI: %-3s (%02d:%d:%02d,%s)\r\n", typeid(*gpVDI).name()+2, (DG.LT.nTrack-DG.FT.nTrack+1), (DG.LT.nLastSide-DG.LT.nFirstSide+1), (DG.LT.nLastSector-DG.LT.nFirstSector+1), (DG.FT.nDensity!=DG.LT.nDensity?"MD":(DG.LT.nDensity==VDI_DENSITY_SINGLE?"SD":"DD")));
-    }
+    Exit_1:
+    CArchive::Release(Disk);
 
+    Exit_0:
     return dwError;
 
 }
 
 //---------------------------------------------------------------------------------
-// Initialize the Operating System Interface
+// List the images of an archive
 //---------------------------------------------------------------------------------
 
-DWORD LoadOSI()
+DWORD PackList()
 {
 
-    int dwError = 0;
+    ARC_HEADER  Header;
+    ARC_IMAGE*  pImages = NULL;
+    FILE*       hFile;
+    DWORD       dwError;
 
-    // Check whether the user indicated a DOS interface
-    if (gpOSI != NULL)
+    if ((hFile = fopen(gpFileSpec[1], "r")) == NULL)
     {
-        if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
-            goto Done;
-        else
-            goto Error;
+        fprintf(ghOut, "Can not open: %s\n", gpFileSpec[1]);
+        return ERROR_FILE_NOT_FOUND;
     }
 
-    // Try TRSDOS Model 4
-
-    gpOSI = new CTD4;
-
-    if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
+    if ((dwError = CARC::Directory(hFile, Header, pImages)) != 0)
+    {
+        fprintf(ghOut, "Not an archive: %s\n", gpFileSpec[1]);
         goto Done;
+    }
 
-    delete gpOSI;
-
-    // Try TRSDOS Model III
-
-    gpOSI = new CTD3;
-
-    if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
-        goto Done;
+    fprintf(ghOut, "\r\nImage                    VDI  Geometry     Sectors Unreadable\r\n\r\n");
 
-    delete gpOSI;
+    for (DWORD x = 0; x < Header.dwImages; x++)
+    {
+        VDI_GEOMETRY DG = pImages[x].DG;
+        fprintf(ghOut, "%-24.24s %-4.4s %02d:%d:%02d,%s %7u %10u\r\n", pImages[x].szName, pImages[x].cVDI,
+            (DG.LT.nTrack-DG.FT.nTrack+1), (DG.LT.nLastSide-DG.LT.nFirstSide+1), (DG.LT.nLastSector-DG.LT.nFirstSector+1),
+            (DG.FT.nDensity!=DG.LT.nDensity?"MD":(DG.LT.nDensity==VDI_DENSITY_SINGLE?"SD":"DD")), pImages[x].dwSectors, pImages[x].dwBad);
+    }
 
-    // Try TRSDOS Model I
+    fprintf(ghOut, "\r\nTotal of %u images, %llu sectors in %u unique blocks (%llu of %llu bytes).\r\n\r\n",
+        Header.dwImages, Header.qwSectors, Header.dwBlocks, Header.qwPool, Header.qwRaw);
 
-    gpOSI = new CTD1;
+    Done:
+    free(pImages);
+    fclose(hFile);
+    return dwError;
 
-    if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
-        goto Done;
+}
 
-    delete gpOSI;
+//---------------------------------------------------------------------------------
+// Finish the archive once every image has been packed
+//---------------------------------------------------------------------------------
 
-    // Try RapiDOS
+DWORD PackEnd()
+{
 
-    gpOSI = new CRD;
+    ARC_HEADER  Header;
+    DWORD       dwError;
 
-    if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
+    if ((dwError = gpArchive->End()) != 0)
+    {
+        fprintf(ghOut, "Can't write the archive: %s\n", gpFileSpec[2]);
         goto Done;
+    }
 
-    delete gpOSI;
-
-    // Try MicroDOS/OS-80 III
-
-    gpOSI = new CMD;
-
-    if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
-        goto Done;
+    gpArchive->GetHeader(Header);
 
-    delete gpOSI;
+    fprintf(ghOut, "\r\nArchive: %u images, %llu sectors in %u unique blocks, %llu of %llu bytes stored (%llu%%).\r\n\r\n",
+        Header.dwImages, Header.qwSectors, Header.dwBlocks, Header.qwPool, Header.qwRaw, (Header.qwRaw != 0 ? Header.qwPool * 100 / Header.qwRaw : 0));
 
-    // Try NewDOS/80
+    Done:
+    delete gpArchive;
+    gpArchive = NULL;
+    return dwError;
 
-    gpOSI = new CND;
+}
 
-    if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
-        goto Done;
+//---------------------------------------------------------------------------------
+// Initialize the Virtual Disk Interface
+//---------------------------------------------------------------------------------
 
-    delete gpOSI;
+DWORD LoadVDI()
+{
 
-    // Try DoubleDOS
+	int dwError;
 
-    gpOSI = new CDD;
+    // Detect the disk format (only the one indicated by the user, if any)
+    dwError = gpImage->ProbeVDI(gpVDIName);
 
-    if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
-        goto Done;
+    // If requested by the user, print disk data
+    if ((gdwFlags & V80_FLAG_INFO) && dwError == 0)
+    {
+        VDI_GEOMETRY DG;
+        gpImage->GetVDI()->GetDG(DG);
+        fprintf(ghOut, "\r\nVDI: %-3s (%02d:%d:%02d,%s)\r\n", gpImage->VDIName(), (DG.LT.nTrack-DG.FT.nTrack+1), (DG.LT.nLastSide-DG.LT.nFirstSide+1), (DG.LT.nLastSector-DG.LT.nFirstSector+1), (DG.FT.nDensity!=DG.LT.nDensity?"MD":(DG.LT.nDensity==VDI_DENSITY_SINGLE?"SD":"DD")));
+    }
 
-    delete gpOSI;
+    return dwError;
 
-    // Try CP/M
+}
 
-    gpOSI = new CCPM;
+//---------------------------------------------------------------------------------
+// Initialize the Operating System Interface
+//---------------------------------------------------------------------------------
 
-    if ((dwError = gpOSI->Load(gpVDI, gdwFlags)) == 0)
-        goto Done;
+DWORD LoadOSI()
+{
 
-    delete gpOSI;
+    int dwError;
 
-    Error:
-    gpOSI = NULL;
+    // Detect the DOS (only the one indicated by the user, if any)
+    dwError = gpImage->ProbeOSI(gpOSIName);
 
-    Done:
     // If requested by the user, print DOS data
-    if ((gdwFlags & V80_FLAG_INFO) && gpOSI != NULL)
+    if ((gdwFlags & V80_FLAG_INFO) && dwError == 0)
     {
         OSI_DOS DOS;
-        gpOSI->GetDOS(DOS);
+        gpImage->GetOSI()->GetDOS(DOS);
         Trim(DOS.szName);
         Trim(DOS.szDate);
-        printf("OSI: %-3s (%s,%s,%02X)\r\n", typeid(*gpOSI).name()+2, DOS.szName, DOS.szDate, DOS.nVersion);
+        fprintf(ghOut, "OSI: %-3s (%s,%s,%02X)\r\n", gpImage->OSIName(), DOS.szName, DOS.szDate, DOS.nVersion);
     }
 
     return dwError;
@@ -1222,166 +3828,138 @@ DWORD LoadOSI()
 }
 
 //---------------------------------------------------------------------------------
-// Print data in hex and ASCII
+// Load the boot sector fingerprint table ($V80_FPRINT or ~/.v80fp)
 //---------------------------------------------------------------------------------
 
-void Dump(unsigned char* pBuffer, int nSize)
+DWORD LoadFPrint()
 {
 
-    char szLine[48+16+1];
-    char szTemp[4];
-    int  x;
-
-    // Clear variables szLine and szTemp
-    memset(szLine, 0, sizeof(szLine));
-    memset(szTemp, 0, sizeof(szTemp));
-
-    // For each byte in the buffer
-    for (x = 0; x < nSize; x++)
-    {
-        // Convert byte to HEX in szTemp
-        sprintf(szTemp, "%02X ", pBuffer[x]);
-
-        // Append szTemp to szLine
-        memcpy(&szLine[(x % 16) *3], szTemp, 3);
-
-        // Set the corresponding ASCII value in szLine
-        szLine[(16 * 3) + (x % 16)] = (pBuffer[x] < ' ' ? '.' : pBuffer[x]);
+    char    szPath[MAX_PATH];
+    DWORD   dwError;
 
-        // When a 16-byte line has been filled, print a CR/LF
-        if ((x % 16) == 15)
-        {
-            printf("%s\r\n", szLine);
-            memset(szLine, ' ', sizeof(szLine)-1);
-        }
+    if (getenv("V80_FPRINT") != NULL)
+        snprintf(szPath, sizeof(szPath), "%s", getenv("V80_FPRINT"));
+    else
+        snprintf(szPath, sizeof(szPath), "%s/%s", (getenv("HOME") != NULL ? getenv("HOME") : "."), FPRINT_FILE);
 
-    }
+    if ((dwError = gFPrint.Load(szPath)) != 0)
+        fprintf(ghOut, "Can not load the fingerprints: %s\n", szPath);
 
-    // If exited in the middle of a 16-byte line, print a CR/LF
-    if (x % 16 != 0)
-        printf("%s\r\n", szLine);
+    return dwError;
 
 }
 
 //---------------------------------------------------------------------------------
-// Compare a string against a wildcard-based mask (case insensitive)
+// Print the outcome of a completed extraction job and release it
 //---------------------------------------------------------------------------------
 
-bool WildComp(const char* pSource, const char* pMask, BYTE nLength)
+void GetReport(POOL_JOB* pJob, WORD& wFiles, DWORD& dwSize)
 {
 
-    for (int x = 0; x < nLength; x++)
+    // Print filenames
+    fprintf(ghOut, "%-12s -> %-12s\t", pJob->szTRSFile, pJob->szFile);
+
+    // Print the result
+    switch (pJob->dwError)
     {
-        if (pMask[x] == '?')
-            continue;
-        if (pMask[x] == '*')
+        case NO_ERROR:
+            fprintf(ghOut, "%8d bytes\tOK\r\n", pJob->dwSize);
+            wFiles++;
+            dwSize += pJob->dwSize;
+            break;
+        case ERROR_EMPTY:
+            fprintf(ghOut, "%8d bytes\tSkipped\r\n", pJob->dwSize);
             break;
-        if ((pMask[x] | ('a'-'A')) != (pSource[x] | ('a'-'A')))
-            return false;
+        case ERROR_SEEK:
+            fprintf(ghOut, "Get seek error\n");
+            break;
+        case ERROR_FILE_NOT_FOUND:
+            fprintf(ghOut, "Can't open: %s\n", pJob->szFile);
+            break;
+        case ERROR_WRITE_FAULT:
+            fprintf(ghOut, "Write error: %s\n", pJob->szFile);
+            break;
+        default:
+            fprintf(ghOut, "Get read error\n");
     }
 
-    return true;
+    // Release the job
+    free(pJob->pBuffer);
+    free(pJob->pRuns);
+    free(pJob);
 
 }
 
 //---------------------------------------------------------------------------------
-// Compare a string against a wildcard-based mask (case insensitive)
+// Start a dump in the format selected by the user, to a target file if one is given
 //---------------------------------------------------------------------------------
 
-void WildCopy(const char* pSource, char* pTarget, const char* pMask, BYTE nLength)
+DWORD DumpBegin(CDump& Dump, const char* pTarget, FILE*& hFile)
 {
-    for (int x = 0; x < nLength; x++)
-    {
-        if (pMask[x] == '?')
-        {
-            pTarget[x] = pSource[x];
-            continue;
-        }
-        if (pMask[x] == '*')
-        {
-            memcpy(&pTarget[x], &pSource[x], nLength - x);
-            break;
-        }
-        pTarget[x] = toupper(pMask[x]);
-    }
-}
 
-//---------------------------------------------------------------------------------
-// Format a new filename from separated parts
-//---------------------------------------------------------------------------------
-
-void FmtName(const char szName[9], const char szType[4], const char* szDivider, char szNewName[13])
-{
+    DUMP_FORMAT nFormat = DUMP_HEX;
+    DWORD       dwError;
 
-    char szTmpName[9];
-    char szTmpType[4];
+    if (gdwFlags & V80_FLAG_XXD)
+        nFormat = DUMP_XXD;
+    else if (gdwFlags & V80_FLAG_RAW)
+        nFormat = DUMP_RAW;
+    else if (gdwFlags & V80_FLAG_JSONL)
+        nFormat = DUMP_JSON;
 
-    // Copy szName and szType to temporary variables
-    memcpy(szTmpName, szName, sizeof(szTmpName));
-    memcpy(szTmpType, szType, sizeof(szTmpType));
+    hFile = NULL;
 
-    // Remove trailing spaces from name
-    for (int x = 8; x > 0 && szTmpName[x - 1] == ' '; x--)
-        szTmpName[x - 1] = 0;
+    if (pTarget != NULL && (hFile = fopen(pTarget, "wb")) == NULL)
+    {
+        perror(pTarget);
+        dwError = ERROR_WRITE_FAULT;
+        goto Done;
+    }
 
-    // Remove trailing spaces from extension
-    for (int x = 3; x > 0 && szTmpType[x - 1] == ' '; x--)
-        szTmpType[x - 1] = 0;
+    dwError = Dump.Begin(hFile != NULL ? hFile : ghOut, nFormat);
 
-    // Assemble the new name from the two temporary variables
-    sprintf(szNewName, "%s%s%s", szTmpName, (szTmpType[0] ? szDivider : ""), szTmpType);
+    Done:
+    return dwError;
 
 }
 
 //---------------------------------------------------------------------------------
-// Convert Windows-based filename to TRS standard
+// Write out the rest of a dump and close its target file
 //---------------------------------------------------------------------------------
 
-void Win2TRS(const char* pWinName, char cTRSName[11])
+DWORD DumpEnd(CDump& Dump, FILE* hFile)
 {
 
-    int x, y, z, k = strlen(pWinName);
-
-    for (x = k; x > 0 && pWinName[x - 1] != '/'; x--)
-		;
-
-    if (pWinName[x] == '/')
-        x++;
-
-    for (y = 0; y < 8 && pWinName[x] != '.' && pWinName[x] != '/' && pWinName[x] != 0; x++, y++)
-        cTRSName[y] = toupper(pWinName[x]);
-
-    for ( ; y < 8; y++)
-        cTRSName[y] = ' ';
+    DWORD   dwError;
 
-    for (z = 0; z < (k - x); z++)
-    {
-        if (pWinName[x+z] == '.' || pWinName[x+z] == '/')
-        {
-            x += z + 1;
-            break;
-        }
-    }
+    dwError = Dump.End();
 
-    for (; y < 11 && pWinName[x] != 0; x++, y++)
-        cTRSName[y] = toupper(pWinName[x]);
+    if (hFile != NULL && fclose(hFile) != 0 && dwError == 0)
+        dwError = ERROR_WRITE_FAULT;
 
-    for ( ; y < 11; y++)
-        cTRSName[y] = ' ';
+    return dwError;
 
 }
 
 //---------------------------------------------------------------------------------
-// Remove spaces from disk name/date
+// Compare a string against a wildcard-based mask (case insensitive)
 //---------------------------------------------------------------------------------
 
-void Trim(char cField[8])
+void WildCopy(const char* pSource, char* pTarget, const char* pMask, BYTE nLength)
 {
-    for (int x = 8; x > 0; x--)
+    for (int x = 0; x < nLength; x++)
     {
-        if (cField[x-1] != ' ')
+        if (pMask[x] == '?')
+        {
+            pTarget[x] = pSource[x];
+            continue;
+        }
+        if (pMask[x] == '*')
+        {
+            memcpy(&pTarget[x], &pSource[x], nLength - x);
             break;
-        cField[x-1] = 0;
+        }
+        pTarget[x] = toupper(pMask[x]);
     }
 }
 
@@ -1398,11 +3976,19 @@ DWORD ParseCmdLine(int argc, char* argv[])
     for (x = 0, z = 0; x < argc; x++)
     {
 
-        if (argv[x][0] == '-')
+        // A lone '-' is a filespec (stdin or stdout for the tar commands), not a switch
+        if (argv[x][0] == '-' && argv[x][1] != 0)
         {
 
             for (y = 0; y < (sizeof(gSwitches) / sizeof(SWITCH)); y++)
             {
+                // Numeric switches carry their value right after the name (e.g. -j8)
+                if (gSwitches[y].pCall == SetNum && strncasecmp(argv[x], gSwitches[y].cName, strlen(gSwitches[y].cName)) == 0 && isdigit(argv[x][strlen(gSwitches[y].cName)]))
+                {
+                    *(DWORD*)gSwitches[y].pParam = atoi(&argv[x][strlen(gSwitches[y].cName)]);
+                    goto Next;
+                }
+
                 if (strcasecmp(argv[x], gSwitches[y].cName) == 0)
                 {
                     if ((dwError = (*gSwitches[y].pCall)(gSwitches[y].pParam)) != 0)
@@ -1497,14 +4083,14 @@ DWORD SetVDI(void* pParam)
 
     DWORD dwError = 0;
 
-    if (gpVDI != NULL)
+    if (gpVDIName != NULL)
     {
         puts("Attempt to set multiple file formats.");
         dwError = ERROR_BAD_ARGUMENTS;
         goto Done;
     }
 
-    gpVDI = (CVDI*)pParam;
+    gpVDIName = (const char*)pParam;
 
     Done:
     return dwError;
@@ -1520,20 +4106,56 @@ DWORD SetOSI(void* pParam)
 
     DWORD dwError = 0;
 
-    if (gpOSI != NULL)
+    if (gpOSIName != NULL)
     {
         puts("Attempt to set multiple operating systems.");
         dwError = ERROR_BAD_ARGUMENTS;
         goto Done;
     }
 
-    gpOSI = (COSI*)pParam;
+    gpOSIName = (const char*)pParam;
+
+    Done:
+    return dwError;
+
+}
+
+//---------------------------------------------------------------------------------
+// Set the disk format of the conversion target
+//---------------------------------------------------------------------------------
+
+DWORD SetTo(void* pParam)
+{
+
+    DWORD dwError = 0;
+
+    if (gpTargetVDI != NULL)
+    {
+        puts("Attempt to set multiple target formats.");
+        dwError = ERROR_BAD_ARGUMENTS;
+        goto Done;
+    }
+
+    gpTargetVDI = (const char*)pParam;
 
     Done:
     return dwError;
 
 }
 
+//---------------------------------------------------------------------------------
+// Reject numeric switches given without a value (values are parsed by ParseCmdLine)
+//---------------------------------------------------------------------------------
+
+DWORD SetNum(void* pParam)
+{
+
+    puts("Missing the switch value.");
+
+    return ERROR_BAD_ARGUMENTS;
+
+}
+
 //---------------------------------------------------------------------------------
 // Print usage instructions
 //---------------------------------------------------------------------------------
@@ -1570,8 +4192,8 @@ void PrintError(DWORD dwError)
     char szMessage[128];
 
 	if(dwError >= 0 && dwError < ERROR_LAST)
-		printf("dwError: %s\n", errors_msg[dwError]);
+		fprintf(ghOut, "dwError: %s\n", errors_msg[dwError]);
 	else
-		printf("dwError: unknown (%d)\n", dwError);
+		fprintf(ghOut, "dwError: unknown (%d)\n", dwError);
 
 }
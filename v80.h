@@ -32,6 +32,9 @@
 //---------------------------------------------------------------------------------
 
 #define V80_MEM             4096                                                    // Heap memory page
+#define V80_CHUNK           (4*V80_MEM)                                             // Streaming transfer chunk
+#define V80_POOL_MEM        (64*V80_CHUNK)                                          // Memory held by files waiting for the writer threads
+#define V80_SYNC_QUIET      500                                                     // Quiet time (ms) before the watch mode applies the host changes
 
 #define V80_FLAG_SYSTEM     0b00000000000000000000000000000001                      // 1: Include System files
 #define V80_FLAG_INVISIBLE  0b00000000000000000000000000000010                      // 1: Include Invisible files
@@ -42,3 +45,13 @@
 #define V80_FLAG_GATFIX     0b00000000000000000000000001000000                      // 1: Skip GAT auto-fix in TRSDOS Model III system disks
 #define V80_FLAG_SS         0b00000000000000000000000010000000                      // 1: Force disk geometry to single-sided
 #define V80_FLAG_DS         0b00000000000000000000000100000000                      // 1: Force disk geometry to double-sided
+#define V80_FLAG_STATS      0b00000000000000000000001000000000                      // 1: Print I/O statistics (V80_STATS builds)
+#define V80_FLAG_JSON       0b00000000000000000000010000000000                      // 1: Print I/O statistics as JSON (V80_STATS builds)
+#define V80_FLAG_TRACE      0b00000000000000000000100000000000                      // 1: Record the sector accesses to <image>.v80t
+#define V80_FLAG_XXD        0b00000000000000000001000000000000                      // 1: Dump in xxd format
+#define V80_FLAG_RAW        0b00000000000000000010000000000000                      // 1: Dump the raw sector or file bytes
+#define V80_FLAG_JSONL      0b00000000000000000100000000000000                      // 1: Dump as JSON lines
+#define V80_FLAG_RECORDS    0b00000000000000001000000000000000                      // 1: Count the extract range in logical records
+#define V80_FLAG_CACHE      0b00000000000000010000000000000000                      // 1: Cache the probe results (<image>.v80c or $V80_CACHE)
+#define V80_FLAG_FPRINT     0b00000000000000100000000000000000                      // 1: Pick the DOS by boot sector fingerprint (~/.v80fp or $V80_FPRINT)
+#define V80_FLAG_WATCH      0b00000000000001000000000000000000                      // 1: Keep syncing the host directory as it changes
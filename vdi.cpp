@@ -33,10 +33,11 @@
 
 #include "windows.h"
 #include "v80.h"
+#include "stats.h"
 #include "vdi.h"
 
 CVDI::CVDI()
-: m_hFile(NULL), m_dwFlags(0), m_DG()
+: m_hFile(NULL), m_dwFlags(0), m_DG(), m_bKnownDG(false), m_pMember(NULL)
 {
 }
 
@@ -48,3 +49,32 @@ void CVDI::GetDG(VDI_GEOMETRY& DG)
 {
     DG = m_DG;
 }
+
+void CVDI::SetDG(const VDI_GEOMETRY& DG)
+{
+    m_DG = DG;
+    m_bKnownDG = true;
+}
+
+void CVDI::SetMember(const char* pMember)
+{
+    m_pMember = pMember;
+}
+
+DWORD CVDI::Flush()
+{
+    STAT_COUNT(STAT_FLUSH);
+    return (m_hFile == NULL || fflush(m_hFile) == 0 ? NO_ERROR : ERROR_WRITE_FAULT);
+}
+
+DWORD CVDI::Offset(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset)
+{
+    return ERROR_NOT_SUPPORTED;
+}
+
+bool CVDI::SameTrack(const VDI_TRACK& Track1, const VDI_TRACK& Track2)
+{
+    return (Track1.nTrack == Track2.nTrack && Track1.nFirstSide == Track2.nFirstSide && Track1.nLastSide == Track2.nLastSide &&
+            Track1.nFirstSector == Track2.nFirstSector && Track1.nLastSector == Track2.nLastSector &&
+            Track1.wSectorSize == Track2.wSectorSize && Track1.nDensity == Track2.nDensity);
+}
@@ -61,6 +61,8 @@ protected:
     FILE			*m_hFile;                                                        // Handle for operations on the associated disk file
     DWORD           m_dwFlags;                                                      // User flags (future usage)
     VDI_GEOMETRY    m_DG;                                                           // Disk descriptor
+    bool            m_bKnownDG;                                                     // m_DG was preset by SetDG (skip its detection)
+    const char*     m_pMember;                                                      // Image to load from a container file (NULL: the first one)
 public:
                     CVDI();                                                                     // Initialize member variables
     virtual         ~CVDI();                                                                    // Release allocated memory
@@ -68,4 +70,9 @@ public:
     virtual DWORD   Read(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize)=0;   // Read one sector from the disk
     virtual DWORD   Write(BYTE nTrack, BYTE nSide, BYTE nSector, BYTE* pBuffer, WORD wSize)=0;  // Write one sector to the disk
     virtual void    GetDG(VDI_GEOMETRY& DG);                                                    // Copy the disk geometry to the caller's struct
+    void            SetDG(const VDI_GEOMETRY& DG);                                              // Preset a known disk geometry (before Load)
+    void            SetMember(const char* pMember);                                             // Name the image to load from a container (before Load)
+    virtual DWORD   Flush();                                                                    // Commit pending writes to the disk file
+    virtual DWORD   Offset(BYTE nTrack, BYTE nSide, BYTE nSector, DWORD& dwOffset);             // Image file offset of a sector stored as plain bytes
+    static bool     SameTrack(const VDI_TRACK& Track1, const VDI_TRACK& Track2);                // Compare two track descriptors
 };
@@ -55,6 +55,7 @@ enum errors
 	ERROR_DISK_TOO_FRAGMENTED,
 	ERROR_EMPTY,
 	ERROR_FILE_CORRUPT,
+	ERROR_FILE_EXISTS,
 	ERROR_FILE_NOT_FOUND,
 	ERROR_FLOPPY_ID_MARK_NOT_FOUND,
 	ERROR_FLOPPY_WRONG_CYLINDER,
@@ -87,6 +88,7 @@ const char *errors_msg[] = {
 	"DISK TOO FRAGMENTED",
 	"EMPTY",
 	"FILE CORRUPT",
+	"FILE EXISTS",
 	"FILE NOT FOUND",
 	"FLOPPY ID MARK NOT FOUND",
 	"FLOPPY WRONG CYLINDER",